@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Minimal microbenchmarking harness, see `bench_main.cpp` for the runner.
+//
+// Every benchmark is a function executed multiple times ("samples"),
+// each sample runs the measured loop for some number of iterations.
+// The number of iterations is calibrated so that one sample takes at least
+// `--min-sample-time` milliseconds. Setup/teardown code outside the loop
+// is not measured, so it's better to keep it out of the loop:
+//
+//     VOXEN_BENCHMARK("module/thing/operation")
+//     {
+//         <setup>
+//         while (state.next()) {
+//             <measured code>
+//         }
+//     }
+//
+// Results are printed as a human-readable table and can also be written
+// as JSON (`--json <path>`) for automated comparison between builds.
+namespace voxen::bench
+{
+
+class State {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit State(uint64_t iterations) noexcept : m_iterations(iterations), m_remaining(iterations) {}
+	State(State &&) = delete;
+	State(const State &) = delete;
+	State &operator=(State &&) = delete;
+	State &operator=(const State &) = delete;
+	~State() = default;
+
+	// Returns true while there are iterations remaining. Timer starts
+	// on the first call and stops when this function returns false.
+	bool next() noexcept
+	{
+		if (m_remaining == 0) [[unlikely]] {
+			m_end = Clock::now();
+			return false;
+		}
+
+		if (m_remaining == m_iterations) [[unlikely]] {
+			m_begin = Clock::now();
+		}
+
+		m_remaining--;
+		return true;
+	}
+
+	// Exclude a part of iteration from measurement, e.g. restoring the initial state.
+	// Keep in mind that clock reads are not free, don't do this for tiny operations.
+	void pauseTiming() noexcept { m_pause_begin = Clock::now(); }
+	void resumeTiming() noexcept { m_paused += Clock::now() - m_pause_begin; }
+
+	// Set the number of items processed by one iteration to report throughput
+	void setItemsPerIteration(uint64_t items) noexcept { m_items_per_iteration = items; }
+
+	uint64_t iterations() const noexcept { return m_iterations; }
+	uint64_t itemsPerIteration() const noexcept { return m_items_per_iteration; }
+	// Measured time of all iterations, valid after `next()` has returned false
+	Clock::duration elapsed() const noexcept { return m_end - m_begin - m_paused; }
+
+private:
+	const uint64_t m_iterations;
+	uint64_t m_remaining;
+	uint64_t m_items_per_iteration = 0;
+
+	Clock::time_point m_begin;
+	Clock::time_point m_end;
+	Clock::time_point m_pause_begin;
+	Clock::duration m_paused {};
+};
+
+using BenchmarkFn = void (*)(State &);
+
+// Do not use directly, see `VOXEN_BENCHMARK` macro
+struct Registrar {
+	Registrar(const char *name, BenchmarkFn fn);
+};
+
+// Prevent the compiler from optimizing out computation of `value`
+template<typename T>
+inline void doNotOptimize(const T &value) noexcept
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Prevent the compiler from caching memory contents across this point
+inline void clobberMemory() noexcept
+{
+	asm volatile("" : : : "memory");
+}
+
+} // namespace voxen::bench
+
+#define VOXEN_BENCHMARK_IMPL(name, id) \
+	static void voxenBenchmarkFn##id(::voxen::bench::State &state); \
+	static const ::voxen::bench::Registrar voxenBenchmarkReg##id(name, &voxenBenchmarkFn##id); \
+	static void voxenBenchmarkFn##id([[maybe_unused]] ::voxen::bench::State &state)
+
+#define VOXEN_BENCHMARK_EXPAND(name, id) VOXEN_BENCHMARK_IMPL(name, id)
+
+// Define a benchmark function with a given name (string literal), it receives `State &state` argument
+#define VOXEN_BENCHMARK(name) VOXEN_BENCHMARK_EXPAND(name, __LINE__)
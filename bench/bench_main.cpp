@@ -0,0 +1,313 @@
+#include "bench_common.hpp"
+
+#include <voxen/version.hpp>
+
+#include <cxxopts/cxxopts.hpp>
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+#include <fmt/os.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <exception>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voxen::bench
+{
+
+namespace
+{
+
+struct BenchmarkEntry {
+	const char *name;
+	BenchmarkFn fn;
+};
+
+struct BenchmarkResult {
+	const char *name;
+	uint64_t iterations;
+	uint64_t items_per_iteration;
+	// Time per iteration of every sample, sorted
+	std::vector<double> sample_ns;
+
+	double min_ns;
+	double median_ns;
+	double mean_ns;
+	double stddev_ns;
+};
+
+struct RunOptions {
+	std::string filter;
+	uint32_t num_samples;
+	double min_sample_time_ns;
+};
+
+// Cap calibration growth, some benchmarks have very uneven iteration times
+constexpr uint64_t MAX_ITERATIONS = uint64_t(1) << 30;
+constexpr uint64_t MAX_CALIBRATION_GROWTH = 100;
+
+std::vector<BenchmarkEntry> &registry()
+{
+	static std::vector<BenchmarkEntry> entries;
+	return entries;
+}
+
+std::vector<BenchmarkEntry> sortedEntries()
+{
+	std::vector<BenchmarkEntry> entries = registry();
+	std::sort(entries.begin(), entries.end(),
+		[](const BenchmarkEntry &a, const BenchmarkEntry &b) { return std::string_view(a.name) < b.name; });
+	return entries;
+}
+
+double runSample(BenchmarkFn fn, State &state)
+{
+	fn(state);
+	return static_cast<double>(std::chrono::nanoseconds(state.elapsed()).count());
+}
+
+uint64_t calibrate(BenchmarkFn fn, const RunOptions &opts)
+{
+	uint64_t iterations = 1;
+
+	while (iterations < MAX_ITERATIONS) {
+		State state(iterations);
+		const double ns = runSample(fn, state);
+
+		if (ns >= opts.min_sample_time_ns) {
+			break;
+		}
+
+		// Aim slightly above the target to not end up just below it again
+		const double estimate = ns > 0.0 ? opts.min_sample_time_ns * 1.2 / ns * double(iterations) : 0.0;
+		const uint64_t next = std::max(iterations * 2, static_cast<uint64_t>(estimate));
+		iterations = std::min({ next, iterations * MAX_CALIBRATION_GROWTH, MAX_ITERATIONS });
+	}
+
+	return iterations;
+}
+
+BenchmarkResult runBenchmark(const BenchmarkEntry &entry, const RunOptions &opts)
+{
+	BenchmarkResult result {};
+	result.name = entry.name;
+	result.iterations = calibrate(entry.fn, opts);
+
+	for (uint32_t i = 0; i < opts.num_samples; i++) {
+		State state(result.iterations);
+		const double ns = runSample(entry.fn, state);
+		result.sample_ns.push_back(ns / double(result.iterations));
+		result.items_per_iteration = state.itemsPerIteration();
+	}
+
+	auto &samples = result.sample_ns;
+	std::sort(samples.begin(), samples.end());
+
+	const size_t n = samples.size();
+	result.min_ns = samples.front();
+	result.median_ns = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) * 0.5;
+	result.mean_ns = std::accumulate(samples.begin(), samples.end(), 0.0) / double(n);
+
+	double variance = 0.0;
+	for (double s : samples) {
+		variance += (s - result.mean_ns) * (s - result.mean_ns);
+	}
+	result.stddev_ns = n > 1 ? std::sqrt(variance / double(n - 1)) : 0.0;
+
+	return result;
+}
+
+std::string formatTime(double ns)
+{
+	if (ns < 1e3) {
+		return fmt::format("{:.2f} ns", ns);
+	} else if (ns < 1e6) {
+		return fmt::format("{:.2f} us", ns * 1e-3);
+	} else if (ns < 1e9) {
+		return fmt::format("{:.2f} ms", ns * 1e-6);
+	}
+
+	return fmt::format("{:.2f} s", ns * 1e-9);
+}
+
+double itemsPerSecond(const BenchmarkResult &result)
+{
+	return double(result.items_per_iteration) * 1e9 / result.median_ns;
+}
+
+void printResult(const BenchmarkResult &result)
+{
+	std::string throughput;
+	if (result.items_per_iteration > 0) {
+		throughput = fmt::format("{:.3g} items/s", itemsPerSecond(result));
+	}
+
+	fmt::print("{:<56} {:>12} {:>12} {:>8.2f}% {:>12} {}\n", result.name, formatTime(result.median_ns),
+		formatTime(result.min_ns), result.stddev_ns * 100.0 / result.mean_ns, result.iterations, throughput);
+}
+
+// Benchmark names are under our control, but escape them anyway to always produce valid JSON
+std::string jsonEscape(std::string_view str)
+{
+	std::string out;
+	out.reserve(str.size());
+
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back(c);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out += fmt::format("\\u{:04x}", int(c));
+		} else {
+			out.push_back(c);
+		}
+	}
+
+	return out;
+}
+
+void writeJson(const std::string &path, const std::vector<BenchmarkResult> &results, const RunOptions &opts)
+{
+	const std::time_t now = std::time(nullptr);
+
+	std::string out = "{\n\t\"context\": {\n";
+	out += fmt::format("\t\t\"version\": \"{}\",\n", jsonEscape(Version::STRING));
+	out += fmt::format("\t\t\"git_hash\": \"{}\",\n", jsonEscape(Version::GIT_HASH));
+	out += fmt::format("\t\t\"debug_build\": {},\n", VOXEN_DEBUG_BUILD ? "true" : "false");
+	out += fmt::format("\t\t\"date\": \"{:%Y-%m-%dT%H:%M:%SZ}\",\n", fmt::gmtime(now));
+	out += fmt::format("\t\t\"hardware_threads\": {},\n", std::thread::hardware_concurrency());
+	out += fmt::format("\t\t\"num_samples\": {},\n", opts.num_samples);
+	out += fmt::format("\t\t\"min_sample_time_ns\": {:.0f}\n", opts.min_sample_time_ns);
+	out += "\t},\n\t\"benchmarks\": [";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult &r = results[i];
+
+		out += i > 0 ? ",\n\t\t{\n" : "\n\t\t{\n";
+		out += fmt::format("\t\t\t\"name\": \"{}\",\n", jsonEscape(r.name));
+		out += fmt::format("\t\t\t\"iterations\": {},\n", r.iterations);
+		out += fmt::format("\t\t\t\"min_ns\": {:.3f},\n", r.min_ns);
+		out += fmt::format("\t\t\t\"median_ns\": {:.3f},\n", r.median_ns);
+		out += fmt::format("\t\t\t\"mean_ns\": {:.3f},\n", r.mean_ns);
+		out += fmt::format("\t\t\t\"stddev_ns\": {:.3f},\n", r.stddev_ns);
+
+		if (r.items_per_iteration > 0) {
+			out += fmt::format("\t\t\t\"items_per_iteration\": {},\n", r.items_per_iteration);
+			out += fmt::format("\t\t\t\"items_per_second\": {:.1f},\n", itemsPerSecond(r));
+		}
+
+		out += fmt::format("\t\t\t\"samples_ns\": [{:.3f}]\n\t\t}}", fmt::join(r.sample_ns, ", "));
+	}
+
+	out += "\n\t]\n}\n";
+
+	if (path == "-") {
+		fmt::print("{}", out);
+	} else {
+		auto file = fmt::output_file(path);
+		file.print("{}", out);
+	}
+}
+
+} // namespace
+
+Registrar::Registrar(const char *name, BenchmarkFn fn)
+{
+	registry().push_back(BenchmarkEntry { name, fn });
+}
+
+} // namespace voxen::bench
+
+int main(int argc, char *argv[])
+{
+	using namespace voxen::bench;
+
+	cxxopts::Options options("bench-voxen", "Voxen microbenchmarks");
+
+	// clang-format off: breaks nice chaining syntax
+	options.add_options()
+		("h,help", "Display help information")
+		("l,list", "List benchmark names and exit")
+		("f,filter", "Run only benchmarks with names containing this substring",
+			cxxopts::value<std::string>()->default_value(""))
+		("j,json", "Write results as JSON into this file ('-' for stdout)", cxxopts::value<std::string>())
+		("s,samples", "Number of samples to collect per benchmark", cxxopts::value<uint32_t>()->default_value("10"))
+		("t,min-sample-time", "Minimal duration of one sample, milliseconds",
+			cxxopts::value<double>()->default_value("50"));
+	// clang-format on
+
+	RunOptions opts;
+	std::string json_path;
+
+	try {
+		auto parsed = options.parse(argc, argv);
+
+		if (parsed.count("help")) {
+			fmt::print("{}\n", options.help());
+			return 0;
+		}
+
+		opts.filter = parsed["filter"].as<std::string>();
+		opts.num_samples = std::max(parsed["samples"].as<uint32_t>(), 1u);
+		opts.min_sample_time_ns = parsed["min-sample-time"].as<double>() * 1e6;
+
+		if (parsed.count("json")) {
+			json_path = parsed["json"].as<std::string>();
+		}
+
+		if (parsed.count("list")) {
+			for (const auto &entry : sortedEntries()) {
+				fmt::print("{}\n", entry.name);
+			}
+			return 0;
+		}
+	}
+	catch (cxxopts::exceptions::exception &ex) {
+		fmt::print(stderr, "Invalid options provided, use -h (--help) to get usage help.\n{}\n", ex.what());
+		return 1;
+	}
+
+	const auto entries = sortedEntries();
+
+	// Don't pollute stdout when JSON goes there
+	const bool print_table = json_path != "-";
+	if (print_table) {
+		fmt::print("{:<56} {:>12} {:>12} {:>9} {:>12}\n", "Benchmark", "Median", "Min", "StdDev", "Iterations");
+	}
+
+	std::vector<BenchmarkResult> results;
+	int exit_code = 0;
+
+	for (const auto &entry : entries) {
+		if (std::string_view(entry.name).find(opts.filter) == std::string_view::npos) {
+			continue;
+		}
+
+		try {
+			results.emplace_back(runBenchmark(entry, opts));
+			if (print_table) {
+				printResult(results.back());
+			}
+		}
+		catch (const std::exception &ex) {
+			fmt::print(stderr, "Benchmark '{}' failed: {}\n", entry.name, ex.what());
+			exit_code = 1;
+		}
+	}
+
+	if (!json_path.empty()) {
+		try {
+			writeJson(json_path, results, opts);
+		}
+		catch (const std::exception &ex) {
+			fmt::print(stderr, "Failed to write JSON results: {}\n", ex.what());
+			exit_code = 1;
+		}
+	}
+
+	return exit_code;
+}
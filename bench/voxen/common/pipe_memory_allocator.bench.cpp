@@ -0,0 +1,141 @@
+#include <voxen/common/pipe_memory_allocator.hpp>
+
+#include <voxen/svc/engine.hpp>
+
+#include "../../bench_common.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <thread>
+#include <vector>
+
+namespace voxen
+{
+
+namespace
+{
+
+// Number of allocations made by every thread in one iteration
+constexpr size_t BATCH_SIZE = 1024;
+
+// Allocate a batch of differently-sized objects then free them in allocation order,
+// roughly resembling message payloads being sent and consumed from a queue
+void allocateBatch(void *(&ptrs)[BATCH_SIZE])
+{
+	for (size_t i = 0; i < BATCH_SIZE; i++) {
+		ptrs[i] = PipeMemoryAllocator::allocate(16 + (i % 8) * 24, 8);
+	}
+
+	for (size_t i = 0; i < BATCH_SIZE; i++) {
+		PipeMemoryAllocator::deallocate(ptrs[i]);
+	}
+}
+
+void runContended(bench::State &state, uint32_t num_threads)
+{
+	auto engine = svc::Engine::createForTestSuite();
+	engine->serviceLocator().requestService<PipeMemoryAllocator>();
+
+	// Main thread takes part in the work too
+	std::barrier<> sync_point { std::ptrdiff_t(num_threads) };
+	std::atomic_bool stop = false;
+
+	auto worker_fn = [&] {
+		void *ptrs[BATCH_SIZE];
+
+		while (true) {
+			sync_point.arrive_and_wait();
+			if (stop.load(std::memory_order_relaxed)) {
+				return;
+			}
+
+			allocateBatch(ptrs);
+			sync_point.arrive_and_wait();
+		}
+	};
+
+	std::vector<std::jthread> workers;
+	for (uint32_t i = 1; i < num_threads; i++) {
+		workers.emplace_back(worker_fn);
+	}
+
+	state.setItemsPerIteration(BATCH_SIZE * num_threads);
+
+	void *ptrs[BATCH_SIZE];
+	while (state.next()) {
+		sync_point.arrive_and_wait();
+		allocateBatch(ptrs);
+		sync_point.arrive_and_wait();
+	}
+
+	stop.store(true, std::memory_order_relaxed);
+	sync_point.arrive_and_wait();
+}
+
+} // namespace
+
+VOXEN_BENCHMARK("common/pipe_memory_allocator/alloc_free")
+{
+	auto engine = svc::Engine::createForTestSuite();
+	engine->serviceLocator().requestService<PipeMemoryAllocator>();
+
+	state.setItemsPerIteration(BATCH_SIZE);
+
+	void *ptrs[BATCH_SIZE];
+	while (state.next()) {
+		allocateBatch(ptrs);
+	}
+}
+
+VOXEN_BENCHMARK("common/pipe_memory_allocator/alloc_free_contended")
+{
+	runContended(state, std::clamp(std::thread::hardware_concurrency(), 2u, 8u));
+}
+
+VOXEN_BENCHMARK("common/pipe_memory_allocator/cross_thread_free")
+{
+	// Producer allocates, consumer frees - the main usage pattern of this allocator
+	auto engine = svc::Engine::createForTestSuite();
+	engine->serviceLocator().requestService<PipeMemoryAllocator>();
+
+	struct Batch {
+		void *ptrs[BATCH_SIZE];
+		// Set instead of filling `ptrs` to stop the consumer
+		bool last = false;
+	};
+
+	// Consumer frees one batch while producer fills the other one
+	Batch batches[2];
+	std::barrier<> sync_point(2);
+
+	std::jthread consumer([&] {
+		for (size_t phase = 0;; phase ^= 1) {
+			sync_point.arrive_and_wait();
+			if (batches[phase].last) {
+				return;
+			}
+
+			for (void *ptr : batches[phase].ptrs) {
+				PipeMemoryAllocator::deallocate(ptr);
+			}
+		}
+	});
+
+	state.setItemsPerIteration(BATCH_SIZE);
+
+	size_t phase = 0;
+	while (state.next()) {
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+			batches[phase].ptrs[i] = PipeMemoryAllocator::allocate(16 + (i % 8) * 24, 8);
+		}
+
+		sync_point.arrive_and_wait();
+		phase ^= 1;
+	}
+
+	batches[phase].last = true;
+	sync_point.arrive_and_wait();
+}
+
+} // namespace voxen
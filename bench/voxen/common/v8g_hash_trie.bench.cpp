@@ -0,0 +1,186 @@
+#include <voxen/common/v8g_hash_trie.hpp>
+#include <voxen/common/v8g_hash_trie_impl.hpp>
+
+#include "../../bench_common.hpp"
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace voxen
+{
+
+namespace
+{
+
+struct TrivialKey {
+	uint64_t key;
+
+	auto operator<=>(const TrivialKey &other) const = default;
+	uint64_t hash() const noexcept { return key; }
+};
+
+using Trie = V8gHashTrie<TrivialKey, uint64_t>;
+
+constexpr size_t NUM_KEYS = 10'000;
+// Number of keys changed between snapshots in `visitDiff` benchmark
+constexpr size_t NUM_DIFF_KEYS = NUM_KEYS / 100;
+
+std::vector<uint64_t> makeKeys()
+{
+	std::mt19937_64 rng(0xDEADBEEF);
+
+	std::vector<uint64_t> keys(NUM_KEYS);
+	for (auto &key : keys) {
+		key = rng();
+	}
+
+	return keys;
+}
+
+Trie makeTrie(const std::vector<uint64_t> &keys, uint64_t timeline)
+{
+	Trie trie;
+	for (uint64_t key : keys) {
+		trie.insert(timeline, TrivialKey(key), Trie::makeValuePtr(key));
+	}
+	return trie;
+}
+
+} // namespace
+
+VOXEN_BENCHMARK("common/v8g_hash_trie/insert")
+{
+	const auto keys = makeKeys();
+	state.setItemsPerIteration(keys.size());
+
+	while (state.next()) {
+		Trie trie = makeTrie(keys, 1);
+		voxen::bench::doNotOptimize(trie);
+	}
+}
+
+VOXEN_BENCHMARK("common/v8g_hash_trie/find")
+{
+	const auto keys = makeKeys();
+	const Trie trie = makeTrie(keys, 1);
+	state.setItemsPerIteration(keys.size());
+
+	while (state.next()) {
+		for (uint64_t key : keys) {
+			voxen::bench::doNotOptimize(trie.find(TrivialKey(key)));
+		}
+	}
+}
+
+VOXEN_BENCHMARK("common/v8g_hash_trie/erase")
+{
+	const auto keys = makeKeys();
+	const Trie original = makeTrie(keys, 1);
+	state.setItemsPerIteration(keys.size());
+
+	while (state.next()) {
+		// Cheap copy, then erase causes copy-on-write of nodes just like in real usage
+		Trie trie = original;
+		for (uint64_t key : keys) {
+			trie.erase(2, TrivialKey(key));
+		}
+		voxen::bench::doNotOptimize(trie);
+	}
+}
+
+VOXEN_BENCHMARK("common/v8g_hash_trie/insert_batch")
+{
+	auto keys = makeKeys();
+	std::ranges::sort(keys);
+	state.setItemsPerIteration(keys.size());
+
+	std::vector<Trie::BatchItem> items;
+	items.reserve(keys.size());
+
+	while (state.next()) {
+		// Value pointer creation is included, as in `insert` benchmark
+		items.clear();
+		for (uint64_t key : keys) {
+			items.emplace_back(TrivialKey(key), Trie::makeValuePtr(key));
+		}
+
+		Trie trie;
+		trie.insertBatch(1, items);
+		voxen::bench::doNotOptimize(trie);
+	}
+}
+
+VOXEN_BENCHMARK("common/v8g_hash_trie/erase_batch")
+{
+	auto keys = makeKeys();
+	const Trie original = makeTrie(keys, 1);
+	std::ranges::sort(keys);
+	state.setItemsPerIteration(keys.size());
+
+	std::vector<TrivialKey> batch(keys.begin(), keys.end());
+
+	while (state.next()) {
+		Trie trie = original;
+		trie.eraseBatch(2, batch);
+		voxen::bench::doNotOptimize(trie);
+	}
+}
+
+VOXEN_BENCHMARK("common/v8g_hash_trie/visit_diff")
+{
+	const auto keys = makeKeys();
+	const Trie old_trie = makeTrie(keys, 1);
+
+	Trie new_trie = old_trie;
+	for (size_t i = 0; i < NUM_DIFF_KEYS; i++) {
+		const uint64_t key = keys[i * (NUM_KEYS / NUM_DIFF_KEYS)];
+		new_trie.insert(2, TrivialKey(key), Trie::makeValuePtr(key + 1));
+	}
+
+	state.setItemsPerIteration(NUM_DIFF_KEYS);
+
+	while (state.next()) {
+		size_t visited = 0;
+		new_trie.visitDiff(old_trie, [&](const Trie::Item *, const Trie::Item *) {
+			visited++;
+			return true;
+		});
+		voxen::bench::doNotOptimize(visited);
+	}
+}
+
+// Baseline for comparison, the trie header quotes relative numbers against it
+VOXEN_BENCHMARK("common/std_unordered_map/insert")
+{
+	const auto keys = makeKeys();
+	state.setItemsPerIteration(keys.size());
+
+	while (state.next()) {
+		std::unordered_map<uint64_t, std::shared_ptr<uint64_t>> map;
+		for (uint64_t key : keys) {
+			map[key] = std::make_shared<uint64_t>(key);
+		}
+		voxen::bench::doNotOptimize(map);
+	}
+}
+
+VOXEN_BENCHMARK("common/std_unordered_map/find")
+{
+	const auto keys = makeKeys();
+	std::unordered_map<uint64_t, std::shared_ptr<uint64_t>> map;
+	for (uint64_t key : keys) {
+		map[key] = std::make_shared<uint64_t>(key);
+	}
+
+	state.setItemsPerIteration(keys.size());
+
+	while (state.next()) {
+		for (uint64_t key : keys) {
+			voxen::bench::doNotOptimize(map.find(key));
+		}
+	}
+}
+
+} // namespace voxen
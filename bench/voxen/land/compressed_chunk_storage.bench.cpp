@@ -0,0 +1,138 @@
+#include <voxen/land/compressed_chunk_storage.hpp>
+
+#include "../../bench_common.hpp"
+#include "land_bench_utils.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace voxen::land
+{
+
+namespace
+{
+
+using Storage = CompressedChunkStorage<uint16_t>;
+using Array = CubeArray<uint16_t, Consts::CHUNK_SIZE_BLOCKS>;
+
+constexpr size_t NUM_RANDOM_ACCESSES = 1024;
+
+std::unique_ptr<Array> makeTerrainArray()
+{
+	auto array = std::make_unique<Array>();
+	bench::fillTerrain(*array, glm::ivec3(0, -1, 0));
+	return array;
+}
+
+std::vector<glm::uvec3> makeRandomPositions()
+{
+	std::mt19937 rng(0x5EED);
+	std::uniform_int_distribution<uint32_t> dist(0, Consts::CHUNK_SIZE_BLOCKS - 1);
+
+	std::vector<glm::uvec3> positions(NUM_RANDOM_ACCESSES);
+	for (auto &pos : positions) {
+		pos = glm::uvec3(dist(rng), dist(rng), dist(rng));
+	}
+
+	return positions;
+}
+
+} // namespace
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/compress_terrain")
+{
+	auto array = makeTerrainArray();
+
+	while (state.next()) {
+		Storage storage(array->cview());
+		voxen::bench::doNotOptimize(storage);
+	}
+}
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/compress_uniform")
+{
+	auto array = std::make_unique<Array>();
+	array->fill(TempBlockMeta::BlockStone);
+
+	while (state.next()) {
+		Storage storage(array->cview());
+		voxen::bench::doNotOptimize(storage);
+	}
+}
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/expand_terrain")
+{
+	auto array = makeTerrainArray();
+	Storage storage(array->cview());
+
+	while (state.next()) {
+		storage.expand(array->view());
+		voxen::bench::clobberMemory();
+	}
+}
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/load_random")
+{
+	auto array = makeTerrainArray();
+	Storage storage(array->cview());
+	const auto positions = makeRandomPositions();
+
+	state.setItemsPerIteration(positions.size());
+
+	while (state.next()) {
+		uint32_t sum = 0;
+		for (glm::uvec3 pos : positions) {
+			sum += storage[pos];
+		}
+		voxen::bench::doNotOptimize(sum);
+	}
+}
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/store_random")
+{
+	auto array = makeTerrainArray();
+	const Storage original(array->cview());
+	const auto positions = makeRandomPositions();
+
+	state.setItemsPerIteration(positions.size());
+
+	while (state.next()) {
+		state.pauseTiming();
+		Storage storage = original;
+		state.resumeTiming();
+
+		for (glm::uvec3 pos : positions) {
+			storage.store(pos, TempBlockMeta::BlockWater);
+		}
+		voxen::bench::doNotOptimize(storage);
+	}
+}
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/compress_bool")
+{
+	auto array = makeTerrainArray();
+	auto bools = std::make_unique<CubeArray<bool, Consts::CHUNK_SIZE_BLOCKS>>();
+	std::transform(array->begin(), array->end(), bools->begin(), [](uint16_t id) { return id != 0; });
+
+	while (state.next()) {
+		CompressedChunkStorage<bool> storage(bools->cview());
+		voxen::bench::doNotOptimize(storage);
+	}
+}
+
+VOXEN_BENCHMARK("land/compressed_chunk_storage/expand_bool")
+{
+	auto array = makeTerrainArray();
+	auto bools = std::make_unique<CubeArray<bool, Consts::CHUNK_SIZE_BLOCKS>>();
+	std::transform(array->begin(), array->end(), bools->begin(), [](uint16_t id) { return id != 0; });
+	CompressedChunkStorage<bool> storage(bools->cview());
+
+	while (state.next()) {
+		storage.expand(bools->view());
+		voxen::bench::clobberMemory();
+	}
+}
+
+} // namespace voxen::land
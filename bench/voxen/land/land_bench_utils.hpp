@@ -0,0 +1,69 @@
+#pragma once
+
+#include <voxen/land/land_chunk.hpp>
+#include <voxen/land/land_public_consts.hpp>
+#include <voxen/land/land_temp_blocks.hpp>
+
+#include <glm/vec3.hpp>
+
+#include <cmath>
+#include <memory>
+
+namespace voxen::land::bench
+{
+
+// Fill `output` with terrain-like contents of the chunk located at `chunk_base` (in chunks).
+// Gives a wavy surface crossing chunks with Y in [-1; 0], stone below it with sparse random
+// inclusions, a few dirt layers and grass on top. Adjacent chunks are filled consistently.
+inline void fillTerrain(Chunk::BlockIdArray &output, glm::ivec3 chunk_base)
+{
+	constexpr int32_t N = Consts::CHUNK_SIZE_BLOCKS;
+
+	for (int32_t x = 0; x < N; x++) {
+		for (int32_t z = 0; z < N; z++) {
+			const int32_t wx = chunk_base.x * N + x;
+			const int32_t wz = chunk_base.z * N + z;
+
+			const double height = 8.0 * std::sin(wx * 0.11) + 6.0 * std::cos(wz * 0.07)
+				+ 4.0 * std::sin((wx + wz) * 0.23);
+			const auto surface = static_cast<int32_t>(std::floor(height));
+
+			for (int32_t y = 0; y < N; y++) {
+				const int32_t wy = chunk_base.y * N + y;
+
+				// Cheap integer hash for "random" inclusions
+				uint32_t hash = uint32_t(wx) * 0x9E3779B1u ^ uint32_t(wy) * 0x85EBCA77u ^ uint32_t(wz) * 0xC2B2AE3Du;
+				hash ^= hash >> 15;
+				hash *= 0x2C1B3C6Du;
+				hash ^= hash >> 12;
+
+				Chunk::BlockId block = TempBlockMeta::BlockEmpty;
+
+				if (wy > surface) {
+					block = TempBlockMeta::BlockEmpty;
+				} else if (wy == surface) {
+					block = TempBlockMeta::BlockGrass;
+				} else if (wy > surface - 4) {
+					block = TempBlockMeta::BlockDirt;
+				} else {
+					block = (hash % 32 == 0) ? TempBlockMeta::BlockSand : TempBlockMeta::BlockStone;
+				}
+
+				output.store(x, y, z, block);
+			}
+		}
+	}
+}
+
+// Make a chunk filled by `fillTerrain()`
+inline Chunk makeTerrainChunk(glm::ivec3 chunk_base)
+{
+	auto array = std::make_unique<Chunk::BlockIdArray>();
+	fillTerrain(*array, chunk_base);
+
+	Chunk chunk;
+	chunk.setAllBlocks(array->cview());
+	return chunk;
+}
+
+} // namespace voxen::land::bench
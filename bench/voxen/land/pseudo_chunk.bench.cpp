@@ -0,0 +1,196 @@
+#include <voxen/land/pseudo_chunk_data.hpp>
+#include <voxen/land/pseudo_chunk_surface.hpp>
+
+#include "../../bench_common.hpp"
+#include "land_bench_utils.hpp"
+
+#include <map>
+#include <span>
+#include <vector>
+
+namespace voxen::land
+{
+
+namespace
+{
+
+// Terrain chunks around the surface and LOD1 pseudo-chunk data generated from them.
+// Building it takes a while, so it's done once and shared by all benchmarks.
+class Fixture {
+public:
+	// Chunks are stored for coordinates in [GRID_MIN; GRID_MIN + GRID_SIZE) per axis
+	constexpr static glm::ivec3 GRID_MIN = glm::ivec3(-2, -4, -2);
+	constexpr static int32_t GRID_SIZE = 7;
+
+	// LOD1 pseudo-chunk taking part in all benchmarks, contains terrain surface
+	constexpr static glm::ivec3 LOD1_BASE = glm::ivec3(0, -2, 0);
+	// LOD2 pseudo-chunk aggregated from 8 LOD1 ones
+	constexpr static glm::ivec3 LOD2_BASE = glm::ivec3(0, -4, 0);
+
+	Fixture()
+	{
+		m_chunks.reserve(GRID_SIZE * GRID_SIZE * GRID_SIZE);
+
+		for (int32_t y = 0; y < GRID_SIZE; y++) {
+			for (int32_t x = 0; x < GRID_SIZE; x++) {
+				for (int32_t z = 0; z < GRID_SIZE; z++) {
+					m_chunks.emplace_back(bench::makeTerrainChunk(GRID_MIN + glm::ivec3(x, y, z)));
+				}
+			}
+		}
+
+		for (glm::ivec3 offset : lod1SurfaceOffsets()) {
+			ensureLod1Data(LOD1_BASE + offset);
+		}
+
+		for (int32_t i = 0; i < 8; i++) {
+			ensureLod1Data(LOD2_BASE + 2 * glm::ivec3((i >> 1) & 1, i >> 2, i & 1));
+		}
+	}
+
+	const Chunk &chunk(glm::ivec3 base) const noexcept
+	{
+		const glm::ivec3 c = base - GRID_MIN;
+		return m_chunks[size_t((c.y * GRID_SIZE + c.x) * GRID_SIZE + c.z)];
+	}
+
+	const PseudoChunkData &lod1Data(glm::ivec3 base) const { return m_lod1_datas.at(ChunkKey(base, 1)); }
+
+	// Fill pointers in the order expected by `PseudoChunkData::generateFromLod0()`
+	void collectLod0Chunks(glm::ivec3 base, std::span<const Chunk *, 27> out) const noexcept
+	{
+		constexpr glm::ivec3 OFFSETS[27] = {
+			{ 0, 0, 0 }, { 0, 0, 1 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 0 }, { 1, 1, 1 },
+			{ 2, 0, 0 }, { 2, 0, 1 }, { 2, 1, 0 }, { 2, 1, 1 }, { 0, 2, 0 }, { 0, 2, 1 }, { 1, 2, 0 }, { 1, 2, 1 },
+			{ 0, 0, 2 }, { 1, 0, 2 }, { 0, 1, 2 }, { 1, 1, 2 }, { 0, 2, 2 }, { 1, 2, 2 }, { 2, 0, 2 }, { 2, 1, 2 },
+			{ 2, 2, 0 }, { 2, 2, 1 }, { 2, 2, 2 },
+		};
+
+		for (size_t i = 0; i < 27; i++) {
+			out[i] = &chunk(base + OFFSETS[i]);
+		}
+	}
+
+	// Offsets (in LOD1 chunks) of 19 pseudo-chunks in the order
+	// expected by `PseudoChunkSurface::generate()`, multiply by scale
+	static std::span<const glm::ivec3, 19> lod1SurfaceOffsets() noexcept
+	{
+		constexpr static glm::ivec3 OFFSETS[19] = {
+			{ 0, 0, 0 },
+			{ 2, 0, 0 },
+			{ -2, 0, 0 },
+			{ 0, 2, 0 },
+			{ 0, -2, 0 },
+			{ 0, 0, 2 },
+			{ 0, 0, -2 },
+			{ 0, -2, -2 },
+			{ 0, -2, 2 },
+			{ 0, 2, -2 },
+			{ 0, 2, 2 },
+			{ -2, 0, -2 },
+			{ -2, 0, 2 },
+			{ 2, 0, -2 },
+			{ 2, 0, 2 },
+			{ -2, -2, 0 },
+			{ 2, -2, 0 },
+			{ -2, 2, 0 },
+			{ 2, 2, 0 },
+		};
+
+		return OFFSETS;
+	}
+
+private:
+	std::vector<Chunk> m_chunks;
+	std::map<ChunkKey, PseudoChunkData> m_lod1_datas;
+
+	void ensureLod1Data(glm::ivec3 base)
+	{
+		const ChunkKey key(base, 1);
+		if (m_lod1_datas.contains(key)) {
+			return;
+		}
+
+		const Chunk *ptrs[27];
+		collectLod0Chunks(base, ptrs);
+		m_lod1_datas.emplace(key, key).first->second.generateFromLod0(ptrs);
+	}
+};
+
+const Fixture &fixture()
+{
+	static const Fixture instance;
+	return instance;
+}
+
+} // namespace
+
+VOXEN_BENCHMARK("land/pseudo_chunk_data/generate_from_lod0")
+{
+	const Fixture &fix = fixture();
+
+	const Chunk *ptrs[27];
+	fix.collectLod0Chunks(Fixture::LOD1_BASE, ptrs);
+
+	while (state.next()) {
+		PseudoChunkData data(ChunkKey(Fixture::LOD1_BASE, 1));
+		data.generateFromLod0(ptrs);
+		voxen::bench::doNotOptimize(data);
+	}
+}
+
+VOXEN_BENCHMARK("land/pseudo_chunk_data/generate_from_finer_lod")
+{
+	const Fixture &fix = fixture();
+
+	const PseudoChunkData *ptrs[8];
+	for (int32_t i = 0; i < 8; i++) {
+		ptrs[i] = &fix.lod1Data(Fixture::LOD2_BASE + 2 * glm::ivec3((i >> 1) & 1, i >> 2, i & 1));
+	}
+
+	while (state.next()) {
+		PseudoChunkData data(ChunkKey(Fixture::LOD2_BASE, 2));
+		data.generateFromFinerLod(ptrs);
+		voxen::bench::doNotOptimize(data);
+	}
+}
+
+VOXEN_BENCHMARK("land/pseudo_chunk_surface/generate_lod0")
+{
+	const Fixture &fix = fixture();
+
+	// Chunk at Y=-1 is crossed by the terrain surface
+	const glm::ivec3 base(0, -1, 0);
+
+	ChunkAdjacencyRef adj(fix.chunk(base));
+	adj.adjacent[0] = &fix.chunk(base + glm::ivec3(1, 0, 0));
+	adj.adjacent[1] = &fix.chunk(base - glm::ivec3(1, 0, 0));
+	adj.adjacent[2] = &fix.chunk(base + glm::ivec3(0, 1, 0));
+	adj.adjacent[3] = &fix.chunk(base - glm::ivec3(0, 1, 0));
+	adj.adjacent[4] = &fix.chunk(base + glm::ivec3(0, 0, 1));
+	adj.adjacent[5] = &fix.chunk(base - glm::ivec3(0, 0, 1));
+
+	while (state.next()) {
+		PseudoChunkSurface surface;
+		surface.generate(adj);
+		voxen::bench::doNotOptimize(surface);
+	}
+}
+
+VOXEN_BENCHMARK("land/pseudo_chunk_surface/generate_lod1")
+{
+	const Fixture &fix = fixture();
+
+	const PseudoChunkData *ptrs[19];
+	for (size_t i = 0; i < 19; i++) {
+		ptrs[i] = &fix.lod1Data(Fixture::LOD1_BASE + Fixture::lod1SurfaceOffsets()[i]);
+	}
+
+	while (state.next()) {
+		PseudoChunkSurface surface;
+		surface.generate(ptrs, 1);
+		voxen::bench::doNotOptimize(surface);
+	}
+}
+
+} // namespace voxen::land
@@ -0,0 +1,133 @@
+#include <voxen/svc/message_queue.hpp>
+
+#include <voxen/svc/engine.hpp>
+#include <voxen/svc/messaging_service.hpp>
+
+#include "../../bench_common.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace voxen::svc
+{
+
+namespace
+{
+
+struct BenchUnicastMessage {
+	constexpr static UID MESSAGE_UID = UID("3c1f6b0e-8e5d2a47-b6c03f19-d42a7e51");
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Unicast;
+
+	uint64_t a;
+	uint64_t b;
+	uint64_t c;
+	uint64_t d;
+};
+
+struct BenchRequestMessage {
+	constexpr static UID MESSAGE_UID = UID("9a27d4c8-51e3b06f-2c8f4a1d-e7b5930c");
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Request;
+
+	uint64_t a;
+	uint64_t b;
+	uint64_t sum;
+};
+
+constexpr UID SENDER_UID("0b9e4d7a-6c2f18e3-a5d1b74c-39f0e286");
+constexpr UID RECEIVER_UID("e4c81a3f-97b2d05e-1f6a3c8d-b20e75a4");
+
+// Number of messages sent in one iteration
+constexpr size_t NUM_MESSAGES = 1000;
+
+} // namespace
+
+VOXEN_BENCHMARK("svc/message_queue/send_poll")
+{
+	auto engine = Engine::createForTestSuite();
+	auto &msg = engine->serviceLocator().requestService<MessagingService>();
+
+	uint64_t sum = 0;
+
+	MessageQueue sender = msg.registerAgent(SENDER_UID);
+	MessageQueue receiver = msg.registerAgent(RECEIVER_UID);
+	receiver.registerHandler<BenchUnicastMessage>(
+		[&sum](BenchUnicastMessage &m, MessageInfo &) { sum += m.a + m.d; });
+
+	state.setItemsPerIteration(NUM_MESSAGES);
+
+	while (state.next()) {
+		for (size_t i = 0; i < NUM_MESSAGES; i++) {
+			sender.send<BenchUnicastMessage>(RECEIVER_UID, uint64_t(i), uint64_t(1), uint64_t(2), uint64_t(3));
+		}
+
+		receiver.pollMessages();
+	}
+
+	voxen::bench::doNotOptimize(sum);
+}
+
+VOXEN_BENCHMARK("svc/message_queue/request_completion")
+{
+	auto engine = Engine::createForTestSuite();
+	auto &msg = engine->serviceLocator().requestService<MessagingService>();
+
+	uint64_t sum = 0;
+
+	MessageQueue sender = msg.registerAgent(SENDER_UID);
+	MessageQueue receiver = msg.registerAgent(RECEIVER_UID);
+	receiver.registerHandler<BenchRequestMessage>([](BenchRequestMessage &m, MessageInfo &) { m.sum = m.a + m.b; });
+	sender.registerCompletionHandler<BenchRequestMessage>(
+		[&sum](BenchRequestMessage &m, RequestCompletionInfo &) { sum += m.sum; });
+
+	state.setItemsPerIteration(NUM_MESSAGES);
+
+	while (state.next()) {
+		for (size_t i = 0; i < NUM_MESSAGES; i++) {
+			sender.requestWithCompletion<BenchRequestMessage>(RECEIVER_UID, uint64_t(i), uint64_t(1), uint64_t(0));
+		}
+
+		receiver.pollMessages();
+		sender.pollMessages();
+	}
+
+	voxen::bench::doNotOptimize(sum);
+}
+
+VOXEN_BENCHMARK("svc/message_queue/cross_thread")
+{
+	// Sender and receiver in different threads, receiver is blocked in `waitMessages()`
+	auto engine = Engine::createForTestSuite();
+	auto &msg = engine->serviceLocator().requestService<MessagingService>();
+
+	MessageQueue sender = msg.registerAgent(SENDER_UID);
+	MessageQueue receiver = msg.registerAgent(RECEIVER_UID);
+
+	std::atomic_uint64_t received = 0;
+	receiver.registerHandler<BenchUnicastMessage>(
+		[&received](BenchUnicastMessage &, MessageInfo &) { received.fetch_add(1, std::memory_order_release); });
+
+	std::atomic_bool stop = false;
+	std::jthread receiver_thread([&] {
+		while (!stop.load(std::memory_order_relaxed)) {
+			receiver.waitMessages(10);
+		}
+	});
+
+	state.setItemsPerIteration(NUM_MESSAGES);
+
+	uint64_t expected = 0;
+	while (state.next()) {
+		for (size_t i = 0; i < NUM_MESSAGES; i++) {
+			sender.send<BenchUnicastMessage>(RECEIVER_UID, uint64_t(i), uint64_t(1), uint64_t(2), uint64_t(3));
+		}
+
+		expected += NUM_MESSAGES;
+		while (received.load(std::memory_order_acquire) < expected) {
+			std::this_thread::yield();
+		}
+	}
+
+	stop.store(true, std::memory_order_relaxed);
+}
+
+} // namespace voxen::svc
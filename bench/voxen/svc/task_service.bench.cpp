@@ -0,0 +1,109 @@
+#include <voxen/svc/task_service.hpp>
+
+#include <voxen/svc/engine.hpp>
+#include <voxen/svc/task_builder.hpp>
+#include <voxen/svc/task_context.hpp>
+
+#include "../../bench_common.hpp"
+
+#include <atomic>
+#include <vector>
+
+namespace voxen::svc
+{
+
+namespace
+{
+
+// Number of tasks launched in one iteration
+constexpr size_t NUM_TASKS = 1000;
+// Number of tasks in a dependency chain, this case is a lot slower
+constexpr size_t NUM_CHAIN_TASKS = 100;
+
+} // namespace
+
+VOXEN_BENCHMARK("svc/task_service/enqueue_wait_independent")
+{
+	// Tasks enqueued from outside of worker threads, like World thread does
+	auto engine = Engine::createForTestSuite();
+	TaskService &ts = engine->serviceLocator().requestService<TaskService>();
+
+	std::atomic_size_t counter = 0;
+	std::vector<uint64_t> task_counters(NUM_TASKS);
+
+	state.setItemsPerIteration(NUM_TASKS);
+
+	while (state.next()) {
+		TaskBuilder bld(ts);
+
+		for (size_t i = 0; i < NUM_TASKS; i++) {
+			bld.enqueueTask([&counter](TaskContext &) { counter.fetch_add(1, std::memory_order_relaxed); });
+			task_counters[i] = bld.getLastTaskCounter();
+		}
+
+		bld.addWait(task_counters);
+		bld.enqueueSyncPoint().wait();
+	}
+
+	voxen::bench::doNotOptimize(counter.load());
+}
+
+VOXEN_BENCHMARK("svc/task_service/enqueue_wait_chain")
+{
+	// Every task depends on the previous one, measures dependency resolution latency
+	auto engine = Engine::createForTestSuite();
+	TaskService &ts = engine->serviceLocator().requestService<TaskService>();
+
+	size_t counter = 0;
+
+	state.setItemsPerIteration(NUM_CHAIN_TASKS);
+
+	while (state.next()) {
+		TaskBuilder bld(ts);
+
+		for (size_t i = 0; i < NUM_CHAIN_TASKS; i++) {
+			bld.addWait(bld.getLastTaskCounter());
+			bld.enqueueTask([&counter](TaskContext &) { counter++; });
+		}
+
+		bld.addWait(bld.getLastTaskCounter());
+		bld.enqueueSyncPoint().wait();
+	}
+
+	voxen::bench::doNotOptimize(counter);
+}
+
+VOXEN_BENCHMARK("svc/task_service/nested_spawn")
+{
+	// Tasks enqueued from inside of a task, go into worker-local queues
+	auto engine = Engine::createForTestSuite();
+	TaskService &ts = engine->serviceLocator().requestService<TaskService>();
+
+	std::atomic_size_t counter = 0;
+	std::vector<uint64_t> task_counters(NUM_TASKS);
+
+	state.setItemsPerIteration(NUM_TASKS);
+
+	while (state.next()) {
+		TaskBuilder bld(ts);
+
+		bld.enqueueTask([&](TaskContext &ctx) {
+			TaskBuilder inner(ctx.taskService());
+			for (size_t i = 0; i < NUM_TASKS; i++) {
+				inner.enqueueTask([&counter](TaskContext &) { counter.fetch_add(1, std::memory_order_relaxed); });
+				task_counters[i] = inner.getLastTaskCounter();
+			}
+		});
+
+		bld.addWait(bld.getLastTaskCounter());
+		bld.enqueueSyncPoint().wait();
+
+		// Spawned tasks are independent of the parent one, wait for them separately
+		bld.addWait(task_counters);
+		bld.enqueueSyncPoint().wait();
+	}
+
+	voxen::bench::doNotOptimize(counter.load());
+}
+
+} // namespace voxen::svc
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <voxen/visibility.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace voxen
+{
+
+// Memory usage statistics of an object pool
+struct ObjectPoolStats {
+	// Number of currently allocated (live) objects
+	size_t live_objects = 0;
+	// Total number of allocated slabs, including empty ones
+	size_t slabs = 0;
+	// Number of slabs having no live objects, these are released by `trim()`
+	size_t empty_slabs = 0;
+	// Size of one slab in bytes
+	size_t slab_size = 0;
+};
+
+namespace detail
+{
+
+// Slab bookkeeping shared by `PrivateObjectPool` and `SharedObjectPool`, do not use directly.
+// Not thread-safe, pools must serialize access to it themselves.
+//
+// Every slab has its own free list and live object count. Non-full slabs
+// are grouped into lists by occupancy, and allocations are taken from
+// the most occupied ones. This keeps live objects packed into fewer slabs
+// and lets the least occupied ones drain out, becoming empty - then
+// `trim()` can return them to the system.
+//
+// Slab memory layout: [objects...][free space/pool-specific data][header]
+class VOXEN_API ObjectPoolSlabs {
+public:
+	// Number of partially occupied slab lists
+	constexpr static uint32_t NUM_OCCUPANCY_LISTS = 8;
+	constexpr static size_t SLAB_HEADER_SIZE = 4 * sizeof(void *) + 16;
+
+	// `owner` is an arbitrary pointer stored in slab headers, see `slabOwner()`.
+	// Slab size must be a power of two, slabs are aligned to it.
+	ObjectPoolSlabs(void *owner, uint32_t object_size, uint32_t slab_size, uint32_t max_objects) noexcept;
+	ObjectPoolSlabs(ObjectPoolSlabs &&) = delete;
+	ObjectPoolSlabs(const ObjectPoolSlabs &) = delete;
+	ObjectPoolSlabs &operator=(ObjectPoolSlabs &&) = delete;
+	ObjectPoolSlabs &operator=(const ObjectPoolSlabs &) = delete;
+	// Frees all slabs regardless of live objects, pools must check for leaks themselves
+	~ObjectPoolSlabs();
+
+	// Take an object slot from the most occupied non-full slab, allocating a new slab if needed
+	void *allocate();
+	// Return object slot to its slab
+	void deallocate(void *obj) noexcept;
+
+	// Release all empty slabs. Returns the number of released bytes.
+	size_t trim() noexcept;
+
+	ObjectPoolStats stats() const noexcept;
+	size_t liveObjects() const noexcept { return m_live_objects; }
+
+	// Get `owner` pointer of the pool `obj` was allocated from
+	static void *slabOwner(void *obj, size_t slab_size) noexcept;
+
+private:
+	struct SlabHeader;
+
+	// Lists of partially occupied slabs by occupancy, then empty and full slabs
+	constexpr static uint32_t EMPTY_LIST = NUM_OCCUPANCY_LISTS;
+	constexpr static uint32_t FULL_LIST = NUM_OCCUPANCY_LISTS + 1;
+	constexpr static uint32_t NUM_LISTS = NUM_OCCUPANCY_LISTS + 2;
+
+	void *const m_owner;
+	const uint32_t m_object_size;
+	const uint32_t m_slab_size;
+	const uint32_t m_max_objects;
+	// Bit N is set if occupancy list N is not empty
+	uint32_t m_occupancy_mask = 0;
+
+	size_t m_live_objects = 0;
+	size_t m_num_slabs = 0;
+	size_t m_num_empty_slabs = 0;
+
+	SlabHeader *m_lists[NUM_LISTS] = {};
+
+	uint32_t listIndex(uint32_t live_objects) const noexcept;
+	void link(SlabHeader *slab, uint32_t list) noexcept;
+	void unlink(SlabHeader *slab) noexcept;
+	void relink(SlabHeader *slab) noexcept;
+};
+
+} // namespace detail
+
+} // namespace voxen
@@ -39,6 +39,20 @@ public:
 	constexpr static size_t MAX_ALLOC_SIZE = 1024 * 1024;
 	constexpr static size_t MAX_ALIGNMENT = 256;
 
+	// How slab memory is backed with huge pages, ignored on non-Linux platforms.
+	// Windows large pages need `SeLockMemoryPrivilege` which is not granted
+	// to regular user accounts, so slabs always use regular pages there.
+	enum class HugePages {
+		// Regular pages only
+		Off,
+		// Ask for transparent huge pages (THP) with `madvise`, no system setup required.
+		// Silently gets regular pages if THP is disabled.
+		Transparent,
+		// Use reserved hugetlbfs pages (`MAP_HUGETLB`), requires `vm.nr_hugepages` setup.
+		// Falls back to `Transparent` once the reserve is exhausted or missing.
+		Explicit,
+	};
+
 	struct Config {
 		// Service starts an auxiliary garbage collection (GC) thread that
 		// periodically checks the "garbage list" and reclaims slabs which
@@ -46,10 +60,37 @@ public:
 		// This setting controls how often (in milliseconds) this thread wakes up.
 		// This thread should have no measurable impact on performance.
 		uint32_t gc_period_msec = 20;
-		// If GC thread detects that some slabs remain free (untaken) for a long time
-		// if will start destroying them until their number is within this threshold.
+		// If GC thread detects that some slabs remained free (untaken) during
+		// the whole `free_slabs_window_msec` interval, it will destroy them
+		// until their number is within this threshold.
 		// This brings memory consumption back down after an allocation spike.
 		uint32_t destroy_free_slabs_threshold = 5;
+		// Length of free slab usage tracking window, in milliseconds.
+		// Longer windows keep spike-allocated slabs around for longer
+		// but avoid destroying and re-creating them with periodic spikes.
+		uint32_t free_slabs_window_msec = 2000;
+		// Huge page usage for slab memory. Slab size matches the usual 2 MB
+		// huge page size, so each slab needs just one TLB entry.
+		HugePages huge_pages = HugePages::Transparent;
+		// Keep separate free slab lists for each NUMA node, threads take slabs from
+		// the list of node they are running on. Slab memory is usually first touched
+		// by the allocating thread, so it stays local to that node. This also splits
+		// the lock contention. Has no effect on single-node systems.
+		bool numa_aware_slabs = true;
+	};
+
+	// Slab usage statistics, see `stats()`
+	struct Stats {
+		// Number of currently existing slabs, including those owned by threads
+		size_t slabs = 0;
+		// Number of them backed with reserved hugetlb pages (`HugePages::Explicit`)
+		size_t hugetlb_slabs = 0;
+		// Slabs with no live allocations, ready to be taken by threads
+		size_t free_slabs = 0;
+		// Exhausted slabs waiting for their live allocations to be freed
+		size_t garbage_slabs = 0;
+		// Mapping hugetlb pages has failed, newer slabs fall back to `HugePages::Transparent`
+		bool hugetlb_fallback = false;
 	};
 
 	// Service constructor, call only from the factory function.
@@ -81,6 +122,12 @@ public:
 	// NOTE: every allocation must be deallocated *before* the service is stopped.
 	static void deallocate(void* ptr) noexcept;
 
+	// Collect current slab usage statistics, mostly for testing and diagnostics.
+	// Slabs are shared by all service instances, they are never destroyed
+	// on service restarts, so the numbers include slabs made by previous ones.
+	// Can be called even when the service is not active.
+	static Stats stats() noexcept;
+
 	// Allocate and construct an object, semantic equivalent of `new T(args...)`.
 	// If the object constructor throws, memory is automatically deallocated.
 	// Otherwise, the caller owns the returned pointer and must destory/deallocate it.
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <voxen/common/object_pool_slabs.hpp>
 #include <voxen/visibility.hpp>
 
 #include <algorithm>
@@ -18,7 +19,7 @@ class VOXEN_API PrivateObjectPoolBase {
 public:
 	constexpr static size_t MAX_OBJECT_SIZE = 512;
 	constexpr static size_t MAX_OBJECT_ALIGN = 64;
-	constexpr static size_t SLAB_HEADER_SIZE = 2 * sizeof(void *) + 8;
+	constexpr static size_t SLAB_HEADER_SIZE = ObjectPoolSlabs::SLAB_HEADER_SIZE;
 
 protected:
 	PrivateObjectPoolBase(size_t object_size, size_t objects_hint) noexcept;
@@ -31,6 +32,10 @@ protected:
 	void *allocate();
 	static void deallocate(void *obj, size_t slab_size) noexcept;
 
+	// Release all slabs having no live objects, returns the number of released bytes
+	size_t trim() noexcept { return m_slabs.trim(); }
+	ObjectPoolStats stats() const noexcept { return m_slabs.stats(); }
+
 	constexpr static size_t adjustObjectSize(size_t object_size) noexcept
 	{
 		return std::max(object_size, sizeof(void *));
@@ -50,10 +55,8 @@ private:
 	const uint32_t m_adjusted_object_size;
 	const uint32_t m_slab_size;
 	const uint32_t m_max_objects;
-	uint32_t m_live_allocations = 0;
 
-	void *m_last_freed_object = nullptr;
-	void *m_newest_slab = nullptr;
+	ObjectPoolSlabs m_slabs;
 };
 
 } // namespace detail
@@ -66,9 +69,11 @@ private:
 // up to one pointer size (4/8 bytes) for internal bookkeeping.
 // These objects should be stored inline where possible anyway.
 //
-// Current implementation keeps "allocation waterline" - that is, memory
-// usage is determined by the maximal number of simultaneously allocated
-// objects during the whole pool lifetime.
+// Allocations are packed into the most occupied slabs, so after a burst of
+// allocations most of the memory tends to end up in fully free slabs.
+// These are kept for reuse until `trim()` is called - memory usage is
+// determined by the maximal number of simultaneously allocated objects
+// since the last `trim()` call (or the pool creation).
 //
 // `SLAB_SIZE_HINT` controls how many objects should be placed in one "slab" memory block.
 // The implementation might allocate more than this number but will not allocate less.
@@ -79,6 +84,8 @@ template<typename T, uint32_t SLAB_SIZE_HINT = 256>
 class PrivateObjectPool : private detail::PrivateObjectPoolBase {
 public:
 	using Base = detail::PrivateObjectPoolBase;
+	using Base::stats;
+	using Base::trim;
 
 	struct Deleter {
 		void operator()(T *obj) noexcept
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <voxen/common/object_pool_slabs.hpp>
 #include <voxen/os/futex.hpp>
 #include <voxen/visibility.hpp>
 
@@ -19,7 +20,7 @@ class VOXEN_API SharedObjectPoolBase {
 public:
 	constexpr static size_t MAX_OBJECT_SIZE = 512;
 	constexpr static size_t MAX_OBJECT_ALIGN = 64;
-	constexpr static size_t SLAB_HEADER_SIZE = 2 * sizeof(void *) + 8;
+	constexpr static size_t SLAB_HEADER_SIZE = ObjectPoolSlabs::SLAB_HEADER_SIZE;
 
 	static void addRef(void *obj, size_t slab_size, size_t adjusted_object_size) noexcept;
 	static bool releaseRef(void *obj, size_t slab_size, size_t adjusted_object_size) noexcept;
@@ -51,14 +52,23 @@ protected:
 
 	void *allocate();
 
+	// Release all slabs having no live objects, returns the number of released bytes
+	size_t trim();
+	ObjectPoolStats stats();
+
 private:
 	const uint32_t m_adjusted_object_size;
 	const uint32_t m_slab_size;
 	const uint32_t m_max_objects;
 
+	// Objects freed (from any thread) but not yet returned to their slabs.
+	// Drained into `m_slabs` under the lock on the next allocation or trim.
+	std::atomic<void *> m_pending_freed_objects = nullptr;
+
 	os::FutexLock m_lock;
-	std::atomic<void *> m_last_freed_object = nullptr;
-	void *m_newest_slab = nullptr;
+	ObjectPoolSlabs m_slabs;
+
+	void drainPendingFreedObjects() noexcept;
 };
 
 } // namespace detail
@@ -195,9 +205,11 @@ private:
 // up to one pointer size (4/8 bytes) for internal bookkeeping.
 // These objects should be stored inline where possible anyway.
 //
-// Current implementation keeps "allocation waterline" - that is, memory
-// usage is determined by the maximal number of simultaneously allocated
-// objects during the whole pool lifetime.
+// Allocations are packed into the most occupied slabs, so after a burst of
+// allocations most of the memory tends to end up in fully free slabs.
+// These are kept for reuse until `trim()` is called - memory usage is
+// determined by the maximal number of simultaneously allocated objects
+// since the last `trim()` call (or the pool creation).
 //
 // `SLAB_SIZE_HINT` controls how many objects should be placed in one "slab" memory block.
 // The implementation might allocate more than this number but will not allocate less.
@@ -208,6 +220,8 @@ template<typename T, uint32_t SLAB_SIZE_HINT = 256>
 class SharedObjectPool : private detail::SharedObjectPoolBase {
 public:
 	using Base = detail::SharedObjectPoolBase;
+	using Base::stats;
+	using Base::trim;
 	// Handle-like reference-counting pointer to the allocated object
 	using Ptr = SharedPoolPtr<T, SLAB_SIZE_HINT>;
 
@@ -2,10 +2,13 @@
 
 #include <voxen/common/v8g_concepts.hpp>
 #include <voxen/common/v8g_helpers.hpp>
+#include <voxen/svc/svc_fwd.hpp>
 
 #include <extras/function_ref.hpp>
 
 #include <memory>
+#include <span>
+#include <utility>
 
 namespace voxen
 {
@@ -48,19 +51,38 @@ namespace voxen
 //
 // Expect `insert`/`erase` to be 4-5 times slower and `find` to be 2.5-3 times
 // slower than `std::unordered_map` based on my very rough measurements.
-// Future optimizations might reduce this performance gap.
+// Use `insertBatch`/`eraseBatch` for bulk modifications, these build
+// or modify each touched node just once instead of doing it per key.
 //
 // Supports efficient versioning-optimized operations:
 // - Constant-complexity, cheap copy (container snapshot)
 // - Visit different (added, removed, updated) objects relative to
-//   another snapshot made from the same "origin" (see `visitDiff`).
+//   another snapshot made from the same "origin" (see `visitDiff`),
+//   optionally in parallel (see `visitDiffParallel`).
 template<CV8gUniqueHashableKey Key, CV8gValue Value>
 class V8gHashTrie {
 public:
 	using ValuePtr = std::shared_ptr<Value>;
 	using Item = V8gMapItem<Key, ValuePtr>;
+	using BatchItem = std::pair<Key, ValuePtr>;
 
 	using DiffVisitorFn = extras::function_ref<bool(const Item *new_item, const Item *old_item)>;
+	// Returns the number of heap bytes owned by a value, not including `sizeof(Value)`
+	using ValueHeapBytesFn = extras::function_ref<size_t(const Value &value)>;
+
+	// Memory usage report, see `memoryStats()`
+	struct MemoryStats {
+		// Number of trie nodes and their total allocated size
+		size_t node_count = 0;
+		size_t node_bytes = 0;
+		// Part of `node_bytes` taken by nodes also referenced by the other snapshot
+		size_t shared_node_bytes = 0;
+		// Number of non-null values and their total size
+		size_t value_count = 0;
+		size_t value_bytes = 0;
+		// Part of `value_bytes` taken by values also referenced by the other snapshot
+		size_t shared_value_bytes = 0;
+	};
 
 	V8gHashTrie() = default;
 	V8gHashTrie(V8gHashTrie &&other) noexcept;
@@ -100,6 +122,31 @@ public:
 	// Otherwise you will summon race condition demons.
 	void erase(uint64_t timeline, Key key);
 
+	// Insert a batch of items, result is the same as calling `insert()` for each of them.
+	// `items` must be sorted by `key.hash()` increasing (see `sortBatch()`), keys must be unique.
+	//
+	// Much faster than item-by-item insertion for large batches: missing subtrees are
+	// built at once with exactly sized nodes, and every touched existing node is
+	// copied or expanded at most once per batch.
+	//
+	// Value pointers are moved out of `items`. If an exception is thrown,
+	// the container stays valid but only some part of the batch might be inserted.
+	//
+	// The same pointer invalidation and `timeline` requirements as with `insert()` apply.
+	void insertBatch(uint64_t timeline, std::span<BatchItem> items);
+
+	// Erase a batch of keys, result is the same as calling `erase()` for each of them.
+	// `keys` must be sorted by `key.hash()` increasing (see `sortBatch()`).
+	// Every touched node is copied at most once per batch.
+	//
+	// The same pointer invalidation and `timeline` requirements as with `erase()` apply.
+	void eraseBatch(uint64_t timeline, std::span<const Key> keys);
+
+	// Sort items in the order required by `insertBatch()`
+	static void sortBatch(std::span<BatchItem> items);
+	// Sort keys in the order required by `eraseBatch()`
+	static void sortBatch(std::span<Key> keys);
+
 	// Find an item in the trie, or null pointer if it's not inserted
 	const Item *find(Key key) const noexcept;
 	// Returns pointer to the first item in the trie, or null pointer if it's empty.
@@ -130,6 +177,28 @@ public:
 	// (with certain overhead depending on their locality), not the whole container size.
 	void visitDiff(const V8gHashTrie &old, DiffVisitorFn visitor) const;
 
+	// Same as `visitDiff()` but splits the work into hash ranges (following the top
+	// levels of trie fanout) which are processed by `TaskService` worker threads.
+	// The calling thread participates in processing and blocks until it's completed.
+	// Use for diffs over large containers, for small ones task overhead is not worth it.
+	//
+	// `visitor` is called concurrently from multiple threads and must be thread-safe.
+	// Calls are hash-ordered within each range but ranges are visited in no particular order.
+	// Returning `false` from `visitor` stops iteration, though a few calls can still
+	// happen from other threads. The first exception thrown by `visitor` stops iteration
+	// too and is rethrown from this function once all threads stop.
+	void visitDiffParallel(const V8gHashTrie &old, svc::TaskService &task_service, DiffVisitorFn visitor) const;
+
+	// Compute memory usage of this container. Walks the whole trie, so don't call it too often.
+	//
+	// Snapshots share structure, so if `other` is not null, nodes and values also referenced
+	// by it are additionally reported as shared. The remaining (unique) bytes are roughly what
+	// will be freed when this snapshot is destroyed while `other` stays alive.
+	//
+	// Value size is `sizeof(Value)` plus `value_heap_bytes(value)` if the function is provided.
+	// Allocator overheads and `shared_ptr` control blocks are not counted.
+	MemoryStats memoryStats(const V8gHashTrie *other, ValueHeapBytesFn value_heap_bytes = {}) const;
+
 	// Construct value pointer for insertion.
 	// Use this wrapper as the underlying pointer type (`std::shared_ptr`)
 	// is an implementation detail which might change later.
@@ -142,6 +211,11 @@ public:
 private:
 	// Some first node pointers are stored inline to slightly reduce indirections
 	constexpr static uint32_t ROOT_NODES_LOG2 = 4;
+	// Number of hash bits indexing root nodes and their direct children.
+	// Diff ranges are expressed in units of this hash prefix.
+	constexpr static uint32_t DIFF_PREFIX_BITS = ROOT_NODES_LOG2 + 6;
+	// Number of hash ranges for parallel diff, must divide `2^DIFF_PREFIX_BITS`
+	constexpr static uint32_t PARALLEL_DIFF_PARTS = 64;
 
 	class Node;
 
@@ -150,6 +224,11 @@ private:
 
 	size_t m_size = 0;
 	NodeItem m_root_nodes[1 << ROOT_NODES_LOG2];
+
+	// Visit diff of items with hash prefixes (`DIFF_PREFIX_BITS` highest bits)
+	// in range `[prefix_begin; prefix_end)`, returns `false` on early exit
+	bool visitDiffRange(const V8gHashTrie &old, uint32_t prefix_begin, uint32_t prefix_end,
+		DiffVisitorFn visitor) const;
 };
 
 } // namespace voxen
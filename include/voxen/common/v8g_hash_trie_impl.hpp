@@ -2,9 +2,16 @@
 
 #include <voxen/common/v8g_hash_trie.hpp>
 
+#include <voxen/os/futex.hpp>
+#include <voxen/svc/task_builder.hpp>
+
 #include <algorithm>
+#include <atomic>
 #include <bit>
 #include <cassert>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace voxen
 {
@@ -372,10 +379,22 @@ public:
 		return refItemIndex(std::popcount(m_item_bitmap & (bit - 1)));
 	}
 
-	static NodePtr allocateNode(uint32_t consumed_hash_bits)
+	// Round capacity so that `m_bytes + capacity` aligns well
+	static uint32_t alignCapacity(uint32_t capacity) noexcept
 	{
-		void *ptr = ::operator new(sizeof(Node) + INITIAL_CAPACITY);
-		return NodePtr(new (ptr) Node(INITIAL_CAPACITY, consumed_hash_bits));
+		if (capacity % alignof(Item) != 0) {
+			capacity += alignof(Item) - capacity % alignof(Item);
+		}
+
+		return capacity;
+	}
+
+	static NodePtr allocateNode(uint32_t consumed_hash_bits, uint32_t capacity = INITIAL_CAPACITY)
+	{
+		capacity = alignCapacity(std::clamp(capacity, INITIAL_CAPACITY, MAX_CAPACITY));
+
+		void *ptr = ::operator new(sizeof(Node) + capacity);
+		return NodePtr(new (ptr) Node(capacity, consumed_hash_bits));
 	}
 
 	static NodePtr copyNode(const Node &old)
@@ -384,21 +403,21 @@ public:
 		return NodePtr(new (ptr) Node(old, old.m_capacity_bytes));
 	}
 
-	static NodePtr expandNode(const Node &old)
+	// Copy with capacity changed, it must be not less than `old.m_used_bytes`
+	static NodePtr copyNode(const Node &old, uint32_t capacity)
 	{
-		// Capacity x1.5 (clamped to max)
-		uint32_t capacity = old.m_capacity_bytes + old.m_capacity_bytes / 2;
-		capacity = std::min(capacity, MAX_CAPACITY);
-
-		if (capacity % alignof(Item) != 0) {
-			// Round capacity so that `m_bytes + capacity` aligns well
-			capacity += alignof(Item) - capacity % alignof(Item);
-		}
+		capacity = alignCapacity(std::min(capacity, MAX_CAPACITY));
 
 		void *ptr = ::operator new(sizeof(Node) + capacity);
 		return NodePtr(new (ptr) Node(old, capacity));
 	}
 
+	static NodePtr expandNode(const Node &old)
+	{
+		// Capacity x1.5 (clamped to max)
+		return copyNode(old, old.m_capacity_bytes + old.m_capacity_bytes / 2);
+	}
+
 	static bool erase(uint64_t timeline, NodeItem &node_item, Key key, uint64_t hash_bits)
 	{
 		const uint64_t bit = uint64_t(1) << (hash_bits >> (64 - 6));
@@ -450,7 +469,225 @@ public:
 		return erased;
 	}
 
-	bool visitUnary(extras::function_ref<bool(const Item *)> visitor) const
+	static uint64_t batchHash(const BatchItem &item) noexcept { return item.first.hash(); }
+	static uint64_t batchHash(const Key &key) noexcept { return key.hash(); }
+
+	// Split hash-sorted `items` into groups having equal `index_bits` hash bits after
+	// the first `consumed_hash_bits`, call `fn(index, group)` for each group in order
+	template<typename T, typename F>
+	static void forEachHashGroup(std::span<T> items, uint32_t consumed_hash_bits, uint32_t index_bits, F &&fn)
+	{
+		auto get_index = [&](size_t i) { return (batchHash(items[i]) << consumed_hash_bits) >> (64 - index_bits); };
+
+		size_t begin = 0;
+
+		while (begin < items.size()) {
+			const uint64_t index = get_index(begin);
+
+			size_t end = begin + 1;
+			while (end < items.size() && get_index(end) == index) {
+				end++;
+			}
+
+			fn(index, items.subspan(begin, end - begin));
+			begin = end;
+		}
+	}
+
+	// Build a new subtree from hash-sorted `items`, consuming their value pointers
+	static NodePtr buildNode(uint64_t timeline, uint32_t consumed_hash_bits, std::span<BatchItem> items)
+	{
+		// Count children first to allocate node of the exact size
+		uint32_t capacity = 0;
+		forEachHashGroup(items, consumed_hash_bits, 6, [&](uint64_t, std::span<BatchItem> group) {
+			capacity += static_cast<uint32_t>(group.size() == 1 ? sizeof(Item) : sizeof(NodeItem));
+		});
+
+		NodePtr node_ptr = allocateNode(consumed_hash_bits, capacity);
+		Node *node = node_ptr.get();
+
+		// Groups go in increasing bit order, so insertions below never shift elements
+		forEachHashGroup(items, consumed_hash_bits, 6, [&](uint64_t index, std::span<BatchItem> group) {
+			const uint64_t bit = uint64_t(1) << index;
+
+			if (group.size() == 1) {
+				node->insertItem(bit, Item(timeline, group[0].first, std::move(group[0].second)));
+			} else {
+				node->insertNode(bit, NodeItem(timeline, buildNode(timeline, consumed_hash_bits + 6, group)));
+			}
+		});
+
+		return node_ptr;
+	}
+
+	// Insert hash-sorted `items` into the subtree of `node_item`.
+	// Returns the number of newly inserted (not updated) items.
+	static size_t insertBatch(uint64_t timeline, NodeItem &node_item, std::span<BatchItem> items)
+	{
+		const Node *old_node = node_item.second.get();
+		const auto consumed_hash_bits = static_cast<uint32_t>(old_node->m_consumed_hash_bits);
+		const uint64_t occupied_mask = old_node->m_node_bitmap | old_node->m_item_bitmap;
+
+		// Reserve space for all newly occupied slots upfront. `NodeItem` is not
+		// larger than `Item`, so this covers both new items and new child nodes.
+		uint32_t required_bytes = static_cast<uint32_t>(old_node->m_used_bytes);
+		forEachHashGroup(items, consumed_hash_bits, 6, [&](uint64_t index, std::span<BatchItem>) {
+			if (!(occupied_mask & (uint64_t(1) << index))) {
+				required_bytes += static_cast<uint32_t>(sizeof(Item));
+			}
+		});
+
+		if (node_item.first != timeline || required_bytes > old_node->m_capacity_bytes) {
+			// We're about to alter this node or its children, need to make a copy.
+			// Here we rely on the requirement to increase `timeline` between container copies.
+			const auto capacity = static_cast<uint32_t>(old_node->m_capacity_bytes);
+			node_item.second = copyNode(*old_node, std::max(capacity, required_bytes));
+			node_item.first = timeline;
+		}
+
+		Node *node = node_item.second.get();
+		size_t inserted = 0;
+
+		forEachHashGroup(items, consumed_hash_bits, 6, [&](uint64_t index, std::span<BatchItem> group) {
+			const uint64_t bit = uint64_t(1) << index;
+
+			if (node->m_item_bitmap & bit) {
+				Item &item = node->refItemBit(bit);
+
+				if (group.size() == 1 && group[0].first == item.key()) {
+					item.version() = timeline;
+					item.valuePtr() = std::move(group[0].second);
+					return;
+				}
+
+				// Hash prefix collision, push the item one level deeper and proceed
+				// to the new node. It's not shared with anyone, mark it as ours.
+				node->promoteItemToNode(bit)->first = timeline;
+			}
+
+			if (node->m_node_bitmap & bit) {
+				inserted += insertBatch(timeline, node->refNodeBit(bit), group);
+			} else if (group.size() == 1) {
+				node->insertItem(bit, Item(timeline, group[0].first, std::move(group[0].second)));
+				inserted++;
+			} else {
+				node->insertNode(bit, NodeItem(timeline, buildNode(timeline, consumed_hash_bits + 6, group)));
+				inserted += group.size();
+			}
+		});
+
+		return inserted;
+	}
+
+	// Erase hash-sorted `keys` from the subtree of `node_item`.
+	// Returns the number of erased items.
+	static size_t eraseBatch(uint64_t timeline, NodeItem &node_item, std::span<const Key> keys)
+	{
+		const auto consumed_hash_bits = static_cast<uint32_t>(node_item.second->m_consumed_hash_bits);
+		const uint64_t occupied_mask = node_item.second->m_node_bitmap | node_item.second->m_item_bitmap;
+
+		// Unlike single-key `erase()` we can cheaply skip copying
+		// when none of the keys can possibly be in this subtree
+		bool may_erase = false;
+		forEachHashGroup(keys, consumed_hash_bits, 6, [&](uint64_t index, std::span<const Key>) {
+			may_erase |= (occupied_mask & (uint64_t(1) << index)) != 0;
+		});
+
+		if (!may_erase) {
+			return 0;
+		}
+
+		if (node_item.first != timeline) {
+			node_item.second = copyNode(*node_item.second);
+			node_item.first = timeline;
+		}
+
+		Node *node = node_item.second.get();
+		size_t erased = 0;
+
+		forEachHashGroup(keys, consumed_hash_bits, 6, [&](uint64_t index, std::span<const Key> group) {
+			const uint64_t bit = uint64_t(1) << index;
+
+			if (node->m_item_bitmap & bit) {
+				if (std::ranges::find(group, node->refItemBit(bit).key()) != group.end()) {
+					node->eraseItem(bit);
+					erased++;
+				}
+			} else if (node->m_node_bitmap & bit) {
+				const size_t child_erased = eraseBatch(timeline, node->refNodeBit(bit), group);
+
+				// Try shrinking the subtree if it just got smaller
+				if (child_erased > 0) {
+					node->tryShrinkChildNode(bit);
+					erased += child_erased;
+				}
+			}
+		});
+
+		return erased;
+	}
+
+	// Add memory usage of the subtree to `stats`. `other_node` is the node
+	// at the same position in `other` snapshot (can be null, as well as `other`).
+	void collectMemoryStats(const Node *other_node, const V8gHashTrie *other, ValueHeapBytesFn value_heap_bytes,
+		MemoryStats &stats) const
+	{
+		// The whole subtree is shared if the node itself is
+		const bool shared = this == other_node;
+		const size_t node_bytes = sizeof(Node) + m_capacity_bytes;
+
+		stats.node_count++;
+		stats.node_bytes += node_bytes;
+		if (shared) {
+			stats.shared_node_bytes += node_bytes;
+		}
+
+		const int32_t item_count = std::popcount(m_item_bitmap);
+		for (int32_t i = 0; i < item_count; i++) {
+			const Item &item = refItemIndex(i);
+			if (!item.hasValue()) {
+				continue;
+			}
+
+			const size_t value_bytes = sizeof(Value) + (value_heap_bytes ? value_heap_bytes(item.value()) : 0);
+			stats.value_count++;
+			stats.value_bytes += value_bytes;
+
+			if (shared) {
+				stats.shared_value_bytes += value_bytes;
+			} else if (other) {
+				// Item might be placed differently in `other`, do a full lookup
+				const Item *other_item = other->find(item.key());
+				if (other_item && other_item->valuePtr() == item.valuePtr()) {
+					stats.shared_value_bytes += value_bytes;
+				}
+			}
+		}
+
+		uint64_t node_mask = m_node_bitmap;
+		int32_t node_index = 0;
+
+		while (node_mask) {
+			const uint64_t bit = uint64_t(1) << std::countr_zero(node_mask);
+			const Node *child = refNodeIndex(node_index).second.get();
+
+			const Node *other_child = nullptr;
+			if (shared) {
+				other_child = child;
+			} else if (other_node && (other_node->m_node_bitmap & bit)) {
+				other_child = other_node->refNodeBit(bit).second.get();
+			}
+
+			child->collectMemoryStats(other_child, other, value_heap_bytes, stats);
+
+			node_mask ^= bit;
+			node_index++;
+		}
+	}
+
+	// Visit all items in subtree. `bit_mask` limits visited
+	// slots of this node (not its children) to those set in it.
+	bool visitUnary(extras::function_ref<bool(const Item *)> visitor, uint64_t bit_mask = ~uint64_t(0)) const
 	{
 		uint64_t combo_mask = m_node_bitmap | m_item_bitmap;
 
@@ -459,15 +696,16 @@ public:
 
 		while (combo_mask) {
 			uint64_t bit = uint64_t(1) << std::countr_zero(combo_mask);
+			const bool visit = (bit_mask & bit) != 0;
 
 			if (m_node_bitmap & bit) {
-				if (!node_ptr->second->visitUnary(visitor)) [[unlikely]] {
+				if (visit && !node_ptr->second->visitUnary(visitor)) [[unlikely]] {
 					return false;
 				}
 
 				node_ptr++;
 			} else {
-				if (!visitor(item_ptr)) [[unlikely]] {
+				if (visit && !visitor(item_ptr)) [[unlikely]] {
 					return false;
 				}
 
@@ -559,7 +797,9 @@ public:
 		return visited_item_bit ? true : visitor(nullptr, item);
 	}
 
-	static bool visitDiff(const Node *new_node, const Node *old_node, DiffVisitorFn visitor)
+	// `bit_mask` limits visited slots of these nodes (not their children) to those set in it
+	static bool visitDiff(const Node *new_node, const Node *old_node, DiffVisitorFn visitor,
+		uint64_t bit_mask = ~uint64_t(0))
 	{
 		uint64_t new_node_bitmap = new_node->m_node_bitmap;
 		uint64_t new_item_bitmap = new_node->m_item_bitmap;
@@ -630,7 +870,7 @@ public:
 
 		uint64_t new_combo_mask = new_node_bitmap | new_item_bitmap;
 		uint64_t old_combo_mask = old_node_bitmap | old_item_bitmap;
-		uint64_t combo_mask = new_combo_mask | old_combo_mask;
+		uint64_t combo_mask = (new_combo_mask | old_combo_mask) & bit_mask;
 
 		while (combo_mask) {
 			uint64_t bit = uint64_t(1) << std::countr_zero(combo_mask);
@@ -786,6 +1026,50 @@ void V8gHashTrie<Key, Value>::erase(uint64_t timeline, Key key)
 	}
 }
 
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+void V8gHashTrie<Key, Value>::insertBatch(uint64_t timeline, std::span<BatchItem> items)
+{
+	assert(std::ranges::is_sorted(items, {}, [](const BatchItem &item) { return item.first.hash(); }));
+
+	Node::forEachHashGroup(items, 0, ROOT_NODES_LOG2, [&](uint64_t index, std::span<BatchItem> group) {
+		NodeItem &root_node_item = m_root_nodes[index];
+
+		if (!root_node_item.second) {
+			root_node_item.second = Node::buildNode(timeline, ROOT_NODES_LOG2, group);
+			root_node_item.first = timeline;
+			m_size += group.size();
+		} else {
+			m_size += Node::insertBatch(timeline, root_node_item, group);
+		}
+	});
+}
+
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+void V8gHashTrie<Key, Value>::eraseBatch(uint64_t timeline, std::span<const Key> keys)
+{
+	assert(std::ranges::is_sorted(keys, {}, [](const Key &key) { return key.hash(); }));
+
+	Node::forEachHashGroup(keys, 0, ROOT_NODES_LOG2, [&](uint64_t index, std::span<const Key> group) {
+		NodeItem &root_node_item = m_root_nodes[index];
+
+		if (root_node_item.second) {
+			m_size -= Node::eraseBatch(timeline, root_node_item, group);
+		}
+	});
+}
+
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+void V8gHashTrie<Key, Value>::sortBatch(std::span<BatchItem> items)
+{
+	std::ranges::sort(items, {}, [](const BatchItem &item) { return item.first.hash(); });
+}
+
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+void V8gHashTrie<Key, Value>::sortBatch(std::span<Key> keys)
+{
+	std::ranges::sort(keys, {}, [](const Key &key) { return key.hash(); });
+}
+
 template<CV8gUniqueHashableKey Key, CV8gValue Value>
 auto V8gHashTrie<Key, Value>::find(Key key) const noexcept -> const Item *
 {
@@ -861,13 +1145,124 @@ auto V8gHashTrie<Key, Value>::findNext(Key key) const noexcept -> const Item *
 	return nullptr;
 }
 
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+auto V8gHashTrie<Key, Value>::memoryStats(const V8gHashTrie *other, ValueHeapBytesFn value_heap_bytes) const
+	-> MemoryStats
+{
+	MemoryStats stats;
+
+	for (uint32_t i = 0; i < std::size(m_root_nodes); i++) {
+		if (const Node *node = m_root_nodes[i].second.get(); node != nullptr) {
+			const Node *other_node = other ? other->m_root_nodes[i].second.get() : nullptr;
+			node->collectMemoryStats(other_node, other, value_heap_bytes, stats);
+		}
+	}
+
+	return stats;
+}
+
 template<CV8gUniqueHashableKey Key, CV8gValue Value>
 void V8gHashTrie<Key, Value>::visitDiff(const V8gHashTrie &old, DiffVisitorFn visitor) const
+{
+	visitDiffRange(old, 0, 1u << DIFF_PREFIX_BITS, visitor);
+}
+
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+void V8gHashTrie<Key, Value>::visitDiffParallel(const V8gHashTrie &old, svc::TaskService &task_service,
+	DiffVisitorFn visitor) const
+{
+	static_assert((1u << DIFF_PREFIX_BITS) % PARALLEL_DIFF_PARTS == 0);
+	constexpr uint32_t PART_PREFIXES = (1u << DIFF_PREFIX_BITS) / PARALLEL_DIFF_PARTS;
+
+	// Shared with tasks, some of them might start executing only after we return.
+	// These won't find any remaining parts and will exit without touching anything else.
+	struct State {
+		State(const V8gHashTrie *n, const V8gHashTrie *o, DiffVisitorFn v) noexcept
+			: new_trie(n), old_trie(o), visitor(v)
+		{}
+
+		const V8gHashTrie *new_trie;
+		const V8gHashTrie *old_trie;
+		DiffVisitorFn visitor;
+
+		std::atomic_uint32_t next_part = 0;
+		std::atomic_uint32_t done_parts = 0;
+		std::atomic_bool stop = false;
+
+		os::FutexLock error_lock;
+		std::exception_ptr error;
+	};
+
+	auto state = std::make_shared<State>(this, &old, visitor);
+
+	auto process_parts = [](State &st) noexcept {
+		uint32_t part;
+
+		while ((part = st.next_part.fetch_add(1, std::memory_order_relaxed)) < PARALLEL_DIFF_PARTS) {
+			if (!st.stop.load(std::memory_order_relaxed)) {
+				try {
+					const uint32_t begin = part * PART_PREFIXES;
+					if (!st.new_trie->visitDiffRange(*st.old_trie, begin, begin + PART_PREFIXES, st.visitor)) {
+						st.stop.store(true, std::memory_order_relaxed);
+					}
+				}
+				catch (...) {
+					std::lock_guard lk(st.error_lock);
+					if (!st.error) {
+						st.error = std::current_exception();
+					}
+
+					st.stop.store(true, std::memory_order_relaxed);
+				}
+			}
+
+			// Release visitor side effects to the waiting thread
+			if (st.done_parts.fetch_add(1, std::memory_order_acq_rel) + 1 == PARALLEL_DIFF_PARTS) {
+				os::Futex::wakeAll(&st.done_parts);
+			}
+		}
+	};
+
+	const uint32_t num_tasks = std::min(PARALLEL_DIFF_PARTS - 1, std::thread::hardware_concurrency());
+
+	try {
+		svc::TaskBuilder bld(task_service);
+
+		for (uint32_t i = 0; i < num_tasks; i++) {
+			bld.enqueueTask([state, process_parts](svc::TaskContext &) { process_parts(*state); });
+		}
+	}
+	catch (...) {
+		// Tasks are just helpers, we will process all remaining parts here anyway
+	}
+
+	process_parts(*state);
+
+	// Wait for parts taken by other threads
+	uint32_t done_parts;
+	while ((done_parts = state->done_parts.load(std::memory_order_acquire)) != PARALLEL_DIFF_PARTS) {
+		os::Futex::waitInfinite(&state->done_parts, done_parts);
+	}
+
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
+
+template<CV8gUniqueHashableKey Key, CV8gValue Value>
+bool V8gHashTrie<Key, Value>::visitDiffRange(const V8gHashTrie &old, uint32_t prefix_begin, uint32_t prefix_end,
+	DiffVisitorFn visitor) const
 {
 	auto left_unary_adapter = [&](const Item *item) { return visitor(item, nullptr); };
 	auto right_unary_adapter = [&](const Item *item) { return visitor(nullptr, item); };
 
-	for (uint32_t i = 0; i < std::size(m_root_nodes); i++) {
+	constexpr uint32_t CHILD_PREFIXES = 64;
+
+	const uint32_t first_root = prefix_begin / CHILD_PREFIXES;
+	const uint32_t last_root = std::min<uint32_t>((prefix_end + CHILD_PREFIXES - 1) / CHILD_PREFIXES,
+		std::size(m_root_nodes));
+
+	for (uint32_t i = first_root; i < last_root; i++) {
 		if (m_root_nodes[i].first == old.m_root_nodes[i].first) {
 			continue;
 		}
@@ -880,18 +1275,26 @@ void V8gHashTrie<Key, Value>::visitDiff(const V8gHashTrie &old, DiffVisitorFn vi
 			continue;
 		}
 
+		// Limit root node slots to the requested range
+		const uint32_t lo = std::max(prefix_begin, i * CHILD_PREFIXES) - i * CHILD_PREFIXES;
+		const uint32_t hi = std::min(prefix_end, (i + 1) * CHILD_PREFIXES) - i * CHILD_PREFIXES;
+		const uint64_t hi_mask = hi == 64 ? ~uint64_t(0) : (uint64_t(1) << hi) - 1;
+		const uint64_t bit_mask = hi_mask & ~((uint64_t(1) << lo) - 1);
+
 		if (!new_node) {
-			if (!old_node->visitUnary(right_unary_adapter)) [[unlikely]] {
-				return;
+			if (!old_node->visitUnary(right_unary_adapter, bit_mask)) [[unlikely]] {
+				return false;
 			}
 		} else if (!old_node) {
-			if (!new_node->visitUnary(left_unary_adapter)) [[unlikely]] {
-				return;
+			if (!new_node->visitUnary(left_unary_adapter, bit_mask)) [[unlikely]] {
+				return false;
 			}
-		} else if (!Node::visitDiff(new_node, old_node, visitor)) [[unlikely]] {
-			return;
+		} else if (!Node::visitDiff(new_node, old_node, visitor, bit_mask)) [[unlikely]] {
+			return false;
 		}
 	}
+
+	return true;
 }
 
 } // namespace voxen
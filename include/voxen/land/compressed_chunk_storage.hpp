@@ -5,6 +5,7 @@
 #include <voxen/visibility.hpp>
 
 #include <memory>
+#include <span>
 
 namespace voxen::land
 {
@@ -23,8 +24,10 @@ namespace voxen::land
 // using `expand()` before doing complex operations on
 // the chunk (when accessing more than a few values).
 //
-// Modifying the storage is not supported - you should decompress,
-// change the plain 3D array and then compress it again.
+// Small modifications can be done in place with `store()`, `fillBox()`
+// and `fillSphere()` - they rewrite only the affected 8x8x8 subchunks.
+// For complex changes touching most of the chunk it's still better
+// to decompress, change the plain 3D array and compress it again.
 //
 // Template is instantiated only for uint8_t, uint16_t and uint32_t values.
 // There is also a specialization for bool values, see below.
@@ -49,6 +52,10 @@ public:
 
 	// Decompress into a plain 3D array
 	void expand(ExpandedView view) const noexcept;
+	// Decompress only values with Y in [8 * slab; 8 * slab + 8), `slab` must be in [0; 4).
+	// Y coordinate in `view` is relative to the slab start, only 8 layers of it are written.
+	// Allows walking the chunk layer by layer without keeping the whole plain array in cache.
+	void expandSlab(uint32_t slab, ExpandedView view) const noexcept;
 
 	// Set all values in the chunk to `value`
 	void setUniform(T value) noexcept;
@@ -65,6 +72,43 @@ public:
 	// Same as `load(pos.x, pos.y, pos.z)`
 	T operator[](glm::uvec3 pos) const noexcept { return load(pos.x, pos.y, pos.z); }
 
+	// Single element modification. Behavior is undefined if
+	// any of x, y or z is out of chunk boundaries.
+	//
+	// Only the affected 8x8x8 subchunk is decompressed and compressed again,
+	// and only if its structure changes (e.g. a uniform part has to be split
+	// or a 2x2x2 piece becomes uniform). Otherwise the value is changed in place.
+	// Compression after any sequence of modifications is as good as if
+	// the whole chunk was compressed from a plain 3D array.
+	void store(uint32_t x, uint32_t y, uint32_t z, T value);
+	// Same as `store(pos.x, pos.y, pos.z, value)`
+	void store(glm::uvec3 pos, T value) { store(pos.x, pos.y, pos.z, value); }
+	// Set all values in [begin; end) box to `value`. The box is clipped
+	// to chunk boundaries. Only 8x8x8 subchunks intersecting it are rewritten.
+	void fillBox(glm::uvec3 begin, glm::uvec3 end, T value);
+	// Set all values within `radius` of `center` (in chunk-local block coordinates,
+	// can be outside of the chunk) to `value`. Block is considered to be within
+	// the sphere if its center point is. Only 8x8x8 subchunks intersecting
+	// the sphere bounding box are rewritten.
+	void fillSphere(glm::vec3 center, float radius, T value);
+
+	// Number of bytes needed to store the current contents with `serialize()`
+	size_t serializedSize() const noexcept;
+	// Write a compact binary representation of the current contents into `output`.
+	// Its size must be at least `serializedSize()`, otherwise the behavior is undefined.
+	// Returns the number of bytes written.
+	//
+	// Representation is a direct dump of the internal structure in native byte order.
+	// It is not portable to big-endian machines but we don't support these anyway.
+	size_t serialize(std::span<std::byte> output) const noexcept;
+	// Restore the contents from a representation written by `serialize()`.
+	// Input is validated, so it's safe to pass untrusted (e.g. loaded from disk) data.
+	// Returns false if `input` is malformed, leaving the current contents unchanged.
+	bool deserialize(std::span<const std::byte> input);
+
+	// Number of heap bytes allocated by this storage, not including `sizeof(*this)`
+	size_t heapBytes() const noexcept;
+
 private:
 	struct Leaf {
 		T data[8];
@@ -85,6 +129,23 @@ private:
 		T m_uniform_value;
 	};
 	std::unique_ptr<Node[]> m_nodes;
+
+	// Compress 8x8x8 values into `output`, replacing its previous contents.
+	// Returns false if all values are zero, then `output` is left empty.
+	static bool compressNode(CubeArrayView<const T, 8> input, Node &output);
+	// Decompress a non-zero node into 8x8x8 values
+	static void expandNode(const Node &node, CubeArrayView<T, 8> output) noexcept;
+
+	// Move nodes into a full 64-entry array, leaving the storage in unspecified
+	// state until `packNodes()` is called. Returns mask of non-zero nodes.
+	uint64_t unpackNodes(std::span<Node, 64> nodes) noexcept;
+	// Move non-zero nodes from a full 64-entry array back into the storage,
+	// collapsing it into a single value if all nodes are uniform and equal
+	void packNodes(std::span<Node, 64> nodes, uint64_t nonzero_node_mask);
+	// Call `fn(node_base, CubeArrayView<T, 8>)` for every node set in `node_mask`
+	// with decompressed node values, then compress the changed nodes back
+	template<typename F>
+	void modifyNodes(uint64_t node_mask, F &&fn);
 };
 
 // Specialization of `CompressedChunkStorage` for boolean values,
@@ -128,6 +189,9 @@ public:
 	// Same as `load(pos.x, pos.y, pos.z)
 	bool operator[](glm::uvec3 pos) { return load(pos.x, pos.y, pos.z); }
 
+	// Number of heap bytes allocated by this storage, not including `sizeof(*this)`
+	size_t heapBytes() const noexcept;
+
 private:
 	struct Node {
 		uint8_t m_leaf_mask[64];
@@ -5,7 +5,7 @@
 namespace voxen::land
 {
 
-class Chunk {
+class VOXEN_API Chunk {
 public:
 	using BlockId = uint16_t;
 
@@ -13,15 +13,22 @@ public:
 	using BlockIdArray = CubeArray<BlockId, Consts::CHUNK_SIZE_BLOCKS>;
 
 	void setAllBlocks(BlockIdStorage::ConstExpandedView view);
+	// Replace block IDs with an already compressed storage, e.g. loaded from disk
+	void setAllBlocks(BlockIdStorage storage) noexcept;
 	void setAllBlocksUniform(BlockId value);
+	// Change a single block ID, see `CompressedChunkStorage::store()`
+	void setBlock(glm::uvec3 pos, BlockId value) { m_block_ids.store(pos, value); }
 
 	const BlockIdStorage &blockIds() const noexcept { return m_block_ids; }
 
+	// Number of heap bytes owned by this object, for memory accounting
+	size_t heapBytes() const noexcept { return m_block_ids.heapBytes(); }
+
 private:
 	BlockIdStorage m_block_ids;
 };
 
-struct ChunkAdjacencyRef {
+struct VOXEN_API ChunkAdjacencyRef {
 	constexpr static uint32_t SIZE = Consts::CHUNK_SIZE_BLOCKS + 2;
 
 	const Chunk &chunk;
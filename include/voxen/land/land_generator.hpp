@@ -5,8 +5,13 @@
 #include <voxen/land/chunk_key.hpp>
 #include <voxen/land/land_chunk.hpp>
 #include <voxen/land/pseudo_chunk_data.hpp>
+#include <voxen/os/futex.hpp>
 #include <voxen/svc/svc_fwd.hpp>
 #include <voxen/util/lru_visit_ordering.hpp>
+#include <voxen/visibility.hpp>
+
+#include <memory>
+#include <unordered_map>
 
 namespace voxen::land
 {
@@ -68,7 +73,7 @@ private:
 
 // This class has special multithreaded usage rules,
 // see description of every function before using it.
-class Generator {
+class VOXEN_API Generator {
 public:
 	Generator();
 	Generator(Generator &&) = delete;
@@ -77,6 +82,7 @@ public:
 	Generator &operator=(const Generator &) = delete;
 	~Generator();
 
+	// Also evicts column heightmaps not used for a while
 	void onWorldTickBegin(WorldTickId new_tick);
 	void setSeed(uint64_t seed);
 	// Uses `bld` to wait for tasks enqueued by this builder.
@@ -91,6 +97,7 @@ public:
 
 	// Generate a true (LOD0) chunk.
 	// Should be called from asynchronous task - this takes a while.
+	// Can be called from multiple threads concurrently, as can `generatePseudoChunk()`.
 	// Before launching that task, call `prepareKeyGeneration(key)`
 	// and wait on the returned counter.
 	//
@@ -116,6 +123,14 @@ private:
 		uint64_t gen_task_counter = 0;
 	};
 
+	// 2D (XZ plane) surface samples shared by all chunks in a vertical column, defined in cpp file
+	struct ColumnHeightmap;
+
+	struct ColumnHeightmapCacheEntry {
+		std::shared_ptr<const ColumnHeightmap> ptr;
+		WorldTickId last_referenced_tick = WorldTickId::INVALID;
+	};
+
 	uint64_t m_initial_seed = 0;
 
 	uint64_t m_global_map_sub_seed = 0;
@@ -129,7 +144,16 @@ private:
 
 	SharedObjectPool<GeneratorRegionalMap, REGIONAL_MAP_POOL_HINT> m_regional_map_pool;
 
+	// Protects column heightmap cache and `m_current_world_tick`
+	// from concurrent generation tasks, all of them use this cache
+	os::FutexLock m_column_cache_lock;
+	// Keyed by chunk key with zero Y coordinate. True chunks (LOD0) and pseudo-chunks
+	// sample different points, their heightmaps differ by the key scale anyway.
+	std::unordered_map<ChunkKey, ColumnHeightmapCacheEntry> m_column_cache;
+
 	uint64_t ensureGlobalMap(svc::TaskBuilder &bld);
+	// Find cached heightmap of the column containing `key` or sample a new one
+	std::shared_ptr<const ColumnHeightmap> getColumnHeightmap(ChunkKey key);
 };
 
 } // namespace voxen::land
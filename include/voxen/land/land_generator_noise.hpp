@@ -0,0 +1,30 @@
+#pragma once
+
+#include <voxen/visibility.hpp>
+
+#include <cstdint>
+#include <span>
+
+// Noise functions used by land `Generator`. Exposed mostly for testing,
+// their output is not guaranteed to stay the same between versions.
+namespace voxen::land::GeneratorNoise
+{
+
+// Sample octaved 2D simplex noise at (x; z) world position, in metres.
+// Noise is wrapped to tile at world X/Z boundaries (see `Consts::*_UNIQUE_WORLD_*_CHUNK`).
+// Returned value is height offset in metres, within roughly [-1000; 1000] range.
+//
+// This is a scalar reference implementation, use `sampleOctavedWrappedSimplexPlane()`
+// to sample many points at once, it is several times faster.
+VOXEN_API float sampleOctavedWrappedSimplex(double x, double z) noexcept;
+
+// Sample a regular `size * size` grid of points with `sampleOctavedWrappedSimplex()`.
+// Point (i; j) is located at (min_x + i * step; min_z + j * step) and its value
+// is stored in `output[i * size + j]` (XZ order), `output` must have enough space.
+//
+// Results can differ from the scalar version by a few ULPs
+// due to different floating point operations rounding.
+VOXEN_API void sampleOctavedWrappedSimplexPlane(double min_x, double min_z, double step, uint32_t size,
+	std::span<float> output) noexcept;
+
+} // namespace voxen::land::GeneratorNoise
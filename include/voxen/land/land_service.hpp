@@ -1,10 +1,16 @@
 #pragma once
 
 #include <voxen/common/world_state.hpp>
+#include <voxen/land/chunk_key.hpp>
+#include <voxen/land/land_shared_state.hpp>
+#include <voxen/land/pseudo_chunk_surface.hpp>
 #include <voxen/svc/service_base.hpp>
 
 #include <extras/pimpl.hpp>
 
+#include <chrono>
+#include <filesystem>
+
 namespace voxen::land
 {
 
@@ -16,14 +22,37 @@ class LandServiceImpl;
 }
 
 struct LandState;
+struct LandStateMemoryStats;
 
 // Accepts the following messages:
 // - `voxen::land::ChunkTicketRequestMessage`
+// - `voxen::land::BlockEditMessage`
 class VOXEN_API LandService final : public svc::IService {
 public:
 	constexpr static UID SERVICE_UID = UID("bbefcea8-8ef334a9-89dd1efc-c0176d14");
 
-	explicit LandService(svc::ServiceLocator &svc);
+	struct Config {
+		// Directory for persistent chunk storage (region files).
+		// Chunks are loaded from there before falling back to generation,
+		// and edited chunks are written back before unloading.
+		// Leave empty to disable persistence, then edits are lost on unload.
+		std::filesystem::path storage_directory;
+		// Target duration of key visiting and cleanup work done by `doTick()`.
+		// Numbers of keys visited per tick are adjusted to fit into it.
+		std::chrono::microseconds tick_work_budget { 2000 };
+		// Memory usage of land state is collected and logged once in this
+		// number of world ticks (see `currentStateMemoryStats()`). Collection walks
+		// the whole state synchronously in `doTick()`, enable only for diagnostics.
+		// Zero (default) disables it.
+		uint32_t memory_stats_period = 0;
+		// Publish chunk table to shared memory for out-of-process readers
+		// after every tick, see `SharedLandStatePublisher`. Disabled if name is empty.
+		SharedLandStatePublisher::Config shared_state;
+		// Vertex welding settings of generated pseudo-chunk (LOD) surfaces
+		PseudoSurfaceWeldingConfig surface_welding;
+	};
+
+	LandService(svc::ServiceLocator &svc, Config cfg);
 	LandService(LandService &&) = delete;
 	LandService(const LandService &) = delete;
 	LandService &operator=(LandService &&) = delete;
@@ -35,8 +64,21 @@ public:
 	void doTick(WorldTickId tick_id);
 	const LandState &stateForCopy() const noexcept;
 
+	// Memory usage of land state as of the last stats collection (see `Config::memory_stats_period`).
+	// Shared parts are relative to the state of the previous tick, so unique bytes are what
+	// that tick has allocated. All zeros until the first collection. Call from `doTick()` thread.
+	const LandStateMemoryStats &currentStateMemoryStats() const noexcept;
+	// Memory usage of the previous tick state collected at the same time, shared parts
+	// are relative to the current state. Its unique bytes are roughly what any snapshot
+	// (e.g. a lingering `WorldState` pointer) retains for every tick it is kept alive.
+	const LandStateMemoryStats &previousStateMemoryStats() const noexcept;
+
+	// Number of chunk tickets currently covering `key`, as of the last `doTick()`.
+	// Intended for diagnostics and tests. Call from `doTick()` thread.
+	uint32_t chunkTicketRefs(ChunkKey key) const noexcept;
+
 private:
-	extras::pimpl<detail::LandServiceImpl, 2048, 8> m_impl;
+	extras::pimpl<detail::LandServiceImpl, 2304, 8> m_impl;
 };
 
 } // namespace voxen::land
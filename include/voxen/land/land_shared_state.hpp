@@ -0,0 +1,151 @@
+#pragma once
+
+#include <voxen/common/world_tick_id.hpp>
+#include <voxen/land/chunk_key.hpp>
+#include <voxen/visibility.hpp>
+
+#include <extras/function_ref.hpp>
+#include <extras/pimpl.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace voxen::land
+{
+
+struct LandState;
+
+// Publishes chunk table of `LandState` into a named shared memory object,
+// making it readable by other processes (see `SharedLandStateView`)
+// without copying data through sockets or pipes.
+//
+// Shared memory holds two index buffers (hash tables keyed by `ChunkKey`)
+// and an arena of serialized `CompressedChunkStorage` blobs. Buffers are
+// published in turns: the inactive one is updated from `V8gHashTrie::visitDiff()`
+// against the state it was last published with, then atomically made active.
+// Unchanged chunks share blobs between buffers and are serialized only once.
+//
+// A buffer is not updated while any reader still uses it, publication is
+// skipped then. Readers are expected to release their snapshots quickly
+// (within a few ticks), otherwise they will see increasingly stale data.
+//
+// Pseudo-chunk surfaces are not published, readers wanting
+// meshes should build them from chunk data themselves.
+class VOXEN_API SharedLandStatePublisher {
+public:
+	struct Config {
+		// Name of the shared memory object, must be a valid file name.
+		// On Linux it is created with `shm_open` (i.e. in `/dev/shm`),
+		// on Windows it is a named file mapping in `Local\` namespace.
+		// On Linux, existing object with the same name is replaced. On Windows, it can't
+		// be replaced while anyone has it open, creation throws `AlreadyRegistered` then.
+		// Leave empty to disable publication (where it is optional).
+		std::string name;
+		// Maximal number of chunks in one published state
+		uint32_t max_chunks = 256 * 1024;
+		// Size of serialized chunk data arena. On Linux, memory is committed
+		// lazily so this can be large. On Windows, it is fully committed
+		// against the page file, though not touched until needed.
+		size_t arena_bytes = size_t(1) << 30;
+	};
+
+	// Creates the shared memory object, throws `Exception` on failure
+	explicit SharedLandStatePublisher(Config cfg);
+	SharedLandStatePublisher(SharedLandStatePublisher &&) = delete;
+	SharedLandStatePublisher(const SharedLandStatePublisher &) = delete;
+	SharedLandStatePublisher &operator=(SharedLandStatePublisher &&) = delete;
+	SharedLandStatePublisher &operator=(const SharedLandStatePublisher &) = delete;
+	// Removes the shared memory object name. Readers having it
+	// opened can continue reading the last published state.
+	~SharedLandStatePublisher() noexcept;
+
+	// Publish chunk table of `state` as the state of `tick_id`. Takes time proportional
+	// to the number of chunks changed since the previous publication (not just the previous
+	// call) plus the number of skipped publications. Returns false if publication was skipped
+	// because a reader is still using the buffer to be updated, or if capacity limits from
+	// `Config` were exceeded. In the latter case publication stops forever, as the buffer
+	// is left partially updated (though readers can still use the last valid one).
+	bool publish(WorldTickId tick_id, const LandState &state);
+
+private:
+	struct VOXEN_LOCAL Impl;
+	extras::pimpl<Impl, 1536, 8> m_impl;
+};
+
+// Read-only view of a land state published by `SharedLandStatePublisher`,
+// possibly from another process. Occupies one of a limited number
+// of reader slots until destroyed.
+//
+// This class is not thread-safe, use separate views in different threads.
+class VOXEN_API SharedLandStateView {
+public:
+	struct ChunkItem {
+		ChunkKey key;
+		// Version (world tick ID) of the last change of this chunk.
+		// Compare with versions from older snapshots to find changed chunks.
+		uint64_t version;
+		// Block IDs storage serialized with `CompressedChunkStorage::serialize()`,
+		// use `Chunk::BlockIdStorage::deserialize()` to restore it
+		std::span<const std::byte> block_ids;
+	};
+
+	// Consistent state of one published tick. Data will not change while this object
+	// is alive, but holding it for long blocks publication. Only one snapshot per
+	// view can exist at a time, destroy it before calling `acquire()` again.
+	class VOXEN_API Snapshot {
+	public:
+		Snapshot() = default;
+		Snapshot(Snapshot &&other) noexcept;
+		Snapshot(const Snapshot &) = delete;
+		Snapshot &operator=(Snapshot &&other) noexcept;
+		Snapshot &operator=(const Snapshot &) = delete;
+		~Snapshot() noexcept;
+
+		// False if nothing was published yet, other methods are invalid then
+		bool valid() const noexcept { return m_view != nullptr; }
+
+		WorldTickId tickId() const noexcept;
+		// Number of chunks in this state
+		size_t size() const noexcept;
+
+		std::optional<ChunkItem> find(ChunkKey key) const noexcept;
+		// Visit all chunks in unspecified order
+		void forEach(extras::function_ref<void(const ChunkItem &)> visitor) const;
+
+	private:
+		const SharedLandStateView *m_view = nullptr;
+		uint32_t m_buffer = 0;
+
+		Snapshot(const SharedLandStateView *view, uint32_t buffer) noexcept : m_view(view), m_buffer(buffer) {}
+		void release() noexcept;
+
+		friend class SharedLandStateView;
+	};
+
+	// Opens the shared memory object and takes a reader slot.
+	// Throws `Exception` if there is no such object, if it has incompatible format
+	// (`VoxenErrc::InvalidData`) or if all reader slots are taken (`VoxenErrc::OutOfResource`).
+	explicit SharedLandStateView(std::string_view name);
+	SharedLandStateView(SharedLandStateView &&) = delete;
+	SharedLandStateView(const SharedLandStateView &) = delete;
+	SharedLandStateView &operator=(SharedLandStateView &&) = delete;
+	SharedLandStateView &operator=(const SharedLandStateView &) = delete;
+	~SharedLandStateView() noexcept;
+
+	// Pin the most recently published state. Returns invalid snapshot if nothing
+	// was published yet. Lock-free, it only retries if a publication happens concurrently.
+	Snapshot acquire();
+
+	// True if the publisher is still running. If it stopped,
+	// the last published state remains readable.
+	bool publisherAlive() const noexcept;
+
+private:
+	struct VOXEN_LOCAL Impl;
+	extras::pimpl<Impl, 64, 8> m_impl;
+};
+
+} // namespace voxen::land
@@ -5,6 +5,7 @@
 #include <voxen/land/land_chunk.hpp>
 #include <voxen/land/pseudo_chunk_data.hpp>
 #include <voxen/land/pseudo_chunk_surface.hpp>
+#include <voxen/visibility.hpp>
 
 namespace voxen
 {
@@ -18,12 +19,39 @@ extern template class V8gHashTrie<land::ChunkKey, land::PseudoChunkSurface>;
 namespace voxen::land
 {
 
+struct LandStateMemoryStats;
+
 struct LandState {
 	using ChunkTable = V8gHashTrie<ChunkKey, Chunk>;
 	using PseudoChunkSurfaceTable = V8gHashTrie<ChunkKey, PseudoChunkSurface>;
 
 	ChunkTable chunk_table;
 	PseudoChunkSurfaceTable pseudo_chunk_surface_table;
+
+	// Compute memory usage of all tables, optionally split into parts shared with `other`
+	// snapshot (see `V8gHashTrie::memoryStats()`). Value sizes include chunk block storage
+	// and surface vertex/index arrays. Walks all tables, don't call it too often.
+	VOXEN_API LandStateMemoryStats memoryStats(const LandState *other) const;
+};
+
+// Memory usage of `LandState` tables, see `LandState::memoryStats()`
+struct LandStateMemoryStats {
+	LandState::ChunkTable::MemoryStats chunk_table;
+	LandState::PseudoChunkSurfaceTable::MemoryStats pseudo_chunk_surface_table;
+
+	// Total bytes of nodes and values in all tables
+	size_t totalBytes() const noexcept
+	{
+		return chunk_table.node_bytes + chunk_table.value_bytes + pseudo_chunk_surface_table.node_bytes
+			+ pseudo_chunk_surface_table.value_bytes;
+	}
+
+	// Bytes of nodes and values not shared with the other snapshot
+	size_t uniqueBytes() const noexcept
+	{
+		return totalBytes() - chunk_table.shared_node_bytes - chunk_table.shared_value_bytes
+			- pseudo_chunk_surface_table.shared_node_bytes - pseudo_chunk_surface_table.shared_value_bytes;
+	}
 };
 
 } // namespace voxen::land
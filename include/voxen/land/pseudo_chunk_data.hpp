@@ -2,6 +2,7 @@
 
 #include <voxen/land/chunk_key.hpp>
 #include <voxen/land/land_fwd.hpp>
+#include <voxen/visibility.hpp>
 
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
@@ -11,7 +12,7 @@
 namespace voxen::land
 {
 
-class PseudoChunkData {
+class VOXEN_API PseudoChunkData {
 public:
 	struct CellEntry {
 		// Cell index (x; y; z), coordinates are in range [0; Consts::CHUNK_SIZE_BLOCKS)
@@ -43,6 +44,8 @@ public:
 		// calculation, clamped to UINT16_MAX. Acts as a weighting factor - during next
 		// aggregations points with larger counts will "drag" the average towards them.
 		uint16_t surface_point_sum_count;
+
+		bool operator==(const CellEntry &other) const noexcept = default;
 	};
 
 	using CellEntryArray = std::vector<CellEntry>;
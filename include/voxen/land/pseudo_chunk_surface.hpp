@@ -1,6 +1,7 @@
 #pragma once
 
 #include <voxen/land/land_fwd.hpp>
+#include <voxen/visibility.hpp>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -44,7 +45,22 @@ struct PseudoSurfaceVertexAttributes {
 	glm::u8vec4 mat_hist_weights;
 };
 
-class PseudoChunkSurface {
+// Controls merging of vertices shared by adjacent triangles of pseudo-chunk surfaces.
+// Only vertices with equal positions and equal sets of material histogram
+// entries can be welded, these are additional tolerances for other attributes.
+// Welded vertex keeps attributes of the first one, the others are dropped.
+struct PseudoSurfaceWeldingConfig {
+	// Maximal angle between normals of welded vertices, in degrees.
+	// Surfaces are flat shaded, so this essentially smooths out features below it.
+	// Set to zero to weld only vertices with exactly matching normals.
+	float max_normal_angle_degrees = 15.0f;
+	// Maximal difference of any material histogram weight ([0; 255] range) of welded vertices
+	uint8_t max_mat_hist_weight_delta = 24;
+	// Size of GPU post-transform vertex cache to optimize index order for, zero disables reordering
+	uint32_t vertex_cache_size = 16;
+};
+
+class VOXEN_API PseudoChunkSurface {
 public:
 	PseudoChunkSurface() = default;
 	PseudoChunkSurface(PseudoChunkSurface &&) = default;
@@ -68,7 +84,11 @@ public:
 	// All pointers must be valid, but can point to special dummy objects.
 	//
 	// `lod` parameter drives "artistic" fixups.
-	void generate(std::span<const PseudoChunkData *const, 19> datas, uint32_t lod);
+	//
+	// Vertices are welded according to `welding` config, and
+	// indices are reordered for better GPU vertex cache usage.
+	void generate(std::span<const PseudoChunkData *const, 19> datas, uint32_t lod,
+		const PseudoSurfaceWeldingConfig &welding = {});
 
 	// Vertex array size is guaranteed to never exceed UINT32_MAX (actually even UINT16_MAX due to 16-bit index)
 	uint32_t numVertices() const noexcept { return static_cast<uint32_t>(m_vertex_positions.size()); }
@@ -81,6 +101,14 @@ public:
 
 	bool empty() const noexcept { return m_indices.empty(); }
 
+	// Number of heap bytes owned by this object (vector capacities), for memory accounting
+	size_t heapBytes() const noexcept
+	{
+		return m_vertex_positions.capacity() * sizeof(PseudoSurfaceVertexPosition)
+			+ m_vertex_attributes.capacity() * sizeof(PseudoSurfaceVertexAttributes)
+			+ m_indices.capacity() * sizeof(uint16_t);
+	}
+
 private:
 	std::vector<PseudoSurfaceVertexPosition> m_vertex_positions;
 	std::vector<PseudoSurfaceVertexAttributes> m_vertex_attributes;
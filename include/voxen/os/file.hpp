@@ -166,6 +166,14 @@ public:
 	// On Windows, behavior is undefined if the file was opened with `AsyncIo` flag.
 	size_t pread(std::span<std::byte> buffer, int64_t offset);
 
+	// Synchronous (blocking) vectored read from the specified non-negative offset.
+	// Works like `pread()` into a buffer formed by concatenating `buffers`
+	// but does it in one syscall (if the number of buffers is not very large).
+	// Returns the total number of bytes read, less than the total size means EOF.
+	//
+	// Concurrency rules and error handling are the same as in `pread()`.
+	size_t preadv(std::span<const std::span<std::byte>> buffers, int64_t offset);
+
 	// Synchronous (blocking) write to the current file offset.
 	// It either writes all bytes supplied in `buffer` (note that "writes" merely means
 	// OS has acknowledged this request, not that data has fully reached the disk),
@@ -195,6 +203,13 @@ public:
 	// On Windows, behavior is undefined if the file was opened with `AsyncIo` flag.
 	void pwrite(std::span<const std::byte> buffer, int64_t offset);
 
+	// Synchronous (blocking) vectored write to the specified non-negative offset.
+	// Works like `pwrite()` from a buffer formed by concatenating `buffers`
+	// but does it in one syscall (if the number of buffers is not very large).
+	//
+	// Concurrency rules and error handling are the same as in `pwrite()`.
+	void pwritev(std::span<const std::span<const std::byte>> buffers, int64_t offset);
+
 	NativeHandle get() const noexcept { return m_handle; }
 	bool valid() const noexcept { return m_handle != INVALID_HANDLE; }
 
@@ -12,21 +12,84 @@
 
 #include <span>
 #include <system_error>
+#include <vector>
 
 namespace voxen::svc
 {
 
 // Performs asynchronous (background) file I/O operations.
+//
+// On Linux it uses io_uring, keeping many operations in flight from one thread.
+// If io_uring is unavailable (old kernel, blocked in a container etc.)
+// or on other platforms, it falls back to a pool of blocking I/O threads.
 class VOXEN_API AsyncFileIoService final : public IService {
 public:
 	constexpr static UID SERVICE_UID = UID("91131570-ddfb7ba3-49b63d4d-04aaf4c8");
 	constexpr static uint32_t FILE_HANDLE_POOL_HINT = 256;
 
-	using Ptr = SharedPoolPtr<os::File, FILE_HANDLE_POOL_HINT>;
+	// File handle registered for asynchronous I/O, see `registerFile()`
+	class VOXEN_API RegisteredFile {
+	public:
+		// Implementation-specific constructor, use `registerFile()`
+		RegisteredFile(os::File file, detail::AsyncFileIoServiceImpl &owner, uint32_t fixed_slot) noexcept;
+		RegisteredFile(RegisteredFile &&) = delete;
+		RegisteredFile(const RegisteredFile &) = delete;
+		RegisteredFile &operator=(RegisteredFile &&) = delete;
+		RegisteredFile &operator=(const RegisteredFile &) = delete;
+		~RegisteredFile();
+
+		// Underlying file handle. Synchronous operations are allowed too, with the
+		// same concurrency rules as if asynchronous ones were its `pread()/pwrite()`.
+		os::File &file() noexcept { return m_file; }
+
+	private:
+		os::File m_file;
+		detail::AsyncFileIoServiceImpl &m_owner;
+		// Index in the kernel-side registered file table, `UINT32_MAX` if not registered
+		uint32_t m_fixed_slot;
+
+		friend class detail::AsyncFileIoServiceImpl;
+	};
+
+	using Ptr = SharedPoolPtr<RegisteredFile, FILE_HANDLE_POOL_HINT>;
 	using ReadResult = cpp::result<size_t, std::error_condition>;
 	using WriteResult = cpp::result<void, std::error_condition>;
+	// Results of batch requests, in the same order as requests
+	using BatchReadResult = std::vector<ReadResult>;
+	using BatchWriteResult = std::vector<WriteResult>;
+
+	// Single read of a batch, see `asyncReadBatch()`
+	struct ReadRequest {
+		Ptr file;
+		std::span<std::byte> buffer;
+		int64_t offset;
+	};
 
-	struct Config {};
+	// Single write of a batch, see `asyncWriteBatch()`
+	struct WriteRequest {
+		Ptr file;
+		std::span<const std::byte> buffer;
+		int64_t offset;
+	};
+
+	struct Config {
+		// Maximal number of operations in flight (io_uring submission queue depth).
+		// Further operations stay queued until some of the in-flight ones complete.
+		// Zero is treated as one.
+		uint32_t queue_depth = 64;
+		// Size of kernel-side registered file table. Files from `registerFile()`
+		// get a slot there while available, saving per-operation fd lookups.
+		// Set to zero to disable file registration.
+		uint32_t registered_file_slots = 64;
+		// Optional memory regions registered with the kernel (io_uring only).
+		// Operations with buffers fully inside one of them skip per-operation page
+		// mapping. This memory must stay valid until the service is destroyed.
+		std::vector<std::span<std::byte>> registered_buffers;
+		// Number of blocking I/O threads used when io_uring is not available
+		uint32_t fallback_threads = 4;
+		// Use blocking I/O threads even if io_uring is available
+		bool force_fallback = false;
+	};
 
 	AsyncFileIoService(ServiceLocator &svc, Config cfg);
 	AsyncFileIoService(AsyncFileIoService &&) = delete;
@@ -43,6 +106,8 @@ public:
 	//
 	// File must have been opened with `FileFlagsBit::AsyncIo` flag, otherwise
 	// asynchronous operations behavior is undefined (on Windows, that is).
+	//
+	// All returned pointers must be destroyed before this service.
 	Ptr registerFile(os::File file);
 
 	// Enqueue an asynchronous read (similar to `File::pread`)
@@ -50,8 +115,23 @@ public:
 	// Enqueue an asynchronous write (similar to `File::pwrite`)
 	CoroFuture<WriteResult> asyncWrite(Ptr file, std::span<const std::byte> buffer, int64_t offset);
 
+	// Enqueue an asynchronous vectored read (similar to `File::preadv`).
+	// `buffers` array is copied, only the memory it points to must stay valid.
+	CoroFuture<ReadResult> asyncReadv(Ptr file, std::span<const std::span<std::byte>> buffers, int64_t offset);
+	// Enqueue an asynchronous vectored write (similar to `File::pwritev`).
+	// `buffers` array is copied, only the memory it points to must stay valid.
+	CoroFuture<WriteResult> asyncWritev(Ptr file, std::span<const std::span<const std::byte>> buffers,
+		int64_t offset);
+
+	// Enqueue many independent reads at once. This takes the queue lock and wakes I/O
+	// thread(s) only once, and uses one counter and one result allocation for the whole batch.
+	// Requests can be performed in any order, the future completes when all of them are done.
+	CoroFuture<BatchReadResult> asyncReadBatch(std::span<const ReadRequest> requests);
+	// Enqueue many independent writes at once, see `asyncReadBatch()`
+	CoroFuture<BatchWriteResult> asyncWriteBatch(std::span<const WriteRequest> requests);
+
 private:
-	extras::pimpl<detail::AsyncFileIoServiceImpl, 256, 8> m_impl;
+	extras::pimpl<detail::AsyncFileIoServiceImpl, 512, 8> m_impl;
 };
 
 } // namespace voxen::svc
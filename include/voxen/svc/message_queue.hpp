@@ -46,9 +46,21 @@ public:
 		}
 	}
 
-	// TODO: send a broadcast message
-	// template<CBroadcastMessageBase Msg, typename... Args>
-	// void broadcast(Args &&...args);
+	// Send a broadcast message. It is received by every agent subscribed to this
+	// message UID at the moment of sending, including this one. Payload is constructed
+	// once and shared among all recipients. Subscribe by registering a handler for it.
+	template<CBroadcastMessageBase Msg, typename... Args>
+	void broadcast(Args &&...args)
+	{
+		detail::MessageHeader *header = makeMessageHeader<Msg>(false, std::forward<Args>(args)...);
+
+		if constexpr (std::is_trivially_destructible_v<Msg>) {
+			// Don't instantiate empty deleter for trivially destructible payloads
+			doBroadcast(Msg::MESSAGE_UID, header, nullptr);
+		} else {
+			doBroadcast(Msg::MESSAGE_UID, header, &destroyPayload<Msg>);
+		}
+	}
 
 	// Register handler function for a non-empty unicast message
 	template<CMessageType Msg, CMessageHandler<Msg> F>
@@ -76,20 +88,23 @@ public:
 		} });
 	}
 
-	// Register handler function for a non-empty broadcast message
+	// Register handler function for a non-empty broadcast message.
+	// This also subscribes the queue to receive broadcasts of this type.
 	template<CBroadcastType Msg, CBroadcastHandler<Msg> F>
 	void registerHandler(F &&fn)
 	{
-		doRegisterHandler(Msg::MESSAGE_UID, MessageHandler { [f = std::forward<F>(fn)](MessageInfo &info, void *payload) {
-			f(*static_cast<const Msg *>(payload), info);
-		} });
+		doRegisterBroadcastHandler(Msg::MESSAGE_UID,
+			MessageHandler { [f = std::forward<F>(fn)](MessageInfo &info, void *payload) {
+				f(*static_cast<const Msg *>(payload), info);
+			} });
 	}
 
-	// Register handler function for an empty broadcast message (signal)
+	// Register handler function for an empty broadcast message (signal).
+	// This also subscribes the queue to receive broadcasts of this type.
 	template<CBroadcastSignalType Msg, CBroadcastSignalHandler<Msg> F>
 	void registerHandler(F &&fn)
 	{
-		doRegisterHandler(Msg::MESSAGE_UID,
+		doRegisterBroadcastHandler(Msg::MESSAGE_UID,
 			MessageHandler { [f = std::forward<F>(fn)](MessageInfo &info, void *) { f(info); } });
 	}
 
@@ -104,10 +119,15 @@ public:
 
 	// Remove a registered handler. Any further incoming message
 	// of this type, including those currently queued, will be dropped.
+	// Broadcast messages of this type will no longer be delivered.
 	template<CMessageBase Msg>
 	void unregisterHandler() noexcept
 	{
-		doUnregisterHandler(Msg::MESSAGE_UID);
+		if constexpr (CBroadcastMessageBase<Msg>) {
+			doUnregisterBroadcastHandler(Msg::MESSAGE_UID);
+		} else {
+			doUnregisterHandler(Msg::MESSAGE_UID);
+		}
 	}
 
 	// Remove a registered completion handler. Any further completion message
@@ -141,20 +161,18 @@ public:
 private:
 	using MessageHandler = extras::move_only_function<void(MessageInfo &, void *)>;
 	using CompletionHandler = extras::move_only_function<void(RequestCompletionInfo &, void *)>;
-	using HandlerItem = std::pair<UID, MessageHandler>;
-	using CompletionHandlerItem = std::pair<UID, CompletionHandler>;
 
 	struct Impl;
-	extras::pimpl<Impl, 72, 8> m_impl;
-
-	static bool handlerComparator(const HandlerItem &a, const HandlerItem &b) noexcept;
-	static bool completionHandlerComparator(const CompletionHandlerItem &a, const CompletionHandlerItem &b) noexcept;
+	extras::pimpl<Impl, 144, 8> m_impl;
 
 	void doRequestWithCompletion(UID to, UID msg_uid, detail::MessageHeader *header, PayloadDeleter deleter);
+	void doBroadcast(UID msg_uid, detail::MessageHeader *header, PayloadDeleter deleter);
 
 	void doRegisterHandler(UID msg_uid, MessageHandler handler);
+	void doRegisterBroadcastHandler(UID msg_uid, MessageHandler handler);
 	void doRegisterCompletionHandler(UID msg_uid, CompletionHandler handler);
 	void doUnregisterHandler(UID msg_uid) noexcept;
+	void doUnregisterBroadcastHandler(UID msg_uid) noexcept;
 	void doUnregisterCompletionHandler(UID msg_uid) noexcept;
 };
 
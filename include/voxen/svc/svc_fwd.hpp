@@ -3,6 +3,7 @@
 namespace voxen::svc
 {
 
+class AsyncFileIoService;
 template<typename>
 class CoroFuture;
 template<typename>
@@ -75,6 +75,12 @@ Config::Scheme Config::mainConfigScheme()
 	s.push_back({ "controller", "forward_speed", "Player forward speed", 100.0 });
 	s.push_back({ "controller", "strafe_speed", "Player strafe speed", 50.0 });
 	s.push_back({ "controller", "roll_speed", "Player roll speed", 1.5 });
+	s.push_back({ "land", "tick_budget_us", "Target duration of land service per-tick work, microseconds", 2000L });
+	s.push_back({ "land", "shared_state_name",
+		"Name of shared memory object to publish land state for external readers, empty to disable",
+		std::string() });
+	s.push_back({ "land", "memory_stats_period",
+		"Collect and log land state memory usage once in this number of ticks, 0 to disable", 0L });
 
 	return s;
 }
@@ -1,5 +1,7 @@
 #include <voxen/server/world.hpp>
 
+#include <voxen/common/config.hpp>
+#include <voxen/common/filemanager.hpp>
 #include <voxen/common/player_state_message.hpp>
 #include <voxen/debug/thread_name.hpp>
 #include <voxen/debug/uid_registry.hpp>
@@ -8,6 +10,8 @@
 #include <voxen/svc/service_locator.hpp>
 #include <voxen/util/log.hpp>
 
+#include <algorithm>
+
 namespace voxen::server
 {
 
@@ -16,7 +20,18 @@ namespace
 
 auto makeLandService(svc::ServiceLocator &svc)
 {
-	return std::make_unique<land::LandService>(svc);
+	land::LandService::Config cfg;
+	cfg.tick_work_budget = std::chrono::microseconds(Config::mainConfig()->getInt32("land", "tick_budget_us"));
+	cfg.memory_stats_period = uint32_t(std::max(0, Config::mainConfig()->getInt32("land", "memory_stats_period")));
+
+	// TODO: support multiple worlds/saves, currently there is only one per profile
+	if (!FileManager::userDataPath().empty()) {
+		cfg.storage_directory = FileManager::userDataPath() / "world" / "land";
+	}
+
+	cfg.shared_state.name = Config::mainConfig()->optionString("land", "shared_state_name").value_or("");
+
+	return std::make_unique<land::LandService>(svc, std::move(cfg));
 }
 
 } // namespace
@@ -0,0 +1,209 @@
+#include <voxen/common/object_pool_slabs.hpp>
+
+#include <bit>
+#include <cassert>
+#include <new>
+#include <utility>
+
+namespace voxen::detail
+{
+
+struct ObjectPoolSlabs::SlabHeader {
+	void *owner = nullptr;
+	SlabHeader *prev = nullptr;
+	SlabHeader *next = nullptr;
+	// Stack of freed objects, links are stored in the objects themselves
+	void *free_list = nullptr;
+	// Objects with indices [0; initial_objects) were allocated at least once
+	uint32_t initial_objects = 0;
+	uint32_t live_objects = 0;
+	uint32_t list = EMPTY_LIST;
+	uint32_t _unused = 0;
+};
+
+namespace
+{
+
+template<typename H>
+H *getSlabHeader(void *slab_base, size_t slab_size) noexcept
+{
+	std::byte *addr = reinterpret_cast<std::byte *>(slab_base);
+	return reinterpret_cast<H *>(addr + slab_size - ObjectPoolSlabs::SLAB_HEADER_SIZE);
+}
+
+template<typename H>
+H *getObjectSlabHeader(void *obj, size_t slab_size) noexcept
+{
+	// Simply mask off lower bits to get slab base address
+	uintptr_t slab_base = uintptr_t(obj) & ~(slab_size - 1u);
+	return getSlabHeader<H>(reinterpret_cast<void *>(slab_base), slab_size);
+}
+
+} // namespace
+
+ObjectPoolSlabs::ObjectPoolSlabs(void *owner, uint32_t object_size, uint32_t slab_size, uint32_t max_objects) noexcept
+	: m_owner(owner), m_object_size(object_size), m_slab_size(slab_size), m_max_objects(max_objects)
+{
+	static_assert(sizeof(SlabHeader) == SLAB_HEADER_SIZE, "Update ObjectPoolSlabs::SLAB_HEADER_SIZE");
+	// Header start alignment in pools' `calcSlabSize()` depends on this
+	static_assert(alignof(SlabHeader) <= sizeof(void *));
+
+	assert(std::has_single_bit(slab_size));
+}
+
+ObjectPoolSlabs::~ObjectPoolSlabs()
+{
+	for (SlabHeader *slab : m_lists) {
+		while (slab) {
+			SlabHeader *next = slab->next;
+			void *base = reinterpret_cast<std::byte *>(slab) + SLAB_HEADER_SIZE - m_slab_size;
+			operator delete(base, std::align_val_t(m_slab_size));
+			slab = next;
+		}
+	}
+}
+
+void *ObjectPoolSlabs::allocate()
+{
+	SlabHeader *slab;
+
+	if (m_occupancy_mask != 0) {
+		// The most occupied list first
+		slab = m_lists[std::bit_width(m_occupancy_mask) - 1];
+	} else if (m_lists[EMPTY_LIST]) {
+		slab = m_lists[EMPTY_LIST];
+	} else {
+		void *base = operator new(m_slab_size, std::align_val_t(m_slab_size));
+
+		slab = new (getSlabHeader<SlabHeader>(base, m_slab_size)) SlabHeader;
+		slab->owner = m_owner;
+		link(slab, EMPTY_LIST);
+		m_num_slabs++;
+	}
+
+	void *obj;
+
+	if (slab->free_list) {
+		// Reuse the last freed object, replace it with the next pointer stored inside it
+		obj = std::exchange(slab->free_list, *reinterpret_cast<void **>(slab->free_list));
+	} else {
+		std::byte *base = reinterpret_cast<std::byte *>(slab) + SLAB_HEADER_SIZE - m_slab_size;
+		obj = base + slab->initial_objects * m_object_size;
+		slab->initial_objects++;
+	}
+
+	slab->live_objects++;
+	m_live_objects++;
+	relink(slab);
+
+	return obj;
+}
+
+void ObjectPoolSlabs::deallocate(void *obj) noexcept
+{
+	SlabHeader *slab = getObjectSlabHeader<SlabHeader>(obj, m_slab_size);
+	assert(slab->owner == m_owner);
+
+	*reinterpret_cast<void **>(obj) = std::exchange(slab->free_list, obj);
+
+	slab->live_objects--;
+	m_live_objects--;
+	relink(slab);
+}
+
+size_t ObjectPoolSlabs::trim() noexcept
+{
+	size_t released = 0;
+
+	while (SlabHeader *slab = m_lists[EMPTY_LIST]) {
+		unlink(slab);
+		m_num_slabs--;
+
+		void *base = reinterpret_cast<std::byte *>(slab) + SLAB_HEADER_SIZE - m_slab_size;
+		operator delete(base, std::align_val_t(m_slab_size));
+		released += m_slab_size;
+	}
+
+	return released;
+}
+
+ObjectPoolStats ObjectPoolSlabs::stats() const noexcept
+{
+	return {
+		.live_objects = m_live_objects,
+		.slabs = m_num_slabs,
+		.empty_slabs = m_num_empty_slabs,
+		.slab_size = m_slab_size,
+	};
+}
+
+void *ObjectPoolSlabs::slabOwner(void *obj, size_t slab_size) noexcept
+{
+	return getObjectSlabHeader<SlabHeader>(obj, slab_size)->owner;
+}
+
+uint32_t ObjectPoolSlabs::listIndex(uint32_t live_objects) const noexcept
+{
+	if (live_objects == 0) {
+		return EMPTY_LIST;
+	}
+
+	if (live_objects == m_max_objects) {
+		return FULL_LIST;
+	}
+
+	return static_cast<uint32_t>(uint64_t(live_objects) * NUM_OCCUPANCY_LISTS / m_max_objects);
+}
+
+void ObjectPoolSlabs::link(SlabHeader *slab, uint32_t list) noexcept
+{
+	slab->list = list;
+	slab->prev = nullptr;
+	slab->next = m_lists[list];
+
+	if (slab->next) {
+		slab->next->prev = slab;
+	}
+
+	m_lists[list] = slab;
+
+	if (list < NUM_OCCUPANCY_LISTS) {
+		m_occupancy_mask |= 1u << list;
+	} else if (list == EMPTY_LIST) {
+		m_num_empty_slabs++;
+	}
+}
+
+void ObjectPoolSlabs::unlink(SlabHeader *slab) noexcept
+{
+	const uint32_t list = slab->list;
+
+	if (slab->prev) {
+		slab->prev->next = slab->next;
+	} else {
+		m_lists[list] = slab->next;
+	}
+
+	if (slab->next) {
+		slab->next->prev = slab->prev;
+	}
+
+	if (list < NUM_OCCUPANCY_LISTS) {
+		if (!m_lists[list]) {
+			m_occupancy_mask &= ~(1u << list);
+		}
+	} else if (list == EMPTY_LIST) {
+		m_num_empty_slabs--;
+	}
+}
+
+void ObjectPoolSlabs::relink(SlabHeader *slab) noexcept
+{
+	const uint32_t list = listIndex(slab->live_objects);
+	if (list != slab->list) {
+		unlink(slab);
+		link(slab, list);
+	}
+}
+
+} // namespace voxen::detail
@@ -6,11 +6,22 @@
 #include <voxen/util/exception.hpp>
 #include <voxen/util/log.hpp>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <memory>
 #include <new>
+#include <system_error>
+
+#ifndef _WIN32
+	#include <sched.h>
+	#include <sys/mman.h>
+#else
+	#define NOMINMAX
+	#include <Windows.h>
+#endif
 
 namespace voxen
 {
@@ -21,6 +32,10 @@ namespace
 struct PipeMemorySlabControl {
 	uint32_t allocated_bytes = 0;
 	std::atomic_uint32_t live_allocations = 0;
+	// Index of slab collection this slab returns to
+	uint32_t numa_node = 0;
+	// Slab memory is mapped from reserved hugetlb pages
+	bool hugetlb = false;
 };
 
 // Whole slab size, must be a large power of two to nicely align with hugepages
@@ -73,11 +88,128 @@ struct PipeMemorySlab {
 
 static_assert(sizeof(PipeMemorySlab) == SLAB_SIZE, "Check SLAB_SIZE/STORAGE_SIZE correctness");
 
-PipeMemorySlab* newSlab()
+PipeMemoryAllocator::Config g_service_config;
+// Set once `MAP_HUGETLB` mapping fails, we don't retry it until the service restarts
+std::atomic_bool g_hugetlb_unavailable = false;
+// Slab counters for `PipeMemoryAllocator::stats()`
+std::atomic_size_t g_num_slabs = 0;
+std::atomic_size_t g_num_hugetlb_slabs = 0;
+
+#ifndef _WIN32
+
+// Sets `hugetlb` if the memory is mapped from reserved hugetlb pages
+void* mapSlabMemory(bool& hugetlb)
+{
+	constexpr int PROT = PROT_READ | PROT_WRITE;
+	constexpr int FLAGS = MAP_PRIVATE | MAP_ANONYMOUS;
+	const auto huge_pages = g_service_config.huge_pages;
+
+	if (huge_pages == PipeMemoryAllocator::HugePages::Explicit
+		&& !g_hugetlb_unavailable.load(std::memory_order_relaxed)) {
+		// Huge page mappings are naturally aligned to their size, which equals `SLAB_SIZE`
+		constexpr int HUGE_2MB = 21 << MAP_HUGE_SHIFT;
+		void* ptr = mmap(nullptr, SLAB_SIZE, PROT, FLAGS | MAP_HUGETLB | HUGE_2MB, -1, 0);
+		if (ptr != MAP_FAILED) [[likely]] {
+			hugetlb = true;
+			return ptr;
+		}
+
+		if (!g_hugetlb_unavailable.exchange(true, std::memory_order_relaxed)) {
+			Log::warn("PipeMemoryAllocator: can't map hugetlb pages ({}), falling back to THP",
+				std::error_code(errno, std::system_category()).message());
+		}
+	}
+
+	hugetlb = false;
+
+	// Over-map by one slab to find an aligned range, then unmap the excess
+	void* raw = mmap(nullptr, 2 * SLAB_SIZE, PROT, FLAGS, -1, 0);
+	if (raw == MAP_FAILED) [[unlikely]] {
+		throw std::bad_alloc();
+	}
+
+	const uintptr_t raw_begin = reinterpret_cast<uintptr_t>(raw);
+	const uintptr_t raw_end = raw_begin + 2 * SLAB_SIZE;
+	const uintptr_t begin = (raw_begin + SLAB_SIZE - 1u) & ~(SLAB_SIZE - 1u);
+	const uintptr_t end = begin + SLAB_SIZE;
+
+	if (begin > raw_begin) {
+		munmap(raw, begin - raw_begin);
+	}
+
+	if (raw_end > end) {
+		munmap(reinterpret_cast<void*>(end), raw_end - end);
+	}
+
+	void* ptr = reinterpret_cast<void*>(begin);
+
+	if (huge_pages != PipeMemoryAllocator::HugePages::Off) {
+		// Errors are not critical, THP can be disabled system-wide
+		madvise(ptr, SLAB_SIZE, MADV_HUGEPAGE);
+	}
+
+	return ptr;
+}
+
+void unmapSlabMemory(void* ptr) noexcept
+{
+	munmap(ptr, SLAB_SIZE);
+}
+
+uint32_t currentNumaNode() noexcept
+{
+	unsigned cpu = 0;
+	unsigned node = 0;
+	// Goes through vDSO, no actual syscall
+	if (getcpu(&cpu, &node) != 0) [[unlikely]] {
+		return 0;
+	}
+
+	return static_cast<uint32_t>(node);
+}
+
+#else
+
+void* mapSlabMemory(bool& hugetlb)
+{
+	// Regular pages only, see `PipeMemoryAllocator::HugePages`
+	hugetlb = false;
+	return operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE));
+}
+
+void unmapSlabMemory(void* ptr) noexcept
+{
+	operator delete(ptr, std::align_val_t(SLAB_SIZE));
+}
+
+uint32_t currentNumaNode() noexcept
+{
+	PROCESSOR_NUMBER proc;
+	GetCurrentProcessorNumberEx(&proc);
+
+	USHORT node = 0;
+	if (!GetNumaProcessorNodeEx(&proc, &node)) [[unlikely]] {
+		return 0;
+	}
+
+	return node;
+}
+
+#endif
+
+PipeMemorySlab* newSlab(uint32_t numa_node)
 {
-	// TODO: map memory with hugepages
-	void* ptr = operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE));
-	return new (ptr) PipeMemorySlab;
+	bool hugetlb = false;
+	PipeMemorySlab* slab = new (mapSlabMemory(hugetlb)) PipeMemorySlab;
+	slab->ctl.numa_node = numa_node;
+	slab->ctl.hugetlb = hugetlb;
+
+	g_num_slabs.fetch_add(1, std::memory_order_relaxed);
+	if (hugetlb) {
+		g_num_hugetlb_slabs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return slab;
 }
 
 void deleteSlab(PipeMemorySlab* slab) noexcept
@@ -93,16 +225,24 @@ void deleteSlab(PipeMemorySlab* slab) noexcept
 		Log::fatal("Live allocations remain => your memory is corrupted, buckle up!");
 	}
 
+	g_num_slabs.fetch_sub(1, std::memory_order_relaxed);
+	if (slab->ctl.hugetlb) {
+		g_num_hugetlb_slabs.fetch_sub(1, std::memory_order_relaxed);
+	}
+
 	// Purely formal call, does nothing
 	slab->~PipeMemorySlab();
-	// TODO: unmap memory (hugepages)
-	operator delete(slab, std::align_val_t(SLAB_SIZE));
+	unmapSlabMemory(slab);
 }
 
-PipeMemoryAllocator::Config g_service_config;
+// Number of slab collections, NUMA nodes beyond it share them
+constexpr uint32_t MAX_NUMA_NODES = 8;
+// Free slab retention window is split into this many sub-intervals
+constexpr uint32_t RETENTION_WINDOW_BUCKETS = 8;
+// Limits the time GC spends destroying slabs in one pass, the rest are destroyed in the next ones
+constexpr size_t MAX_DESTROYED_SLABS_PER_GC = 4;
 
-// We might use several instances of this struct
-// to distribute lock contention among threads
+// One instance per NUMA node, this also distributes lock contention among threads
 class SlabCollection {
 public:
 	SlabCollection() = default;
@@ -128,14 +268,15 @@ public:
 		m_gc_slabs.emplace_back(slab);
 	}
 
-	PipeMemorySlab* replaceSlab(PipeMemorySlab* slab)
+	// Take a free slab or create a new one. If `slab` is not null, it is put
+	// into the garbage list of this collection, it must belong to it.
+	PipeMemorySlab* replaceSlab(PipeMemorySlab* slab, uint32_t numa_node)
 	{
 		// Scoped lock - `newSlab()` is slow and needs no locking
 		{
 			std::lock_guard lk(m_lock);
 
-			// Should be true any time after the first call from this thread
-			if (slab) [[likely]] {
+			if (slab) {
 				m_gc_slabs.emplace_back(slab);
 				slab = nullptr;
 			}
@@ -145,28 +286,57 @@ public:
 			if (!m_free_slabs.empty()) [[likely]] {
 				slab = m_free_slabs.back();
 				m_free_slabs.pop_back();
+				m_free_low_mark = std::min(m_free_low_mark, m_free_slabs.size());
 			}
 		}
 
-		return slab ? slab : newSlab();
+		return slab ? slab : newSlab(numa_node);
+	}
+
+	void addStats(PipeMemoryAllocator::Stats& stats) noexcept
+	{
+		std::lock_guard lk(m_lock);
+		stats.free_slabs += m_free_slabs.size();
+		stats.garbage_slabs += m_gc_slabs.size();
 	}
 
-	void reclaimFreedSlabs() noexcept
+	// `gc_calls_per_bucket` - number of calls making one retention window sub-interval
+	void reclaimFreedSlabs(uint32_t gc_calls_per_bucket) noexcept
 	{
-		PipeMemorySlab* slab_to_delete = nullptr;
+		std::array<PipeMemorySlab*, MAX_DESTROYED_SLABS_PER_GC> slabs_to_delete;
+		size_t num_slabs_to_delete = 0;
 
 		// Scoped lock - `deleteSlab()` is slow and needs no locking
 		{
 			std::lock_guard lk(m_lock);
 
+			if (++m_gc_calls_in_bucket >= gc_calls_per_bucket) {
+				// Close the current sub-interval and start the next one from the current count
+				m_gc_calls_in_bucket = 0;
+				m_window_low_marks[m_window_bucket] = m_free_low_mark;
+				m_window_bucket = (m_window_bucket + 1) % RETENTION_WINDOW_BUCKETS;
+				m_free_low_mark = m_free_slabs.size();
+			}
+
 			// Don't keep too many free slabs, they can be allocated after
 			// a memory usage spike and will simply waste memory afterwards.
-			//
-			// TODO: this has an implicit dependency on GC call period.
-			// Need to count free slabs over some larger time interval, like 1-2 seconds.
-			if (m_free_slabs.size() > g_service_config.destroy_free_slabs_threshold) {
-				slab_to_delete = m_free_slabs.back();
-				m_free_slabs.pop_back();
+			// Slabs above the lowest free count seen during the whole window
+			// were not taken at all, and these can be destroyed safely.
+			const size_t idle_slabs = std::min(m_free_low_mark, *std::ranges::min_element(m_window_low_marks));
+			const size_t keep_slabs = g_service_config.destroy_free_slabs_threshold;
+
+			if (idle_slabs > keep_slabs) {
+				num_slabs_to_delete = std::min(idle_slabs - keep_slabs, MAX_DESTROYED_SLABS_PER_GC);
+
+				// Slabs are taken from the back, so the front ones are the coldest
+				const auto range_end = m_free_slabs.begin() + static_cast<ptrdiff_t>(num_slabs_to_delete);
+				std::copy(m_free_slabs.begin(), range_end, slabs_to_delete.begin());
+				m_free_slabs.erase(m_free_slabs.begin(), range_end);
+
+				m_free_low_mark -= num_slabs_to_delete;
+				for (size_t& mark : m_window_low_marks) {
+					mark -= num_slabs_to_delete;
+				}
 			}
 
 			for (size_t i = 0; i < m_gc_slabs.size(); /*nothing*/) {
@@ -189,8 +359,8 @@ public:
 			}
 		}
 
-		if (slab_to_delete) {
-			deleteSlab(slab_to_delete);
+		for (size_t i = 0; i < num_slabs_to_delete; i++) {
+			deleteSlab(slabs_to_delete[i]);
 		}
 	}
 
@@ -198,11 +368,18 @@ private:
 	os::FutexLock m_lock;
 	std::vector<PipeMemorySlab*> m_gc_slabs;
 	std::vector<PipeMemorySlab*> m_free_slabs;
+
+	// Lowest free slab count during the current window sub-interval
+	size_t m_free_low_mark = 0;
+	// Lowest free slab counts of the last window sub-intervals, ring buffer.
+	// Zeros initially, so nothing is destroyed until the window fills up.
+	std::array<size_t, RETENTION_WINDOW_BUCKETS> m_window_low_marks = {};
+	uint32_t m_window_bucket = 0;
+	uint32_t m_gc_calls_in_bucket = 0;
 };
 
-// Global collection of garbage and free slabs.
-// We can add more if lock contention becomes a problem.
-SlabCollection g_slab_collection;
+// Per-NUMA node collections of garbage and free slabs
+std::array<SlabCollection, MAX_NUMA_NODES> g_slab_collections;
 // Garbage collection thread, wakes up periodically to reclaim
 // deallocated slabs, moving them from garbage to the free list.
 // TODO: migrate to job system (as a recurring task) once it's implemented.
@@ -210,6 +387,16 @@ std::thread g_slab_gc_thread;
 // Set to `true` while GC thread should continue running
 std::atomic_bool g_slab_gc_run_flag = false;
 
+// Collection index for slabs allocated by the calling thread
+uint32_t allocatingNumaNode() noexcept
+{
+	if (!g_service_config.numa_aware_slabs) {
+		return 0;
+	}
+
+	return currentNumaNode() % MAX_NUMA_NODES;
+}
+
 void gcThreadProc()
 {
 	debug::setThreadName("PipeAlloc GC");
@@ -219,13 +406,20 @@ void gcThreadProc()
 	// it's extremely unlikely that this thread creates any noticeable load).
 	// Similarly, when garbage submission is high, we might reduce GC interval
 	// to reclaim slabs faster and avoid some excessive memory allocations.
-	const auto gc_period = std::chrono::milliseconds(g_service_config.gc_period_msec);
+	const uint32_t gc_period_msec = std::max(g_service_config.gc_period_msec, 1u);
+	const auto gc_period = std::chrono::milliseconds(gc_period_msec);
+
+	const uint32_t window_msec = g_service_config.free_slabs_window_msec;
+	const uint32_t gc_calls_per_bucket = std::max(1u, window_msec / (gc_period_msec * RETENTION_WINDOW_BUCKETS));
 
 	Log::info("Pipe memory allocator GC thread started");
 
 	while (g_slab_gc_run_flag.load(std::memory_order_relaxed)) {
 		std::this_thread::sleep_for(gc_period);
-		g_slab_collection.reclaimFreedSlabs();
+
+		for (SlabCollection& collection : g_slab_collections) {
+			collection.reclaimFreedSlabs(gc_calls_per_bucket);
+		}
 	}
 
 	Log::info("Pipe memory allocator GC thread stopped");
@@ -249,7 +443,7 @@ struct ThreadSlabDeleter {
 		// Thread-local destructors are ordered before static ones.
 		// Therefore this collection can still be used even after GC thread stops.
 		// Remaining slabs will get deleted in its destructor at program exit.
-		g_slab_collection.putGarbageSlab(slab);
+		g_slab_collections[slab->ctl.numa_node].putGarbageSlab(slab);
 	}
 };
 
@@ -266,6 +460,7 @@ PipeMemoryAllocator::PipeMemoryAllocator(svc::ServiceLocator& /*svc*/, Config cf
 	}
 
 	g_service_config = cfg;
+	g_hugetlb_unavailable.store(false, std::memory_order_relaxed);
 	g_slab_gc_run_flag.store(true, std::memory_order_release);
 	g_slab_gc_thread = std::thread(gcThreadProc);
 }
@@ -300,8 +495,18 @@ void* PipeMemoryAllocator::allocate(size_t size, size_t align)
 		// move it to the garbage list.
 	}
 
-	// Put this slab into the garbage list and get a new one
-	thread_slab = g_slab_collection.replaceSlab(t_this_thread_slab.release());
+	// Put this slab into the garbage list and get a new one,
+	// preferring slabs of NUMA node this thread is running on
+	const uint32_t numa_node = allocatingNumaNode();
+	thread_slab = t_this_thread_slab.release();
+
+	if (thread_slab && thread_slab->ctl.numa_node != numa_node) [[unlikely]] {
+		// Thread has migrated to another node, return the slab to its home collection
+		g_slab_collections[thread_slab->ctl.numa_node].putGarbageSlab(thread_slab);
+		thread_slab = nullptr;
+	}
+
+	thread_slab = g_slab_collections[numa_node].replaceSlab(thread_slab, numa_node);
 	t_this_thread_slab.reset(thread_slab);
 
 	// Now this must succeed
@@ -310,6 +515,21 @@ void* PipeMemoryAllocator::allocate(size_t size, size_t align)
 	return ptr;
 }
 
+auto PipeMemoryAllocator::stats() noexcept -> Stats
+{
+	Stats stats {
+		.slabs = g_num_slabs.load(std::memory_order_relaxed),
+		.hugetlb_slabs = g_num_hugetlb_slabs.load(std::memory_order_relaxed),
+		.hugetlb_fallback = g_hugetlb_unavailable.load(std::memory_order_relaxed),
+	};
+
+	for (SlabCollection& collection : g_slab_collections) {
+		collection.addStats(stats);
+	}
+
+	return stats;
+}
+
 void PipeMemoryAllocator::deallocate(void* ptr) noexcept
 {
 	if (!ptr) [[unlikely]] {
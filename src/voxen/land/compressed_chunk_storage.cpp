@@ -1,5 +1,14 @@
 #include <voxen/land/compressed_chunk_storage.hpp>
 
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+
+// SIMD and BMI2 intrinsics
+#include <immintrin.h>
+
+#include <bit>
+#include <cassert>
 #include <cstring>
 #include <utility>
 
@@ -21,145 +30,152 @@ glm::uvec3 nodeBaseOffset(uint32_t i) noexcept
 	return res;
 }
 
-glm::uvec3 leafBaseOffset(glm::uvec3 base, uint32_t i) noexcept
+// Number of `Leaf` entries allocated for a non-uniform node: non-uniform
+// leaves go first, then uniform leaf values packed 8 per entry
+uint32_t leafArraySize(uint64_t nonuniform_leaf_mask) noexcept
 {
-	// Leaf bases are aligned to 2 blocks (1 binary zero)
-	base.x += (i & 0b001100) >> 1;
-	base.y += (i & 0b110000) >> 3;
-	base.z += (i & 0b000011) << 1;
-	return base;
+	auto num_nonuniform_leaves = uint32_t(std::popcount(nonuniform_leaf_mask));
+	return num_nonuniform_leaves + (64 - num_nonuniform_leaves + 7) / 8;
 }
 
-} // namespace
-
-template<typename T>
-CompressedChunkStorage<T>::CompressedChunkStorage(ConstExpandedView expanded)
+// Bitmask of 8x8x8 nodes intersecting with [begin; end) box
+uint64_t boxNodeMask(glm::uvec3 begin, glm::uvec3 end) noexcept
 {
-	auto construct_node = [&](uint32_t index, Node &output) {
-		const glm::uvec3 node_base = nodeBaseOffset(index);
-
-		Leaf leaves[64];
-
-		uint64_t nonuniform_leaf_mask = 0;
-
-		T node_uniform_value = 0;
-		bool met_uniform_leaf = false;
-		bool whole_node_uniform = true;
-
-		for (uint32_t i = 0; i < 64; i++) {
-			// Gather leaf values
-			CubeArray<T, 2> leaf_cube;
-			expanded.extractTo(leafBaseOffset(node_base, i), leaf_cube);
+	uint64_t mask = 0;
 
-			auto &leaf = leaves[i];
-			// Well...
-			leaf = std::bit_cast<Leaf>(leaf_cube);
-
-			bool uniform = true;
-			for (uint32_t j = 1; j < std::size(leaf.data); j++) {
-				if (leaf.data[j] != leaf.data[0]) {
-					uniform = false;
-					break;
-				}
-			}
+	for (uint32_t i = 0; i < 64; i++) {
+		glm::uvec3 node_begin = nodeBaseOffset(i);
+		glm::uvec3 node_end = node_begin + 8u;
 
-			if (!uniform) {
-				// Non-uniform leaf
-				nonuniform_leaf_mask |= uint64_t(1) << i;
-				// Whole-node uniform optimization reuses mask bits which are now needed
-				whole_node_uniform = false;
-			} else if (!met_uniform_leaf) {
-				// The first uniform leaf, set the value
-				node_uniform_value = leaf.data[0];
-				met_uniform_leaf = true;
-			} else if (node_uniform_value != leaf.data[0]) {
-				// Several different uniform values, disable it
-				whole_node_uniform = false;
-			}
+		if (glm::all(glm::lessThan(node_begin, end)) && glm::all(glm::lessThan(begin, node_end))) {
+			mask |= uint64_t(1) << i;
 		}
+	}
 
-		if (whole_node_uniform && node_uniform_value == 0) {
-			// Whole node is zero, don't construct it at all
-			return false;
-		}
+	return mask;
+}
 
-		if (whole_node_uniform) {
-			// Whole node is non-zero uniform, construct it without leaf allocation
-			output.uniform_value = node_uniform_value;
-			return true;
-		}
+// Converts between four Z rows of 8 values at (y, x), (y, x+1), (y+1, x), (y+1, x+1)
+// and four 2x2x2 leaves along Z. Leaf element index is `z%2 + (x%2)*2 + (y%2)*4`,
+// so treating a pair of Z-adjacent values as one wider integer this is just
+// a 4x4 matrix transpose. It is its own inverse, so works in both directions.
+template<typename T>
+void transposeZPairs(const T *const (&in)[4], T *const (&out)[4]) noexcept
+{
+	if constexpr (sizeof(T) == 1) {
+		// Pairs are 16-bit, row is 64-bit
+		__m128i r0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in[0]));
+		__m128i r1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in[1]));
+		__m128i r2 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in[2]));
+		__m128i r3 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in[3]));
+
+		__m128i t01 = _mm_unpacklo_epi16(r0, r1);
+		__m128i t23 = _mm_unpacklo_epi16(r2, r3);
+		__m128i lo = _mm_unpacklo_epi32(t01, t23);
+		__m128i hi = _mm_unpackhi_epi32(t01, t23);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(out[0]), lo);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(out[1]), _mm_unpackhi_epi64(lo, lo));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(out[2]), hi);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(out[3]), _mm_unpackhi_epi64(hi, hi));
+	} else if constexpr (sizeof(T) == 2) {
+		// Pairs are 32-bit, row is 128-bit
+		__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in[0]));
+		__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in[1]));
+		__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in[2]));
+		__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in[3]));
+
+		__m128i t01_lo = _mm_unpacklo_epi32(r0, r1);
+		__m128i t01_hi = _mm_unpackhi_epi32(r0, r1);
+		__m128i t23_lo = _mm_unpacklo_epi32(r2, r3);
+		__m128i t23_hi = _mm_unpackhi_epi32(r2, r3);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out[0]), _mm_unpacklo_epi64(t01_lo, t23_lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out[1]), _mm_unpackhi_epi64(t01_lo, t23_lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out[2]), _mm_unpacklo_epi64(t01_hi, t23_hi));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out[3]), _mm_unpackhi_epi64(t01_hi, t23_hi));
+	} else {
+		static_assert(sizeof(T) == 4);
+
+		// Pairs are 64-bit, row is 256-bit
+		__m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in[0]));
+		__m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in[1]));
+		__m256i r2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in[2]));
+		__m256i r3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in[3]));
+
+		// Unpacks work within 128-bit lanes: (pair0, pair2) and (pair1, pair3)
+		__m256i t01_02 = _mm256_unpacklo_epi64(r0, r1);
+		__m256i t01_13 = _mm256_unpackhi_epi64(r0, r1);
+		__m256i t23_02 = _mm256_unpacklo_epi64(r2, r3);
+		__m256i t23_13 = _mm256_unpackhi_epi64(r2, r3);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out[0]), _mm256_permute2x128_si256(t01_02, t23_02, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out[1]), _mm256_permute2x128_si256(t01_13, t23_13, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out[2]), _mm256_permute2x128_si256(t01_02, t23_02, 0x31));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out[3]), _mm256_permute2x128_si256(t01_13, t23_13, 0x31));
+	}
+}
 
-		// Non-uniform node, allocate leaves + single uniform values.
-		// Leaf has 8 entries so we can pack 8 uniform leaves in one.
-		auto num_nonuniform_leaves = uint32_t(std::popcount(nonuniform_leaf_mask));
-		auto num_uniform_leaves = (64 - num_nonuniform_leaves + 7) / 8;
+// Check that all 8 values are equal by comparing with the broadcasted first one
+template<typename T>
+bool isLeafUniform(const T *data) noexcept
+{
+	if constexpr (sizeof(T) == 1) {
+		__m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data));
+		__m128i eq = _mm_cmpeq_epi8(v, _mm_broadcastb_epi8(v));
+		return (_mm_movemask_epi8(eq) & 0xFF) == 0xFF;
+	} else if constexpr (sizeof(T) == 2) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+		__m128i eq = _mm_cmpeq_epi16(v, _mm_broadcastw_epi16(v));
+		return _mm_movemask_epi8(eq) == 0xFFFF;
+	} else {
+		static_assert(sizeof(T) == 4);
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+		__m256i eq = _mm256_cmpeq_epi32(v, _mm256_broadcastd_epi32(_mm256_castsi256_si128(v)));
+		return _mm256_movemask_epi8(eq) == -1;
+	}
+}
 
-		output.nonuniform_leaf_mask = nonuniform_leaf_mask;
-		output.leaves = std::make_unique<Leaf[]>(num_nonuniform_leaves + num_uniform_leaves);
+// PEXT/PDEP mask selecting the lowest bit of every byte
+constexpr uint64_t BOOL_BYTE_BITS_MASK = 0x0101010101010101;
 
-		Leaf *output_nonuniform = output.leaves.get();
-		T *output_uniform = output.leaves[num_nonuniform_leaves].data;
+// Pack 8 bools (0/1 bytes) into 8 bits
+uint8_t packBools(const uint8_t *bools) noexcept
+{
+	uint64_t word;
+	memcpy(&word, bools, sizeof(word));
+	return static_cast<uint8_t>(_pext_u64(word, BOOL_BYTE_BITS_MASK));
+}
 
-		for (uint32_t i = 0; i < 64; i++) {
-			if (nonuniform_leaf_mask & (uint64_t(1) << i)) {
-				*output_nonuniform = leaves[i];
-				output_nonuniform++;
-			} else {
-				*output_uniform = leaves[i].data[0];
-				output_uniform++;
-			}
-		}
+// Spread 8 bits into 8 bools (0/1 bytes)
+void unpackBools(uint8_t bits, uint8_t *bools) noexcept
+{
+	uint64_t word = _pdep_u64(bits, BOOL_BYTE_BITS_MASK);
+	memcpy(bools, &word, sizeof(word));
+}
 
-		return true;
-	};
+template<typename V>
+std::byte *writeValue(std::byte *output, const V &value) noexcept
+{
+	memcpy(output, &value, sizeof(V));
+	return output + sizeof(V);
+}
 
-	Node nodes[64];
-	uint32_t used_nodes = 0;
+} // namespace
 
-	T chunk_uniform_value = 0;
-	bool met_uniform_node = false;
-	bool whole_chunk_uniform = true;
+template<typename T>
+CompressedChunkStorage<T>::CompressedChunkStorage(ConstExpandedView expanded)
+{
+	Node nodes[64];
+	uint64_t nonzero_node_mask = 0;
 
 	for (uint32_t i = 0; i < 64; i++) {
-		Node &node = nodes[used_nodes];
-
-		if (!construct_node(i, node)) {
-			// Zero node
-
-			met_uniform_node = true;
-			if (chunk_uniform_value != 0) {
-				// There was a non-zero uniform node
-				whole_chunk_uniform = false;
-			}
-
-			continue;
-		}
-
-		if (!node.uniform()) {
-			// Whole-chunk uniform optimization reuses mask bits which are now needed
-			whole_chunk_uniform = false;
-		} else if (!met_uniform_node) {
-			// The first uniform node, set the value
-			chunk_uniform_value = node.uniform_value;
-		} else if (chunk_uniform_value != node.uniform_value) {
-			// Several different uniform values, disable it
-			whole_chunk_uniform = false;
+		if (compressNode(expanded.template view<8>(nodeBaseOffset(i)), nodes[i])) {
+			nonzero_node_mask |= uint64_t(1) << i;
 		}
-
-		m_nonzero_node_mask |= uint64_t(1) << i;
-		used_nodes++;
 	}
 
-	if (whole_chunk_uniform) {
-		// The whole chunk has uniform value, don't allocate nodes.
-		// We overwrite nonzero node mask but it's irrelevant now.
-		m_uniform_value = chunk_uniform_value;
-		return;
-	}
-
-	// Allocatae nodes, nonzero node mask is already written
-	m_nodes = std::make_unique<Node[]>(used_nodes);
-	std::move(nodes, nodes + used_nodes, m_nodes.get());
+	packNodes(nodes, nonzero_node_mask);
 }
 
 template<typename T>
@@ -201,7 +217,7 @@ CompressedChunkStorage<T>::CompressedChunkStorage(const CompressedChunkStorage &
 
 		node.nonuniform_leaf_mask = other_node.nonuniform_leaf_mask;
 		node.leaves = std::make_unique<Leaf[]>(num_leaves);
-		std::copy(node.leaves.get(), node.leaves.get() + num_leaves, other_node.leaves.get());
+		std::copy_n(other_node.leaves.get(), num_leaves, node.leaves.get());
 	}
 }
 
@@ -237,41 +253,44 @@ void CompressedChunkStorage<T>::expand(CubeArrayView<T, Consts::CHUNK_SIZE_BLOCK
 	const Node *node = m_nodes.get();
 
 	for (uint32_t i = 0; i < 64; i++) {
-		glm::uvec3 base = nodeBaseOffset(i);
-
-		auto out_node_view = view.template view<8>(base);
+		auto out_node_view = view.template view<8>(nodeBaseOffset(i));
 
 		if (!(m_nonzero_node_mask & (uint64_t(1) << i))) {
 			out_node_view.fill(0);
 			continue;
 		}
 
-		if (node->uniform()) {
-			out_node_view.fill(node->uniform_value);
-			node++;
-			continue;
-		}
+		expandNode(*node, out_node_view);
+		node++;
+	}
+}
 
-		const uint64_t nonuniform_mask = node->nonuniform_leaf_mask;
-		const Leaf *nonuniform_leaf = node->leaves.get();
-		const T *uniform_leaf = (nonuniform_leaf + std::popcount(nonuniform_mask))->data;
+template<typename T>
+void CompressedChunkStorage<T>::expandSlab(uint32_t slab, ExpandedView view) const noexcept
+{
+	assert(slab < 4);
 
-		for (uint32_t j = 0; j < 64; j++) {
-			glm::uvec3 leaf_base = leafBaseOffset(base, j);
+	if (!m_nodes) {
+		view.fill(glm::uvec3(0), glm::uvec3(Consts::CHUNK_SIZE_BLOCKS, 8, Consts::CHUNK_SIZE_BLOCKS), m_uniform_value);
+		return;
+	}
 
-			auto out_leaf_view = view.template view<2>(leaf_base);
+	// Skip nodes of all previous slabs, 16 nodes per slab
+	const uint32_t first_node = slab * 16;
+	const Node *node = m_nodes.get() + std::popcount(m_nonzero_node_mask & ((uint64_t(1) << first_node) - 1));
 
-			if (nonuniform_mask & (uint64_t(1) << j)) {
-				// Well...
-				auto leaf_cube = std::bit_cast<CubeArray<T, 2>>(*nonuniform_leaf);
-				out_leaf_view.fillFrom(leaf_cube.cview());
-				nonuniform_leaf++;
-			} else {
-				out_leaf_view.fill(*uniform_leaf);
-				uniform_leaf++;
-			}
+	for (uint32_t i = first_node; i < first_node + 16; i++) {
+		glm::uvec3 node_base = nodeBaseOffset(i);
+		node_base.y = 0;
+
+		auto out_node_view = view.template view<8>(node_base);
+
+		if (!(m_nonzero_node_mask & (uint64_t(1) << i))) {
+			out_node_view.fill(0);
+			continue;
 		}
 
+		expandNode(*node, out_node_view);
 		node++;
 	}
 }
@@ -325,38 +344,558 @@ T CompressedChunkStorage<T>::load(uint32_t x, uint32_t y, uint32_t z) const noex
 	return *(element + std::popcount(~node.nonuniform_leaf_mask & leaf_tail_mask));
 }
 
+template<typename T>
+void CompressedChunkStorage<T>::store(uint32_t x, uint32_t y, uint32_t z, T value)
+{
+	if (load(x, y, z) == value) {
+		// Nothing changes, this also covers all uniform/zero cases with the same value
+		return;
+	}
+
+	const uint32_t node_id = z / 8 + (x / 8) * 4 + (y / 8) * 16;
+	const uint64_t node_bit = uint64_t(1) << node_id;
+
+	if (m_nodes && (m_nonzero_node_mask & node_bit)) {
+		Node &node = m_nodes[std::popcount(m_nonzero_node_mask & (node_bit - 1))];
+
+		const uint32_t leaf_id = z % 8 / 2 + (x % 8 / 2) * 4 + (y % 8 / 2) * 16;
+		const uint64_t leaf_bit = uint64_t(1) << leaf_id;
+
+		if (!node.uniform() && (node.nonuniform_leaf_mask & leaf_bit)) {
+			// Fast path - change the value directly in non-uniform leaf
+			Leaf &leaf = node.leaves[std::popcount(node.nonuniform_leaf_mask & (leaf_bit - 1))];
+			leaf.data[z % 2 + (x % 2) * 2 + (y % 2) * 4] = value;
+
+			if (!isLeafUniform(leaf.data)) {
+				return;
+			}
+
+			// Leaf became uniform, rewrite the node to compress it
+		}
+	}
+
+	modifyNodes(node_bit, [&](glm::uvec3 /*node_base*/, CubeArrayView<T, 8> node_view) {
+		node_view.store(x % 8, y % 8, z % 8, value);
+	});
+}
+
+template<typename T>
+void CompressedChunkStorage<T>::fillBox(glm::uvec3 begin, glm::uvec3 end, T value)
+{
+	end = glm::min(end, glm::uvec3(Consts::CHUNK_SIZE_BLOCKS));
+
+	if (glm::any(glm::greaterThanEqual(begin, end))) {
+		// Empty box or entirely out of bounds
+		return;
+	}
+
+	if (!m_nodes && m_uniform_value == value) {
+		return;
+	}
+
+	modifyNodes(boxNodeMask(begin, end), [&](glm::uvec3 node_base, CubeArrayView<T, 8> node_view) {
+		glm::uvec3 lo = glm::max(begin, node_base) - node_base;
+		glm::uvec3 hi = glm::min(end, node_base + 8u) - node_base;
+		node_view.fill(lo, hi - lo, value);
+	});
+}
+
+template<typename T>
+void CompressedChunkStorage<T>::fillSphere(glm::vec3 center, float radius, T value)
+{
+	if (radius < 0.0f || (!m_nodes && m_uniform_value == value)) {
+		return;
+	}
+
+	// Bounding box of blocks whose centers (`x + 0.5`) can be within the sphere
+	constexpr int32_t N = Consts::CHUNK_SIZE_BLOCKS;
+	const glm::ivec3 lo = glm::clamp(glm::ivec3(glm::ceil(center - radius - 0.5f)), glm::ivec3(0), glm::ivec3(N));
+	const glm::ivec3 hi = glm::clamp(glm::ivec3(glm::floor(center + radius - 0.5f)) + 1, glm::ivec3(0), glm::ivec3(N));
+
+	if (glm::any(glm::greaterThanEqual(lo, hi))) {
+		return;
+	}
+
+	const glm::uvec3 begin(lo);
+	const glm::uvec3 end(hi);
+	const float radius_sq = radius * radius;
+
+	modifyNodes(boxNodeMask(begin, end), [&](glm::uvec3 node_base, CubeArrayView<T, 8> node_view) {
+		glm::uvec3 node_lo = glm::max(begin, node_base);
+		glm::uvec3 node_hi = glm::min(end, node_base + 8u);
+
+		for (uint32_t y = node_lo.y; y < node_hi.y; y++) {
+			for (uint32_t x = node_lo.x; x < node_hi.x; x++) {
+				for (uint32_t z = node_lo.z; z < node_hi.z; z++) {
+					glm::vec3 d = glm::vec3(x, y, z) + 0.5f - center;
+
+					if (glm::dot(d, d) <= radius_sq) {
+						node_view.store(x - node_base.x, y - node_base.y, z - node_base.z, value);
+					}
+				}
+			}
+		}
+	});
+}
+
+template<typename T>
+size_t CompressedChunkStorage<T>::serializedSize() const noexcept
+{
+	if (!m_nodes) {
+		// Zero mask + uniform value
+		return sizeof(uint64_t) + sizeof(T);
+	}
+
+	// Nonzero node mask + uniform node mask
+	size_t size = 2 * sizeof(uint64_t);
+
+	const auto num_nodes = uint32_t(std::popcount(m_nonzero_node_mask));
+	for (uint32_t i = 0; i < num_nodes; i++) {
+		const Node &node = m_nodes[i];
+
+		if (node.uniform()) {
+			size += sizeof(T);
+		} else {
+			size += sizeof(uint64_t) + leafArraySize(node.nonuniform_leaf_mask) * sizeof(Leaf);
+		}
+	}
+
+	return size;
+}
+
+template<typename T>
+size_t CompressedChunkStorage<T>::heapBytes() const noexcept
+{
+	if (!m_nodes) {
+		return 0;
+	}
+
+	const auto num_nodes = uint32_t(std::popcount(m_nonzero_node_mask));
+	size_t bytes = num_nodes * sizeof(Node);
+
+	for (uint32_t i = 0; i < num_nodes; i++) {
+		const Node &node = m_nodes[i];
+
+		if (!node.uniform()) {
+			bytes += leafArraySize(node.nonuniform_leaf_mask) * sizeof(Leaf);
+		}
+	}
+
+	return bytes;
+}
+
+template<typename T>
+size_t CompressedChunkStorage<T>::serialize(std::span<std::byte> output) const noexcept
+{
+	assert(output.size() >= serializedSize());
+	std::byte *out = output.data();
+
+	if (!m_nodes) {
+		// Zero nonzero node mask is impossible for a non-uniform chunk, use it as a marker
+		out = writeValue(out, uint64_t(0));
+		out = writeValue(out, m_uniform_value);
+		return size_t(out - output.data());
+	}
+
+	const auto num_nodes = uint32_t(std::popcount(m_nonzero_node_mask));
+
+	// Nodes are stored in the order of set bits in the nonzero mask,
+	// so we can recover the node ID of each one by walking these bits
+	uint64_t uniform_node_mask = 0;
+	uint64_t remaining_mask = m_nonzero_node_mask;
+
+	for (uint32_t i = 0; i < num_nodes; i++) {
+		uint64_t node_bit = remaining_mask & (~remaining_mask + 1);
+		remaining_mask ^= node_bit;
+
+		if (m_nodes[i].uniform()) {
+			uniform_node_mask |= node_bit;
+		}
+	}
+
+	out = writeValue(out, m_nonzero_node_mask);
+	out = writeValue(out, uniform_node_mask);
+
+	for (uint32_t i = 0; i < num_nodes; i++) {
+		const Node &node = m_nodes[i];
+
+		if (node.uniform()) {
+			out = writeValue(out, node.uniform_value);
+			continue;
+		}
+
+		const size_t leaves_bytes = leafArraySize(node.nonuniform_leaf_mask) * sizeof(Leaf);
+
+		out = writeValue(out, node.nonuniform_leaf_mask);
+		memcpy(out, node.leaves.get(), leaves_bytes);
+		out += leaves_bytes;
+	}
+
+	return size_t(out - output.data());
+}
+
+template<typename T>
+bool CompressedChunkStorage<T>::deserialize(std::span<const std::byte> input)
+{
+	size_t pos = 0;
+
+	auto read = [&]<typename V>(V &value) {
+		if (input.size() - pos < sizeof(V)) {
+			return false;
+		}
+
+		memcpy(&value, input.data() + pos, sizeof(V));
+		pos += sizeof(V);
+		return true;
+	};
+
+	uint64_t nonzero_node_mask = 0;
+	if (!read(nonzero_node_mask)) {
+		return false;
+	}
+
+	if (nonzero_node_mask == 0) {
+		// Uniform chunk
+		T value;
+		if (!read(value) || pos != input.size()) {
+			return false;
+		}
+
+		setUniform(value);
+		return true;
+	}
+
+	uint64_t uniform_node_mask = 0;
+	if (!read(uniform_node_mask) || (uniform_node_mask & ~nonzero_node_mask) != 0) {
+		// Uniform nodes must be a subset of nonzero ones
+		return false;
+	}
+
+	const auto num_nodes = uint32_t(std::popcount(nonzero_node_mask));
+	auto nodes = std::make_unique<Node[]>(num_nodes);
+	Node *node = nodes.get();
+
+	for (uint32_t i = 0; i < 64; i++) {
+		const uint64_t node_bit = uint64_t(1) << i;
+
+		if (!(nonzero_node_mask & node_bit)) {
+			continue;
+		}
+
+		if (uniform_node_mask & node_bit) {
+			if (!read(node->uniform_value)) {
+				return false;
+			}
+
+			node++;
+			continue;
+		}
+
+		uint64_t nonuniform_leaf_mask = 0;
+		if (!read(nonuniform_leaf_mask)) {
+			return false;
+		}
+
+		const uint32_t num_leaves = leafArraySize(nonuniform_leaf_mask);
+		const size_t leaves_bytes = num_leaves * sizeof(Leaf);
+
+		if (input.size() - pos < leaves_bytes) {
+			return false;
+		}
+
+		node->nonuniform_leaf_mask = nonuniform_leaf_mask;
+		node->leaves = std::make_unique<Leaf[]>(num_leaves);
+		memcpy(node->leaves.get(), input.data() + pos, leaves_bytes);
+		pos += leaves_bytes;
+
+		node++;
+	}
+
+	if (pos != input.size()) {
+		// Trailing garbage, something is wrong with this data
+		return false;
+	}
+
+	m_nonzero_node_mask = nonzero_node_mask;
+	m_nodes = std::move(nodes);
+	return true;
+}
+
+template<typename T>
+bool CompressedChunkStorage<T>::compressNode(CubeArrayView<const T, 8> input, Node &output)
+{
+	output = Node();
+
+	Leaf leaves[64];
+
+	// Gather four leaves (along Z) at once from four value rows
+	for (uint32_t y = 0; y < 8; y += 2) {
+		for (uint32_t x = 0; x < 8; x += 2) {
+			const T *rows[4] = {
+				input.addr(glm::uvec3(x, y, 0)),
+				input.addr(glm::uvec3(x + 1, y, 0)),
+				input.addr(glm::uvec3(x, y + 1, 0)),
+				input.addr(glm::uvec3(x + 1, y + 1, 0)),
+			};
+
+			Leaf *out = &leaves[x / 2 * 4 + y / 2 * 16];
+			transposeZPairs(rows, { out[0].data, out[1].data, out[2].data, out[3].data });
+		}
+	}
+
+	uint64_t nonuniform_leaf_mask = 0;
+
+	T node_uniform_value = 0;
+	bool met_uniform_leaf = false;
+	bool whole_node_uniform = true;
+
+	for (uint32_t i = 0; i < 64; i++) {
+		const Leaf &leaf = leaves[i];
+
+		if (!isLeafUniform(leaf.data)) {
+			// Non-uniform leaf
+			nonuniform_leaf_mask |= uint64_t(1) << i;
+			// Whole-node uniform optimization reuses mask bits which are now needed
+			whole_node_uniform = false;
+		} else if (!met_uniform_leaf) {
+			// The first uniform leaf, set the value
+			node_uniform_value = leaf.data[0];
+			met_uniform_leaf = true;
+		} else if (node_uniform_value != leaf.data[0]) {
+			// Several different uniform values, disable it
+			whole_node_uniform = false;
+		}
+	}
+
+	if (whole_node_uniform && node_uniform_value == 0) {
+		// Whole node is zero, don't construct it at all
+		return false;
+	}
+
+	if (whole_node_uniform) {
+		// Whole node is non-zero uniform, construct it without leaf allocation
+		output.uniform_value = node_uniform_value;
+		return true;
+	}
+
+	// Non-uniform node, allocate leaves + single uniform values.
+	// Leaf has 8 entries so we can pack 8 uniform leaves in one.
+	auto num_nonuniform_leaves = uint32_t(std::popcount(nonuniform_leaf_mask));
+
+	output.nonuniform_leaf_mask = nonuniform_leaf_mask;
+	output.leaves = std::make_unique<Leaf[]>(leafArraySize(nonuniform_leaf_mask));
+
+	Leaf *output_nonuniform = output.leaves.get();
+	T *output_uniform = output.leaves[num_nonuniform_leaves].data;
+
+	for (uint32_t i = 0; i < 64; i++) {
+		if (nonuniform_leaf_mask & (uint64_t(1) << i)) {
+			*output_nonuniform = leaves[i];
+			output_nonuniform++;
+		} else {
+			*output_uniform = leaves[i].data[0];
+			output_uniform++;
+		}
+	}
+
+	return true;
+}
+
+template<typename T>
+void CompressedChunkStorage<T>::expandNode(const Node &node, CubeArrayView<T, 8> output) noexcept
+{
+	if (node.uniform()) {
+		output.fill(node.uniform_value);
+		return;
+	}
+
+	const uint64_t nonuniform_mask = node.nonuniform_leaf_mask;
+	const Leaf *nonuniform_leaf = node.leaves.get();
+	const T *uniform_leaf = (nonuniform_leaf + std::popcount(nonuniform_mask))->data;
+
+	// Scatter four leaves (along Z) at once into four value rows
+	for (uint32_t y = 0; y < 8; y += 2) {
+		for (uint32_t x = 0; x < 8; x += 2) {
+			Leaf uniform_leaves[4];
+			const T *in[4];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				if (nonuniform_mask & (uint64_t(1) << (k + x / 2 * 4 + y / 2 * 16))) {
+					in[k] = nonuniform_leaf->data;
+					nonuniform_leaf++;
+				} else {
+					std::fill_n(uniform_leaves[k].data, 8, *uniform_leaf);
+					in[k] = uniform_leaves[k].data;
+					uniform_leaf++;
+				}
+			}
+
+			transposeZPairs(in, {
+				output.addr(glm::uvec3(x, y, 0)),
+				output.addr(glm::uvec3(x + 1, y, 0)),
+				output.addr(glm::uvec3(x, y + 1, 0)),
+				output.addr(glm::uvec3(x + 1, y + 1, 0)),
+			});
+		}
+	}
+}
+
+template<typename T>
+uint64_t CompressedChunkStorage<T>::unpackNodes(std::span<Node, 64> nodes) noexcept
+{
+	if (!m_nodes) {
+		if (m_uniform_value == 0) {
+			return 0;
+		}
+
+		for (Node &node : nodes) {
+			node.uniform_value = m_uniform_value;
+		}
+
+		return ~uint64_t(0);
+	}
+
+	Node *input = m_nodes.get();
+
+	for (uint32_t i = 0; i < 64; i++) {
+		if (m_nonzero_node_mask & (uint64_t(1) << i)) {
+			nodes[i] = std::move(*input);
+			input++;
+		}
+	}
+
+	return m_nonzero_node_mask;
+}
+
+template<typename T>
+void CompressedChunkStorage<T>::packNodes(std::span<Node, 64> nodes, uint64_t nonzero_node_mask)
+{
+	if (nonzero_node_mask == 0) {
+		// All nodes are zero
+		setUniform(0);
+		return;
+	}
+
+	if (nonzero_node_mask == ~uint64_t(0) && nodes[0].uniform()) {
+		bool whole_chunk_uniform = true;
+
+		for (uint32_t i = 1; i < 64; i++) {
+			if (!nodes[i].uniform() || nodes[i].uniform_value != nodes[0].uniform_value) {
+				whole_chunk_uniform = false;
+				break;
+			}
+		}
+
+		if (whole_chunk_uniform) {
+			// The whole chunk has uniform value, don't allocate nodes
+			setUniform(nodes[0].uniform_value);
+			return;
+		}
+	}
+
+	const auto num_nodes = uint32_t(std::popcount(nonzero_node_mask));
+
+	// Reuse the existing node array if it has the right size
+	if (!m_nodes || uint32_t(std::popcount(m_nonzero_node_mask)) != num_nodes) {
+		m_nodes = std::make_unique<Node[]>(num_nodes);
+	}
+
+	Node *output = m_nodes.get();
+
+	for (uint32_t i = 0; i < 64; i++) {
+		if (nonzero_node_mask & (uint64_t(1) << i)) {
+			*output = std::move(nodes[i]);
+			output++;
+		}
+	}
+
+	m_nonzero_node_mask = nonzero_node_mask;
+}
+
+template<typename T>
+template<typename F>
+void CompressedChunkStorage<T>::modifyNodes(uint64_t node_mask, F &&fn)
+{
+	// Unpack into the full array of 64 nodes. This doesn't touch leaves
+	// of nodes, only moves their pointers, so untouched nodes are cheap.
+	Node nodes[64];
+	uint64_t nonzero_node_mask = unpackNodes(nodes);
+
+	CubeArray<T, 8> expanded;
+
+	while (node_mask != 0) {
+		const auto i = uint32_t(std::countr_zero(node_mask));
+		const uint64_t node_bit = uint64_t(1) << i;
+		node_mask ^= node_bit;
+
+		if (nonzero_node_mask & node_bit) {
+			expandNode(nodes[i], expanded.view());
+		} else {
+			expanded.fill(0);
+		}
+
+		fn(nodeBaseOffset(i), expanded.view());
+
+		if (compressNode(expanded.cview(), nodes[i])) {
+			nonzero_node_mask |= node_bit;
+		} else {
+			nonzero_node_mask &= ~node_bit;
+		}
+	}
+
+	packNodes(nodes, nonzero_node_mask);
+}
+
 CompressedChunkStorage<bool>::CompressedChunkStorage(ConstExpandedView expanded)
 {
 	Node nodes[64];
 	uint32_t used_nodes = 0;
 
-	for (uint32_t i = 0; i < 64; i++) {
-		CubeArray<bool, 8> node_bools;
-		expanded.extractTo(nodeBaseOffset(i), node_bools);
+	// Bools are 0/1 bytes, work on them as integers
+	const CubeArrayView<const uint8_t, Consts::CHUNK_SIZE_BLOCKS> bytes {
+		reinterpret_cast<const uint8_t *>(expanded.data),
+		expanded.y_stride,
+		expanded.x_stride,
+	};
 
+	for (uint32_t i = 0; i < 64; i++) {
+		const glm::uvec3 base = nodeBaseOffset(i);
 		Node &node = nodes[used_nodes];
-		// Reset all bits to zero so we won't need to clear them one by one
-		memset(&node, 0, sizeof(Node));
-
-		bool has_false = false;
-		bool has_true = false;
-
-		const bool *bools = node_bools.begin();
-		for (size_t j = 0; j < node_bools.size(); j++) {
-			// TODO: optimize: load 8 bools at once (uint64_t) -> pack first bits of bytes together
-			if (bools[j]) {
-				node.m_leaf_mask[j / 8] |= 1u << (j % 8);
-				has_true = true;
-			} else {
-				has_false = true;
+
+		// Gather four leaves (along Z) at once, then pack every leaf into 8 bits
+		for (uint32_t y = 0; y < 8; y += 2) {
+			for (uint32_t x = 0; x < 8; x += 2) {
+				const uint8_t *rows[4] = {
+					bytes.addr(base + glm::uvec3(x, y, 0)),
+					bytes.addr(base + glm::uvec3(x + 1, y, 0)),
+					bytes.addr(base + glm::uvec3(x, y + 1, 0)),
+					bytes.addr(base + glm::uvec3(x + 1, y + 1, 0)),
+				};
+
+				uint8_t leaves[4][8];
+				transposeZPairs(rows, { leaves[0], leaves[1], leaves[2], leaves[3] });
+
+				for (uint32_t k = 0; k < 4; k++) {
+					node.m_leaf_mask[k + x / 2 * 4 + y / 2 * 16] = packBools(leaves[k]);
+				}
 			}
 		}
 
-		if (has_false && has_true) {
+		uint64_t words[8];
+		memcpy(words, node.m_leaf_mask, sizeof(words));
+
+		uint64_t all_ones = ~uint64_t(0);
+		uint64_t any_ones = 0;
+		for (uint64_t word : words) {
+			all_ones &= word;
+			any_ones |= word;
+		}
+
+		if (any_ones != 0 && all_ones != ~uint64_t(0)) {
 			// Non-uniform node
 			m_nonuniform_node_mask |= uint64_t(1) << i;
 			used_nodes++;
-		} else if (has_true) {
+		} else if (any_ones != 0) {
 			// Uniform ones node, set its bit, don't store
 			m_uniform_value_mask |= uint64_t(1) << i;
 		} // else - uniform zeros node, do nothing
@@ -407,6 +946,13 @@ void CompressedChunkStorage<bool>::expand(ExpandedView expanded) const noexcept
 {
 	const Node *node = m_nodes.get();
 
+	// Bools are 0/1 bytes, work on them as integers
+	CubeArrayView<uint8_t, Consts::CHUNK_SIZE_BLOCKS> bytes {
+		reinterpret_cast<uint8_t *>(expanded.data),
+		expanded.y_stride,
+		expanded.x_stride,
+	};
+
 	for (uint32_t i = 0; i < 64; i++) {
 		glm::uvec3 base = nodeBaseOffset(i);
 		uint64_t i_bit = uint64_t(1) << i;
@@ -416,16 +962,25 @@ void CompressedChunkStorage<bool>::expand(ExpandedView expanded) const noexcept
 			continue;
 		}
 
-		uint32_t j = 0;
-		for (uint32_t y = base.y; y <= base.y + 8; y++) {
-			for (uint32_t x = base.x; x <= base.x + 8; x++) {
-				// TODO: optimize: uint64_t(mask) -> spread bits to bytes -> store 8 bools at once
-				for (uint32_t z = base.z; z <= base.z + 8; z++) {
-					expanded[glm::uvec3(x, y, z)] = !!(node->m_leaf_mask[j / 8] & (1u << j));
-					j++;
+		// Spread every leaf from 8 bits into bools, then scatter four leaves (along Z) at once
+		for (uint32_t y = 0; y < 8; y += 2) {
+			for (uint32_t x = 0; x < 8; x += 2) {
+				uint8_t leaves[4][8];
+
+				for (uint32_t k = 0; k < 4; k++) {
+					unpackBools(node->m_leaf_mask[k + x / 2 * 4 + y / 2 * 16], leaves[k]);
 				}
+
+				transposeZPairs<uint8_t>({ leaves[0], leaves[1], leaves[2], leaves[3] }, {
+					bytes.addr(base + glm::uvec3(x, y, 0)),
+					bytes.addr(base + glm::uvec3(x + 1, y, 0)),
+					bytes.addr(base + glm::uvec3(x, y + 1, 0)),
+					bytes.addr(base + glm::uvec3(x + 1, y + 1, 0)),
+				});
 			}
 		}
+
+		node++;
 	}
 }
 
@@ -443,7 +998,7 @@ bool CompressedChunkStorage<bool>::load(uint32_t x, uint32_t y, uint32_t z) cons
 	uint64_t node_bit = uint64_t(1) << node_id;
 	uint64_t node_tail_mask = node_bit - 1;
 
-	if (!m_nodes) {
+	if (!(m_nonuniform_node_mask & node_bit)) {
 		return !!(m_uniform_value_mask & node_bit);
 	}
 
@@ -456,6 +1011,15 @@ bool CompressedChunkStorage<bool>::load(uint32_t x, uint32_t y, uint32_t z) cons
 	return !!(node.m_leaf_mask[leaf_id] & (1u << leaf_bit_id));
 }
 
+size_t CompressedChunkStorage<bool>::heapBytes() const noexcept
+{
+	if (!m_nodes) {
+		return 0;
+	}
+
+	return size_t(std::popcount(m_nonuniform_node_mask)) * sizeof(Node);
+}
+
 template class VOXEN_API CompressedChunkStorage<uint8_t>;
 template class VOXEN_API CompressedChunkStorage<uint16_t>;
 template class VOXEN_API CompressedChunkStorage<uint32_t>;
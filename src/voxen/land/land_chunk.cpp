@@ -8,6 +8,11 @@ void Chunk::setAllBlocks(BlockIdStorage::ConstExpandedView view)
 	m_block_ids = BlockIdStorage(view);
 }
 
+void Chunk::setAllBlocks(BlockIdStorage storage) noexcept
+{
+	m_block_ids = std::move(storage);
+}
+
 void Chunk::setAllBlocksUniform(BlockId value)
 {
 	m_block_ids.setUniform(value);
@@ -0,0 +1,300 @@
+#include "land_chunk_store_private.hpp"
+
+#include <voxen/land/land_chunk.hpp>
+#include <voxen/os/file.hpp>
+#include <voxen/svc/async_file_io_service.hpp>
+#include <voxen/svc/task_coro.hpp>
+#include <voxen/util/exception.hpp>
+#include <voxen/util/hash.hpp>
+#include <voxen/util/log.hpp>
+
+#include <extras/dyn_array.hpp>
+
+#include <fmt/format.h>
+
+#include <cassert>
+#include <mutex>
+
+namespace voxen::land::detail
+{
+
+namespace
+{
+
+// "VXRG" in little-endian byte order
+constexpr uint32_t REGION_FILE_MAGIC = 0x47525856;
+// Increment when changing the file layout or chunk serialization format
+constexpr uint32_t REGION_FILE_VERSION = 1;
+
+struct RegionFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	// Parameters defining data layout, stored to detect incompatible files
+	uint32_t region_size_chunks;
+	uint32_t chunk_size_blocks;
+
+	bool operator==(const RegionFileHeader &) const = default;
+};
+
+struct RegionEntry {
+	// Offset of chunk payload from the file start, zero if the chunk is not stored
+	int64_t offset;
+	uint32_t size;
+	uint32_t crc32;
+};
+
+static_assert(sizeof(RegionFileHeader) == 16, "16-byte packing of RegionFileHeader is broken");
+static_assert(sizeof(RegionEntry) == 16, "16-byte packing of RegionEntry is broken");
+
+constexpr RegionFileHeader EXPECTED_REGION_FILE_HEADER = {
+	.magic = REGION_FILE_MAGIC,
+	.version = REGION_FILE_VERSION,
+	.region_size_chunks = ChunkStore::REGION_SIZE_CHUNKS,
+	.chunk_size_blocks = Consts::CHUNK_SIZE_BLOCKS,
+};
+
+constexpr int64_t REGION_HEADER_SIZE = static_cast<int64_t>(
+	sizeof(RegionFileHeader) + ChunkStore::CHUNKS_PER_REGION * sizeof(RegionEntry));
+
+ChunkKey regionKey(ChunkKey key) noexcept
+{
+	constexpr int32_t SHIFT = std::countr_zero(uint32_t(ChunkStore::REGION_SIZE_CHUNKS));
+	return ChunkKey(key.base() >> SHIFT);
+}
+
+uint32_t chunkIndexInRegion(ChunkKey key) noexcept
+{
+	constexpr uint32_t MASK = ChunkStore::REGION_SIZE_CHUNKS - 1;
+	constexpr uint32_t SIZE = ChunkStore::REGION_SIZE_CHUNKS;
+
+	glm::uvec3 local = glm::uvec3(key.base()) & MASK;
+	return local.z + local.x * SIZE + local.y * SIZE * SIZE;
+}
+
+} // namespace
+
+struct ChunkStore::Region {
+	// Protects all fields below
+	os::FutexLock lock;
+	// Region file does not exist. No need to retry opening
+	// it for loading until it's created by a store operation.
+	bool missing = false;
+	// Region file is unusable (incompatible/corrupt header or I/O error).
+	// All operations will fail until this region is closed and reopened.
+	bool broken = false;
+	svc::AsyncFileIoService::Ptr file;
+	// Offset at which the next chunk payload will be appended
+	int64_t file_end = 0;
+	// Header entries of all chunks, indexed by `chunkIndexInRegion()`
+	std::unique_ptr<RegionEntry[]> entries;
+
+	// Open region file and read its header, or create an empty one.
+	// Must be called with `lock` held. Does blocking I/O, but only once per region.
+	bool ensureOpen(const std::filesystem::path &path, bool create, svc::AsyncFileIoService &aio)
+	{
+		if (file) [[likely]] {
+			return true;
+		}
+
+		if (broken || (missing && !create)) {
+			return false;
+		}
+
+		os::FileFlags flags { os::FileFlagsBit::Read, os::FileFlagsBit::Write, os::FileFlagsBit::AsyncIo,
+			os::FileFlagsBit::LockExclusive, os::FileFlagsBit::HintRandomAccess };
+		if (create) {
+			flags.set(os::FileFlagsBit::CreateSubdirs);
+		}
+
+		auto maybe_file = os::File::tryOpen(path, flags);
+		if (maybe_file.has_error()) {
+			if (!create && maybe_file.error() == std::errc::no_such_file_or_directory) {
+				// Nothing was ever stored in this region, this is expected
+				missing = true;
+				return false;
+			}
+
+			Log::warn("Can't open land region file '{}': {}", path, maybe_file.error().message());
+			broken = true;
+			return false;
+		}
+
+		os::File opened_file = std::move(maybe_file).value();
+		auto opened_entries = std::make_unique<RegionEntry[]>(CHUNKS_PER_REGION);
+		auto entry_bytes = std::as_writable_bytes(std::span(opened_entries.get(), CHUNKS_PER_REGION));
+
+		try {
+			int64_t size = opened_file.stat().size;
+
+			if (size == 0) {
+				// Freshly created file, write the header with empty entries
+				opened_file.pwrite(std::as_bytes(std::span(&EXPECTED_REGION_FILE_HEADER, 1)), 0);
+				opened_file.pwrite(entry_bytes, sizeof(RegionFileHeader));
+				size = REGION_HEADER_SIZE;
+			} else {
+				RegionFileHeader header {};
+
+				if (size < REGION_HEADER_SIZE
+					|| opened_file.pread(std::as_writable_bytes(std::span(&header, 1)), 0) != sizeof(header)
+					|| header != EXPECTED_REGION_FILE_HEADER) {
+					Log::warn("Land region file '{}' is corrupt or has incompatible format, ignoring it", path);
+					broken = true;
+					return false;
+				}
+
+				if (opened_file.pread(entry_bytes, sizeof(RegionFileHeader)) != entry_bytes.size()) {
+					Log::warn("Land region file '{}' is truncated, ignoring it", path);
+					broken = true;
+					return false;
+				}
+			}
+
+			file_end = size;
+		}
+		catch (const Exception &ex) {
+			Log::warn("I/O error on land region file '{}': {}", path, ex.what());
+			broken = true;
+			return false;
+		}
+
+		file = aio.registerFile(std::move(opened_file));
+		entries = std::move(opened_entries);
+		missing = false;
+		return true;
+	}
+};
+
+ChunkStore::ChunkStore(svc::AsyncFileIoService &aio, std::filesystem::path directory)
+	: m_aio(aio), m_directory(std::move(directory))
+{}
+
+ChunkStore::~ChunkStore() = default;
+
+svc::CoroSubTask<bool> ChunkStore::load(ChunkKey key, Chunk &output)
+{
+	assert(key.scale_log2 == 0);
+
+	const ChunkKey region_key = regionKey(key);
+	const uint32_t index = chunkIndexInRegion(key);
+	std::shared_ptr<Region> region = acquireRegion(region_key);
+
+	svc::AsyncFileIoService::Ptr file;
+	RegionEntry entry;
+
+	{
+		std::lock_guard lock(region->lock);
+
+		if (!region->ensureOpen(regionPath(region_key), false, m_aio)) {
+			co_return false;
+		}
+
+		file = region->file;
+		entry = region->entries[index];
+	}
+
+	if (entry.offset == 0) {
+		// This chunk was never stored
+		co_return false;
+	}
+
+	const glm::ivec3 base = key.base();
+
+	extras::dyn_array<std::byte> buffer(entry.size);
+	svc::AsyncFileIoService::ReadResult result = co_await m_aio.asyncRead(std::move(file), buffer, entry.offset);
+
+	if (result.has_error() || *result != buffer.size()) {
+		Log::warn("Failed to read stored chunk ({}, {}, {}), it will be generated anew", base.x, base.y, base.z);
+		co_return false;
+	}
+
+	Chunk::BlockIdStorage block_ids;
+
+	if (checksumCrc32(buffer) != entry.crc32 || !block_ids.deserialize(buffer)) {
+		Log::warn("Stored chunk ({}, {}, {}) is corrupt, it will be generated anew", base.x, base.y, base.z);
+		co_return false;
+	}
+
+	output.setAllBlocks(std::move(block_ids));
+	co_return true;
+}
+
+svc::CoroSubTask<bool> ChunkStore::store(ChunkKey key, const Chunk &chunk)
+{
+	assert(key.scale_log2 == 0);
+
+	const ChunkKey region_key = regionKey(key);
+	const uint32_t index = chunkIndexInRegion(key);
+	std::shared_ptr<Region> region = acquireRegion(region_key);
+
+	extras::dyn_array<std::byte> buffer(chunk.blockIds().serializedSize());
+	chunk.blockIds().serialize(buffer);
+
+	RegionEntry entry {
+		.offset = 0,
+		.size = static_cast<uint32_t>(buffer.size()),
+		.crc32 = checksumCrc32(buffer),
+	};
+
+	svc::AsyncFileIoService::Ptr file;
+
+	{
+		std::lock_guard lock(region->lock);
+
+		if (!region->ensureOpen(regionPath(region_key), true, m_aio)) {
+			co_return false;
+		}
+
+		file = region->file;
+		// Reserve the range, concurrent stores will append after it
+		entry.offset = region->file_end;
+		region->file_end += entry.size;
+	}
+
+	// Write the payload first and only then repoint the header entry to it
+	svc::AsyncFileIoService::WriteResult result = co_await m_aio.asyncWrite(file, buffer, entry.offset);
+
+	if (!result.has_error()) {
+		const auto entry_offset = static_cast<int64_t>(sizeof(RegionFileHeader) + index * sizeof(RegionEntry));
+		result = co_await m_aio.asyncWrite(std::move(file), std::as_bytes(std::span(&entry, 1)), entry_offset);
+	}
+
+	if (result.has_error()) {
+		const glm::ivec3 base = key.base();
+		Log::warn("Failed to write chunk ({}, {}, {}) into region file: {}", base.x, base.y, base.z,
+			result.error().message());
+		co_return false;
+	}
+
+	{
+		std::lock_guard lock(region->lock);
+		region->entries[index] = entry;
+	}
+
+	co_return true;
+}
+
+std::filesystem::path ChunkStore::regionPath(ChunkKey region_key) const
+{
+	const glm::ivec3 base = region_key.base();
+	return m_directory / fmt::format("r.{}.{}.{}.vxr", base.x, base.y, base.z);
+}
+
+std::shared_ptr<ChunkStore::Region> ChunkStore::acquireRegion(ChunkKey region_key)
+{
+	std::lock_guard lock(m_regions_lock);
+
+	auto iter = m_regions.find(region_key);
+	if (iter != m_regions.end()) {
+		return iter->second;
+	}
+
+	if (m_regions.size() >= MAX_OPEN_REGIONS) {
+		// Close regions not referenced by any ongoing operation. Pointers are
+		// copied out of the map only under this lock, so use count can't grow now.
+		std::erase_if(m_regions, [](const auto &item) { return item.second.use_count() == 1; });
+	}
+
+	return m_regions.emplace(region_key, std::make_shared<Region>()).first->second;
+}
+
+} // namespace voxen::land::detail
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <voxen/land/chunk_key.hpp>
+#include <voxen/land/land_fwd.hpp>
+#include <voxen/os/futex.hpp>
+#include <voxen/svc/svc_fwd.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+
+namespace voxen::land::detail
+{
+
+// Persistent on-disk storage of true (LOD0) chunks.
+//
+// World is split into regions of `REGION_SIZE_CHUNKS^3` chunks, each stored
+// in a separate file. Region file starts with a fixed-size header containing
+// offset, size and checksum of every stored chunk, followed by serialized
+// `CompressedChunkStorage<uint16_t>` payloads of block IDs.
+//
+// Payloads are append-only - storing a chunk again writes a new payload
+// and then repoints its header entry, so a crash can lose the latest
+// version but will never leave a half-written one visible.
+// TODO: this leaves dead ranges in files, region compaction is needed.
+//
+// Load/store operations are task coroutines doing I/O via `AsyncFileIoService`.
+// Operations on different keys can run concurrently from any threads,
+// but the caller must ensure operations on the same key do not overlap.
+class ChunkStore {
+public:
+	constexpr static int32_t REGION_SIZE_CHUNKS = 16;
+	constexpr static uint32_t CHUNKS_PER_REGION = REGION_SIZE_CHUNKS * REGION_SIZE_CHUNKS * REGION_SIZE_CHUNKS;
+	// Keep at most this many region files open, unused ones are closed past this limit
+	constexpr static size_t MAX_OPEN_REGIONS = 64;
+
+	// Region files will be located in `directory`, it will be created if missing
+	ChunkStore(svc::AsyncFileIoService &aio, std::filesystem::path directory);
+	ChunkStore(ChunkStore &&) = delete;
+	ChunkStore(const ChunkStore &) = delete;
+	ChunkStore &operator=(ChunkStore &&) = delete;
+	ChunkStore &operator=(const ChunkStore &) = delete;
+	~ChunkStore();
+
+	// Try loading chunk data into `output`. Returns false if the chunk
+	// was never stored or its data could not be read, then `output` is not changed.
+	// `key` must have zero scale, otherwise the behavior is undefined.
+	svc::CoroSubTask<bool> load(ChunkKey key, Chunk &output);
+	// Write chunk data, replacing the previously stored version (if any).
+	// Returns false if writing has failed, then the previous version remains.
+	// `key` must have zero scale, otherwise the behavior is undefined.
+	svc::CoroSubTask<bool> store(ChunkKey key, const Chunk &chunk);
+
+private:
+	struct Region;
+
+	svc::AsyncFileIoService &m_aio;
+	std::filesystem::path m_directory;
+
+	os::FutexLock m_regions_lock;
+	std::unordered_map<ChunkKey, std::shared_ptr<Region>> m_regions;
+
+	std::filesystem::path regionPath(ChunkKey region_key) const;
+	std::shared_ptr<Region> acquireRegion(ChunkKey region_key);
+};
+
+} // namespace voxen::land::detail
@@ -1,5 +1,6 @@
 #include <voxen/land/land_generator.hpp>
 
+#include <voxen/land/land_generator_noise.hpp>
 #include <voxen/land/land_public_consts.hpp>
 #include <voxen/land/land_temp_blocks.hpp>
 #include <voxen/land/land_utils.hpp>
@@ -13,6 +14,8 @@
 #include <pcg/pcg_random.hpp>
 
 #include <array>
+#include <cfloat>
+#include <mutex>
 #include <random>
 
 namespace voxen::land
@@ -43,22 +46,23 @@ constexpr float SHORE_LEVEL_METRES = 3.5f;
 constexpr float MOUNTAIN_LEVEL_METRES = 750.0f;
 constexpr float SNOW_PEAK_LEVEL_METRES = 2000.0f;
 
+// Column heightmaps are evicted from cache after not being used for this number of ticks.
+// Vertically stacked chunks of a ticket area are usually generated within a few ticks.
+constexpr int64_t COLUMN_HEIGHTMAP_MAX_AGE = 100;
+// Cache is scanned for eviction once in this number of ticks
+constexpr int64_t COLUMN_HEIGHTMAP_EVICT_PERIOD = 25;
+
 struct LocalPlaneSample {
 	float global_map_height;
 	float global_map_temperature;
 	float surface_height;
 };
 
-glm::bvec2 fillLocalPlaneSample(GeneratorGlobalMap::SampledPoint sampled, LocalPlaneSample &output, float ymin,
-	float ymax)
+void fillLocalPlaneSample(GeneratorGlobalMap::SampledPoint sampled, LocalPlaneSample &output)
 {
 	output.global_map_height = sampled.height;
 	output.global_map_temperature = sampled.temperature;
 	output.surface_height = std::max(WATER_LEVEL_METRES, sampled.height);
-
-	bool have_empty = ymax > output.surface_height;
-	bool have_solid = ymin <= output.surface_height;
-	return glm::bvec2(have_empty, have_solid);
 }
 
 Chunk::BlockId assignMaterial(LocalPlaneSample &sample, float y_height, bool true_chunk)
@@ -87,135 +91,29 @@ Chunk::BlockId assignMaterial(LocalPlaneSample &sample, float y_height, bool tru
 	return TempBlockMeta::BlockEmpty;
 }
 
-glm::vec2 grad(int32_t x, int32_t z) noexcept
-{
-	uint64_t kek = Hash::xxh64Fixed((uint64_t(x) << 32) | uint64_t(z));
-
-	uint32_t k1 = uint32_t(kek >> 32);
-	uint32_t k2 = uint32_t(kek);
-
-	constexpr uint32_t S = 1u << 31;
-	constexpr uint32_t M = 16777215u;
-	float gx = ((k1 & S) ? -float(k1 & M) : float(k1 & M)) / float(M);
-	float gy = ((k2 & S) ? -float(k2 & M) : float(k2 & M)) / float(M);
-	return glm::vec2(gx, gy);
-}
-
-float sampleRawSimplexNoise(double x, double z)
-{
-	constexpr double F = 0.3660254038;
-	constexpr double G = 0.2113248654;
-
-	double xskew = x + (x + z) * F;
-	double zskew = z + (x + z) * F;
-
-	double x0d = std::floor(xskew);
-	double z0d = std::floor(zskew);
-	int32_t x0 = static_cast<int32_t>(x0d);
-	int32_t z0 = static_cast<int32_t>(z0d);
-
-	glm::vec2 inner(xskew - x0d, zskew - z0d);
-
-	int32_t x1 = inner.x >= inner.y ? x0 + 1 : x0;
-	int32_t z1 = inner.x < inner.y ? z0 + 1 : z0;
-	double x1d = double(x1);
-	double z1d = double(z1);
-
-	int32_t x2 = x0 + 1;
-	int32_t z2 = z0 + 1;
-	double x2d = double(x2);
-	double z2d = double(z2);
-
-	double x0_unskew = x0d - (x0d + z0d) * G;
-	double z0_unskew = z0d - (x0d + z0d) * G;
-	double x1_unskew = x1d - (x1d + z1d) * G;
-	double z1_unskew = z1d - (x1d + z1d) * G;
-	double x2_unskew = x2d - (x2d + z2d) * G;
-	double z2_unskew = z2d - (x2d + z2d) * G;
-
-	glm::vec2 r0(x - x0_unskew, z - z0_unskew);
-	glm::vec2 r1(x - x1_unskew, z - z1_unskew);
-	glm::vec2 r2(x - x2_unskew, z - z2_unskew);
-
-	float d0 = std::max(0.0f, 0.5f - r0.x * r0.x - r0.y * r0.y);
-	float d1 = std::max(0.0f, 0.5f - r1.x * r1.x - r1.y * r1.y);
-	float d2 = std::max(0.0f, 0.5f - r2.x * r2.x - r2.y * r2.y);
-
-	d0 = d0 * d0;
-	d0 = d0 * d0;
-	d1 = d1 * d1;
-	d1 = d1 * d1;
-	d2 = d2 * d2;
-	d2 = d2 * d2;
-
-	float g0 = glm::dot(grad(x0, z0), r0);
-	float g1 = glm::dot(grad(x1, z1), r1);
-	float g2 = glm::dot(grad(x2, z2), r2);
-
-	float result = d0 * g0 + d1 * g1 + d2 * g2;
-	// TODO: why this multiplication?
-	return 16.0f * result;
-}
-
-float sampleOctavedRawSimplexNoise(double x, double z)
-{
-	float noise = 0.0f;
-
-	noise += 450.0f * sampleRawSimplexNoise(x * 0.001, z * 0.001);
-	noise += 250.0f * sampleRawSimplexNoise(x * 0.002, z * 0.002);
-	noise += 150.0f * sampleRawSimplexNoise(x * 0.004, z * 0.004);
-	noise += 50.0f * sampleRawSimplexNoise(x * 0.01, z * 0.01);
-	noise += 25.0f * sampleRawSimplexNoise(x * 0.025, z * 0.025);
-	noise += 13.0f * sampleRawSimplexNoise(x * 0.05, z * 0.05);
-	noise += 4.5f * sampleRawSimplexNoise(x * 0.1, z * 0.1);
-	noise += 1.5f * sampleRawSimplexNoise(x * 0.3, z * 0.3);
-
-	return noise;
-}
+} // namespace
 
-float sampleOctavedWrappedSimplexNoise(double x, double z)
-{
-	// This will bring coordinates in range [-N/2:N/2]. Not sure which ends
-	// are inclusive/exclusive but that doesn't matter much.
-	// Combining samples of four pairs (x; z) (x; -z) (-x; z) (-x; -z)
-	// will make any noise function correctly tile at world boundaries:
-	// other "aliased" positions will sample from same set of points.
-	//
-	// TODO: but is taking 4x noise samples and severely messing up
-	// its value distribution in the process worth it?
-	// One of the better solutions would be to move this hack to the
-	// outermost sampling procedure and introduce logic to skip sampling
-	// an axis twice if it's far from the wrapparound point (close to zero),
-	// smoothly introducing the second sample as we're getting closer to it.
-	x = fmod(x, 0.5 * WORLD_SIZE_X_METRES);
-	z = fmod(z, 0.5 * WORLD_SIZE_Z_METRES);
-
-	float samples[4] = { sampleOctavedRawSimplexNoise(x, z), sampleOctavedRawSimplexNoise(-x, -z),
-		sampleOctavedRawSimplexNoise(x, -z), sampleOctavedRawSimplexNoise(-x, z) };
-	// Sort it manually (and partially)
-	if (samples[0] > samples[1]) {
-		std::swap(samples[0], samples[1]);
-	}
-	if (samples[1] > samples[2]) {
-		std::swap(samples[1], samples[2]);
-	}
-	if (samples[2] > samples[3]) {
-		std::swap(samples[2], samples[3]);
-	}
-	// Now `samples[3]` is the largest
-	if (samples[0] > samples[1]) {
-		std::swap(samples[0], samples[1]);
-	}
-	if (samples[1] > samples[2]) {
-		std::swap(samples[1], samples[2]);
+struct Generator::ColumnHeightmap {
+	// Pseudo-chunks sample one more point along each axis (cell corners)
+	constexpr static int32_t MAX_SIZE = Consts::CHUNK_SIZE_BLOCKS + 1;
+
+	// Number of samples along X and Z axes
+	int32_t size = 0;
+	// Ranges of sampled values, to skip generating chunks
+	// completely above or below the surface early
+	float min_surface_height = 0.0f;
+	float max_surface_height = 0.0f;
+	float min_global_map_height = 0.0f;
+
+	// Only `size * size` items in XZ order are used
+	std::array<LocalPlaneSample, MAX_SIZE * MAX_SIZE> samples;
+
+	LocalPlaneSample &at(uint32_t x, uint32_t z) noexcept { return samples[size_t(x) * size_t(size) + z]; }
+	const LocalPlaneSample &at(uint32_t x, uint32_t z) const noexcept
+	{
+		return samples[size_t(x) * size_t(size) + z];
 	}
-	// Now `samples[2]` is the second largest
-
-	// Kinda softmax
-	return 0.125f * samples[0] + 0.125f * samples[1] + 0.25f * samples[2] + 0.5f * samples[3];
-}
-
-} // namespace
+};
 
 uint64_t GeneratorGlobalMap::enqueueGenerate(uint64_t seed, svc::TaskBuilder &bld)
 {
@@ -456,7 +354,14 @@ Generator::~Generator() = default;
 
 void Generator::onWorldTickBegin(WorldTickId new_tick)
 {
+	std::lock_guard lock(m_column_cache_lock);
 	m_current_world_tick = new_tick;
+
+	if (new_tick.value % COLUMN_HEIGHTMAP_EVICT_PERIOD == 0) {
+		std::erase_if(m_column_cache, [&](const auto &pair) {
+			return pair.second.last_referenced_tick + COLUMN_HEIGHTMAP_MAX_AGE < new_tick;
+		});
+	}
 }
 
 void Generator::setSeed(uint64_t seed)
@@ -486,8 +391,6 @@ uint64_t Generator::prepareKeyGeneration(ChunkKey key, svc::TaskBuilder &bld)
 void Generator::generateChunk(ChunkKey key, Chunk &output)
 {
 	const glm::ivec3 min_blockspace = key.base() * Consts::CHUNK_SIZE_BLOCKS;
-	// Sample points are shifted by 0.5 to be in centers of block volumes
-	const glm::dvec3 min_world = (glm::dvec3(min_blockspace) + 0.5) * Consts::BLOCK_SIZE_METRES;
 
 	float y_height[Consts::CHUNK_SIZE_BLOCKS];
 	for (int32_t y = 0; y < Consts::CHUNK_SIZE_BLOCKS; y++) {
@@ -497,33 +400,32 @@ void Generator::generateChunk(ChunkKey key, Chunk &output)
 	const float ymin = y_height[0];
 	const float ymax = y_height[Consts::CHUNK_SIZE_BLOCKS - 1];
 
-	using LocalPlane = std::array<std::array<LocalPlaneSample, Consts::CHUNK_SIZE_BLOCKS>, Consts::CHUNK_SIZE_BLOCKS>;
-	auto local_plane = std::make_unique<LocalPlane>();
-
-	glm::bvec2 have_empty_solid(false, false);
-
-	for (uint32_t x = 0; x < Consts::CHUNK_SIZE_BLOCKS; x++) {
-		for (uint32_t z = 0; z < Consts::CHUNK_SIZE_BLOCKS; z++) {
-			double sample_x = min_world.x + x * Consts::BLOCK_SIZE_METRES;
-			double sample_z = min_world.z + z * Consts::BLOCK_SIZE_METRES;
+	const std::shared_ptr<const ColumnHeightmap> heightmap = getColumnHeightmap(key);
 
-			GeneratorGlobalMap::SampledPoint sp = m_global_map.sample(sample_x, sample_z);
-			sp.height += sampleOctavedWrappedSimplexNoise(sample_x, sample_z);
-			have_empty_solid |= fillLocalPlaneSample(sp, (*local_plane)[x][z], ymin, ymax);
-		}
-	}
-
-	if (!have_empty_solid.y) {
+	if (ymin > heightmap->max_surface_height) {
 		// No solid blocks
 		output.setAllBlocksUniform(TempBlockMeta::BlockEmpty);
 		return;
 	}
 
+	if (ymax <= heightmap->min_surface_height && ymax <= heightmap->min_global_map_height) {
+		// All blocks are solid and not water, material then depends only on height
+		LocalPlaneSample sample = heightmap->at(0, 0);
+		const Chunk::BlockId bottom_id = assignMaterial(sample, ymin, true);
+
+		if (bottom_id == assignMaterial(sample, ymax, true)) {
+			// Both ends are in the same material layer
+			output.setAllBlocksUniform(bottom_id);
+			return;
+		}
+	}
+
 	// Allocate on heap, expanded array is pretty large
 	auto ids = std::make_unique<Chunk::BlockIdArray>();
 
 	Utils::forYXZ<Consts::CHUNK_SIZE_BLOCKS>([&](uint32_t x, uint32_t y, uint32_t z) {
-		ids->store(x, y, z, assignMaterial((*local_plane)[x][z], y_height[y], true));
+		LocalPlaneSample sample = heightmap->at(x, z);
+		ids->store(x, y, z, assignMaterial(sample, y_height[y], true));
 	});
 
 	output.setAllBlocks(ids->cview());
@@ -542,25 +444,10 @@ void Generator::generatePseudoChunk(ChunkKey key, PseudoChunkData &output)
 	const float ymin = y_height[0];
 	const float ymax = y_height[Consts::CHUNK_SIZE_BLOCKS];
 
-	constexpr int32_t NP = Consts::CHUNK_SIZE_BLOCKS + 1;
-
-	using LocalPlane = std::array<std::array<LocalPlaneSample, NP>, NP>;
-	auto local_plane = std::make_unique<LocalPlane>();
-
-	glm::bvec2 have_empty_solid(false, false);
+	const std::shared_ptr<const ColumnHeightmap> heightmap = getColumnHeightmap(key);
 
-	for (int32_t x = 0; x <= Consts::CHUNK_SIZE_BLOCKS; x++) {
-		for (int32_t z = 0; z <= Consts::CHUNK_SIZE_BLOCKS; z++) {
-			double sample_x = double(min_blockspace.x + x * step_blockspace) * Consts::BLOCK_SIZE_METRES;
-			double sample_z = double(min_blockspace.z + z * step_blockspace) * Consts::BLOCK_SIZE_METRES;
-
-			GeneratorGlobalMap::SampledPoint sp = m_global_map.sample(sample_x, sample_z);
-			sp.height += sampleOctavedWrappedSimplexNoise(sample_x, sample_z);
-			have_empty_solid |= fillLocalPlaneSample(sp, (*local_plane)[size_t(x)][size_t(z)], ymin, ymax);
-		}
-	}
-
-	if (!have_empty_solid.x || !have_empty_solid.y) {
+	if (ymax <= heightmap->min_surface_height || ymin > heightmap->max_surface_height) {
+		// Completely below or above the surface
 		return;
 	}
 
@@ -571,10 +458,10 @@ void Generator::generatePseudoChunk(ChunkKey key, PseudoChunkData &output)
 		const float y0 = y_height[y];
 		const float y1 = y_height[y + 1];
 
-		const float h00 = (*local_plane)[x][z].surface_height;
-		const float h01 = (*local_plane)[x][z + 1].surface_height;
-		const float h10 = (*local_plane)[x + 1][z].surface_height;
-		const float h11 = (*local_plane)[x + 1][z + 1].surface_height;
+		const float h00 = heightmap->at(x, z).surface_height;
+		const float h01 = heightmap->at(x, z + 1).surface_height;
+		const float h10 = heightmap->at(x + 1, z).surface_height;
+		const float h11 = heightmap->at(x + 1, z + 1).surface_height;
 
 		float values[8];
 		values[0] = y0 - h00;
@@ -596,7 +483,7 @@ void Generator::generatePseudoChunk(ChunkKey key, PseudoChunkData &output)
 			if (values[i] <= 0.0f) {
 				cell.corner_solid_mask |= (1 << i);
 
-				auto &sample = (*local_plane)[x + ((i & 0b010) ? 1 : 0)][z + ((i & 0b001) ? 1 : 0)];
+				LocalPlaneSample sample = heightmap->at(x + ((i & 0b010) ? 1 : 0), z + ((i & 0b001) ? 1 : 0));
 				Chunk::BlockId block_id = assignMaterial(sample, (i & 0b100) ? y1 : y0, false);
 				uint16_t block_color = TempBlockMeta::packColor555(TempBlockMeta::BLOCK_FIXED_COLOR[block_id]);
 				detail::GeometryUtils::addMatHistEntry(material_histogram, { block_color, 255 });
@@ -662,6 +549,77 @@ void Generator::generatePseudoChunk(ChunkKey key, PseudoChunkData &output)
 	output.generateExternally(cells);
 }
 
+std::shared_ptr<const Generator::ColumnHeightmap> Generator::getColumnHeightmap(ChunkKey key)
+{
+	const ChunkKey column_key(key.x, 0, key.z, key.scaleLog2());
+
+	{
+		std::lock_guard lock(m_column_cache_lock);
+
+		auto iter = m_column_cache.find(column_key);
+		if (iter != m_column_cache.end()) {
+			iter->second.last_referenced_tick = m_current_world_tick;
+			return iter->second.ptr;
+		}
+	}
+
+	// Sample without holding the lock. If another task is doing the same column
+	// concurrently, one of the results is discarded - cheaper than waiting.
+	auto heightmap = std::make_shared<ColumnHeightmap>();
+
+	const glm::ivec3 min_blockspace = key.base() * Consts::CHUNK_SIZE_BLOCKS;
+	const int32_t step_blockspace = key.scaleMultiplier();
+
+	glm::dvec2 min_world;
+	if (key.scaleLog2() == 0) {
+		// True chunk sample points are shifted by 0.5 to be in centers of block volumes
+		heightmap->size = Consts::CHUNK_SIZE_BLOCKS;
+		min_world = (glm::dvec2(min_blockspace.x, min_blockspace.z) + 0.5) * Consts::BLOCK_SIZE_METRES;
+	} else {
+		// Pseudo-chunk sample points are at cell corners
+		heightmap->size = Consts::CHUNK_SIZE_BLOCKS + 1;
+		min_world = glm::dvec2(min_blockspace.x, min_blockspace.z) * Consts::BLOCK_SIZE_METRES;
+	}
+
+	const double step_world = step_blockspace * Consts::BLOCK_SIZE_METRES;
+
+	heightmap->min_surface_height = FLT_MAX;
+	heightmap->max_surface_height = -FLT_MAX;
+	heightmap->min_global_map_height = FLT_MAX;
+
+	// Noise is the most expensive part, sample the whole plane in one batch
+	std::array<float, ColumnHeightmap::MAX_SIZE * ColumnHeightmap::MAX_SIZE> noise;
+	GeneratorNoise::sampleOctavedWrappedSimplexPlane(min_world.x, min_world.y, step_world, uint32_t(heightmap->size),
+		noise);
+
+	for (int32_t x = 0; x < heightmap->size; x++) {
+		for (int32_t z = 0; z < heightmap->size; z++) {
+			double sample_x = min_world.x + x * step_world;
+			double sample_z = min_world.y + z * step_world;
+
+			GeneratorGlobalMap::SampledPoint sp = m_global_map.sample(sample_x, sample_z);
+			sp.height += noise[size_t(x) * size_t(heightmap->size) + size_t(z)];
+
+			LocalPlaneSample &sample = heightmap->at(uint32_t(x), uint32_t(z));
+			fillLocalPlaneSample(sp, sample);
+
+			heightmap->min_surface_height = std::min(heightmap->min_surface_height, sample.surface_height);
+			heightmap->max_surface_height = std::max(heightmap->max_surface_height, sample.surface_height);
+			heightmap->min_global_map_height = std::min(heightmap->min_global_map_height, sample.global_map_height);
+		}
+	}
+
+	std::lock_guard lock(m_column_cache_lock);
+
+	auto [iter, inserted] = m_column_cache.try_emplace(column_key);
+	if (inserted) {
+		iter->second.ptr = std::move(heightmap);
+	}
+
+	iter->second.last_referenced_tick = m_current_world_tick;
+	return iter->second.ptr;
+}
+
 uint64_t Generator::ensureGlobalMap(svc::TaskBuilder &bld)
 {
 	if (m_global_map_gen_task_counter > 0) [[likely]] {
@@ -0,0 +1,332 @@
+#include <voxen/land/land_generator_noise.hpp>
+
+#include <voxen/land/land_public_consts.hpp>
+#include <voxen/util/hash.hpp>
+
+#include <glm/vec2.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+// AVX2 intrinsics, baseline for our builds
+#include <immintrin.h>
+
+namespace voxen::land::GeneratorNoise
+{
+
+namespace
+{
+
+constexpr double WORLD_SIZE_X_METRES = Consts::CHUNK_SIZE_METRES
+	* (Consts::MAX_UNIQUE_WORLD_X_CHUNK + 1 - Consts::MIN_UNIQUE_WORLD_X_CHUNK);
+constexpr double WORLD_SIZE_Z_METRES = Consts::CHUNK_SIZE_METRES
+	* (Consts::MAX_UNIQUE_WORLD_Z_CHUNK + 1 - Consts::MIN_UNIQUE_WORLD_Z_CHUNK);
+
+// Skew/unskew factors of 2D simplex grid
+constexpr double SKEW_F = 0.3660254038;
+constexpr double UNSKEW_G = 0.2113248654;
+
+// Gradient components are encoded as 24-bit magnitude plus sign bit
+constexpr uint32_t GRAD_SIGN_BIT = 1u << 31;
+constexpr uint32_t GRAD_MAGNITUDE_MASK = 16777215u;
+
+struct Octave {
+	double frequency;
+	float amplitude;
+};
+
+constexpr std::array<Octave, 8> OCTAVES = { {
+	{ 0.001, 450.0f },
+	{ 0.002, 250.0f },
+	{ 0.004, 150.0f },
+	{ 0.01, 50.0f },
+	{ 0.025, 25.0f },
+	{ 0.05, 13.0f },
+	{ 0.1, 4.5f },
+	{ 0.3, 1.5f },
+} };
+
+glm::vec2 grad(int32_t x, int32_t z) noexcept
+{
+	uint64_t kek = Hash::xxh64Fixed((uint64_t(x) << 32) | uint64_t(z));
+
+	uint32_t k1 = uint32_t(kek >> 32);
+	uint32_t k2 = uint32_t(kek);
+
+	constexpr uint32_t S = GRAD_SIGN_BIT;
+	constexpr uint32_t M = GRAD_MAGNITUDE_MASK;
+	float gx = ((k1 & S) ? -float(k1 & M) : float(k1 & M)) / float(M);
+	float gy = ((k2 & S) ? -float(k2 & M) : float(k2 & M)) / float(M);
+	return glm::vec2(gx, gy);
+}
+
+float sampleRawSimplexNoise(double x, double z) noexcept
+{
+	double xskew = x + (x + z) * SKEW_F;
+	double zskew = z + (x + z) * SKEW_F;
+
+	double x0d = std::floor(xskew);
+	double z0d = std::floor(zskew);
+	int32_t x0 = static_cast<int32_t>(x0d);
+	int32_t z0 = static_cast<int32_t>(z0d);
+
+	glm::vec2 inner(xskew - x0d, zskew - z0d);
+
+	int32_t x1 = inner.x >= inner.y ? x0 + 1 : x0;
+	int32_t z1 = inner.x < inner.y ? z0 + 1 : z0;
+	double x1d = double(x1);
+	double z1d = double(z1);
+
+	int32_t x2 = x0 + 1;
+	int32_t z2 = z0 + 1;
+	double x2d = double(x2);
+	double z2d = double(z2);
+
+	double x0_unskew = x0d - (x0d + z0d) * UNSKEW_G;
+	double z0_unskew = z0d - (x0d + z0d) * UNSKEW_G;
+	double x1_unskew = x1d - (x1d + z1d) * UNSKEW_G;
+	double z1_unskew = z1d - (x1d + z1d) * UNSKEW_G;
+	double x2_unskew = x2d - (x2d + z2d) * UNSKEW_G;
+	double z2_unskew = z2d - (x2d + z2d) * UNSKEW_G;
+
+	glm::vec2 r0(x - x0_unskew, z - z0_unskew);
+	glm::vec2 r1(x - x1_unskew, z - z1_unskew);
+	glm::vec2 r2(x - x2_unskew, z - z2_unskew);
+
+	float d0 = std::max(0.0f, 0.5f - r0.x * r0.x - r0.y * r0.y);
+	float d1 = std::max(0.0f, 0.5f - r1.x * r1.x - r1.y * r1.y);
+	float d2 = std::max(0.0f, 0.5f - r2.x * r2.x - r2.y * r2.y);
+
+	d0 = d0 * d0;
+	d0 = d0 * d0;
+	d1 = d1 * d1;
+	d1 = d1 * d1;
+	d2 = d2 * d2;
+	d2 = d2 * d2;
+
+	float g0 = glm::dot(grad(x0, z0), r0);
+	float g1 = glm::dot(grad(x1, z1), r1);
+	float g2 = glm::dot(grad(x2, z2), r2);
+
+	float result = d0 * g0 + d1 * g1 + d2 * g2;
+	// TODO: why this multiplication?
+	return 16.0f * result;
+}
+
+float sampleOctavedRawSimplexNoise(double x, double z) noexcept
+{
+	float noise = 0.0f;
+
+	for (const Octave &octave : OCTAVES) {
+		noise += octave.amplitude * sampleRawSimplexNoise(x * octave.frequency, z * octave.frequency);
+	}
+
+	return noise;
+}
+
+// Combine samples of four mirrored positions (x; z) (-x; -z) (x; -z) (-x; z)
+float combineWrappedSamples(std::array<float, 4> samples) noexcept
+{
+	// Sort it manually (and partially)
+	if (samples[0] > samples[1]) {
+		std::swap(samples[0], samples[1]);
+	}
+	if (samples[1] > samples[2]) {
+		std::swap(samples[1], samples[2]);
+	}
+	if (samples[2] > samples[3]) {
+		std::swap(samples[2], samples[3]);
+	}
+	// Now `samples[3]` is the largest
+	if (samples[0] > samples[1]) {
+		std::swap(samples[0], samples[1]);
+	}
+	if (samples[1] > samples[2]) {
+		std::swap(samples[1], samples[2]);
+	}
+	// Now `samples[2]` is the second largest
+
+	// Kinda softmax
+	return 0.125f * samples[0] + 0.125f * samples[1] + 0.25f * samples[2] + 0.5f * samples[3];
+}
+
+// SIMD versions below evaluate four mirrored positions of one point
+// in vector lanes, exactly matching lanes of `combineWrappedSamples()`.
+// Double precision parts use 4x64-bit lanes, single precision - 4x32-bit.
+
+// AVX2 has no 64-bit multiplication, compose it from 32x32->64-bit ones.
+// Higher 32 bits of `a_hi * b_hi` product are dropped anyway.
+__m256i mul64(__m256i a, uint64_t b) noexcept
+{
+	const __m256i b_lo = _mm256_set1_epi64x(int64_t(b & 0xFFFFFFFF));
+	const __m256i b_hi = _mm256_set1_epi64x(int64_t(b >> 32));
+
+	__m256i lo = _mm256_mul_epu32(a, b_lo);
+	__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b_lo), _mm256_mul_epu32(a, b_hi));
+	return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+template<int R>
+__m256i rotl64(__m256i a) noexcept
+{
+	return _mm256_or_si256(_mm256_slli_epi64(a, R), _mm256_srli_epi64(a, 64 - R));
+}
+
+// Vectorized `Hash::xxh64Fixed()`, must produce identical results
+__m256i xxh64Fixed4(__m256i data) noexcept
+{
+	constexpr uint64_t PRIME1 = 11400714785074694791ULL;
+	constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+	constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+	constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+	constexpr uint64_t INIT = 2870177450012600261ULL + 8ULL;
+
+	data = mul64(rotl64<31>(mul64(data, PRIME2)), PRIME1);
+	__m256i result = _mm256_xor_si256(_mm256_set1_epi64x(int64_t(INIT)), data);
+	result = _mm256_add_epi64(mul64(rotl64<27>(result), PRIME1), _mm256_set1_epi64x(int64_t(PRIME4)));
+	result = _mm256_xor_si256(result, _mm256_srli_epi64(result, 33));
+	result = mul64(result, PRIME2);
+	result = _mm256_xor_si256(result, _mm256_srli_epi64(result, 29));
+	result = mul64(result, PRIME3);
+	return _mm256_xor_si256(result, _mm256_srli_epi64(result, 32));
+}
+
+// Vectorized `grad()` followed by dot product with (rx; rz)
+__m128 gradDot4(__m128i x, __m128i z, __m128 rx, __m128 rz) noexcept
+{
+	// Sign-extended like `uint64_t(int32_t)` conversions
+	__m256i key = _mm256_or_si256(_mm256_slli_epi64(_mm256_cvtepi32_epi64(x), 32), _mm256_cvtepi32_epi64(z));
+	__m256i hash = xxh64Fixed4(key);
+
+	// Gather higher halves (`k1`) into the lower 128 bits, lower halves (`k2`) into the upper ones
+	hash = _mm256_permutevar8x32_epi32(hash, _mm256_setr_epi32(1, 3, 5, 7, 0, 2, 4, 6));
+
+	// Converted magnitude is non-negative, so just copy the sign bit to negate it
+	__m256i magnitude = _mm256_and_si256(hash, _mm256_set1_epi32(int32_t(GRAD_MAGNITUDE_MASK)));
+	__m256i sign = _mm256_and_si256(hash, _mm256_set1_epi32(int32_t(GRAD_SIGN_BIT)));
+	__m256 g = _mm256_or_ps(_mm256_cvtepi32_ps(magnitude), _mm256_castsi256_ps(sign));
+	g = _mm256_div_ps(g, _mm256_set1_ps(float(GRAD_MAGNITUDE_MASK)));
+
+	__m128 gx = _mm256_castps256_ps128(g);
+	__m128 gz = _mm256_extractf128_ps(g, 1);
+	return _mm_add_ps(_mm_mul_ps(gx, rx), _mm_mul_ps(gz, rz));
+}
+
+// Falloff factor `max(0, 0.5 - |r|^2)^4`
+__m128 falloff4(__m128 rx, __m128 rz) noexcept
+{
+	__m128 d = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(rx, rx)), _mm_mul_ps(rz, rz));
+	d = _mm_max_ps(_mm_setzero_ps(), d);
+	d = _mm_mul_ps(d, d);
+	return _mm_mul_ps(d, d);
+}
+
+// Vectorized `sampleRawSimplexNoise()`
+__m128 sampleRawSimplexNoise4(__m256d x, __m256d z) noexcept
+{
+	const __m256d skew_f = _mm256_set1_pd(SKEW_F);
+	const __m256d unskew_g = _mm256_set1_pd(UNSKEW_G);
+
+	__m256d skew = _mm256_mul_pd(_mm256_add_pd(x, z), skew_f);
+	__m256d xskew = _mm256_add_pd(x, skew);
+	__m256d zskew = _mm256_add_pd(z, skew);
+
+	__m256d x0d = _mm256_floor_pd(xskew);
+	__m256d z0d = _mm256_floor_pd(zskew);
+	__m128i x0 = _mm256_cvttpd_epi32(x0d);
+	__m128i z0 = _mm256_cvttpd_epi32(z0d);
+
+	__m128 inner_x = _mm256_cvtpd_ps(_mm256_sub_pd(xskew, x0d));
+	__m128 inner_z = _mm256_cvtpd_ps(_mm256_sub_pd(zskew, z0d));
+
+	// Masks are all ones (-1) in selected lanes, subtract them to add 1
+	__m128i ge_mask = _mm_castps_si128(_mm_cmp_ps(inner_x, inner_z, _CMP_GE_OQ));
+	__m128i lt_mask = _mm_castps_si128(_mm_cmp_ps(inner_x, inner_z, _CMP_LT_OQ));
+
+	__m128i x1 = _mm_sub_epi32(x0, ge_mask);
+	__m128i z1 = _mm_sub_epi32(z0, lt_mask);
+	__m256d x1d = _mm256_cvtepi32_pd(x1);
+	__m256d z1d = _mm256_cvtepi32_pd(z1);
+
+	const __m128i one = _mm_set1_epi32(1);
+	__m128i x2 = _mm_add_epi32(x0, one);
+	__m128i z2 = _mm_add_epi32(z0, one);
+	__m256d x2d = _mm256_cvtepi32_pd(x2);
+	__m256d z2d = _mm256_cvtepi32_pd(z2);
+
+	auto relative = [&](__m256d cx, __m256d cz, __m128 &rx, __m128 &rz) {
+		__m256d unskew = _mm256_mul_pd(_mm256_add_pd(cx, cz), unskew_g);
+		rx = _mm256_cvtpd_ps(_mm256_sub_pd(x, _mm256_sub_pd(cx, unskew)));
+		rz = _mm256_cvtpd_ps(_mm256_sub_pd(z, _mm256_sub_pd(cz, unskew)));
+	};
+
+	__m128 r0x, r0z, r1x, r1z, r2x, r2z;
+	relative(x0d, z0d, r0x, r0z);
+	relative(x1d, z1d, r1x, r1z);
+	relative(x2d, z2d, r2x, r2z);
+
+	__m128 result = _mm_mul_ps(falloff4(r0x, r0z), gradDot4(x0, z0, r0x, r0z));
+	result = _mm_add_ps(result, _mm_mul_ps(falloff4(r1x, r1z), gradDot4(x1, z1, r1x, r1z)));
+	result = _mm_add_ps(result, _mm_mul_ps(falloff4(r2x, r2z), gradDot4(x2, z2, r2x, r2z)));
+	return _mm_mul_ps(_mm_set1_ps(16.0f), result);
+}
+
+} // namespace
+
+float sampleOctavedWrappedSimplex(double x, double z) noexcept
+{
+	// This will bring coordinates in range [-N/2:N/2]. Not sure which ends
+	// are inclusive/exclusive but that doesn't matter much.
+	// Combining samples of four pairs (x; z) (x; -z) (-x; z) (-x; -z)
+	// will make any noise function correctly tile at world boundaries:
+	// other "aliased" positions will sample from same set of points.
+	//
+	// TODO: but is taking 4x noise samples and severely messing up
+	// its value distribution in the process worth it?
+	// One of the better solutions would be to move this hack to the
+	// outermost sampling procedure and introduce logic to skip sampling
+	// an axis twice if it's far from the wrapparound point (close to zero),
+	// smoothly introducing the second sample as we're getting closer to it.
+	x = fmod(x, 0.5 * WORLD_SIZE_X_METRES);
+	z = fmod(z, 0.5 * WORLD_SIZE_Z_METRES);
+
+	return combineWrappedSamples({ sampleOctavedRawSimplexNoise(x, z), sampleOctavedRawSimplexNoise(-x, -z),
+		sampleOctavedRawSimplexNoise(x, -z), sampleOctavedRawSimplexNoise(-x, z) });
+}
+
+void sampleOctavedWrappedSimplexPlane(double min_x, double min_z, double step, uint32_t size,
+	std::span<float> output) noexcept
+{
+	assert(output.size() >= size_t(size) * size_t(size));
+
+	// Lane signs of mirrored positions, see `sampleOctavedWrappedSimplex()`
+	const __m256d x_signs = _mm256_setr_pd(1.0, -1.0, 1.0, -1.0);
+	const __m256d z_signs = _mm256_setr_pd(1.0, -1.0, -1.0, 1.0);
+
+	for (uint32_t i = 0; i < size; i++) {
+		const double x = fmod(min_x + double(i) * step, 0.5 * WORLD_SIZE_X_METRES);
+		const __m256d xv = _mm256_mul_pd(_mm256_set1_pd(x), x_signs);
+
+		for (uint32_t j = 0; j < size; j++) {
+			const double z = fmod(min_z + double(j) * step, 0.5 * WORLD_SIZE_Z_METRES);
+			const __m256d zv = _mm256_mul_pd(_mm256_set1_pd(z), z_signs);
+
+			__m128 noise = _mm_setzero_ps();
+
+			for (const Octave &octave : OCTAVES) {
+				const __m256d freq = _mm256_set1_pd(octave.frequency);
+				__m128 raw = sampleRawSimplexNoise4(_mm256_mul_pd(xv, freq), _mm256_mul_pd(zv, freq));
+				noise = _mm_add_ps(noise, _mm_mul_ps(_mm_set1_ps(octave.amplitude), raw));
+			}
+
+			std::array<float, 4> samples;
+			_mm_storeu_ps(samples.data(), noise);
+			output[size_t(i) * size + j] = combineWrappedSamples(samples);
+		}
+	}
+}
+
+} // namespace voxen::land::GeneratorNoise
@@ -34,12 +34,35 @@ struct ChunkLoadCompletionMessage {
 	LandState::ChunkTable::ValuePtr value_ptr;
 };
 
+// Sent from slave threads upon chunk edit (batch of block changes) job completion
+struct ChunkEditCompletionMessage {
+	constexpr static UID MESSAGE_UID = UID("c469d3cd-7f7d49a1-8cabc3e6-c69245db");
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Unicast;
+
+	ChunkKey key;
+	// Chunk-local box [begin; end) of actually changed blocks.
+	// Empty (any component of `begin` >= `end`) if nothing was changed.
+	glm::ivec3 dirty_begin;
+	glm::ivec3 dirty_end;
+};
+
+// Sent from slave threads upon chunk store (to persistent storage) job completion
+struct ChunkStoreCompletionMessage {
+	constexpr static UID MESSAGE_UID = UID("6c0f2e51-b83d94a7-1f5ae0c3-72d9b4e8");
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Unicast;
+
+	ChunkKey key;
+};
+
 // Sent from slave threads upon pseudo-chunk data gen job completion
 struct PseudoChunkDataGenCompletionMessage {
 	constexpr static UID MESSAGE_UID = UID("921efbbd-863d267a-f4063130-218f6b30");
 	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Unicast;
 
 	ChunkKey key;
+	// False if generated data is the same as the previous version,
+	// then nothing depending on it needs to be invalidated
+	bool changed = true;
 };
 
 // Sent from slave thread upon pseudo-chunk surface gen job completion
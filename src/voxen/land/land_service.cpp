@@ -4,20 +4,27 @@
 #include <voxen/debug/uid_registry.hpp>
 #include <voxen/land/land_generator.hpp>
 #include <voxen/land/land_messages.hpp>
+#include <voxen/land/land_state.hpp>
 #include <voxen/land/land_temp_blocks.hpp>
 #include <voxen/land/land_utils.hpp>
+#include <voxen/svc/async_file_io_service.hpp>
 #include <voxen/svc/messaging_service.hpp>
 #include <voxen/svc/service_locator.hpp>
 #include <voxen/svc/task_builder.hpp>
+#include <voxen/svc/task_coro.hpp>
 #include <voxen/svc/task_service.hpp>
 #include <voxen/util/concentric_octahedra_walker.hpp>
 #include <voxen/util/log.hpp>
 #include <voxen/util/lru_visit_ordering.hpp>
 
+#include "land_chunk_store_private.hpp"
 #include "land_private_consts.hpp"
 #include "land_private_messages.hpp"
 
 #include <array>
+#include <chrono>
+#include <optional>
+#include <queue>
 #include <unordered_map>
 #include <vector>
 
@@ -33,9 +40,18 @@ using PseudoSurfacePtr = LandState::PseudoChunkSurfaceTable::ValuePtr;
 namespace
 {
 
+// Compare freshly generated pseudo-data with its previous version (can be null)
+// and send completion message. Previous version must be already complete.
+void completePseudoChunkDataGen(ChunkKey key, const PseudoDataPtr &prev_ptr, const PseudoDataPtr &out_ptr,
+	svc::MessageSender *sender)
+{
+	const bool changed = !prev_ptr || prev_ptr->cellEntries() != out_ptr->cellEntries();
+	sender->send<detail::PseudoChunkDataGenCompletionMessage>(LandService::SERVICE_UID, key, changed);
+}
+
 // Aggregate LOD1 pseudo-chunk data from LOD0 (true) chunks
 void aggregatePseudoChunkData(ChunkKey key, std::array<ChunkPtr, 27> ref, svc::MessageSender *sender,
-	PseudoDataPtr out_ptr)
+	PseudoDataPtr prev_ptr, PseudoDataPtr out_ptr)
 {
 	const Chunk *ptrs[27];
 	for (size_t i = 0; i < 27; i++) {
@@ -43,12 +59,12 @@ void aggregatePseudoChunkData(ChunkKey key, std::array<ChunkPtr, 27> ref, svc::M
 	}
 
 	out_ptr->generateFromLod0(ptrs);
-	sender->send<detail::PseudoChunkDataGenCompletionMessage>(LandService::SERVICE_UID, key);
+	completePseudoChunkDataGen(key, prev_ptr, out_ptr, sender);
 }
 
 // Aggregate LODn pseudo-chunk data from LOD(n-1) (higher-resolution) pseudo-chunks
 void aggregatePseudoChunkData(ChunkKey key, std::array<PseudoDataPtr, 8> ref, svc::MessageSender *sender,
-	PseudoDataPtr out_ptr)
+	PseudoDataPtr prev_ptr, PseudoDataPtr out_ptr)
 {
 	const PseudoChunkData *ptrs[8];
 	for (size_t i = 0; i < 8; i++) {
@@ -56,7 +72,7 @@ void aggregatePseudoChunkData(ChunkKey key, std::array<PseudoDataPtr, 8> ref, sv
 	}
 
 	out_ptr->generateFromFinerLod(ptrs);
-	sender->send<detail::PseudoChunkDataGenCompletionMessage>(LandService::SERVICE_UID, key);
+	completePseudoChunkDataGen(key, prev_ptr, out_ptr, sender);
 }
 
 void generatePseudoChunkSurface(ChunkKey key, std::array<ChunkPtr, 7> ref, svc::MessageSender *sender)
@@ -85,7 +101,8 @@ void generatePseudoChunkSurface(ChunkKey key, std::array<ChunkPtr, 7> ref, svc::
 }
 
 // Generate pseudo-chunk surface from pseudo-chunk data
-void generatePseudoChunkSurface(ChunkKey key, std::array<PseudoDataPtr, 19> ref, svc::MessageSender *sender)
+void generatePseudoChunkSurface(ChunkKey key, std::array<PseudoDataPtr, 19> ref,
+	const PseudoSurfaceWeldingConfig &welding, svc::MessageSender *sender)
 {
 	const PseudoChunkData *ptrs[19];
 	for (size_t i = 0; i < 19; i++) {
@@ -93,7 +110,7 @@ void generatePseudoChunkSurface(ChunkKey key, std::array<PseudoDataPtr, 19> ref,
 	}
 
 	PseudoSurfacePtr out_ptr = LandState::PseudoChunkSurfaceTable::makeValuePtr();
-	out_ptr->generate(ptrs, key.scaleLog2());
+	out_ptr->generate(ptrs, key.scaleLog2(), welding);
 
 	if (!out_ptr->empty()) {
 		// Not-empty surface, send it back to the servicee
@@ -104,37 +121,102 @@ void generatePseudoChunkSurface(ChunkKey key, std::array<PseudoDataPtr, 19> ref,
 	}
 }
 
-void editBlock(ChunkKey key, ChunkPtr chunk, glm::ivec3 position, Chunk::BlockId block_id, svc::MessageSender *sender)
+struct BlockEdit {
+	// Chunk-local block position
+	glm::ivec3 position;
+	Chunk::BlockId new_id;
+};
+
+// Apply a batch of block edits to one chunk in order
+void editBlocks(ChunkKey key, ChunkPtr chunk, std::vector<BlockEdit> edits, svc::MessageSender *sender)
 {
-	assert(glm::all(glm::greaterThanEqual(position, glm::ivec3(0))));
-	assert(glm::all(glm::lessThan(position, glm::ivec3(Consts::CHUNK_SIZE_BLOCKS))));
+	glm::ivec3 dirty_begin(Consts::CHUNK_SIZE_BLOCKS);
+	glm::ivec3 dirty_end(0);
 
-	// TODO: we really need to expand everything to change a single block ID?
-	// That won't scale... at all.
+	for (const BlockEdit &edit : edits) {
+		assert(glm::all(glm::greaterThanEqual(edit.position, glm::ivec3(0))));
+		assert(glm::all(glm::lessThan(edit.position, glm::ivec3(Consts::CHUNK_SIZE_BLOCKS))));
 
-	auto expanded = std::make_unique<Chunk::BlockIdArray>();
-	chunk->blockIds().expand(expanded->view());
+		const glm::uvec3 pos(edit.position);
 
-	if (expanded->load(position.x, position.y, position.z) == block_id) {
-		// Not changed, discard this operation
-		return;
+		if (chunk->blockIds()[pos] == edit.new_id) {
+			// Not changed, discard this operation
+			continue;
+		}
+
+		// Rewrites only the affected 8x8x8 node, no need to expand the whole chunk
+		chunk->setBlock(pos, edit.new_id);
+
+		dirty_begin = glm::min(dirty_begin, edit.position);
+		dirty_end = glm::max(dirty_end, edit.position + 1);
+	}
+
+	sender->send<detail::ChunkEditCompletionMessage>(LandService::SERVICE_UID, key, dirty_begin, dirty_end);
+}
+
+// Load chunk from persistent storage, generate it if it's not stored there
+svc::CoroTask loadChunk(ChunkKey key, detail::ChunkStore *store, Generator *gen, uint64_t gen_prepare_counter,
+	svc::MessageSender *sender, ChunkPtr ptr)
+{
+	if (!co_await store->load(key, *ptr)) {
+		// Generator resources were requested in advance but we
+		// didn't wait for them until it's clear they are needed
+		if (gen_prepare_counter != 0) {
+			co_await svc::CoroFuture<void>(gen_prepare_counter);
+		}
+
+		gen->generateChunk(key, *ptr);
 	}
 
-	expanded->store(position.x, position.y, position.z, block_id);
-	chunk->setAllBlocks(expanded->cview());
-	sender->send<detail::ChunkLoadCompletionMessage>(LandService::SERVICE_UID, key);
+	sender->send<detail::ChunkLoadCompletionMessage>(LandService::SERVICE_UID, key, std::move(ptr));
+}
+
+// Write (edited) chunk into persistent storage
+svc::CoroTask storeChunk(ChunkKey key, detail::ChunkStore *store, svc::MessageSender *sender, ChunkPtr ptr)
+{
+	// Failures are logged by the store, nothing else we can do about them
+	co_await store->store(key, *ptr);
+	sender->send<detail::ChunkStoreCompletionMessage>(LandService::SERVICE_UID, key);
 }
 
 constexpr int64_t STALE_CHUNK_AGE_THRESHOLD = 750;
+// Release fully unused pool slabs once in this number of ticks. Chunks go stale
+// in bulk (e.g. after teleporting), trimming more often would only churn slabs.
+constexpr int64_t POOL_TRIM_PERIOD = 250;
+
+// Known contents of chunk data/pseudo-data, see `ChunkMetastate`.
+// Allows to skip tasks whose results are known to be empty in advance.
+enum : uint32_t {
+	// Not known - data is not generated yet or has pending tasks
+	CONTENT_UNKNOWN = 0,
+	// Chunk has only empty blocks, pseudo-data has no surface cells
+	CONTENT_EMPTY = 1,
+	// Chunk has only solid blocks, not used for pseudo-data
+	CONTENT_SOLID = 2,
+	// Anything else, surface might be present
+	CONTENT_MIXED = 3,
+};
 
 struct ChunkMetastate {
 	WorldTickId last_referenced_tick = WorldTickId::INVALID;
 
-	uint32_t pending_task_count : 8 = 0;
+	// Block edits add to it too, so it's wide enough for them to pile up
+	uint32_t pending_task_count : 16 = 0;
 	uint32_t chunk_data_invalidated : 1 = 1;
 	uint32_t pseudo_data_invalidated : 1 = 1;
 	uint32_t pseudo_surface_invalidated : 1 = 1;
 	uint32_t is_virgin : 1 = 1;
+	// Chunk was edited since it was last loaded or stored,
+	// it must be written to persistent storage before unloading
+	uint32_t chunk_data_modified : 1 = 0;
+	// `CONTENT_*` constants for the latest chunk data and pseudo-data.
+	// Evaluated lazily when the key has no pending tasks, reset when
+	// enqueueing tasks modifying the respective data.
+	uint32_t chunk_content : 2 = CONTENT_UNKNOWN;
+	uint32_t pseudo_data_content : 2 = CONTENT_UNKNOWN;
+	// Edit tasks not completed yet, each might set `chunk_data_modified`.
+	// As wide as `pending_task_count`, edits can pile up behind a slow load.
+	uint32_t pending_edit_count : 16 = 0;
 
 	uint64_t chunk_gen_task_counter = 0;
 	uint64_t pseudo_data_gen_task_counter = 0;
@@ -149,11 +231,87 @@ struct TicketState {
 	bool valid;
 };
 
+struct TicketKeyState {
+	// Number of tickets covering this key
+	uint32_t refs = 0;
+	// Manhattan distance (in scaled chunk units) to the pivot
+	// of the latest ticket covering it, defines visit priority
+	uint32_t pivot_distance = 0;
+};
+
+struct KeyVisitRequest {
+	uint32_t pivot_distance;
+	ChunkKey key;
+};
+
+// Makes `std::priority_queue` pop keys closest to pivots first
+struct KeyVisitRequestCompare {
+	bool operator()(const KeyVisitRequest &a, const KeyVisitRequest &b) const noexcept
+	{
+		return a.pivot_distance > b.pivot_distance;
+	}
+};
+
+// Adapts the number of items processed per tick by some work phase to make
+// its duration fit into a given time target. Tracks moving average of the
+// per-item cost measured on previous ticks, so it works the same regardless
+// of CPU speed, number of task threads competing for caches etc.
+class AdaptiveVisitBudget {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	AdaptiveVisitBudget(size_t min_count, size_t max_count, size_t initial_count) noexcept
+		: m_min_count(min_count), m_max_count(max_count), m_initial_count(initial_count)
+	{}
+
+	// Number of items to process in this tick to spend approximately `target` time
+	size_t plan(Clock::duration target) const noexcept
+	{
+		if (m_avg_item_cost_ns <= 0.0) {
+			// Nothing measured yet
+			return m_initial_count;
+		}
+
+		const double target_ns = static_cast<double>(std::chrono::nanoseconds(target).count());
+		const double count = std::max(target_ns, 0.0) / m_avg_item_cost_ns;
+		return std::clamp(static_cast<size_t>(count), m_min_count, m_max_count);
+	}
+
+	// Report the actual amount of work done in this tick
+	void record(size_t processed, Clock::duration elapsed) noexcept
+	{
+		if (processed == 0) {
+			return;
+		}
+
+		const double elapsed_ns = static_cast<double>(std::chrono::nanoseconds(elapsed).count());
+		const double cost = elapsed_ns / static_cast<double>(processed);
+
+		// Smooth out outliers like an occasional slow task enqueue
+		if (m_avg_item_cost_ns <= 0.0) {
+			m_avg_item_cost_ns = cost;
+		} else {
+			m_avg_item_cost_ns += (cost - m_avg_item_cost_ns) * 0.25;
+		}
+	}
+
+private:
+	const size_t m_min_count;
+	const size_t m_max_count;
+	const size_t m_initial_count;
+
+	double m_avg_item_cost_ns = 0.0;
+};
+
 } // namespace
 
 class detail::LandServiceImpl {
 public:
-	LandServiceImpl(svc::ServiceLocator &svc) : m_task_service(svc.requestService<svc::TaskService>())
+	LandServiceImpl(svc::ServiceLocator &svc, LandService::Config cfg)
+		: m_task_service(svc.requestService<svc::TaskService>())
+		, m_tick_work_budget(cfg.tick_work_budget)
+		, m_memory_stats_period(cfg.memory_stats_period)
+		, m_surface_welding(cfg.surface_welding)
 	{
 		// Public messages
 		debug::UidRegistry::registerLiteral(ChunkTicketRequestMessage::MESSAGE_UID,
@@ -167,6 +325,10 @@ public:
 			"voxen::land::detail::ChunkTicketRemoveMessage");
 		debug::UidRegistry::registerLiteral(ChunkLoadCompletionMessage::MESSAGE_UID,
 			"voxen::land::detail::ChunkLoadCompletionMessage");
+		debug::UidRegistry::registerLiteral(ChunkEditCompletionMessage::MESSAGE_UID,
+			"voxen::land::detail::ChunkEditCompletionMessage");
+		debug::UidRegistry::registerLiteral(ChunkStoreCompletionMessage::MESSAGE_UID,
+			"voxen::land::detail::ChunkStoreCompletionMessage");
 		debug::UidRegistry::registerLiteral(PseudoChunkDataGenCompletionMessage::MESSAGE_UID,
 			"voxen::land::detail::PseudoChunkDataGenCompletionMessage");
 		debug::UidRegistry::registerLiteral(PseudoChunkSurfaceGenCompletionMessage::MESSAGE_UID,
@@ -190,6 +352,10 @@ public:
 			[this](BlockEditMessage &msg, svc::MessageInfo &) { handleBlockEditMessage(msg); });
 		m_queue.registerHandler<ChunkLoadCompletionMessage>(
 			[this](ChunkLoadCompletionMessage &msg, svc::MessageInfo &) { handleChunkLoadCompletion(msg); });
+		m_queue.registerHandler<ChunkEditCompletionMessage>(
+			[this](ChunkEditCompletionMessage &msg, svc::MessageInfo &) { handleChunkEditCompletion(msg); });
+		m_queue.registerHandler<ChunkStoreCompletionMessage>(
+			[this](ChunkStoreCompletionMessage &msg, svc::MessageInfo &) { handleChunkStoreCompletion(msg); });
 		m_queue.registerHandler<PseudoChunkDataGenCompletionMessage>(
 			[this](PseudoChunkDataGenCompletionMessage &msg, svc::MessageInfo &) { handlePseudoDataGenCompletion(msg); });
 		m_queue.registerHandler<PseudoChunkSurfaceGenCompletionMessage>(
@@ -203,10 +369,35 @@ public:
 		m_dummy_below_limit_chunk = LandState::ChunkTable::makeValuePtr();
 		m_dummy_below_limit_chunk->setAllBlocksUniform(TempBlockMeta::BlockUnderlimit);
 		m_dummy_pseudo_data_ptr = m_pseudo_chunk_data_pool.allocate(ChunkKey { 0, 0, 0, Consts::NUM_LOD_SCALES });
+
+		if (!cfg.storage_directory.empty()) {
+			Log::info("Using persistent land storage at '{}'", cfg.storage_directory);
+			auto &aio = svc.requestService<svc::AsyncFileIoService>();
+			m_chunk_store = std::make_unique<ChunkStore>(aio, std::move(cfg.storage_directory));
+		} else {
+			Log::info("Persistent land storage is disabled, edits will be lost on unload");
+		}
+
+		if (!cfg.shared_state.name.empty()) {
+			m_shared_state_publisher = std::make_unique<SharedLandStatePublisher>(std::move(cfg.shared_state));
+		}
 	}
 
 	~LandServiceImpl()
 	{
+		// Edits received during the last tick were not applied yet
+		enqueueBlockEdits();
+
+		if (m_chunk_store) {
+			// Don't lose edits of chunks that are still loaded. Completions of pending
+			// edits won't be processed, store chunks as if they have changed something.
+			for (auto &[key, m] : m_metastate) {
+				if (m.chunk_data_modified || m.pending_edit_count > 0) {
+					enqueueChunkStore(key, m);
+				}
+			}
+		}
+
 		svc::TaskBuilder bld(m_task_service);
 		m_generator.waitEnqueuedTasks(bld);
 
@@ -235,9 +426,20 @@ public:
 
 	void doTick(WorldTickId tick_id)
 	{
+		using Clock = AdaptiveVisitBudget::Clock;
+		const Clock::time_point tick_begin = Clock::now();
+
 		m_tick_id = tick_id;
 		m_generator.onWorldTickBegin(tick_id);
 
+		// Remember the previous tick state to see what this tick changes. Copy is cheap,
+		// and we keep it only until the end of this tick, not adding any retention.
+		const bool collect_memory_stats = m_memory_stats_period > 0 && tick_id.value % m_memory_stats_period == 0;
+		std::optional<LandState> stats_previous_state;
+		if (collect_memory_stats) {
+			stats_previous_state.emplace(m_land_state);
+		}
+
 		// Process chunk ticket change requests, now we have a fresh list of tickets.
 		// Job completions and invalidation enqueues will be processed here too.
 		m_queue.pollMessages();
@@ -251,6 +453,7 @@ public:
 
 			iter->second.pseudo_data_invalidated = 1;
 			iter->second.is_virgin = 0;
+			enqueueTicketedKeyUpdate(key);
 		}
 
 		for (ChunkKey key : m_this_tick_pseudo_surface_invalidations) {
@@ -260,87 +463,82 @@ public:
 			}
 
 			iter->second.pseudo_surface_invalidated = 1;
+			enqueueTicketedKeyUpdate(key);
 		}
 
 		m_this_tick_pseudo_data_invalidations.clear();
 		m_this_tick_pseudo_surface_invalidations.clear();
 
-		// No keys left to update for this tick, collect a new list.
-		// It might be very big if there are many tickets but we will consume
-		// it in batches over the following ticks.
-		// XXX: still not very got, can hitch on high workloads (too many players/chunkloading entities)
-		if (m_keys_to_update.empty()) {
-			for (const TicketState &state : m_chunk_tickets) {
-				if (!state.valid) {
-					continue;
-				}
+		enqueueBlockEdits();
 
-				if (const auto *box_area = std::get_if<ChunkTicketBoxArea>(&state.area); box_area != nullptr) {
-					const ChunkKey lo = box_area->begin;
-					const ChunkKey hi = box_area->end;
-					const int32_t step = lo.scaleMultiplier();
-
-					// Limit to vertical world bounds
-					const int64_t lo_y = std::max<int64_t>(lo.y, Consts::MIN_WORLD_Y_CHUNK);
-					const int64_t hi_y = std::min<int64_t>(hi.y, Consts::MAX_WORLD_Y_CHUNK);
-
-					for (int64_t y = lo_y; y < hi_y; y += step) {
-						for (int64_t x = lo.x; x < hi.x; x += step) {
-							for (int64_t z = lo.z; z < hi.z; z += step) {
-								ChunkKey ck(x, y, z, lo.scale_log2);
-								m_keys_to_update.emplace_back(ck);
-							}
-						}
-					}
-				} else {
-					const auto *octa_area = std::get_if<ChunkTicketOctahedronArea>(&state.area);
-					// It can be either box or octahedron
-					assert(octa_area != nullptr);
+		// Split the remaining tick time budget between key visiting and cleanup.
+		// Both phases are guaranteed some minimal share to always make progress.
+		const Clock::duration budget = m_tick_work_budget;
+		const Clock::duration min_phase_budget = budget / 8;
 
-					const glm::ivec3 pivot = octa_area->pivot.base();
-					const int32_t scale = octa_area->pivot.scaleMultiplier();
+		const Clock::time_point visit_begin = Clock::now();
+		const Clock::duration visit_target = std::max(budget - (visit_begin - tick_begin) - budget / 4,
+			min_phase_budget);
 
-					ConcentricOctahedraWalker cwk(octa_area->scaled_radius);
-					while (!cwk.wrappedAround()) {
-						ChunkKey ck(pivot + scale * cwk.step(), octa_area->pivot.scale_log2);
+		// Visit keys added by ticket changes and invalidations, closest to ticket
+		// pivots first. There might be very many of them after adding a ticket
+		// but we will consume the queue in batches over the following ticks.
+		const size_t max_visits = m_key_visit_budget.plan(visit_target);
+		const Clock::time_point visit_deadline = visit_begin + 2 * visit_target;
+		size_t num_visited = 0;
 
-						if (ck.y >= Consts::MIN_WORLD_Y_CHUNK && ck.y <= Consts::MAX_WORLD_Y_CHUNK) {
-							m_keys_to_update.emplace_back(ck);
-						}
-					}
-				}
+		while (num_visited < max_visits && !m_keys_to_update.empty()) {
+			const ChunkKey key = m_keys_to_update.top().key;
+			m_keys_to_update.pop();
+
+			if (!m_ticket_key_refs.contains(key)) {
+				// Ticket was moved away or removed before we got to this key
+				continue;
 			}
 
-			// Eliminate duplicate keys from overlapping tickets
-			std::sort(m_keys_to_update.begin(), m_keys_to_update.end());
-			auto last = std::unique(m_keys_to_update.begin(), m_keys_to_update.end());
-			m_keys_to_update.erase(last, m_keys_to_update.end());
+			tickChunkKey(key, tick_id);
+			num_visited++;
+
+			// Cost estimation can be way off if the workload changes abruptly
+			if (num_visited % 64 == 0 && Clock::now() > visit_deadline) [[unlikely]] {
+				break;
+			}
 		}
 
-		// Limit the number of keys visited per tick.
-		// TODO: move to constants/options/auto-adjust?
-		constexpr size_t KEYS_PER_TICK = 500;
-		const size_t num_visited = std::min(KEYS_PER_TICK, m_keys_to_update.size());
+		const Clock::time_point cleanup_begin = Clock::now();
+		m_key_visit_budget.record(num_visited, cleanup_begin - visit_begin);
 
-		for (size_t i = 0; i < num_visited; i++) {
-			tickChunkKey(m_keys_to_update.back(), tick_id);
-			m_keys_to_update.pop_back();
-		}
+		const Clock::duration cleanup_target = std::max(budget - (cleanup_begin - tick_begin), min_phase_budget);
+		size_t num_cleanup_visited = 0;
 
 		// Try cleaning up some unused chunks
 		m_keys_lru_check_order.visitOldest(
 			[&](ChunkKey key) -> WorldTickId {
+				num_cleanup_visited++;
+
 				auto iter = m_metastate.find(key);
 				if (iter == m_metastate.end()) {
 					// Wut, key gone without our action?
 					return WorldTickId::INVALID;
 				}
 
+				if (m_ticket_key_refs.contains(key)) {
+					// Still covered by some ticket, it's never stale
+					return tick_id + STALE_CHUNK_AGE_THRESHOLD;
+				}
+
 				if (iter->second.last_referenced_tick + STALE_CHUNK_AGE_THRESHOLD > tick_id) {
 					// Not yet stale, reschedule the visit
 					return iter->second.last_referenced_tick + STALE_CHUNK_AGE_THRESHOLD;
 				}
 
+				if (hasTicketedDependents(key)) {
+					// Ticketed keys are not visited unless something changes, so their
+					// dependencies are not referenced either. Keep them while needed.
+					iter->second.last_referenced_tick = tick_id;
+					return tick_id + STALE_CHUNK_AGE_THRESHOLD;
+				}
+
 				if (iter->second.pending_task_count > 0) {
 					// Has some pending work, unsafe to remove.
 					// This will leave it pretty much at the same place - the chunk
@@ -348,19 +546,57 @@ public:
 					return tick_id + 1;
 				}
 
-				uint64_t version = static_cast<uint64_t>(tick_id.value);
-				m_land_state.chunk_table.erase(version, iter->first);
-				m_land_state.pseudo_chunk_surface_table.erase(version, iter->first);
+				if (iter->second.chunk_data_modified && m_chunk_store) {
+					// Edited chunk, write it to persistent storage before
+					// removing. This will wait for its completion as above.
+					enqueueChunkStore(iter->first, iter->second);
+					return tick_id + 1;
+				}
+
+				// Table erasure is batched after the visit
+				m_this_tick_stale_keys.emplace_back(iter->first);
 				m_metastate.erase(iter);
 
 				return WorldTickId::INVALID;
 			},
-			// TODO: move to constants/options
-			1000, tick_id);
+			m_cleanup_visit_budget.plan(cleanup_target), tick_id);
+
+		if (!m_this_tick_stale_keys.empty()) {
+			const uint64_t version = static_cast<uint64_t>(tick_id.value);
+
+			LandState::ChunkTable::sortBatch(m_this_tick_stale_keys);
+			m_land_state.chunk_table.eraseBatch(version, m_this_tick_stale_keys);
+			m_land_state.pseudo_chunk_surface_table.eraseBatch(version, m_this_tick_stale_keys);
+			m_this_tick_stale_keys.clear();
+		}
+
+		m_cleanup_visit_budget.record(num_cleanup_visited, Clock::now() - cleanup_begin);
+
+		if (tick_id.value % POOL_TRIM_PERIOD == 0) {
+			m_pseudo_chunk_data_pool.trim();
+		}
+
+		if (collect_memory_stats) {
+			collectMemoryStats(*stats_previous_state);
+		}
+
+		if (m_shared_state_publisher) {
+			// Skipped publications are caught up with the next one
+			m_shared_state_publisher->publish(tick_id, m_land_state);
+		}
 	}
 
+	const LandStateMemoryStats &currentStateMemoryStats() const noexcept { return m_current_memory_stats; }
+	const LandStateMemoryStats &previousStateMemoryStats() const noexcept { return m_previous_memory_stats; }
+
 	const LandState &landState() const noexcept { return m_land_state; }
 
+	uint32_t chunkTicketRefs(ChunkKey key) const noexcept
+	{
+		auto iter = m_ticket_key_refs.find(key);
+		return iter != m_ticket_key_refs.end() ? iter->second.refs : 0;
+	}
+
 private:
 	svc::TaskService &m_task_service;
 
@@ -368,6 +604,9 @@ private:
 	svc::MessageSender m_sender;
 
 	std::vector<TicketState> m_chunk_tickets;
+	// Keys covered by valid tickets with the number of referencing tickets.
+	// Updated incrementally when tickets are added, adjusted or removed.
+	std::unordered_map<ChunkKey, TicketKeyState> m_ticket_key_refs;
 	// Must be placed before all objects that can store pool pointers
 	// to destroy after them. In our case this is only `m_metastate`.
 	SharedObjectPool<PseudoChunkData> m_pseudo_chunk_data_pool;
@@ -375,14 +614,36 @@ private:
 	std::unordered_map<ChunkKey, ChunkMetastate> m_metastate;
 	std::vector<ChunkKey> m_this_tick_pseudo_data_invalidations;
 	std::vector<ChunkKey> m_this_tick_pseudo_surface_invalidations;
+	// Keys removed by cleanup this tick, to be erased from state tables in one batch
+	std::vector<ChunkKey> m_this_tick_stale_keys;
+	// Block edits received this tick grouped by chunk, applied as one task per chunk
+	std::unordered_map<ChunkKey, std::vector<BlockEdit>> m_this_tick_block_edits;
 
 	LruVisitOrdering<ChunkKey, WorldTickTag> m_keys_lru_check_order;
-	std::vector<ChunkKey> m_keys_to_update;
+	// Ticketed keys needing a visit (`tickChunkKey`), can contain duplicates
+	std::priority_queue<KeyVisitRequest, std::vector<KeyVisitRequest>, KeyVisitRequestCompare> m_keys_to_update;
+
+	// Target duration of `doTick()` work, see `LandService::Config`
+	const std::chrono::microseconds m_tick_work_budget;
+	// Initial values are what used to be hardcoded, adjusted after the first ticks
+	AdaptiveVisitBudget m_key_visit_budget { 16, 100'000, 500 };
+	AdaptiveVisitBudget m_cleanup_visit_budget { 16, 100'000, 1000 };
 
 	WorldTickId m_tick_id;
 	LandState m_land_state;
 
+	// Collect memory stats once in this number of ticks, zero disables it
+	const uint32_t m_memory_stats_period;
+	LandStateMemoryStats m_current_memory_stats;
+	LandStateMemoryStats m_previous_memory_stats;
+
+	const PseudoSurfaceWeldingConfig m_surface_welding;
+
 	Generator m_generator;
+	// Null if persistent storage is disabled
+	std::unique_ptr<ChunkStore> m_chunk_store;
+	// Null if shared memory publication is disabled
+	std::unique_ptr<SharedLandStatePublisher> m_shared_state_publisher;
 
 	// Dummy chunk above the world height limit; filled with empty block IDs (zeros)
 	ChunkPtr m_dummy_above_limit_chunk;
@@ -391,6 +652,22 @@ private:
 	// Dummy pseudo-data without any surface crossing
 	PseudoDataPtr m_dummy_pseudo_data_ptr;
 
+	void collectMemoryStats(const LandState &previous_state)
+	{
+		m_current_memory_stats = m_land_state.memoryStats(&previous_state);
+		m_previous_memory_stats = previous_state.memoryStats(&m_land_state);
+
+		constexpr double MIB = 1024.0 * 1024.0;
+		const auto &cur = m_current_memory_stats;
+
+		Log::info("Land state memory at tick {}: {:.2f} MiB total, {:.2f} MiB changed in the last tick, "
+			"{:.2f} MiB retained per snapshot tick; chunks: {} ({:.2f} MiB), surfaces: {} ({:.2f} MiB)",
+			m_tick_id.value, double(cur.totalBytes()) / MIB, double(cur.uniqueBytes()) / MIB,
+			double(m_previous_memory_stats.uniqueBytes()) / MIB, cur.chunk_table.value_count,
+			double(cur.chunk_table.value_bytes) / MIB, cur.pseudo_chunk_surface_table.value_count,
+			double(cur.pseudo_chunk_surface_table.value_bytes) / MIB);
+	}
+
 	ChunkMetastate &getMetastate(ChunkKey key)
 	{
 		auto [iter, inserted] = m_metastate.try_emplace(key);
@@ -405,6 +682,264 @@ private:
 		return m;
 	}
 
+	// Returns `CONTENT_*` constant for the latest chunk data of this key.
+	// Chunk data can be read safely only when no tasks are modifying it.
+	static uint32_t knownChunkContent(ChunkMetastate &m) noexcept
+	{
+		if (m.chunk_content == CONTENT_UNKNOWN && m.pending_task_count == 0 && m.latest_chunk_ptr) {
+			const Chunk::BlockIdStorage &ids = m.latest_chunk_ptr->blockIds();
+
+			if (!ids.uniform()) {
+				m.chunk_content = CONTENT_MIXED;
+			} else {
+				m.chunk_content = TempBlockMeta::isBlockEmpty(ids.load(0, 0, 0)) ? CONTENT_EMPTY : CONTENT_SOLID;
+			}
+		}
+
+		return m.chunk_content;
+	}
+
+	// Returns `CONTENT_*` constant for the latest pseudo-data of this key.
+	// Pseudo-data can be read safely only when no tasks are modifying it.
+	static uint32_t knownPseudoDataContent(ChunkMetastate &m) noexcept
+	{
+		if (m.pseudo_data_content == CONTENT_UNKNOWN && m.pending_task_count == 0 && m.latest_pseudo_data_ptr) {
+			m.pseudo_data_content = m.latest_pseudo_data_ptr->empty() ? CONTENT_EMPTY : CONTENT_MIXED;
+		}
+
+		return m.pseudo_data_content;
+	}
+
+	// Publish empty pseudo-surface without launching a task, as if it was generated
+	void setEmptyPseudoSurface(ChunkKey ck)
+	{
+		const auto *item = m_land_state.pseudo_chunk_surface_table.find(ck);
+		if (item && !item->hasValue()) {
+			// Already known to be empty, don't update the version needlessly
+			return;
+		}
+
+		m_land_state.pseudo_chunk_surface_table.insert(static_cast<uint64_t>(m_tick_id.value), ck, PseudoSurfacePtr());
+	}
+
+	// Publish empty pseudo-data without a generating task, as if it was generated
+	void setEmptyPseudoData(ChunkKey ck, ChunkMetastate &m)
+	{
+		if (m.latest_pseudo_data_ptr.get() == m_dummy_pseudo_data_ptr.get()) {
+			// Already known to be empty
+			return;
+		}
+
+		if (m.latest_pseudo_data_ptr) {
+			// Dependents were generated from non-empty data and will check if they are
+			// outdated by comparing task counters. Give this version a counter newer than
+			// theirs by enqueueing a trivial task, this is much cheaper than aggregation.
+			svc::TaskBuilder bld(m_task_service);
+			bld.addWait(m.pseudo_data_gen_task_counter);
+			bld.enqueueTask([](svc::TaskContext &) {});
+			m.pseudo_data_gen_task_counter = bld.getLastTaskCounter();
+		}
+
+		m.latest_pseudo_data_ptr = m_dummy_pseudo_data_ptr;
+		m.pseudo_data_content = CONTENT_EMPTY;
+
+		// Dependent keys don't know it's empty now
+		invalidatePseudoDataDependents(ck, m);
+	}
+
+	// Call `fn(ChunkKey, uint32_t pivot_distance)` for every key at LOD `scale_log2` within `[lo; hi)`
+	// box and vertical world bounds. Distance is Manhattan, in scaled units, to `pivot`.
+	template<typename F>
+	static void forEachBoxKey(glm::ivec3 lo, glm::ivec3 hi, uint32_t scale_log2, glm::ivec3 pivot, F &&fn)
+	{
+		const int32_t step = 1 << scale_log2;
+
+		// Limit to vertical world bounds
+		const int64_t lo_y = std::max<int64_t>(lo.y, Consts::MIN_WORLD_Y_CHUNK);
+		const int64_t hi_y = std::min<int64_t>(hi.y, Consts::MAX_WORLD_Y_CHUNK);
+
+		for (int64_t y = lo_y; y < hi_y; y += step) {
+			for (int64_t x = lo.x; x < hi.x; x += step) {
+				for (int64_t z = lo.z; z < hi.z; z += step) {
+					ChunkKey ck(x, y, z, scale_log2);
+					glm::ivec3 offset = glm::abs(ck.base() - pivot);
+					fn(ck, static_cast<uint32_t>(offset.x + offset.y + offset.z) >> scale_log2);
+				}
+			}
+		}
+	}
+
+	// Call `fn(ChunkKey, uint32_t pivot_distance)` for every key of the area within vertical
+	// world bounds. Distance is Manhattan, in scaled units, box center is considered its pivot.
+	template<typename F>
+	static void forEachTicketAreaKey(const ChunkTicketArea &area, F &&fn)
+	{
+		if (const auto *box_area = std::get_if<ChunkTicketBoxArea>(&area); box_area != nullptr) {
+			const glm::ivec3 lo = box_area->begin.base();
+			const glm::ivec3 hi = box_area->end.base();
+			forEachBoxKey(lo, hi, box_area->begin.scale_log2, (lo + hi) / 2, fn);
+			return;
+		}
+
+		const auto *octa_area = std::get_if<ChunkTicketOctahedronArea>(&area);
+		// It can be either box or octahedron
+		assert(octa_area != nullptr);
+
+		const glm::ivec3 pivot = octa_area->pivot.base();
+		const int32_t scale = octa_area->pivot.scaleMultiplier();
+
+		ConcentricOctahedraWalker cwk(octa_area->scaled_radius);
+		while (!cwk.wrappedAround()) {
+			const glm::ivec3 step = cwk.step();
+			ChunkKey ck(pivot + scale * step, octa_area->pivot.scale_log2);
+
+			if (ck.y >= Consts::MIN_WORLD_Y_CHUNK && ck.y <= Consts::MAX_WORLD_Y_CHUNK) {
+				const glm::ivec3 offset = glm::abs(step);
+				fn(ck, static_cast<uint32_t>(offset.x + offset.y + offset.z));
+			}
+		}
+	}
+
+	// Call `fn(ChunkKey, uint32_t pivot_distance)` for every key of box area `a` not covered
+	// by box area `b` at the same LOD, see `forEachTicketAreaKey()`. The difference is split
+	// into up to six non-overlapping slabs around the intersection, which is not visited.
+	template<typename F>
+	static void forEachBoxDifferenceKey(const ChunkTicketBoxArea &a, const ChunkTicketBoxArea &b, F &&fn)
+	{
+		assert(a.begin.scale_log2 == b.begin.scale_log2);
+
+		const uint32_t scale_log2 = a.begin.scale_log2;
+		const glm::ivec3 a_lo = a.begin.base();
+		const glm::ivec3 a_hi = a.end.base();
+		const glm::ivec3 pivot = (a_lo + a_hi) / 2;
+
+		// Valid keys at the same LOD are aligned, so the intersection is on the grid of both
+		const glm::ivec3 i_lo = glm::max(a_lo, b.begin.base());
+		const glm::ivec3 i_hi = glm::min(a_hi, b.end.base());
+
+		if (glm::any(glm::greaterThanEqual(i_lo, i_hi))) {
+			// No intersection
+			forEachBoxKey(a_lo, a_hi, scale_log2, pivot, fn);
+			return;
+		}
+
+		glm::ivec3 lo = a_lo;
+		glm::ivec3 hi = a_hi;
+
+		for (glm::length_t axis = 0; axis < 3; axis++) {
+			// Slabs before and after the intersection along this axis
+			glm::ivec3 slab_hi = hi;
+			slab_hi[axis] = i_lo[axis];
+			forEachBoxKey(lo, slab_hi, scale_log2, pivot, fn);
+
+			glm::ivec3 slab_lo = lo;
+			slab_lo[axis] = i_hi[axis];
+			forEachBoxKey(slab_lo, hi, scale_log2, pivot, fn);
+
+			// Slabs along the next axes are within the intersection along this one
+			lo[axis] = i_lo[axis];
+			hi[axis] = i_hi[axis];
+		}
+	}
+
+	void addTicketKeyRef(ChunkKey key, uint32_t pivot_distance)
+	{
+		TicketKeyState &state = m_ticket_key_refs[key];
+		state.pivot_distance = pivot_distance;
+
+		if (state.refs++ == 0) {
+			// Newly covered key, needs a visit
+			m_keys_to_update.push(KeyVisitRequest { pivot_distance, key });
+		}
+	}
+
+	void removeTicketKeyRef(ChunkKey key)
+	{
+		auto iter = m_ticket_key_refs.find(key);
+		assert(iter != m_ticket_key_refs.end());
+
+		if (--iter->second.refs > 0) {
+			return;
+		}
+
+		m_ticket_key_refs.erase(iter);
+
+		// Not covered anymore, start counting its stale age from now
+		if (auto meta_iter = m_metastate.find(key); meta_iter != m_metastate.end()) {
+			meta_iter->second.last_referenced_tick = m_tick_id;
+		}
+	}
+
+	void addTicketKeyRefs(const ChunkTicketArea &area)
+	{
+		forEachTicketAreaKey(area,
+			[this](ChunkKey key, uint32_t pivot_distance) { addTicketKeyRef(key, pivot_distance); });
+	}
+
+	void removeTicketKeyRefs(const ChunkTicketArea &area)
+	{
+		forEachTicketAreaKey(area, [this](ChunkKey key, uint32_t /*pivot_distance*/) { removeTicketKeyRef(key); });
+	}
+
+	// Check if any ticketed key directly uses data of this key to generate its own,
+	// i.e. it is a dependency of their surface or pseudo-data (see `enqueue*Gen`)
+	bool hasTicketedDependents(ChunkKey key) const
+	{
+		const glm::ivec3 B = key.base();
+		const int32_t S = key.scaleMultiplier();
+		const uint32_t lod = key.scaleLog2();
+		// LOD0 surfaces use 6 face-adjacent chunks, pseudo-chunk ones add 12 edge-adjacent
+		const int max_nonzero_offsets = lod == 0 ? 1 : 2;
+
+		for (int32_t y = -1; y <= 1; y++) {
+			for (int32_t x = -1; x <= 1; x++) {
+				for (int32_t z = -1; z <= 1; z++) {
+					const int nonzero_offsets = int(x != 0) + int(y != 0) + int(z != 0);
+					if (nonzero_offsets == 0 || nonzero_offsets > max_nonzero_offsets) {
+						continue;
+					}
+
+					if (m_ticket_key_refs.contains(ChunkKey(B + glm::ivec3(x, y, z) * S, lod))) {
+						return true;
+					}
+				}
+			}
+		}
+
+		if (lod + 1 >= Consts::NUM_LOD_SCALES) {
+			return false;
+		}
+
+		if (lod > 0) {
+			// Aggregated from 8 children only
+			return m_ticket_key_refs.contains(key.parentLodKey());
+		}
+
+		// LOD1 pseudo-data collects 3x3x3 chunks starting from its base, so every
+		// chunk has one or two such LOD1 keys along each axis (two if it's even)
+		const glm::ivec3 P = key.parentLodKey().base();
+		for (int32_t y = P.y; y >= B.y - 2; y -= 2) {
+			for (int32_t x = P.x; x >= B.x - 2; x -= 2) {
+				for (int32_t z = P.z; z >= B.z - 2; z -= 2) {
+					if (m_ticket_key_refs.contains(ChunkKey(glm::ivec3(x, y, z), 1))) {
+						return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	// Schedule a visit for this key if it is covered by some ticket.
+	// Others are updated only when referenced by ticketed keys.
+	void enqueueTicketedKeyUpdate(ChunkKey key)
+	{
+		if (auto iter = m_ticket_key_refs.find(key); iter != m_ticket_key_refs.end()) {
+			m_keys_to_update.push(KeyVisitRequest { iter->second.pivot_distance, key });
+		}
+	}
+
 	void tickChunkKey(ChunkKey ck, WorldTickId tick_id)
 	{
 		auto [iter, inserted] = m_metastate.try_emplace(ck);
@@ -418,6 +953,11 @@ private:
 
 		if (ck.scale_log2 == 0) {
 			enqueueChunkDataGen(ck, m);
+		} else {
+			// Surface gen does it too, but only if the surface itself is invalidated.
+			// Edits of child chunks invalidate only pseudo-data, its regeneration
+			// will then invalidate the surface if anything has changed.
+			enqueuePseudoDataGen(ck, m);
 		}
 
 		enqueuePseudoSurfaceGen(ck, m);
@@ -435,10 +975,7 @@ private:
 		bld.addWait(m.pseudo_surface_gen_task_counter);
 
 		if (ck.scale_log2 == 0) {
-			// LOD0 (true) chunk - generate from it + 6 adjacent.
-			// TODO: optimize for case when all chunks are known to be
-			// empty and will not produce any pseudo data. To know that
-			// in advance there must be no pending gen tasks on them.
+			// LOD0 (true) chunk - generate from it + 6 adjacent
 			std::array<ChunkPtr, 7> dependencies;
 			uint64_t wait_counters[7] = {};
 			bool outdated = false;
@@ -448,9 +985,15 @@ private:
 			wait_counters[0] = m.chunk_gen_task_counter;
 			outdated = m.chunk_gen_task_counter >= m.pseudo_surface_gen_task_counter;
 
+			const uint32_t content = knownChunkContent(m);
+			// Surface is empty if this chunk is empty or it's solid and fully enclosed
+			const bool known_empty = content == CONTENT_EMPTY;
+			bool known_enclosed = content == CONTENT_SOLID;
+
 			auto collect_dependency = [&](ChunkKey dk, size_t index) {
 				if (dk.y > Consts::MAX_WORLD_Y_CHUNK) [[unlikely]] {
 					dependencies[index] = m_dummy_above_limit_chunk;
+					known_enclosed = false;
 					return;
 				}
 
@@ -461,6 +1004,7 @@ private:
 
 				ChunkMetastate &mm = getMetastate(dk);
 				enqueueChunkDataGen(dk, mm);
+				known_enclosed = known_enclosed && knownChunkContent(mm) == CONTENT_SOLID;
 
 				if (m.pseudo_surface_gen_task_counter <= mm.chunk_gen_task_counter) {
 					outdated = true;
@@ -483,15 +1027,19 @@ private:
 				return;
 			}
 
+			if ((known_empty || known_enclosed) && m.pending_task_count == 0) {
+				// No need to launch a task. Pending tasks of this key
+				// could overwrite our result so wait for them otherwise.
+				setEmptyPseudoSurface(ck);
+				return;
+			}
+
 			bld.addWait(wait_counters);
 			bld.enqueueTask([ck, deps = std::move(dependencies), snd = &m_sender](svc::TaskContext &) {
 				generatePseudoChunkSurface(ck, std::move(deps), snd);
 			});
 		} else {
-			// Pseudo-chunk - generate from it + 18 adjacent.
-			// TODO: optimize for case when all chunks are known to be
-			// empty and will not produce any pseudo data. To know that
-			// in advance there must be no pending gen tasks on them.
+			// Pseudo-chunk - generate from it + 18 adjacent
 			std::array<PseudoDataPtr, 19> dependencies;
 			uint64_t wait_counters[19] = {};
 			bool outdated = false;
@@ -501,6 +1049,9 @@ private:
 			wait_counters[0] = m.pseudo_data_gen_task_counter;
 			outdated = m.pseudo_data_gen_task_counter >= m.pseudo_surface_gen_task_counter;
 
+			// Surface is empty if all pseudo-data has no cells
+			bool known_empty = knownPseudoDataContent(m) == CONTENT_EMPTY;
+
 			auto collect_dependency = [&](ChunkKey dk, size_t index) {
 				if (dk.y < Consts::MIN_WORLD_Y_CHUNK || dk.y > Consts::MAX_WORLD_Y_CHUNK) [[unlikely]] {
 					dependencies[index] = m_dummy_pseudo_data_ptr;
@@ -509,6 +1060,7 @@ private:
 
 				ChunkMetastate &mm = getMetastate(dk);
 				enqueuePseudoDataGen(dk, mm);
+				known_empty = known_empty && knownPseudoDataContent(mm) == CONTENT_EMPTY;
 
 				if (m.pseudo_surface_gen_task_counter <= mm.pseudo_data_gen_task_counter) {
 					outdated = true;
@@ -548,10 +1100,17 @@ private:
 				return;
 			}
 
+			if (known_empty && m.pending_task_count == 0) {
+				// No need to launch a task, see the comment above
+				setEmptyPseudoSurface(ck);
+				return;
+			}
+
 			bld.addWait(wait_counters);
-			bld.enqueueTask([ck, deps = std::move(dependencies), snd = &m_sender](svc::TaskContext &) {
-				generatePseudoChunkSurface(ck, std::move(deps), snd);
-			});
+			bld.enqueueTask(
+				[ck, deps = std::move(dependencies), welding = m_surface_welding, snd = &m_sender](svc::TaskContext &) {
+					generatePseudoChunkSurface(ck, std::move(deps), welding, snd);
+				});
 		}
 
 		m.pending_task_count++;
@@ -576,26 +1135,29 @@ private:
 
 		if (ck.scale_log2 == 1) {
 			// LOD1 - collect chunk data from 27 LOD0 chunks
-			// TODO: optimize for case when all chunks are known to be
-			// empty and will not produce any pseudo data. To know that
-			// in advance there must be no pending gen tasks on them.
 			std::array<ChunkPtr, 27> dependencies;
 			uint64_t wait_counters[27] = {};
 			bool outdated = false;
 
+			// Pseudo-data is empty if all chunks are either empty or solid
+			uint32_t content_mask = 0;
+
 			auto collect_dependency = [&](ChunkKey dk, size_t index) {
 				if (dk.y > Consts::MAX_WORLD_Y_CHUNK) [[unlikely]] {
 					dependencies[index] = m_dummy_above_limit_chunk;
+					content_mask |= 1u << CONTENT_EMPTY;
 					return;
 				}
 
 				if (dk.y < Consts::MIN_WORLD_Y_CHUNK) [[unlikely]] {
 					dependencies[index] = m_dummy_below_limit_chunk;
+					content_mask |= 1u << CONTENT_SOLID;
 					return;
 				}
 
 				ChunkMetastate &mm = getMetastate(dk);
 				enqueueChunkDataGen(dk, mm);
+				content_mask |= 1u << knownChunkContent(mm);
 
 				if (m.pseudo_data_gen_task_counter <= mm.chunk_gen_task_counter) {
 					outdated = true;
@@ -644,13 +1206,23 @@ private:
 				return;
 			}
 
-			m.latest_pseudo_data_ptr = m_pseudo_chunk_data_pool.allocate(ck);
+			if ((content_mask == 1u << CONTENT_EMPTY || content_mask == 1u << CONTENT_SOLID)
+				&& m.pending_task_count == 0) {
+				// No need to launch a task. Pending tasks of this key
+				// could overwrite our result so wait for them otherwise.
+				setEmptyPseudoData(ck, m);
+				return;
+			}
+
+			// Previous version is kept to check if the result has changed
+			PseudoDataPtr prev_ptr = std::exchange(m.latest_pseudo_data_ptr, m_pseudo_chunk_data_pool.allocate(ck));
+			m.pseudo_data_content = CONTENT_UNKNOWN;
 
 			bld.addWait(wait_counters);
-			bld.enqueueTask(
-				[ck, deps = std::move(dependencies), snd = &m_sender, ptr = m.latest_pseudo_data_ptr](svc::TaskContext &) {
-					aggregatePseudoChunkData(ck, std::move(deps), snd, std::move(ptr));
-				});
+			bld.enqueueTask([ck, deps = std::move(dependencies), snd = &m_sender, prev = std::move(prev_ptr),
+								ptr = m.latest_pseudo_data_ptr](svc::TaskContext &) {
+				aggregatePseudoChunkData(ck, std::move(deps), snd, std::move(prev), std::move(ptr));
+			});
 		} else if (ck.scale_log2 <= Consts::MAX_GENERATABLE_LOD && m.is_virgin) {
 			if (m.latest_pseudo_data_ptr) {
 				// Virgin pseudo-chunks can't be outdated
@@ -658,6 +1230,7 @@ private:
 			}
 
 			m.latest_pseudo_data_ptr = m_pseudo_chunk_data_pool.allocate(ck);
+			m.pseudo_data_content = CONTENT_UNKNOWN;
 
 			// Direct gen of "virgin" chunk - enqueue an independent task
 			bld.addWait(m_generator.prepareKeyGeneration(ck, bld));
@@ -667,13 +1240,13 @@ private:
 			});
 		} else {
 			// Aggregation gen - collect chunk data from 8 "children" chunks
-			// TODO: optimize for case when all pseudochunks are known to be
-			// empty and aggregation will not produce any data. To know that
-			// in advance there must be no pending gen tasks on them.
 			std::array<PseudoDataPtr, 8> dependencies;
 			uint64_t wait_counters[8] = {};
 			bool outdated = false;
 
+			// Aggregation of empty pseudo-data is empty too
+			bool known_empty = true;
+
 			auto collect_dependency = [&](ChunkKey dk, size_t index) {
 				if (dk.y < Consts::MIN_WORLD_Y_CHUNK || dk.y > Consts::MAX_WORLD_Y_CHUNK) [[unlikely]] {
 					// Out of world height bounds
@@ -683,6 +1256,7 @@ private:
 
 				ChunkMetastate &mm = getMetastate(dk);
 				enqueuePseudoDataGen(dk, mm);
+				known_empty = known_empty && knownPseudoDataContent(mm) == CONTENT_EMPTY;
 
 				if (m.pseudo_data_gen_task_counter <= mm.pseudo_data_gen_task_counter) {
 					outdated = true;
@@ -709,13 +1283,21 @@ private:
 				return;
 			}
 
-			m.latest_pseudo_data_ptr = m_pseudo_chunk_data_pool.allocate(ck);
+			if (known_empty && m.pending_task_count == 0) {
+				// No need to launch a task, see the comment above
+				setEmptyPseudoData(ck, m);
+				return;
+			}
+
+			// Previous version is kept to check if the result has changed
+			PseudoDataPtr prev_ptr = std::exchange(m.latest_pseudo_data_ptr, m_pseudo_chunk_data_pool.allocate(ck));
+			m.pseudo_data_content = CONTENT_UNKNOWN;
 
 			bld.addWait(wait_counters);
-			bld.enqueueTask(
-				[ck, deps = std::move(dependencies), snd = &m_sender, ptr = m.latest_pseudo_data_ptr](svc::TaskContext &) {
-					aggregatePseudoChunkData(ck, std::move(deps), snd, std::move(ptr));
-				});
+			bld.enqueueTask([ck, deps = std::move(dependencies), snd = &m_sender, prev = std::move(prev_ptr),
+								ptr = m.latest_pseudo_data_ptr](svc::TaskContext &) {
+				aggregatePseudoChunkData(ck, std::move(deps), snd, std::move(prev), std::move(ptr));
+			});
 		}
 
 		m.pending_task_count++;
@@ -738,15 +1320,40 @@ private:
 		}
 
 		m.latest_chunk_ptr = LandState::ChunkTable::makeValuePtr();
+		m.chunk_content = CONTENT_UNKNOWN;
 
 		svc::TaskBuilder bld(m_task_service);
 		// This will ensure successive chunk gen tasks complete in order
 		bld.addWait(m.chunk_gen_task_counter);
-		bld.addWait(m_generator.prepareKeyGeneration(ck, bld));
-		bld.enqueueTask([ck, gen = &m_generator, snd = &m_sender, ptr = m.latest_chunk_ptr](svc::TaskContext &) {
-			gen->generateChunk(ck, *ptr);
-			snd->send<detail::ChunkLoadCompletionMessage>(LandService::SERVICE_UID, ck, std::move(ptr));
-		});
+
+		if (m_chunk_store) {
+			// Try loading from persistent storage first, it's much cheaper than
+			// generating. Generation resources will be awaited only if needed.
+			uint64_t gen_prepare_counter = m_generator.prepareKeyGeneration(ck, bld);
+			bld.enqueueTask(
+				loadChunk(ck, m_chunk_store.get(), &m_generator, gen_prepare_counter, &m_sender, m.latest_chunk_ptr));
+		} else {
+			bld.addWait(m_generator.prepareKeyGeneration(ck, bld));
+			bld.enqueueTask([ck, gen = &m_generator, snd = &m_sender, ptr = m.latest_chunk_ptr](svc::TaskContext &) {
+				gen->generateChunk(ck, *ptr);
+				snd->send<detail::ChunkLoadCompletionMessage>(LandService::SERVICE_UID, ck, std::move(ptr));
+			});
+		}
+
+		m.pending_task_count++;
+		m.chunk_gen_task_counter = bld.getLastTaskCounter();
+	}
+
+	void enqueueChunkStore(ChunkKey ck, ChunkMetastate &m)
+	{
+		assert(m_chunk_store);
+		m.chunk_data_modified = 0;
+
+		svc::TaskBuilder bld(m_task_service);
+		// Wait for the last edit to complete. Following edits will wait
+		// for this task in turn, so the chunk is not modified while storing.
+		bld.addWait(m.chunk_gen_task_counter);
+		bld.enqueueTask(storeChunk(ck, m_chunk_store.get(), &m_sender, m.latest_chunk_ptr));
 
 		m.pending_task_count++;
 		m.chunk_gen_task_counter = bld.getLastTaskCounter();
@@ -761,6 +1368,8 @@ private:
 			return;
 		}
 
+		addTicketKeyRefs(msg.area);
+
 		for (uint64_t ticket_id = 0; ticket_id < m_chunk_tickets.size(); ticket_id++) {
 			if (!m_chunk_tickets[ticket_id].valid) {
 				m_chunk_tickets[ticket_id].area = msg.area;
@@ -783,13 +1392,34 @@ private:
 		}
 
 		assert(msg.ticket_id < m_chunk_tickets.size());
-		m_chunk_tickets[msg.ticket_id].area = msg.new_area;
+		TicketState &state = m_chunk_tickets[msg.ticket_id];
+
+		const auto *old_box = std::get_if<ChunkTicketBoxArea>(&state.area);
+		const auto *new_box = std::get_if<ChunkTicketBoxArea>(&msg.new_area);
+
+		if (old_box && new_box && old_box->begin.scale_log2 == new_box->begin.scale_log2) {
+			// Moving box (the common case) changes only a few slabs of keys, keys
+			// covered by both boxes keep their refs and previous visit priority
+			forEachBoxDifferenceKey(*new_box, *old_box,
+				[this](ChunkKey key, uint32_t pivot_distance) { addTicketKeyRef(key, pivot_distance); });
+			forEachBoxDifferenceKey(*old_box, *new_box,
+				[this](ChunkKey key, uint32_t /*pivot_distance*/) { removeTicketKeyRef(key); });
+		} else {
+			// Add first so keys covered by both areas don't drop to zero refs
+			addTicketKeyRefs(msg.new_area);
+			removeTicketKeyRefs(state.area);
+		}
+
+		state.area = msg.new_area;
 	}
 
 	void handleChunkTicketRemove(const ChunkTicketRemoveMessage &msg)
 	{
 		assert(msg.ticket_id < m_chunk_tickets.size());
-		m_chunk_tickets[msg.ticket_id].valid = false;
+		TicketState &state = m_chunk_tickets[msg.ticket_id];
+
+		removeTicketKeyRefs(state.area);
+		state.valid = false;
 	}
 
 	void handleBlockEditMessage(const BlockEditMessage &msg)
@@ -797,24 +1427,35 @@ private:
 		glm::ivec3 chunk_lowest_block = msg.position & ~(Consts::CHUNK_SIZE_BLOCKS - 1);
 		ChunkKey chunk_key(chunk_lowest_block / Consts::CHUNK_SIZE_BLOCKS, 0);
 
-		ChunkMetastate &m = getMetastate(chunk_key);
-		enqueueChunkDataGen(chunk_key, m);
+		// Coalesce edits, bulk building can send lots of them per chunk
+		m_this_tick_block_edits[chunk_key].emplace_back(msg.position - chunk_lowest_block, msg.new_id);
+	}
 
-		glm::ivec3 edit_position = msg.position - chunk_lowest_block;
+	// Launch edit tasks for block edits collected from messages
+	void enqueueBlockEdits()
+	{
+		for (auto &[chunk_key, edits] : m_this_tick_block_edits) {
+			ChunkMetastate &m = getMetastate(chunk_key);
+			enqueueChunkDataGen(chunk_key, m);
 
-		svc::TaskBuilder bld(m_task_service);
-		// This will ensure successive chunk gen/edit tasks complete in order
-		bld.addWait(m.chunk_gen_task_counter);
-		bld.enqueueTask(
-			[chunk_key, position = edit_position, new_block = msg.new_id, snd = &m_sender, ptr = m.latest_chunk_ptr](
-				svc::TaskContext &) { editBlock(chunk_key, std::move(ptr), position, new_block, snd); });
+			svc::TaskBuilder bld(m_task_service);
+			// This will ensure successive chunk gen/edit tasks complete in order
+			bld.addWait(m.chunk_gen_task_counter);
+			bld.enqueueTask(
+				[ck = chunk_key, batch = std::move(edits), snd = &m_sender, ptr = m.latest_chunk_ptr](
+					svc::TaskContext &) mutable { editBlocks(ck, std::move(ptr), std::move(batch), snd); });
 
-		m.pending_task_count++;
-		m.chunk_gen_task_counter = bld.getLastTaskCounter();
+			m.pending_task_count++;
+			m.pending_edit_count++;
+			m.chunk_gen_task_counter = bld.getLastTaskCounter();
+			// Might change, don't let dependents rely on the cached content
+			m.chunk_content = CONTENT_UNKNOWN;
 
-		// Immediately re-enqueue surface gen to lower display latency
-		m.pseudo_surface_invalidated = 1;
-		enqueuePseudoSurfaceGen(chunk_key, m);
+			// Everything else is invalidated after the edit is done,
+			// only if it turns out to change anything at all
+		}
+
+		m_this_tick_block_edits.clear();
 	}
 
 	void handleChunkLoadCompletion(ChunkLoadCompletionMessage &msg)
@@ -823,9 +1464,6 @@ private:
 		m.pending_task_count--;
 		m_land_state.chunk_table.insert(static_cast<uint64_t>(m_tick_id.value), msg.key, std::move(msg.value_ptr));
 
-		// XXX: for chunk modifications (not full data gen) trim the potentially
-		// affected data set. E.g. no need to rebuild adjacent chunks' geometries
-		// if only internal (not border) blocks were changed. Similar with pseudo-data.
 		const glm::ivec3 base = msg.key.base();
 
 		// Invalidate geometry of this and adjacent 6 chunks
@@ -848,19 +1486,88 @@ private:
 		m_this_tick_pseudo_data_invalidations.emplace_back(ChunkKey(base - glm::ivec3(1, 1, 1)).parentLodKey());
 	}
 
+	void handleChunkEditCompletion(const ChunkEditCompletionMessage &msg)
+	{
+		ChunkMetastate &m = m_metastate[msg.key];
+		m.pending_task_count--;
+		m.pending_edit_count--;
+
+		if (glm::any(glm::greaterThanEqual(msg.dirty_begin, msg.dirty_end))) {
+			// No blocks were actually changed
+			return;
+		}
+
+		// Chunk was modified in place, re-insert to update its version
+		m_land_state.chunk_table.insert(static_cast<uint64_t>(m_tick_id.value), msg.key, m.latest_chunk_ptr);
+		m.chunk_data_modified = 1;
+
+		// Immediately re-enqueue surface gen of this chunk to lower display latency.
+		// Others depend only on blocks at the border layers facing them.
+		m.pseudo_surface_invalidated = 1;
+		enqueuePseudoSurfaceGen(msg.key, m);
+
+		const glm::ivec3 base = msg.key.base();
+		const glm::bvec3 lower_border = glm::equal(msg.dirty_begin, glm::ivec3(0));
+		const glm::bvec3 upper_border = glm::equal(msg.dirty_end, glm::ivec3(Consts::CHUNK_SIZE_BLOCKS));
+
+		for (glm::length_t axis = 0; axis < 3; axis++) {
+			glm::ivec3 offset(0);
+			offset[axis] = 1;
+
+			if (upper_border[axis]) {
+				m_this_tick_pseudo_surface_invalidations.emplace_back(ChunkKey(base + offset));
+			}
+
+			if (lower_border[axis]) {
+				m_this_tick_pseudo_surface_invalidations.emplace_back(ChunkKey(base - offset));
+			}
+		}
+
+		// Pseudo-data of the parent is always affected. Parents of 7 other chunks
+		// in "tail" direction take only the lower border layers of this chunk.
+		for (int32_t i = 0; i < 8; i++) {
+			const glm::ivec3 offset((i >> 1) & 1, (i >> 2) & 1, i & 1);
+
+			if (glm::any(glm::greaterThan(offset, glm::ivec3(lower_border)))) {
+				// Offset along some axis where lower border is not changed
+				continue;
+			}
+
+			m_this_tick_pseudo_data_invalidations.emplace_back(ChunkKey(base - offset).parentLodKey());
+		}
+	}
+
+	void handleChunkStoreCompletion(const ChunkStoreCompletionMessage &msg)
+	{
+		ChunkMetastate &m = m_metastate[msg.key];
+		m.pending_task_count--;
+	}
+
 	void handlePseudoDataGenCompletion(PseudoChunkDataGenCompletionMessage &msg)
 	{
 		ChunkMetastate &m = m_metastate[msg.key];
 		m.pending_task_count--;
 
+		if (!msg.changed) {
+			// Same cells as before, no need to regenerate anything
+			return;
+		}
+
+		invalidatePseudoDataDependents(msg.key, m);
+	}
+
+	// Invalidate everything generated from pseudo-data of `key` after it has changed
+	void invalidatePseudoDataDependents(ChunkKey key, ChunkMetastate &m)
+	{
 		// XXX: this might be quite hard to track, but invalidating adjacent chunks
 		// pseudo-surfaces is only needed if border cell entries were changed.
-		const glm::ivec3 base = msg.key.base();
-		const int32_t S = msg.key.scaleMultiplier();
-		const uint32_t lod = msg.key.scaleLog2();
+		const glm::ivec3 base = key.base();
+		const int32_t S = key.scaleMultiplier();
+		const uint32_t lod = key.scaleLog2();
 
 		// Invalidate pseudo-surface geometry of this and adjacent 18 chunks
 		m.pseudo_surface_invalidated = 1;
+		enqueueTicketedKeyUpdate(key);
 		m_this_tick_pseudo_surface_invalidations.emplace_back(ChunkKey(base + glm::ivec3(S, 0, 0), lod));
 		m_this_tick_pseudo_surface_invalidations.emplace_back(ChunkKey(base - glm::ivec3(S, 0, 0), lod));
 		m_this_tick_pseudo_surface_invalidations.emplace_back(ChunkKey(base + glm::ivec3(0, S, 0), lod));
@@ -884,7 +1591,7 @@ private:
 		m_this_tick_pseudo_surface_invalidations.emplace_back(ChunkKey(base + glm::ivec3(-S, -S, 0), lod));
 
 		// Invalidate pseudo-data of the parent chunk (force reaggregation)
-		m_this_tick_pseudo_data_invalidations.emplace_back(msg.key.parentLodKey());
+		m_this_tick_pseudo_data_invalidations.emplace_back(key.parentLodKey());
 	}
 
 	void handlePseudoSurfaceGenCompletion(PseudoChunkSurfaceGenCompletionMessage &msg)
@@ -958,7 +1665,7 @@ private:
 	}
 };
 
-LandService::LandService(svc::ServiceLocator &svc) : m_impl(svc) {}
+LandService::LandService(svc::ServiceLocator &svc, Config cfg) : m_impl(svc, std::move(cfg)) {}
 
 LandService::~LandService() = default;
 
@@ -972,4 +1679,19 @@ const LandState &LandService::stateForCopy() const noexcept
 	return m_impl->landState();
 }
 
+const LandStateMemoryStats &LandService::currentStateMemoryStats() const noexcept
+{
+	return m_impl->currentStateMemoryStats();
+}
+
+const LandStateMemoryStats &LandService::previousStateMemoryStats() const noexcept
+{
+	return m_impl->previousStateMemoryStats();
+}
+
+uint32_t LandService::chunkTicketRefs(ChunkKey key) const noexcept
+{
+	return m_impl->chunkTicketRefs(key);
+}
+
 } // namespace voxen::land
@@ -0,0 +1,844 @@
+#include <voxen/land/land_shared_state.hpp>
+
+#include <voxen/land/land_state.hpp>
+#include <voxen/os/process.hpp>
+#include <voxen/util/hash.hpp>
+#include <voxen/util/error_condition.hpp>
+#include <voxen/util/exception.hpp>
+#include <voxen/util/log.hpp>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <signal.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#else
+	#define NOMINMAX
+	#include <Windows.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace voxen::land
+{
+
+namespace
+{
+
+// Shared memory layout, everything in native byte order:
+// - Header region (`SharedHeader` padded to `HEADER_REGION_SIZE`), mapped read-write by readers
+// - Data region, mapped read-only by readers:
+//   - Two index buffers, `index_capacity` entries each
+//   - Chunk blob arena, `arena_size` bytes
+
+constexpr uint64_t LAYOUT_MAGIC = 0x31'45'54'41'54'53'44'4C; // "LDSTATE1"
+constexpr uint32_t LAYOUT_VERSION = 1;
+// Allocation granularity on Windows, data region view offset must be aligned to it
+constexpr size_t HEADER_REGION_SIZE = 64 * 1024;
+constexpr uint32_t MAX_READERS = 64;
+constexpr uint32_t NUM_BUFFERS = 2;
+
+// Blob arena allocation classes, sizes go in quarter steps between powers of two
+constexpr uint32_t MIN_BLOB_SIZE_LOG2 = 6;
+constexpr uint32_t MIN_BLOB_SIZE = 1u << MIN_BLOB_SIZE_LOG2;
+
+static_assert(std::atomic_uint64_t::is_always_lock_free, "Shared memory needs address-free atomics");
+
+struct IndexEntry {
+	// `ChunkKey::packed()`
+	uint64_t key;
+	// Offset from the arena start
+	uint64_t blob_offset;
+	// Zero marks an empty slot
+	uint32_t blob_size;
+	uint32_t _unused;
+	uint64_t version;
+};
+
+struct BufferHeader {
+	uint64_t generation;
+	int64_t tick_id;
+	uint64_t num_entries;
+	uint64_t _unused;
+};
+
+struct ReaderSlot {
+	// Process ID of the slot owner, zero if free
+	std::atomic_uint64_t owner_pid;
+	// Generation pinned by `SharedLandStateView::Snapshot`, zero if none
+	std::atomic_uint64_t pinned_generation;
+};
+
+struct SharedHeader {
+	uint64_t magic;
+	uint32_t layout_version;
+	uint32_t max_readers;
+	uint64_t total_size;
+	// Entries in one index buffer, power of two
+	uint64_t index_capacity;
+	uint64_t arena_size;
+	// Offsets from the data region start
+	uint64_t index_offset[NUM_BUFFERS];
+	uint64_t arena_offset;
+
+	// Publication counter, buffer `generation % NUM_BUFFERS` is active.
+	// Zero means nothing was published yet.
+	std::atomic_uint64_t active_generation;
+	// Process ID of the publisher, zero after it was destroyed
+	std::atomic_uint64_t publisher_pid;
+
+	BufferHeader buffers[NUM_BUFFERS];
+	ReaderSlot readers[MAX_READERS];
+};
+
+static_assert(sizeof(SharedHeader) <= HEADER_REGION_SIZE);
+
+uint32_t blobSizeClass(size_t size) noexcept
+{
+	if (size <= MIN_BLOB_SIZE) {
+		return 0;
+	}
+
+	// 2^log2 < size <= 2^(log2+1)
+	const auto log2 = uint32_t(std::bit_width(size - 1) - 1);
+	const size_t quarter = size_t(1) << (log2 - 2);
+	const auto sub = uint32_t((size - (size_t(1) << log2) + quarter - 1) / quarter);
+	return (log2 - MIN_BLOB_SIZE_LOG2) * 4 + sub;
+}
+
+size_t blobClassSize(uint32_t size_class) noexcept
+{
+	if (size_class == 0) {
+		return MIN_BLOB_SIZE;
+	}
+
+	const uint32_t log2 = MIN_BLOB_SIZE_LOG2 + (size_class - 1) / 4;
+	const uint32_t sub = (size_class - 1) % 4 + 1;
+	return (size_t(1) << log2) + sub * (size_t(1) << (log2 - 2));
+}
+
+uint64_t currentPid() noexcept
+{
+	return static_cast<uint64_t>(os::Process::getProcessId());
+}
+
+// Conservative: returns true when unsure
+bool processAlive(uint64_t pid) noexcept
+{
+#ifndef _WIN32
+	return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#else
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+	if (!process) {
+		return GetLastError() != ERROR_INVALID_PARAMETER;
+	}
+
+	const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	CloseHandle(process);
+	return alive;
+#endif
+}
+
+[[noreturn]] void throwSystemError(const char *details)
+{
+#ifndef _WIN32
+	throw Exception::fromErrorCode({ errno, std::system_category() }, details);
+#else
+	throw Exception::fromErrorCode({ static_cast<int>(GetLastError()), std::system_category() }, details);
+#endif
+}
+
+// Mapped views of a shared memory object
+class SharedMapping {
+public:
+	SharedMapping() = default;
+	SharedMapping(SharedMapping &&other) noexcept { *this = std::move(other); }
+	SharedMapping(const SharedMapping &) = delete;
+
+	SharedMapping &operator=(SharedMapping &&other) noexcept
+	{
+		std::swap(m_header, other.m_header);
+		std::swap(m_data, other.m_data);
+		std::swap(m_data_size, other.m_data_size);
+#ifdef _WIN32
+		std::swap(m_handle, other.m_handle);
+#endif
+		return *this;
+	}
+
+	SharedMapping &operator=(const SharedMapping &) = delete;
+
+	~SharedMapping() noexcept
+	{
+#ifndef _WIN32
+		if (m_data) {
+			munmap(m_data, m_data_size);
+		}
+
+		if (m_header) {
+			munmap(m_header, HEADER_REGION_SIZE);
+		}
+#else
+		if (m_data) {
+			UnmapViewOfFile(m_data);
+		}
+
+		if (m_header) {
+			UnmapViewOfFile(m_header);
+		}
+
+		if (m_handle) {
+			CloseHandle(m_handle);
+		}
+#endif
+	}
+
+	SharedHeader &header() const noexcept { return *reinterpret_cast<SharedHeader *>(m_header); }
+	std::byte *data() const noexcept { return m_data; }
+
+	// Create a new object replacing the existing one, map everything read-write
+	static SharedMapping create(const std::string &name, size_t total_size)
+	{
+		SharedMapping m;
+		m.m_data_size = total_size - HEADER_REGION_SIZE;
+
+#ifndef _WIN32
+		const std::string path = '/' + name;
+		// Remove leftovers of a crashed publisher
+		shm_unlink(path.c_str());
+
+		int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (fd < 0) {
+			throwSystemError("'shm_open' failed");
+		}
+
+		// Sparse allocation, pages are committed on first touch
+		if (ftruncate(fd, static_cast<off_t>(total_size)) != 0) {
+			int err = errno;
+			close(fd);
+			shm_unlink(path.c_str());
+			errno = err;
+			throwSystemError("'ftruncate' failed");
+		}
+
+		void *ptr = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (ptr == MAP_FAILED) {
+			int err = errno;
+			shm_unlink(path.c_str());
+			errno = err;
+			throwSystemError("'mmap' failed");
+		}
+
+		// One mapping, but it's fine to unmap it as two parts like readers' ones
+		m.m_header = reinterpret_cast<std::byte *>(ptr);
+		m.m_data = m.m_header + HEADER_REGION_SIZE;
+#else
+		const std::string path = "Local\\" + name;
+		m.m_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(total_size >> 32),
+			DWORD(total_size & 0xFFFFFFFF), path.c_str());
+		if (!m.m_handle) {
+			throwSystemError("'CreateFileMappingA' failed");
+		}
+
+		if (GetLastError() == ERROR_ALREADY_EXISTS) {
+			// Can't replace it like on Linux while any handle or view is open
+			throw Exception::fromError(VoxenErrc::AlreadyRegistered, "shared land state object already exists");
+		}
+
+		m.m_header = reinterpret_cast<std::byte *>(
+			MapViewOfFile(m.m_handle, FILE_MAP_ALL_ACCESS, 0, 0, HEADER_REGION_SIZE));
+		if (!m.m_header) {
+			throwSystemError("'MapViewOfFile' failed");
+		}
+
+		m.m_data = reinterpret_cast<std::byte *>(
+			MapViewOfFile(m.m_handle, FILE_MAP_ALL_ACCESS, 0, HEADER_REGION_SIZE, m.m_data_size));
+		if (!m.m_data) {
+			throwSystemError("'MapViewOfFile' failed");
+		}
+#endif
+
+		return m;
+	}
+
+	// Open an existing object, map header read-write and data read-only
+	static SharedMapping open(const std::string &name)
+	{
+		SharedMapping m;
+
+#ifndef _WIN32
+		const std::string path = '/' + name;
+		int fd = shm_open(path.c_str(), O_RDWR, 0);
+		if (fd < 0) {
+			throwSystemError("'shm_open' failed");
+		}
+
+		struct stat st {};
+		if (fstat(fd, &st) != 0 || size_t(st.st_size) <= HEADER_REGION_SIZE) {
+			close(fd);
+			throw Exception::fromError(VoxenErrc::InvalidData, "shared land state object is too small");
+		}
+
+		void *header = mmap(nullptr, HEADER_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (header == MAP_FAILED) {
+			int err = errno;
+			close(fd);
+			errno = err;
+			throwSystemError("'mmap' failed");
+		}
+
+		m.m_header = reinterpret_cast<std::byte *>(header);
+		m.m_data_size = size_t(st.st_size) - HEADER_REGION_SIZE;
+
+		void *data = mmap(nullptr, m.m_data_size, PROT_READ, MAP_SHARED, fd, HEADER_REGION_SIZE);
+		close(fd);
+
+		if (data == MAP_FAILED) {
+			throwSystemError("'mmap' failed");
+		}
+
+		m.m_data = reinterpret_cast<std::byte *>(data);
+#else
+		const std::string path = "Local\\" + name;
+		m.m_handle = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, path.c_str());
+		if (!m.m_handle) {
+			throwSystemError("'OpenFileMappingA' failed");
+		}
+
+		m.m_header = reinterpret_cast<std::byte *>(MapViewOfFile(m.m_handle, FILE_MAP_WRITE, 0, 0, HEADER_REGION_SIZE));
+		if (!m.m_header) {
+			throwSystemError("'MapViewOfFile' failed");
+		}
+
+		// Windows has no way to query mapping object size, take it from the header
+		const uint64_t total_size = m.header().total_size;
+		if (total_size <= HEADER_REGION_SIZE) {
+			throw Exception::fromError(VoxenErrc::InvalidData, "shared land state object is too small");
+		}
+
+		m.m_data_size = size_t(total_size - HEADER_REGION_SIZE);
+		m.m_data = reinterpret_cast<std::byte *>(
+			MapViewOfFile(m.m_handle, FILE_MAP_READ, 0, HEADER_REGION_SIZE, m.m_data_size));
+		if (!m.m_data) {
+			throwSystemError("'MapViewOfFile' failed");
+		}
+#endif
+
+		return m;
+	}
+
+	static void unlink(const std::string &name) noexcept
+	{
+#ifndef _WIN32
+		shm_unlink(('/' + name).c_str());
+#else
+		// Named mappings are destroyed with the last handle, nothing to do
+		(void) name;
+#endif
+	}
+
+private:
+	std::byte *m_header = nullptr;
+	std::byte *m_data = nullptr;
+	size_t m_data_size = 0;
+#ifdef _WIN32
+	HANDLE m_handle = nullptr;
+#endif
+};
+
+// Read-side helpers shared by publisher and view
+struct IndexBuffer {
+	IndexEntry *entries;
+	uint64_t mask;
+
+	uint64_t homeSlot(uint64_t packed_key) const noexcept { return ChunkKey(packed_key).hash() & mask; }
+
+	// Returns the slot holding `packed_key` or the empty slot where it should be inserted
+	uint64_t findSlot(uint64_t packed_key) const noexcept
+	{
+		uint64_t slot = homeSlot(packed_key);
+		while (entries[slot].blob_size != 0 && entries[slot].key != packed_key) {
+			slot = (slot + 1) & mask;
+		}
+
+		return slot;
+	}
+
+	// Linear probing deletion with backward shift, leaves no tombstones
+	void eraseSlot(uint64_t slot) noexcept
+	{
+		uint64_t next = slot;
+
+		while (true) {
+			next = (next + 1) & mask;
+			if (entries[next].blob_size == 0) {
+				break;
+			}
+
+			// Move the entry back unless its home slot is cyclically within (slot; next]
+			const uint64_t home = homeSlot(entries[next].key);
+			const bool stays = slot < next ? (home > slot && home <= next) : (home > slot || home <= next);
+
+			if (!stays) {
+				entries[slot] = entries[next];
+				slot = next;
+			}
+		}
+
+		entries[slot] = {};
+	}
+};
+
+IndexBuffer getIndexBuffer(const SharedMapping &mapping, uint32_t buffer) noexcept
+{
+	const SharedHeader &header = mapping.header();
+	return {
+		.entries = reinterpret_cast<IndexEntry *>(mapping.data() + header.index_offset[buffer]),
+		.mask = header.index_capacity - 1,
+	};
+}
+
+} // namespace
+
+// SharedLandStatePublisher
+
+struct SharedLandStatePublisher::Impl {
+	// Chunks can be edited in place and then re-inserted with a new version,
+	// so a blob is identified by both chunk address and its table item version
+	struct BlobKey {
+		const Chunk *chunk;
+		uint64_t version;
+
+		bool operator==(const BlobKey &) const = default;
+	};
+
+	struct BlobKeyHash {
+		size_t operator()(const BlobKey &key) const noexcept
+		{
+			return Hash::xxh64Fixed(reinterpret_cast<uintptr_t>(key.chunk) ^ Hash::xxh64Fixed(key.version));
+		}
+	};
+
+	struct BlobRecord {
+		uint64_t offset;
+		// Serialized size, chunk can be mutated after serialization
+		uint32_t size;
+		uint32_t size_class;
+		// Number of index buffers referencing this blob, 1 or 2
+		uint32_t refs;
+	};
+
+	Config config;
+	SharedMapping mapping;
+
+	// Chunk table each index buffer was last published with.
+	// Keeps chunks alive, so their addresses are not reused while blobs are referenced.
+	LandState::ChunkTable buffer_tables[NUM_BUFFERS];
+	std::unordered_map<BlobKey, BlobRecord, BlobKeyHash> blobs;
+
+	// Arena allocator state, writer-private
+	uint64_t arena_top = 0;
+	std::vector<std::vector<uint64_t>> free_blobs;
+
+	bool failed = false;
+	uint64_t skipped_publications = 0;
+
+	// Returns false if the arena is exhausted
+	bool addBlobRef(const Chunk &chunk, uint64_t version, uint64_t &offset, uint32_t &size);
+	void releaseBlobRef(const Chunk &chunk, uint64_t version) noexcept;
+	bool generationPinned(uint64_t generation) noexcept;
+};
+
+bool SharedLandStatePublisher::Impl::addBlobRef(const Chunk &chunk, uint64_t version, uint64_t &offset,
+	uint32_t &size)
+{
+	auto [iter, inserted] = blobs.try_emplace(BlobKey { &chunk, version });
+	BlobRecord &record = iter->second;
+
+	if (!inserted) {
+		// Already serialized for the other buffer
+		record.refs++;
+		offset = record.offset;
+		size = record.size;
+		return true;
+	}
+
+	const SharedHeader &header = mapping.header();
+	const Chunk::BlockIdStorage &block_ids = chunk.blockIds();
+	const size_t blob_size = block_ids.serializedSize();
+
+	const uint32_t size_class = blobSizeClass(blob_size);
+	if (size_class >= free_blobs.size()) {
+		free_blobs.resize(size_class + 1);
+	}
+
+	uint64_t blob_offset;
+	if (!free_blobs[size_class].empty()) {
+		blob_offset = free_blobs[size_class].back();
+		free_blobs[size_class].pop_back();
+	} else {
+		const size_t class_size = blobClassSize(size_class);
+		if (arena_top + class_size > header.arena_size) [[unlikely]] {
+			blobs.erase(iter);
+			return false;
+		}
+
+		blob_offset = arena_top;
+		arena_top += class_size;
+	}
+
+	std::byte *blob = mapping.data() + header.arena_offset + blob_offset;
+	block_ids.serialize(std::span(blob, blob_size));
+
+	record = {
+		.offset = blob_offset,
+		.size = static_cast<uint32_t>(blob_size),
+		.size_class = size_class,
+		.refs = 1,
+	};
+	offset = blob_offset;
+	size = static_cast<uint32_t>(blob_size);
+	return true;
+}
+
+void SharedLandStatePublisher::Impl::releaseBlobRef(const Chunk &chunk, uint64_t version) noexcept
+{
+	auto iter = blobs.find(BlobKey { &chunk, version });
+	assert(iter != blobs.end());
+
+	BlobRecord &record = iter->second;
+	if (--record.refs == 0) {
+		free_blobs[record.size_class].push_back(record.offset);
+		blobs.erase(iter);
+	}
+}
+
+bool SharedLandStatePublisher::Impl::generationPinned(uint64_t generation) noexcept
+{
+	SharedHeader &header = mapping.header();
+
+	for (ReaderSlot &slot : header.readers) {
+		// Pairs with `seq_cst` store in `SharedLandStateView::acquire()`,
+		// either we see its pin or it sees the newer active generation
+		if (slot.pinned_generation.load(std::memory_order_seq_cst) != generation) {
+			continue;
+		}
+
+		uint64_t pid = slot.owner_pid.load(std::memory_order_relaxed);
+		if (pid != 0 && !processAlive(pid)) {
+			Log::warn("Reader process {} of shared land state '{}' died holding a snapshot, releasing its slot", pid,
+				config.name);
+			// A new reader might be taking over this slot concurrently (see `SharedLandStateView` ctor),
+			// don't overwrite its values. It can't pin this older generation, only the active one.
+			uint64_t expected = generation;
+			slot.pinned_generation.compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+			slot.owner_pid.compare_exchange_strong(pid, 0, std::memory_order_release, std::memory_order_relaxed);
+			continue;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+SharedLandStatePublisher::SharedLandStatePublisher(Config cfg) : m_impl()
+{
+	Impl &impl = m_impl.object();
+
+	const uint64_t index_capacity = std::bit_ceil(uint64_t(std::max(cfg.max_chunks, 1u)) * 2);
+	const uint64_t index_bytes = index_capacity * sizeof(IndexEntry);
+	const uint64_t arena_size = (cfg.arena_bytes + MIN_BLOB_SIZE - 1) / MIN_BLOB_SIZE * MIN_BLOB_SIZE;
+	const uint64_t total_size = HEADER_REGION_SIZE + NUM_BUFFERS * index_bytes + arena_size;
+
+	impl.mapping = SharedMapping::create(cfg.name, total_size);
+
+	SharedHeader &header = impl.mapping.header();
+	// Object is freshly created and zero-filled, atomics are valid as-is
+	header.layout_version = LAYOUT_VERSION;
+	header.max_readers = MAX_READERS;
+	header.total_size = total_size;
+	header.index_capacity = index_capacity;
+	header.arena_size = arena_size;
+	header.index_offset[0] = 0;
+	header.index_offset[1] = index_bytes;
+	header.arena_offset = NUM_BUFFERS * index_bytes;
+	header.publisher_pid.store(currentPid(), std::memory_order_relaxed);
+	// Readers check magic last, publish it after everything else
+	std::atomic_ref(header.magic).store(LAYOUT_MAGIC, std::memory_order_release);
+
+	Log::info("Publishing land state to shared memory '{}' ({} chunks max, {} MiB arena)", cfg.name, cfg.max_chunks,
+		arena_size >> 20);
+	impl.config = std::move(cfg);
+}
+
+SharedLandStatePublisher::~SharedLandStatePublisher() noexcept
+{
+	Impl &impl = m_impl.object();
+	impl.mapping.header().publisher_pid.store(0, std::memory_order_release);
+	SharedMapping::unlink(impl.config.name);
+}
+
+bool SharedLandStatePublisher::publish(WorldTickId tick_id, const LandState &state)
+{
+	Impl &impl = m_impl.object();
+	if (impl.failed) {
+		return false;
+	}
+
+	SharedHeader &header = impl.mapping.header();
+	const uint64_t generation = header.active_generation.load(std::memory_order_relaxed) + 1;
+	const uint32_t buffer = generation % NUM_BUFFERS;
+
+	// This buffer holds the generation before the active one, can't touch it while pinned
+	if (generation > NUM_BUFFERS && impl.generationPinned(generation - NUM_BUFFERS)) {
+		impl.skipped_publications++;
+		return false;
+	}
+
+	IndexBuffer index = getIndexBuffer(impl.mapping, buffer);
+	BufferHeader &buffer_header = header.buffers[buffer];
+	uint64_t num_entries = buffer_header.num_entries;
+
+	state.chunk_table.visitDiff(impl.buffer_tables[buffer],
+		[&](const LandState::ChunkTable::Item *new_item, const LandState::ChunkTable::Item *old_item) {
+			// Null value items are not published, treat them as missing
+			const Chunk *new_chunk = new_item ? new_item->valueAddr() : nullptr;
+			const Chunk *old_chunk = old_item ? old_item->valueAddr() : nullptr;
+
+			const ChunkKey key = new_item ? new_item->key() : old_item->key();
+			const uint64_t slot = index.findSlot(key.packed());
+			IndexEntry &entry = index.entries[slot];
+
+			if (new_chunk) {
+				if (entry.blob_size == 0 && num_entries >= impl.config.max_chunks) [[unlikely]] {
+					impl.failed = true;
+					return false;
+				}
+
+				uint64_t blob_offset;
+				uint32_t blob_size;
+				// Add the new reference before releasing the old one, they might be the same blob
+				if (!impl.addBlobRef(*new_chunk, new_item->version(), blob_offset, blob_size)) [[unlikely]] {
+					impl.failed = true;
+					return false;
+				}
+
+				if (entry.blob_size == 0) {
+					num_entries++;
+				}
+
+				entry = {
+					.key = key.packed(),
+					.blob_offset = blob_offset,
+					.blob_size = blob_size,
+					._unused = 0,
+					.version = new_item->version(),
+				};
+			} else if (entry.blob_size != 0) {
+				index.eraseSlot(slot);
+				num_entries--;
+			}
+
+			if (old_chunk) {
+				impl.releaseBlobRef(*old_chunk, old_item->version());
+			}
+
+			return true;
+		});
+
+	if (impl.failed) [[unlikely]] {
+		Log::error("Shared land state '{}' capacity exceeded (max {} chunks, {} MiB arena), publication stopped",
+			impl.config.name, impl.config.max_chunks, header.arena_size >> 20);
+		return false;
+	}
+
+	impl.buffer_tables[buffer] = state.chunk_table;
+
+	buffer_header.generation = generation;
+	buffer_header.tick_id = tick_id.value;
+	buffer_header.num_entries = num_entries;
+
+	// Pairs with `seq_cst` loads in `SharedLandStateView::acquire()`
+	header.active_generation.store(generation, std::memory_order_seq_cst);
+	return true;
+}
+
+// SharedLandStateView
+
+struct SharedLandStateView::Impl {
+	SharedMapping mapping;
+	ReaderSlot *slot = nullptr;
+};
+
+SharedLandStateView::Snapshot::Snapshot(Snapshot &&other) noexcept
+	: m_view(std::exchange(other.m_view, nullptr)), m_buffer(other.m_buffer)
+{}
+
+SharedLandStateView::Snapshot &SharedLandStateView::Snapshot::operator=(Snapshot &&other) noexcept
+{
+	if (this != &other) {
+		release();
+		m_view = std::exchange(other.m_view, nullptr);
+		m_buffer = other.m_buffer;
+	}
+
+	return *this;
+}
+
+SharedLandStateView::Snapshot::~Snapshot() noexcept
+{
+	release();
+}
+
+WorldTickId SharedLandStateView::Snapshot::tickId() const noexcept
+{
+	return WorldTickId(m_view->m_impl->mapping.header().buffers[m_buffer].tick_id);
+}
+
+size_t SharedLandStateView::Snapshot::size() const noexcept
+{
+	return m_view->m_impl->mapping.header().buffers[m_buffer].num_entries;
+}
+
+std::optional<SharedLandStateView::ChunkItem> SharedLandStateView::Snapshot::find(ChunkKey key) const noexcept
+{
+	const SharedMapping &mapping = m_view->m_impl->mapping;
+	const IndexBuffer index = getIndexBuffer(mapping, m_buffer);
+	const IndexEntry &entry = index.entries[index.findSlot(key.packed())];
+
+	if (entry.blob_size == 0) {
+		return std::nullopt;
+	}
+
+	const std::byte *arena = mapping.data() + mapping.header().arena_offset;
+	return ChunkItem {
+		.key = key,
+		.version = entry.version,
+		.block_ids = std::span(arena + entry.blob_offset, entry.blob_size),
+	};
+}
+
+void SharedLandStateView::Snapshot::forEach(extras::function_ref<void(const ChunkItem &)> visitor) const
+{
+	const SharedMapping &mapping = m_view->m_impl->mapping;
+	const IndexBuffer index = getIndexBuffer(mapping, m_buffer);
+	const std::byte *arena = mapping.data() + mapping.header().arena_offset;
+
+	for (uint64_t slot = 0; slot <= index.mask; slot++) {
+		const IndexEntry &entry = index.entries[slot];
+		if (entry.blob_size != 0) {
+			visitor(ChunkItem {
+				.key = ChunkKey(entry.key),
+				.version = entry.version,
+				.block_ids = std::span(arena + entry.blob_offset, entry.blob_size),
+			});
+		}
+	}
+}
+
+void SharedLandStateView::Snapshot::release() noexcept
+{
+	if (m_view) {
+		m_view->m_impl->slot->pinned_generation.store(0, std::memory_order_release);
+		m_view = nullptr;
+	}
+}
+
+SharedLandStateView::SharedLandStateView(std::string_view name) : m_impl()
+{
+	Impl &impl = m_impl.object();
+	impl.mapping = SharedMapping::open(std::string(name));
+
+	SharedHeader &header = impl.mapping.header();
+	if (std::atomic_ref(header.magic).load(std::memory_order_acquire) != LAYOUT_MAGIC
+		|| header.layout_version != LAYOUT_VERSION) {
+		throw Exception::fromError(VoxenErrc::InvalidData, "shared land state has unknown format");
+	}
+
+	const uint64_t pid = currentPid();
+	for (ReaderSlot &slot : header.readers) {
+		uint64_t expected = 0;
+		if (slot.owner_pid.compare_exchange_strong(expected, pid, std::memory_order_acq_rel)) {
+			impl.slot = &slot;
+			break;
+		}
+	}
+
+	if (!impl.slot) {
+		// Publisher releases slots of dead readers only when they pin a buffer it wants to
+		// overwrite. Others (e.g. killed without a snapshot) stay taken, reclaim one of them.
+		for (ReaderSlot &slot : header.readers) {
+			uint64_t owner = slot.owner_pid.load(std::memory_order_relaxed);
+			if (owner != 0 && processAlive(owner)) {
+				continue;
+			}
+
+			if (slot.owner_pid.compare_exchange_strong(owner, pid, std::memory_order_acq_rel)) {
+				if (owner != 0) {
+					Log::info("Reclaimed shared land state '{}' reader slot of dead process {}", name, owner);
+				}
+
+				// Dead owner might have left its snapshot pinned
+				slot.pinned_generation.store(0, std::memory_order_release);
+				impl.slot = &slot;
+				break;
+			}
+		}
+	}
+
+	if (!impl.slot) {
+		throw Exception::fromError(VoxenErrc::OutOfResource, "no free shared land state reader slots");
+	}
+}
+
+SharedLandStateView::~SharedLandStateView() noexcept
+{
+	Impl &impl = m_impl.object();
+	impl.slot->pinned_generation.store(0, std::memory_order_relaxed);
+	impl.slot->owner_pid.store(0, std::memory_order_release);
+}
+
+SharedLandStateView::Snapshot SharedLandStateView::acquire()
+{
+	Impl &impl = m_impl.object();
+	const SharedHeader &header = impl.mapping.header();
+	// Only one snapshot per view is allowed
+	assert(impl.slot->pinned_generation.load(std::memory_order_relaxed) == 0);
+
+	uint64_t generation = header.active_generation.load(std::memory_order_acquire);
+
+	while (generation != 0) {
+		impl.slot->pinned_generation.store(generation, std::memory_order_seq_cst);
+
+		// Publisher might have started updating this buffer before seeing our pin.
+		// Then it must have published a newer generation, retry with it.
+		const uint64_t active = header.active_generation.load(std::memory_order_seq_cst);
+		if (active == generation) {
+			return Snapshot(this, uint32_t(generation % NUM_BUFFERS));
+		}
+
+		generation = active;
+	}
+
+	impl.slot->pinned_generation.store(0, std::memory_order_relaxed);
+	return Snapshot();
+}
+
+bool SharedLandStateView::publisherAlive() const noexcept
+{
+	const uint64_t pid = m_impl->mapping.header().publisher_pid.load(std::memory_order_acquire);
+	return pid != 0 && processAlive(pid);
+}
+
+} // namespace voxen::land
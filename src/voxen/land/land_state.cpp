@@ -10,3 +10,21 @@ template class V8gHashTrie<land::ChunkKey, land::Chunk>;
 template class V8gHashTrie<land::ChunkKey, land::PseudoChunkSurface>;
 
 } // namespace voxen
+
+namespace voxen::land
+{
+
+LandStateMemoryStats LandState::memoryStats(const LandState *other) const
+{
+	LandStateMemoryStats stats;
+
+	stats.chunk_table = chunk_table.memoryStats(other ? &other->chunk_table : nullptr,
+		[](const Chunk &chunk) { return chunk.heapBytes(); });
+	stats.pseudo_chunk_surface_table = pseudo_chunk_surface_table.memoryStats(
+		other ? &other->pseudo_chunk_surface_table : nullptr,
+		[](const PseudoChunkSurface &surface) { return surface.heapBytes(); });
+
+	return stats;
+}
+
+} // namespace voxen::land
@@ -9,6 +9,8 @@
 
 #include <glm/gtc/packing.hpp>
 
+#include <algorithm>
+
 namespace voxen::land
 {
 
@@ -42,81 +44,88 @@ void PseudoChunkData::generateFromLod0(std::span<const Chunk *const, 27> chunks)
 {
 	constexpr uint32_t B = Consts::CHUNK_SIZE_BLOCKS;
 	constexpr uint32_t B2 = B + B;
-
-	// Stores two triples for each face/edge-adjacent chunk:
-	// - XYZ to add when storing into expanded array ([0], [1], [2])
-	// - XYZ limits of iteration over this chunk ([3], [4], [5])
-	constexpr uint32_t ADJACENT_WALK_TABLE[18][6] = {
-		// X face-adjacent chunks
-		{ B2, 0, 0, 1, B, B },
-		{ B2, 0, B, 1, B, B },
-		{ B2, B, 0, 1, B, B },
-		{ B2, B, B, 1, B, B },
-		// Y face-adjacent chunks
-		{ 0, B2, 0, B, 1, B },
-		{ 0, B2, B, B, 1, B },
-		{ B, B2, 0, B, 1, B },
-		{ B, B2, B, B, 1, B },
-		// Z face-adjacent chunks
-		{ 0, 0, B2, B, B, 1 },
-		{ B, 0, B2, B, B, 1 },
-		{ 0, B, B2, B, B, 1 },
-		{ B, B, B2, B, B, 1 },
-		// X edge-adjacent chunks
-		{ 0, B2, B2, B, 1, 1 },
-		{ B, B2, B2, B, 1, 1 },
-		// Y edge-adjacent chunks
-		{ B2, 0, B2, 1, B, 1 },
-		{ B2, B, B2, 1, B, 1 },
-		// Z edge-adjacent chunks
-		{ B2, B2, 0, 1, 1, B },
-		{ B2, B2, B, 1, 1, B },
+	constexpr uint32_t SLAB = 8;
+
+	// Gather block IDs from all chunks into (B2 + 1)^2 layers and walk over them
+	// layer by layer. Not strictly necessary but the alternative is to handle
+	// tons of special cases for different adjacency types.
+	//
+	// Output cells of Y row `y` need layers [2y; 2y + 2], so we keep a ring of
+	// two slabs of layers, unpacking the next one while processing the current.
+	// This is ~4x less memory than expanding the whole (B2 + 1)^3 array
+	// and the working set of one output row stays in L1/L2 caches.
+	constexpr uint32_t RING_LAYERS = 2 * SLAB;
+	constexpr uint32_t LAYER_STRIDE = (B2 + 1) * (B2 + 1);
+	constexpr uint32_t ROW_STRIDE = B2 + 1;
+
+	auto ring = std::make_unique<Chunk::BlockId[]>(RING_LAYERS * LAYER_STRIDE);
+
+	auto layer_ptr = [&](uint32_t layer) { return ring.get() + (layer % RING_LAYERS) * LAYER_STRIDE; };
+	auto ring_view = [&](uint32_t layer, uint32_t x, uint32_t z) {
+		return Chunk::BlockIdStorage::ExpandedView { layer_ptr(layer) + x * ROW_STRIDE + z, LAYER_STRIDE, ROW_STRIDE };
 	};
 
-	// Gather block IDs from all chunks into one huge array and
-	// then walk over it. Not strictly necessary but the alternative
-	// is to handle tons of special cases for different adjacency types.
-	// Allocate on heap, expanded array is pretty large.
-	// XXX: this thrashes caches like hell. Better to unpack layer by layer
-	// while iterating in Y, we need only two (three?) layers at a time.
-	// 3D array can easily annihilate L2 cache while 2D might even fit in L1.
-	auto expanded_ids = std::make_unique<CubeArray<Chunk::BlockId, B2 + 1>>();
+	// Unpack layers [SLAB * slab; SLAB * slab + SLAB) of the gathered array.
+	// Slab 8 consists of only one layer (Y = B2) coming from the upper chunks.
+	auto expand_slab = [&](uint32_t slab) {
+		const uint32_t first_layer = slab * SLAB;
+
+		if (first_layer == B2) {
+			// Y face-adjacent chunks, only the first layer matters but unpacking a slab is
+			// cheaper than loading blocks one by one. Extra layers land into the free ring half.
+			for (uint32_t i = 0; i < 4; i++) {
+				const uint32_t add_x = (i & 0b10) ? B : 0;
+				const uint32_t add_z = (i & 0b01) ? B : 0;
+				chunks[12 + i]->blockIds().expandSlab(0, ring_view(first_layer, add_x, add_z));
+			}
 
-	// Expand "primary" chunks using the special unpack function
-	for (size_t i = 0; i < 8; i++) {
-		const Chunk *chunk = chunks[i];
+			// X and Z edge-adjacent chunks
+			for (uint32_t i = 0; i < 2; i++) {
+				const auto &x_edge_ids = chunks[20 + i]->blockIds();
+				const auto &z_edge_ids = chunks[24 + i]->blockIds();
 
-		const uint32_t add_x = (i & 0b010) ? B : 0;
-		const uint32_t add_y = (i & 0b100) ? B : 0;
-		const uint32_t add_z = (i & 0b001) ? B : 0;
+				for (uint32_t j = 0; j < B; j++) {
+					layer_ptr(first_layer)[(i * B + j) * ROW_STRIDE + B2] = x_edge_ids.load(j, 0, 0);
+					layer_ptr(first_layer)[B2 * ROW_STRIDE + i * B + j] = z_edge_ids.load(0, 0, j);
+				}
+			}
 
-		chunk->blockIds().expand(expanded_ids->view<B>(glm::uvec3(add_x, add_y, add_z)));
-	}
+			// Vertex-adjacent chunks provides only one block ID
+			layer_ptr(first_layer)[B2 * ROW_STRIDE + B2] = chunks[26]->blockIds().load(0, 0, 0);
+			return;
+		}
 
-	// Other chunks need a few blocks, gather them directly.
-	// XXX: this is the ultimate cache-thrasher 9000!
-	for (size_t i = 0; i < 18; i++) {
-		const auto &block_ids = chunks[i + 8]->blockIds();
-
-		const uint32_t add_x = ADJACENT_WALK_TABLE[i][0];
-		const uint32_t add_y = ADJACENT_WALK_TABLE[i][1];
-		const uint32_t add_z = ADJACENT_WALK_TABLE[i][2];
-		const uint32_t lim_x = ADJACENT_WALK_TABLE[i][3];
-		const uint32_t lim_y = ADJACENT_WALK_TABLE[i][4];
-		const uint32_t lim_z = ADJACENT_WALK_TABLE[i][5];
-
-		// One or two of these loops will have only one iteration
-		for (uint32_t y = 0; y < lim_y; y++) {
-			for (uint32_t x = 0; x < lim_x; x++) {
-				for (uint32_t z = 0; z < lim_z; z++) {
-					expanded_ids->store(x + add_x, y + add_y, z + add_z, block_ids.load(x, y, z));
+		const uint32_t add_y = (first_layer >= B) ? 1 : 0;
+		const uint32_t chunk_y = first_layer % B;
+
+		// "Primary" chunks are unpacked with the special function
+		for (uint32_t i = 0; i < 4; i++) {
+			const uint32_t add_x = (i & 0b10) ? B : 0;
+			const uint32_t add_z = (i & 0b01) ? B : 0;
+			chunks[add_y * 4 + i]->blockIds().expandSlab(chunk_y / SLAB, ring_view(first_layer, add_x, add_z));
+		}
+
+		// Other chunks need a few blocks per layer, gather them directly
+		for (uint32_t ly = 0; ly < SLAB; ly++) {
+			Chunk::BlockId *layer = layer_ptr(first_layer + ly);
+			const uint32_t y = chunk_y + ly;
+
+			for (uint32_t i = 0; i < 2; i++) {
+				// X face-adjacent chunks fill the column X = B2
+				const auto &x_face_ids = chunks[8 + add_y * 2 + i]->blockIds();
+				// Z face-adjacent chunks fill the row Z = B2
+				const auto &z_face_ids = chunks[16 + add_y * 2 + i]->blockIds();
+
+				for (uint32_t j = 0; j < B; j++) {
+					layer[B2 * ROW_STRIDE + i * B + j] = x_face_ids.load(0, y, j);
+					layer[(i * B + j) * ROW_STRIDE + B2] = z_face_ids.load(j, y, 0);
 				}
 			}
-		}
-	}
 
-	// Vertex-adjacent chunks provides only one block ID
-	expanded_ids->store(B2, B2, B2, chunks[26]->blockIds().load(0, 0, 0));
+			// Y edge-adjacent chunks
+			layer[B2 * ROW_STRIDE + B2] = chunks[22 + add_y]->blockIds().load(0, y, 0);
+		}
+	};
 
 	std::vector<SurfaceMatHistEntry> material_histogram;
 	glm::vec4 surface_point_weighted_sum;
@@ -146,14 +155,21 @@ void PseudoChunkData::generateFromLod0(std::span<const Chunk *const, 27> chunks)
 
 	// Now collect "Hermite data" by iterating over 3x3x3 cells.
 	// Every such cell might produce one output cell.
-	Utils::forYXZ<B>([&](uint32_t x, uint32_t y, uint32_t z) {
+	auto process_cell = [&](uint32_t x, uint32_t y, uint32_t z) {
 		const glm::uvec3 cell_base_coord_2x = 2u * glm::uvec3(x, y, z);
 
 		// We have 3x3x3 block ID grid.
 		// Only 8 corner blocks will determine if the generated cell crosses the surface.
 		// But every block can still contribute to QEF solver and the material histogram.
 		CubeArray<Chunk::BlockId, 3> cell_blocks;
-		expanded_ids->extractTo<3>(cell_base_coord_2x, cell_blocks);
+		for (uint32_t ay = 0; ay < 3; ay++) {
+			const Chunk::BlockId *layer = layer_ptr(cell_base_coord_2x.y + ay);
+
+			for (uint32_t ax = 0; ax < 3; ax++) {
+				const Chunk::BlockId *row = layer + (cell_base_coord_2x.x + ax) * ROW_STRIDE + cell_base_coord_2x.z;
+				std::copy_n(row, 3, cell_blocks.data[ay][ax]);
+			}
+		}
 
 		uint8_t solid_mask = 0;
 		solid_mask |= isBlockSolid(cell_blocks.data[0][0][0]) ? 0b00000001 : 0;
@@ -192,7 +208,6 @@ void PseudoChunkData::generateFromLod0(std::span<const Chunk *const, 27> chunks)
 		});
 
 		// We know that at least 3 edges were added, otherwise we'd have failed `solid_mask` check.
-		// Because of `forYXZ` we will store produced entries already sorted in the required order.
 		CellEntry &out_cell_entry = m_cell_entries.emplace_back();
 
 		out_cell_entry.cell_index = glm::u8vec3(x, y, z);
@@ -203,7 +218,24 @@ void PseudoChunkData::generateFromLod0(std::span<const Chunk *const, 27> chunks)
 		glm::vec3 surface_point = glm::vec3(surface_point_weighted_sum) / surface_point_weighted_sum.w;
 		out_cell_entry.surface_point_unorm = glm::packUnorm<uint16_t>(surface_point);
 		out_cell_entry.surface_point_sum_count = static_cast<uint16_t>(std::min(surface_point_weighted_sum.w, 65535.0f));
-	});
+	};
+
+	// Output Y rows [4s; 4s + 4) need slab `s` and the first layer of slab `s + 1`.
+	// Processing them in YXZ order stores entries already sorted in the required order.
+	expand_slab(0);
+
+	for (uint32_t slab = 0; slab < B2 / SLAB; slab++) {
+		// Overwrites layers of `slab - 1` which are not needed anymore
+		expand_slab(slab + 1);
+
+		for (uint32_t y = slab * SLAB / 2; y < (slab + 1) * SLAB / 2; y++) {
+			for (uint32_t x = 0; x < B; x++) {
+				for (uint32_t z = 0; z < B; z++) {
+					process_cell(x, y, z);
+				}
+			}
+		}
+	}
 }
 
 void PseudoChunkData::generateFromFinerLod(std::span<const PseudoChunkData *const, 8> finer)
@@ -13,9 +13,18 @@
 #include "land_geometry_utils_private.hpp"
 
 #include <glm/gtc/packing.hpp>
+#include <glm/trigonometric.hpp>
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
-#include <unordered_map>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+
+// AVX2 and BMI2 intrinsics
+#include <immintrin.h>
 
 namespace voxen::land
 {
@@ -133,126 +142,460 @@ void packMaterialHistogram(const ProcessedCellEntry &c0, const ProcessedCellEntr
 	resolve_vertex(c2, a2);
 }
 
-} // namespace
+// Bit mask of non-empty blocks in a row of `Consts::CHUNK_SIZE_BLOCKS + 2` expanded
+// block IDs, bit index is the position in row. Higher bits are always zero.
+uint64_t makeSolidRowMask(const uint16_t *row) noexcept
+{
+	static_assert(Consts::CHUNK_SIZE_BLOCKS == 32, "Update row mask calculation");
 
-void PseudoChunkSurface::generate(ChunkAdjacencyRef adj)
+	// Compare 16 IDs at once, then take one bit of every 16-bit comparison result
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i lo = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row)), zero);
+	__m256i hi = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + 16)), zero);
+
+	constexpr uint32_t EVEN_BITS = 0x55555555;
+	uint64_t empty = _pext_u32(uint32_t(_mm256_movemask_epi8(lo)), EVEN_BITS)
+		| (uint64_t(_pext_u32(uint32_t(_mm256_movemask_epi8(hi)), EVEN_BITS)) << 16);
+	empty |= uint64_t(TempBlockMeta::isBlockEmpty(row[32])) << 32;
+	empty |= uint64_t(TempBlockMeta::isBlockEmpty(row[33])) << 33;
+
+	return ~empty & ((uint64_t(1) << 34) - 1u);
+}
+
+// Inverse of `packNormal()`
+glm::vec3 unpackNormal(glm::i16vec2 packed) noexcept
 {
-	m_vertex_positions.clear();
-	m_vertex_attributes.clear();
-	m_indices.clear();
+	glm::vec2 p = glm::unpackSnorm<float>(packed);
+	glm::vec3 v(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+
+	if (v.y < 0.0f) {
+		float x = (1.0f - std::abs(v.z)) * (v.x >= 0.0f ? 1.0f : -1.0f);
+		float z = (1.0f - std::abs(v.x)) * (v.z >= 0.0f ? 1.0f : -1.0f);
+		v.x = x;
+		v.z = z;
+	}
 
-	constexpr static uint32_t B = Consts::CHUNK_SIZE_BLOCKS;
+	return glm::normalize(v);
+}
 
-	// Allocate on heap, expanded array is pretty large
-	auto expanded_ids = std::make_unique<CubeArray<uint16_t, B + 2>>();
-	adj.expandBlockIds(expanded_ids->view());
+uint64_t packWeldingKey(const PseudoSurfaceVertexPosition &pos) noexcept
+{
+	return uint64_t(pos.position_unorm.x) | (uint64_t(pos.position_unorm.y) << 16)
+		| (uint64_t(pos.position_unorm.z) << 32);
+}
 
-	std::unordered_map<int64_t, uint32_t> vertex_index_map;
-	std::vector<uint32_t> index_buffer;
+uint64_t packWeldingKey(const PseudoSurfaceVertexAttributes &attrib) noexcept
+{
+	return uint64_t(attrib.mat_hist_entries.x) | (uint64_t(attrib.mat_hist_entries.y) << 16)
+		| (uint64_t(attrib.mat_hist_entries.z) << 32) | (uint64_t(attrib.mat_hist_entries.w) << 48);
+}
 
-	auto get_vertex_index = [&](glm::ivec3 position, int32_t orientation, Chunk::BlockId block_id) {
-		int64_t key = (position.x << 16) | (position.y << 8) | position.z;
-		key = (key << 24) | (orientation << 8) | block_id;
+// Reorder triangles for better post-transform vertex cache usage. This is "Tipsify" algorithm
+// from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" paper by Sander et al.:
+// https://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+// It fans around vertices choosing the next one likely to remain in the cache. Winding is preserved.
+std::vector<uint32_t> reorderForVertexCache(std::span<const uint32_t> indices, uint32_t num_vertices,
+	uint32_t cache_size)
+{
+	constexpr uint32_t NONE = UINT32_MAX;
+	const uint32_t num_triangles = static_cast<uint32_t>(indices.size() / 3);
 
-		auto iter = vertex_index_map.find(key);
-		if (iter != vertex_index_map.end()) {
-			return iter->second;
+	// Number of not yet emitted triangles using each vertex
+	std::vector<uint32_t> live(num_vertices, 0);
+	for (uint32_t v : indices) {
+		live[v]++;
+	}
+
+	// Vertex-triangle adjacency, triangles of vertex `v` are in [offsets[v]; offsets[v + 1])
+	std::vector<uint32_t> offsets(num_vertices + 1, 0);
+	for (uint32_t v = 0; v < num_vertices; v++) {
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++) {
+			adjacency[cursors[indices[i]]++] = i / 3;
 		}
+	}
 
-		uint32_t vertex_index = static_cast<uint32_t>(m_vertex_positions.size());
-		vertex_index_map[key] = vertex_index;
+	// Timestamps of vertices entering the simulated FIFO cache
+	std::vector<uint32_t> cache_time(num_vertices, 0);
+	std::vector<bool> emitted(num_triangles, false);
+	std::vector<uint32_t> dead_end_stack;
+	std::vector<uint32_t> candidates;
 
-		auto &vertex_pos = m_vertex_positions.emplace_back();
-		auto &vertex_attrib = m_vertex_attributes.emplace_back();
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
 
-		constexpr float DIVISOR = 1.0f / static_cast<float>(B);
-		glm::vec3 pos_normalized = glm::vec3(position) * DIVISOR;
-		packVertexPosition(pos_normalized, vertex_pos);
+	uint32_t time = cache_size + 1;
+	uint32_t input_cursor = 0;
+	uint32_t fanning = num_vertices > 0 ? 0 : NONE;
 
-		packNormal(FACE_NORMAL[orientation], vertex_attrib);
+	while (fanning != NONE) {
+		candidates.clear();
 
-		PackedColorSrgb packed_color = TempBlockMeta::BLOCK_FIXED_COLOR[block_id];
-		uint16_t color = TempBlockMeta::packColor555(packed_color);
+		for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+			const uint32_t triangle = adjacency[i];
+			if (emitted[triangle]) {
+				continue;
+			}
 
-		vertex_attrib.mat_hist_entries = glm::u16vec4(color, 0, 0, 0);
-		vertex_attrib.mat_hist_weights = glm::u8vec4(255, 0, 0, 0);
+			for (uint32_t j = 0; j < 3; j++) {
+				const uint32_t v = indices[triangle * 3 + j];
+				output.emplace_back(v);
+				dead_end_stack.emplace_back(v);
+				candidates.emplace_back(v);
+				live[v]--;
 
-		return vertex_index;
-	};
+				if (time - cache_time[v] > cache_size) {
+					cache_time[v] = time;
+					time++;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// Prefer the oldest candidate that will still be in cache after fanning around it
+		uint32_t next = NONE;
+		int64_t best_priority = -1;
+
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) {
+				continue;
+			}
+
+			int64_t priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+				priority = time - cache_time[v];
+			}
+
+			if (priority > best_priority) {
+				best_priority = priority;
+				next = v;
+			}
+		}
+
+		// Dead end, take the most recently used vertex with remaining triangles
+		while (next == NONE && !dead_end_stack.empty()) {
+			const uint32_t v = dead_end_stack.back();
+			dead_end_stack.pop_back();
 
-	auto add_face = [&](uint32_t x, uint32_t y, uint32_t z, int32_t orientation, Chunk::BlockId block_id) {
-		glm::ivec3 base_coord(x, y, z);
+			if (live[v] > 0) {
+				next = v;
+			}
+		}
+
+		// Or just the next one in input order
+		while (next == NONE && input_cursor < num_vertices) {
+			if (live[input_cursor] > 0) {
+				next = input_cursor;
+			}
+			input_cursor++;
+		}
+
+		fanning = next;
+	}
 
-		uint32_t vertex_indices[4];
+	return output;
+}
+
+// Merge matching vertices of a non-indexed triangle list (every three vertices form a triangle)
+// according to `cfg`, then build index buffer and reorder vertices in the order of first use.
+void weldVertices(std::vector<PseudoSurfaceVertexPosition> &positions,
+	std::vector<PseudoSurfaceVertexAttributes> &attributes, std::vector<uint16_t> &indices,
+	const PseudoSurfaceWeldingConfig &cfg)
+{
+	const uint32_t num_input_vertices = static_cast<uint32_t>(positions.size());
+
+	// Sort vertices to group candidates for welding, ties are broken by
+	// index so that the first vertex of a group becomes its representative
+	std::vector<uint32_t> order(num_input_vertices);
+	std::iota(order.begin(), order.end(), 0u);
+
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return std::tuple(packWeldingKey(positions[a]), packWeldingKey(attributes[a]), a)
+			< std::tuple(packWeldingKey(positions[b]), packWeldingKey(attributes[b]), b);
+	});
 
+	const float min_normal_cos = std::cos(glm::radians(cfg.max_normal_angle_degrees));
+
+	auto can_weld = [&](const PseudoSurfaceVertexAttributes &a, const PseudoSurfaceVertexAttributes &b) {
 		for (int i = 0; i < 4; i++) {
-			glm::ivec3 vertex_coord = base_coord + FACE_COORD_OFFSET[orientation][i];
-			vertex_indices[i] = get_vertex_index(vertex_coord, orientation, block_id);
+			if (std::abs(int32_t(a.mat_hist_weights[i]) - int32_t(b.mat_hist_weights[i]))
+				> int32_t(cfg.max_mat_hist_weight_delta)) {
+				return false;
+			}
 		}
 
-		// First triangle
-		index_buffer.emplace_back(vertex_indices[0]);
-		index_buffer.emplace_back(vertex_indices[1]);
-		index_buffer.emplace_back(vertex_indices[2]);
-		// Second triangle
-		index_buffer.emplace_back(vertex_indices[2]);
-		index_buffer.emplace_back(vertex_indices[3]);
-		index_buffer.emplace_back(vertex_indices[0]);
+		if (a.normal_oct_snorm == b.normal_oct_snorm) {
+			return true;
+		}
+
+		return glm::dot(unpackNormal(a.normal_oct_snorm), unpackNormal(b.normal_oct_snorm)) >= min_normal_cos;
 	};
 
-	Utils::forYXZ<B>([&](uint32_t x, uint32_t y, uint32_t z) {
-		// TODO: check adjacency occlusion in a more generalized way.
-		// Non-empty blocks might be not fully occluding in certain faces.
+	// Input vertex index -> index of its representative input vertex
+	std::vector<uint32_t> remap(num_input_vertices);
+	// Representatives of the current group
+	std::vector<uint32_t> group_reps;
 
-		// TODO: request "fake face color" from the block interface.
-		// Currently using hardcoded face color-coding for debugging.
+	for (uint32_t i = 0; i < num_input_vertices; i++) {
+		const uint32_t v = order[i];
 
-		Chunk::BlockId block_id = expanded_ids->load(x + 1, y + 1, z + 1);
+		if (i == 0 || packWeldingKey(positions[v]) != packWeldingKey(positions[order[i - 1]])
+			|| packWeldingKey(attributes[v]) != packWeldingKey(attributes[order[i - 1]])) {
+			group_reps.clear();
+		}
 
-		if (TempBlockMeta::isBlockEmpty(block_id)) {
-			// Block has no visible faces
-			return;
+		remap[v] = v;
+		for (uint32_t rep : group_reps) {
+			if (can_weld(attributes[rep], attributes[v])) {
+				remap[v] = rep;
+				break;
+			}
 		}
 
-		if (TempBlockMeta::isBlockEmpty(expanded_ids->load(x + 2, y + 1, z + 1))) {
-			// X+ face visible
-			add_face(x, y, z, 0, block_id);
+		if (remap[v] == v) {
+			group_reps.emplace_back(v);
 		}
+	}
 
-		if (TempBlockMeta::isBlockEmpty(expanded_ids->load(x, y + 1, z + 1))) {
-			// X- face visible
-			add_face(x, y, z, 1, block_id);
+	// Compact representative indices, in order of their first appearance
+	constexpr uint32_t UNASSIGNED = UINT32_MAX;
+	std::vector<uint32_t> compact_index(num_input_vertices, UNASSIGNED);
+	std::vector<uint32_t> compact_to_input;
+	std::vector<uint32_t> compact_indices(num_input_vertices);
+
+	for (uint32_t i = 0; i < num_input_vertices; i++) {
+		const uint32_t rep = remap[i];
+		if (compact_index[rep] == UNASSIGNED) {
+			compact_index[rep] = static_cast<uint32_t>(compact_to_input.size());
+			compact_to_input.emplace_back(rep);
 		}
 
-		if (TempBlockMeta::isBlockEmpty(expanded_ids->load(x + 1, y + 2, z + 1))) {
-			// Y+ face visible
-			add_face(x, y, z, 2, block_id);
+		compact_indices[i] = compact_index[rep];
+	}
+
+	const uint32_t num_vertices = static_cast<uint32_t>(compact_to_input.size());
+	assert(num_vertices <= UINT16_MAX + 1u);
+
+	if (cfg.vertex_cache_size > 0) {
+		compact_indices = reorderForVertexCache(compact_indices, num_vertices, cfg.vertex_cache_size);
+	}
+
+	// Finally lay out vertices in the order of first use by the index buffer
+	std::vector<uint32_t> final_index(num_vertices, UNASSIGNED);
+	std::vector<PseudoSurfaceVertexPosition> final_positions;
+	std::vector<PseudoSurfaceVertexAttributes> final_attributes;
+	final_positions.reserve(num_vertices);
+	final_attributes.reserve(num_vertices);
+
+	indices.resize(compact_indices.size());
+
+	for (size_t i = 0; i < compact_indices.size(); i++) {
+		const uint32_t v = compact_indices[i];
+		if (final_index[v] == UNASSIGNED) {
+			final_index[v] = static_cast<uint32_t>(final_positions.size());
+			final_positions.emplace_back(positions[compact_to_input[v]]);
+			final_attributes.emplace_back(attributes[compact_to_input[v]]);
 		}
 
-		if (TempBlockMeta::isBlockEmpty(expanded_ids->load(x + 1, y, z + 1))) {
-			// Y- face visible
-			add_face(x, y, z, 3, block_id);
+		indices[i] = static_cast<uint16_t>(final_index[v]);
+	}
+
+	positions = std::move(final_positions);
+	attributes = std::move(final_attributes);
+}
+
+} // namespace
+
+void PseudoChunkSurface::generate(ChunkAdjacencyRef adj)
+{
+	m_vertex_positions.clear();
+	m_vertex_attributes.clear();
+	m_indices.clear();
+
+	constexpr static uint32_t B = Consts::CHUNK_SIZE_BLOCKS;
+	constexpr static uint32_t E = B + 2;
+
+	struct Scratch {
+		CubeArray<uint16_t, E> expanded_ids;
+		// Non-empty block bits of `expanded_ids`, indexed by (y; x), Z coordinate is the bit index
+		uint64_t solid_rows[E][E];
+		// Visible face bits of chunk blocks for every orientation,
+		// indexed by (slice; u), V coordinate is the bit index (see below)
+		uint32_t face_rows[6][B][B];
+	};
+
+	// Allocate on heap, expanded array is pretty large. Zero-initialized.
+	auto scratch = std::make_unique<Scratch>();
+	adj.expandBlockIds(scratch->expanded_ids.view());
+
+	for (uint32_t y = 0; y < E; y++) {
+		for (uint32_t x = 0; x < E; x++) {
+			scratch->solid_rows[y][x] = makeSolidRowMask(scratch->expanded_ids.data[y][x]);
 		}
+	}
+
+	// Visible faces are where a solid block meets an empty one. Compare whole rows of blocks
+	// with rows of neighbors, Z neighbors are in the same row - just shift it by one bit.
+	// TODO: check adjacency occlusion in a more generalized way.
+	// Non-empty blocks might be not fully occluding in certain faces.
+	for (uint32_t y = 0; y < B; y++) {
+		for (uint32_t x = 0; x < B; x++) {
+			const uint64_t row = scratch->solid_rows[y + 1][x + 1];
+			if (row == 0) {
+				continue;
+			}
 
-		if (TempBlockMeta::isBlockEmpty(expanded_ids->load(x + 1, y + 1, z + 2))) {
-			// Z+ face visible
-			add_face(x, y, z, 4, block_id);
+			// Drop border bits and shift back to chunk-local Z coordinates
+			auto inner = [](uint64_t bits) { return static_cast<uint32_t>(bits >> 1); };
+
+			const uint32_t faces[6] = {
+				inner(row & ~scratch->solid_rows[y + 1][x + 2]),
+				inner(row & ~scratch->solid_rows[y + 1][x]),
+				inner(row & ~scratch->solid_rows[y + 2][x + 1]),
+				inner(row & ~scratch->solid_rows[y][x + 1]),
+				inner(row & ~(row >> 1)),
+				inner(row & ~(row << 1)),
+			};
+
+			// X faces - slice is X, rows are Y
+			scratch->face_rows[0][x][y] = faces[0];
+			scratch->face_rows[1][x][y] = faces[1];
+			// Y faces - slice is Y, rows are X
+			scratch->face_rows[2][y][x] = faces[2];
+			scratch->face_rows[3][y][x] = faces[3];
+
+			// Z faces - slice is Z, rows are X, scatter the bits to transpose
+			for (int32_t orientation = 4; orientation < 6; orientation++) {
+				for (uint32_t bits = faces[orientation]; bits != 0; bits &= bits - 1) {
+					const uint32_t z = static_cast<uint32_t>(std::countr_zero(bits));
+					scratch->face_rows[orientation][z][x] |= 1u << y;
+				}
+			}
 		}
+	}
+
+	// TODO: request "fake face color" from the block interface.
+	// Currently using hardcoded face color-coding for debugging.
+	std::array<uint16_t, TempBlockMeta::NUM_BLOCKS> block_face_colors;
+	for (Chunk::BlockId id = 0; id < TempBlockMeta::NUM_BLOCKS; id++) {
+		block_face_colors[id] = TempBlockMeta::packColor555(TempBlockMeta::BLOCK_FIXED_COLOR[id]);
+	}
+
+	// Emit one quad covering `extent_u * extent_v` faces starting from `base`
+	auto add_quad = [&](int32_t orientation, glm::ivec3 base, glm::ivec3 extent, uint16_t color) {
+		uint32_t first_vertex = static_cast<uint32_t>(m_vertex_positions.size());
+		assert(first_vertex + 4 <= UINT16_MAX);
 
-		if (TempBlockMeta::isBlockEmpty(expanded_ids->load(x + 1, y + 1, z))) {
-			// Z- face visible
-			add_face(x, y, z, 5, block_id);
+		PseudoSurfaceVertexAttributes attrib;
+		packNormal(FACE_NORMAL[orientation], attrib);
+		attrib.mat_hist_entries = glm::u16vec4(color, 0, 0, 0);
+		attrib.mat_hist_weights = glm::u8vec4(255, 0, 0, 0);
+
+		for (int i = 0; i < 4; i++) {
+			// Offsets of a unit face, stretched along the plane axes
+			glm::ivec3 vertex_coord = base + FACE_COORD_OFFSET[orientation][i] * extent;
+
+			constexpr float DIVISOR = 1.0f / static_cast<float>(B);
+			packVertexPosition(glm::vec3(vertex_coord) * DIVISOR, m_vertex_positions.emplace_back());
+			m_vertex_attributes.emplace_back(attrib);
 		}
-	});
 
-	m_indices.resize(index_buffer.size());
-	for (size_t i = 0; i < index_buffer.size(); i++) {
-		assert(index_buffer[i] <= UINT16_MAX);
-		m_indices[i] = static_cast<uint16_t>(index_buffer[i]);
+		// First triangle
+		m_indices.emplace_back(static_cast<uint16_t>(first_vertex));
+		m_indices.emplace_back(static_cast<uint16_t>(first_vertex + 1));
+		m_indices.emplace_back(static_cast<uint16_t>(first_vertex + 2));
+		// Second triangle
+		m_indices.emplace_back(static_cast<uint16_t>(first_vertex + 2));
+		m_indices.emplace_back(static_cast<uint16_t>(first_vertex + 3));
+		m_indices.emplace_back(static_cast<uint16_t>(first_vertex));
+	};
+
+	// Greedy meshing - visible faces of every orientation are merged slice by slice
+	// into as large rectangles of the same color as possible. Only set bits of face
+	// rows are visited, merged faces are consumed by clearing their bits.
+	// This creates T-junctions between quads but they are hardly noticeable with flat shading.
+	for (int32_t orientation = 0; orientation < 6; orientation++) {
+		const int32_t normal_axis = orientation / 2;
+		// Axes of the face plane, `u` selects face rows and `v` selects bits
+		const int32_t u_axis = normal_axis == 0 ? 1 : 0;
+		const int32_t v_axis = normal_axis == 2 ? 1 : 2;
+
+		// Strides of X/Y/Z axes in `expanded_ids` (YXZ order)
+		constexpr uint32_t AXIS_STRIDE[3] = { E, E * E, 1 };
+		const uint32_t normal_stride = AXIS_STRIDE[normal_axis];
+		const uint32_t u_stride = AXIS_STRIDE[u_axis];
+		const uint32_t v_stride = AXIS_STRIDE[v_axis];
+
+		for (uint32_t slice = 0; slice < B; slice++) {
+			uint32_t(&rows)[B] = scratch->face_rows[orientation][slice];
+
+			auto block_coord = [&](uint32_t u, uint32_t v) {
+				glm::ivec3 coord;
+				coord[normal_axis] = int32_t(slice);
+				coord[u_axis] = int32_t(u);
+				coord[v_axis] = int32_t(v);
+				return coord;
+			};
+
+			// Expanded coordinates are shifted by 1 from chunk-local ones
+			const uint16_t *slice_ids = &scratch->expanded_ids.data[1][1][1] + slice * normal_stride;
+
+			auto face_color = [&](uint32_t u, uint32_t v) {
+				return block_face_colors[slice_ids[u * u_stride + v * v_stride]];
+			};
+
+			for (uint32_t u = 0; u < B; u++) {
+				while (rows[u] != 0) {
+					const uint32_t v = static_cast<uint32_t>(std::countr_zero(rows[u]));
+					const uint16_t color = face_color(u, v);
+
+					// Extend along the row as far as possible
+					uint32_t width = 1;
+					while (v + width < B && (rows[u] >> (v + width)) & 1u && face_color(u, v + width) == color) {
+						width++;
+					}
+
+					const uint32_t span = static_cast<uint32_t>(((uint64_t(1) << width) - 1u) << v);
+
+					// Then extend by whole rows of the same width
+					uint32_t height = 1;
+					while (u + height < B && (rows[u + height] & span) == span) {
+						bool same_color = true;
+						for (uint32_t dv = 0; dv < width && same_color; dv++) {
+							same_color = face_color(u + height, v + dv) == color;
+						}
+
+						if (!same_color) {
+							break;
+						}
+
+						height++;
+					}
+
+					// Consume merged faces
+					for (uint32_t du = 0; du < height; du++) {
+						rows[u + du] &= ~span;
+					}
+
+					glm::ivec3 extent(1);
+					extent[u_axis] = int32_t(height);
+					extent[v_axis] = int32_t(width);
+
+					add_quad(orientation, block_coord(u, v), extent, color);
+				}
+			}
+		}
 	}
 }
 
-void PseudoChunkSurface::generate(std::span<const PseudoChunkData *const, 19> datas, uint32_t lod)
+void PseudoChunkSurface::generate(std::span<const PseudoChunkData *const, 19> datas, uint32_t lod,
+	const PseudoSurfaceWeldingConfig &welding)
 {
 	m_vertex_positions.clear();
 	m_vertex_attributes.clear();
@@ -267,13 +610,8 @@ void PseudoChunkSurface::generate(std::span<const PseudoChunkData *const, 19> da
 		// TODO: something is wrong, negation is not needed
 		glm::vec3 normal = glm::normalize(-glm::cross(v10, v12));
 
-		// TODO: use indexing!
-		// No need to repeat the same vertices if there is no significant difference
-		// in normals (not a sharp feature) and material histograms can be matched.
-		uint32_t first_new_index = static_cast<uint32_t>(m_indices.size());
-		m_indices.emplace_back(first_new_index);
-		m_indices.emplace_back(first_new_index + 1);
-		m_indices.emplace_back(first_new_index + 2);
+		// Emit unique vertices, indexing is done by welding them afterwards
+		const size_t first_new_index = m_vertex_positions.size();
 
 		m_vertex_positions.emplace_back();
 		m_vertex_positions.emplace_back();
@@ -526,6 +864,8 @@ void PseudoChunkSurface::generate(std::span<const PseudoChunkData *const, 19> da
 			add_edge(cell_index + glm::ivec3(1, 1, 0), 2, solid[6]);
 		}
 	}
+
+	weldVertices(m_vertex_positions, m_vertex_attributes, m_indices, welding);
 }
 
 } // namespace voxen::land
@@ -8,6 +8,7 @@
 	#include <fcntl.h>
 	#include <sys/file.h>
 	#include <sys/stat.h>
+	#include <sys/uio.h>
 #else
 	#define NOMINMAX
 	#include <Windows.h>
@@ -15,6 +16,8 @@
 
 #include <chrono>
 #include <cinttypes>
+#include <climits>
+#include <vector>
 
 namespace voxen::os
 {
@@ -240,6 +243,63 @@ FileTimeDuration getFileTimeDuration(FILETIME ft) noexcept
 }
 #endif
 
+#ifndef _WIN32
+// Common part of `preadv()` and `pwritev()`, `fn` is the respective syscall.
+// Returns the number of transferred bytes, less than requested only on EOF.
+template<typename B, typename F>
+size_t vectoredTransfer(std::span<const std::span<B>> buffers, int64_t offset, F &&fn, const char *fn_name)
+{
+	std::vector<iovec> iovecs(buffers.size());
+	size_t remaining = 0;
+
+	for (size_t i = 0; i < buffers.size(); i++) {
+		iovecs[i].iov_base = const_cast<std::byte *>(buffers[i].data());
+		iovecs[i].iov_len = buffers[i].size();
+		remaining += buffers[i].size();
+	}
+
+	size_t transferred = 0;
+	size_t first = 0;
+
+	while (remaining > 0) {
+		const int count = static_cast<int>(std::min<size_t>(iovecs.size() - first, IOV_MAX));
+
+		ssize_t result = fn(iovecs.data() + first, count, offset);
+		if (result < 0) [[unlikely]] {
+			if (errno == EINTR) {
+				// Ignore signal interruptions
+				continue;
+			}
+
+			throw Exception::fromErrorCode({ errno, std::system_category() }, fn_name);
+		}
+
+		if (result == 0) {
+			// EOF, stop here
+			break;
+		}
+
+		auto bytes = static_cast<size_t>(result);
+		transferred += bytes;
+		remaining -= bytes;
+		offset += result;
+
+		// Incomplete transfer, skip fully completed buffers and try again
+		while (bytes > 0 && bytes >= iovecs[first].iov_len) {
+			bytes -= iovecs[first].iov_len;
+			first++;
+		}
+
+		if (bytes > 0) {
+			iovecs[first].iov_base = static_cast<std::byte *>(iovecs[first].iov_base) + bytes;
+			iovecs[first].iov_len -= bytes;
+		}
+	}
+
+	return transferred;
+}
+#endif
+
 } // namespace
 
 File::File(File &&other) noexcept : m_handle(std::exchange(other.m_handle, INVALID_HANDLE)) {}
@@ -478,6 +538,31 @@ void File::write(std::span<const std::byte> buffer)
 #endif
 }
 
+size_t File::preadv(std::span<const std::span<std::byte>> buffers, int64_t offset)
+{
+#ifndef _WIN32
+	return vectoredTransfer(buffers, offset,
+		[this](const iovec *iov, int count, int64_t off) { return preadv64(m_handle, iov, count, off); },
+		"'preadv' failed");
+#else
+	// No vectored positional reads on Windows (`ReadFileScatter` has too many restrictions)
+	size_t read_bytes = 0;
+
+	for (std::span<std::byte> buffer : buffers) {
+		size_t read_result = pread(buffer, offset);
+		read_bytes += read_result;
+		offset += static_cast<int64_t>(read_result);
+
+		if (read_result < buffer.size()) {
+			// EOF, stop here
+			break;
+		}
+	}
+
+	return read_bytes;
+#endif
+}
+
 void File::pwrite(std::span<const std::byte> buffer, int64_t offset)
 {
 #ifndef _WIN32
@@ -520,6 +605,31 @@ void File::pwrite(std::span<const std::byte> buffer, int64_t offset)
 #endif
 }
 
+void File::pwritev(std::span<const std::span<const std::byte>> buffers, int64_t offset)
+{
+#ifndef _WIN32
+	size_t total_size = 0;
+	for (std::span<const std::byte> buffer : buffers) {
+		total_size += buffer.size();
+	}
+
+	size_t written = vectoredTransfer(buffers, offset,
+		[this](const iovec *iov, int count, int64_t off) { return pwritev64(m_handle, iov, count, off); },
+		"'pwritev' failed");
+
+	if (written < total_size) [[unlikely]] {
+		// Zero bytes written, retrying would likely get us stuck
+		throw Exception::fromError(std::make_error_condition(std::errc::io_error), "'pwritev' wrote nothing");
+	}
+#else
+	// No vectored positional writes on Windows (`WriteFileGather` has too many restrictions)
+	for (std::span<const std::byte> buffer : buffers) {
+		pwrite(buffer, offset);
+		offset += static_cast<int64_t>(buffer.size());
+	}
+#endif
+}
+
 File File::open(const std::filesystem::path &path, FileFlags flags)
 {
 	auto open_result = tryOpen(path, flags);
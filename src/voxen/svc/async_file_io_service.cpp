@@ -8,14 +8,22 @@
 #include <voxen/util/error_condition.hpp>
 #include <voxen/util/exception.hpp>
 #include <voxen/util/futex_work_counter.hpp>
+#include <voxen/util/log.hpp>
 
 #include "async_counter_tracker.hpp"
+#include "io_uring_private.hpp"
 
 #include <extras/defer.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <queue>
 #include <thread>
+#include <type_traits>
 #include <variant>
+#include <vector>
 
 namespace voxen::svc
 {
@@ -23,6 +31,13 @@ namespace voxen::svc
 namespace
 {
 
+// Fixed file slot value meaning "not registered"
+constexpr uint32_t NO_FIXED_SLOT = detail::IoUring::NO_INDEX;
+// User data of io_uring wakeup eventfd read completions
+constexpr uint64_t WAKEUP_USER_DATA = UINT64_MAX;
+// Max number of io_uring completions reaped at once
+constexpr size_t REAP_BATCH_SIZE = 32;
+
 struct FileReadCommand {
 	std::span<std::byte> buffer;
 	int64_t offset;
@@ -35,6 +50,53 @@ struct FileWriteCommand {
 	std::shared_ptr<AsyncFileIoService::WriteResult> result_ptr;
 };
 
+struct FileReadvCommand {
+	std::vector<std::span<std::byte>, TPipeMemoryAllocator<std::span<std::byte>>> buffers;
+	size_t total_size;
+	int64_t offset;
+	std::shared_ptr<AsyncFileIoService::ReadResult> result_ptr;
+};
+
+struct FileWritevCommand {
+	std::vector<std::span<const std::byte>, TPipeMemoryAllocator<std::span<const std::byte>>> buffers;
+	size_t total_size;
+	int64_t offset;
+	std::shared_ptr<AsyncFileIoService::WriteResult> result_ptr;
+};
+
+template<typename T>
+constexpr bool IS_READ_COMMAND = std::is_same_v<T, FileReadCommand> || std::is_same_v<T, FileReadvCommand>;
+template<typename T>
+constexpr bool IS_VECTORED_COMMAND = std::is_same_v<T, FileReadvCommand> || std::is_same_v<T, FileWritevCommand>;
+
+size_t commandSize(const FileReadCommand &cmd) noexcept
+{
+	return cmd.buffer.size();
+}
+
+size_t commandSize(const FileWriteCommand &cmd) noexcept
+{
+	return cmd.buffer.size();
+}
+
+size_t commandSize(const FileReadvCommand &cmd) noexcept
+{
+	return cmd.total_size;
+}
+
+size_t commandSize(const FileWritevCommand &cmd) noexcept
+{
+	return cmd.total_size;
+}
+
+// Shared state of `asyncReadBatch()/asyncWriteBatch()` requests
+template<typename R>
+struct BatchState {
+	std::vector<R> results;
+	// Number of not yet completed requests, the last one completes the counter
+	std::atomic_size_t remaining;
+};
+
 } // namespace
 
 class detail::AsyncFileIoServiceImpl {
@@ -42,116 +104,567 @@ public:
 	struct IoQueueItem {
 		uint64_t async_counter;
 		AsyncFileIoService::Ptr file_ptr;
-		std::variant<FileReadCommand, FileWriteCommand> command;
+		std::variant<FileReadCommand, FileWriteCommand, FileReadvCommand, FileWritevCommand> command;
+		// Set for batch requests, points into `BatchState` kept alive by `result_ptr`
+		std::atomic_size_t *batch_remaining = nullptr;
 	};
 
 	AsyncFileIoServiceImpl(ServiceLocator &svc, AsyncFileIoService::Config cfg)
 		: m_cfg(std::move(cfg)), m_counter_tracker(svc.requestService<AsyncCounterTracker>())
 	{
 		svc.requestService<PipeMemoryAllocator>();
-		m_io_thread = std::thread(ioThreadProc, std::ref(*this));
+
+		// Ring thread would have no free ops and spin forever
+		m_cfg.queue_depth = std::max(m_cfg.queue_depth, 1u);
+
+		if (!m_cfg.force_fallback) {
+			initRing();
+		}
+
+		if (m_ring) {
+			m_io_threads.emplace_back(ringThreadProc, std::ref(*this));
+		} else {
+			const uint32_t num_threads = std::max(m_cfg.fallback_threads, 1u);
+			for (uint32_t i = 0; i < num_threads; i++) {
+				m_io_threads.emplace_back(blockingThreadProc, std::ref(*this));
+			}
+		}
 	}
 
 	~AsyncFileIoServiceImpl()
 	{
 		m_io_work_counter.requestStop();
-		m_io_thread.join();
+		for (auto &thread : m_io_threads) {
+			thread.join();
+		}
+	}
+
+	AsyncFileIoService::Ptr registerFile(os::File file)
+	{
+		const uint32_t slot = acquireFixedSlot(file.get());
+
+		try {
+			return m_file_handle_pool.allocate(std::move(file), *this, slot);
+		}
+		catch (...) {
+			releaseFixedSlot(slot);
+			throw;
+		}
 	}
 
-	AsyncFileIoService::Ptr registerFile(os::File file) { return m_file_handle_pool.allocate(std::move(file)); }
+	// Called when the last pointer to a registered file dies
+	void releaseFixedSlot(uint32_t slot) noexcept
+	{
+		if (slot == NO_FIXED_SLOT) {
+			return;
+		}
+
+		try {
+			m_ring->updateFileSlot(slot, os::File::INVALID_HANDLE);
+		}
+		catch (Exception &ex) {
+			// The slot still references the file, don't give it out again
+			Log::warn("Failed to clear io_uring fixed file slot {}: {}", slot, ex.what());
+			return;
+		}
+
+		std::lock_guard lock(m_fixed_slots_lock);
+		m_free_fixed_slots.emplace_back(slot);
+	}
 
 	uint64_t allocateAsyncCounter() { return m_counter_tracker.allocateCounter(); }
 
-	void pushIoCommand(IoQueueItem item)
+	void pushIoCommand(IoQueueItem item) { pushIoCommands(std::span(&item, 1)); }
+
+	// Enqueue all items under one lock and wake I/O thread(s) only once
+	void pushIoCommands(std::span<IoQueueItem> items)
 	{
+		bool wake_ring;
+
 		{
 			std::lock_guard lock(m_io_queue_lock);
-			m_io_queue.emplace(std::move(item));
+			for (IoQueueItem &item : items) {
+				m_io_queue.emplace(std::move(item));
+			}
+
+			wake_ring = std::exchange(m_ring_waiting, false);
+		}
+
+		m_io_work_counter.addWork(static_cast<uint32_t>(items.size()));
+
+		if (wake_ring) {
+			m_ring->wake();
+		}
+	}
+
+	template<typename Cmd, typename Req>
+	auto enqueueBatch(std::span<const Req> requests)
+	{
+		using Result = typename decltype(Cmd::result_ptr)::element_type;
+
+		auto state = std::allocate_shared<BatchState<Result>>(TPipeMemoryAllocator<BatchState<Result>>());
+		state->results.resize(requests.size());
+		state->remaining.store(requests.size(), std::memory_order_relaxed);
+
+		std::shared_ptr<std::vector<Result>> results_ptr(state, &state->results);
+		if (requests.empty()) {
+			// Zero counter is always complete
+			return CoroFuture<std::vector<Result>>(0, std::move(results_ptr));
+		}
+
+		std::vector<IoQueueItem, TPipeMemoryAllocator<IoQueueItem>> items;
+		items.reserve(requests.size());
+
+		const uint64_t counter = allocateAsyncCounter();
+
+		for (size_t i = 0; i < requests.size(); i++) {
+			items.emplace_back(IoQueueItem {
+				.async_counter = counter,
+				.file_ptr = requests[i].file,
+				.command = Cmd { requests[i].buffer, requests[i].offset,
+					std::shared_ptr<Result>(state, &state->results[i]) },
+				.batch_remaining = &state->remaining,
+			});
 		}
 
-		m_io_work_counter.addWork(1);
+		pushIoCommands(items);
+		return CoroFuture<std::vector<Result>>(counter, std::move(results_ptr));
 	}
 
 private:
+	// State of an operation submitted to io_uring
+	struct InflightOp {
+		IoQueueItem item;
+		// Bytes transferred by previous (partial) completions
+		size_t transferred = 0;
+		// Remaining part of vectored transfer buffers
+		std::vector<IoUring::IoVec> iovecs;
+	};
+
 	AsyncFileIoService::Config m_cfg;
 	AsyncCounterTracker &m_counter_tracker;
 
-	SharedObjectPool<os::File, AsyncFileIoService::FILE_HANDLE_POOL_HINT> m_file_handle_pool;
+	std::unique_ptr<IoUring> m_ring;
+	os::FutexLock m_fixed_slots_lock;
+	std::vector<uint32_t> m_free_fixed_slots;
+
+	SharedObjectPool<AsyncFileIoService::RegisteredFile, AsyncFileIoService::FILE_HANDLE_POOL_HINT> m_file_handle_pool;
 
-	std::thread m_io_thread;
+	std::vector<std::thread> m_io_threads;
 	FutexWorkCounter m_io_work_counter;
 	os::FutexLock m_io_queue_lock;
 	std::queue<IoQueueItem> m_io_queue;
+	// Set (under `m_io_queue_lock`) while the ring thread is blocked in the
+	// kernel waiting for completions and can take more operations
+	bool m_ring_waiting = false;
 
-	// This thread processes queued I/O commands and performs them
-	//	in a blocking fashion (with `File::pread()/pwrite()` calls).
-	//
-	// TODO: this is not the right way to implement asynchronous I/O.
-	// We should use designated platform-specific APIs:
-	// io_uring on Linux and OVERLAPPED/threadpool/IOCP/ on Windows.
-	// Now it's done like that only to bring up the engine interface.
-	//
-	// NOTE: see commented out piece about `AsyncIo` flag in
-	// windows implementation of `File`. It must be uncommented
-	// once we rewrite this part to the proper asynchronous calls.
-	static void ioThreadProc(AsyncFileIoServiceImpl &me)
+	void initRing()
 	{
-		debug::setThreadName("FileIoThread");
+		try {
+			// One extra entry for the wakeup read
+			m_ring = std::make_unique<IoUring>(m_cfg.queue_depth + 1);
+		}
+		catch (Exception &ex) {
+			Log::warn("io_uring is not available, falling back to blocking I/O threads: {}", ex.what());
+			return;
+		}
 
-		uint32_t work_count = 0;
-		bool stop_requested = false;
+		if (m_cfg.registered_file_slots > 0) {
+			try {
+				m_ring->registerFileTable(m_cfg.registered_file_slots);
 
-		while (!stop_requested) {
-			if (work_count == 0) {
-				std::tie(work_count, stop_requested) = me.m_io_work_counter.wait();
+				m_free_fixed_slots.resize(m_cfg.registered_file_slots);
+				// Reverse order to give out lower slots first
+				for (uint32_t i = 0; i < m_cfg.registered_file_slots; i++) {
+					m_free_fixed_slots[i] = m_cfg.registered_file_slots - i - 1;
+				}
+			}
+			catch (Exception &ex) {
+				Log::warn("Failed to register io_uring file table: {}", ex.what());
 			}
+		}
+
+		if (!m_cfg.registered_buffers.empty() && !m_ring->supportsFixedBuffers()) {
+			Log::warn("io_uring does not support fixed-buffer transfers, not registering buffers");
+			m_cfg.registered_buffers.clear();
+		}
+
+		if (!m_cfg.registered_buffers.empty()) {
+			try {
+				m_ring->registerBuffers(m_cfg.registered_buffers);
+			}
+			catch (Exception &ex) {
+				Log::warn("Failed to register io_uring buffers: {}", ex.what());
+				m_cfg.registered_buffers.clear();
+			}
+		}
+	}
+
+	uint32_t acquireFixedSlot(os::File::NativeHandle handle)
+	{
+		uint32_t slot;
+
+		{
+			std::lock_guard lock(m_fixed_slots_lock);
+			if (m_free_fixed_slots.empty()) {
+				return NO_FIXED_SLOT;
+			}
+
+			slot = m_free_fixed_slots.back();
+			m_free_fixed_slots.pop_back();
+		}
 
-			uint32_t work_remaining = work_count;
+		try {
+			m_ring->updateFileSlot(slot, handle);
+		}
+		catch (Exception &ex) {
+			// Not critical, just use the file without registration
+			Log::warn("Failed to update io_uring fixed file slot {}: {}", slot, ex.what());
+
+			std::lock_guard lock(m_fixed_slots_lock);
+			m_free_fixed_slots.emplace_back(slot);
+			return NO_FIXED_SLOT;
+		}
+
+		return slot;
+	}
 
-			while (work_remaining > 0) {
-				IoQueueItem item;
+	// Find registered buffer containing the whole `[data; data + size)` range
+	uint32_t findRegisteredBuffer(const std::byte *data, size_t size) const noexcept
+	{
+		for (size_t i = 0; i < m_cfg.registered_buffers.size(); i++) {
+			const std::span<std::byte> buf = m_cfg.registered_buffers[i];
+			if (data >= buf.data() && data + size <= buf.data() + buf.size()) {
+				return static_cast<uint32_t>(i);
+			}
+		}
 
-				{
-					std::lock_guard lock(me.m_io_queue_lock);
-					item = std::move(me.m_io_queue.front());
-					me.m_io_queue.pop();
+		return IoUring::NO_INDEX;
+	}
+
+	// Reserve `op.iovecs` for all buffers of a vectored command, so
+	// that `fillIoVecs()` never allocates when (re)preparing it
+	static void reserveIoVecs(InflightOp &op)
+	{
+		std::visit(
+			[&](const auto &cmd) {
+				if constexpr (IS_VECTORED_COMMAND<std::remove_cvref_t<decltype(cmd)>>) {
+					op.iovecs.reserve(cmd.buffers.size());
 				}
+			},
+			op.item.command);
+	}
 
-				work_remaining--;
+	// Fill `op.iovecs` with the part of `buffers` remaining after `op.transferred` bytes.
+	// Storage must be reserved with `reserveIoVecs()` before.
+	template<typename B>
+	static void fillIoVecs(InflightOp &op, std::span<const std::span<B>> buffers) noexcept
+	{
+		op.iovecs.clear();
+		size_t skip = op.transferred;
 
-				if (const FileReadCommand *read_cmd = std::get_if<FileReadCommand>(&item.command); read_cmd) {
-					try {
-						*read_cmd->result_ptr = item.file_ptr->pread(read_cmd->buffer, read_cmd->offset);
-					}
-					catch (Exception &ex) {
-						*read_cmd->result_ptr = cpp::failure(ex.error());
-					}
-					catch (...) {
-						*read_cmd->result_ptr = cpp::failure(VoxenErrc::UnknownError);
+		for (std::span<B> buffer : buffers) {
+			if (skip >= buffer.size()) {
+				skip -= buffer.size();
+				continue;
+			}
+
+			op.iovecs.push_back({ const_cast<std::byte *>(buffer.data()) + skip, buffer.size() - skip });
+			skip = 0;
+		}
+	}
+
+	void prepareCommand(InflightOp &op, IoUring::Target target, const FileReadCommand &cmd,
+		uint64_t user_data) noexcept
+	{
+		auto buffer = cmd.buffer.subspan(op.transferred);
+		target.buffer_index = findRegisteredBuffer(buffer.data(), buffer.size());
+		m_ring->prepRead(target, buffer, cmd.offset + int64_t(op.transferred), user_data);
+	}
+
+	void prepareCommand(InflightOp &op, IoUring::Target target, const FileWriteCommand &cmd,
+		uint64_t user_data) noexcept
+	{
+		auto buffer = cmd.buffer.subspan(op.transferred);
+		target.buffer_index = findRegisteredBuffer(buffer.data(), buffer.size());
+		m_ring->prepWrite(target, buffer, cmd.offset + int64_t(op.transferred), user_data);
+	}
+
+	void prepareCommand(InflightOp &op, IoUring::Target target, const FileReadvCommand &cmd,
+		uint64_t user_data) noexcept
+	{
+		fillIoVecs(op, std::span(cmd.buffers));
+		m_ring->prepReadv(target, op.iovecs, cmd.offset + int64_t(op.transferred), user_data);
+	}
+
+	void prepareCommand(InflightOp &op, IoUring::Target target, const FileWritevCommand &cmd,
+		uint64_t user_data) noexcept
+	{
+		fillIoVecs(op, std::span(cmd.buffers));
+		m_ring->prepWritev(target, op.iovecs, cmd.offset + int64_t(op.transferred), user_data);
+	}
+
+	// Prepare (the remaining part of) an operation, does not submit it
+	void prepareOp(InflightOp &op, uint64_t user_data) noexcept
+	{
+		const AsyncFileIoService::RegisteredFile &file = *op.item.file_ptr;
+		IoUring::Target target { .handle = file.m_file.get(), .fixed_slot = file.m_fixed_slot };
+
+		std::visit([&](const auto &cmd) { prepareCommand(op, target, cmd, user_data); }, op.item.command);
+	}
+
+	// Complete the counter unless this is not the last item of a batch
+	void completeItem(IoQueueItem &item)
+	{
+		if (item.batch_remaining && item.batch_remaining->fetch_sub(1, std::memory_order_acq_rel) > 1) {
+			return;
+		}
+
+		m_counter_tracker.completeCounter(item.async_counter);
+	}
+
+	// Process io_uring completion result. Returns true if the operation
+	// is finished, false if it was prepared for resubmission.
+	bool handleCompletion(InflightOp &op, int32_t result, uint64_t user_data) noexcept
+	{
+		if (result == -EINTR || result == -EAGAIN) {
+			// Spurious failure, try again
+			prepareOp(op, user_data);
+			return false;
+		}
+
+		std::error_condition error;
+		if (result < 0) {
+			error = std::error_code(-result, std::system_category()).default_error_condition();
+		}
+
+		const bool finished = std::visit(
+			[&](auto &cmd) {
+				constexpr bool is_read = IS_READ_COMMAND<std::remove_cvref_t<decltype(cmd)>>;
+
+				if (result > 0) {
+					op.transferred += size_t(result);
+					if (op.transferred < commandSize(cmd)) {
+						// Short transfer, continue with the remaining part.
+						// EOF will be reported by zero-sized completion.
+						prepareOp(op, user_data);
+						return false;
 					}
+				} else if (result == 0 && !is_read && op.transferred < commandSize(cmd)) {
+					// Zero-sized write would loop forever
+					error = std::make_error_condition(std::errc::io_error);
+				}
+
+				if (error) {
+					*cmd.result_ptr = cpp::failure(error);
+				} else if constexpr (is_read) {
+					*cmd.result_ptr = op.transferred;
+				}
+
+				return true;
+			},
+			op.item.command);
+
+		if (finished) {
+			completeItem(op.item);
+		}
+
+		return finished;
+	}
+
+	// Ring thread keeps up to `queue_depth` operations in flight.
+	// It sleeps in the kernel while waiting for completions, producers
+	// interrupt this sleep with the wakeup eventfd if it can take more.
+	void runRing()
+	{
+		IoUring &ring = *m_ring;
+
+		// User data of operation SQEs is index in this array
+		std::vector<InflightOp> ops(m_cfg.queue_depth);
+		std::vector<uint32_t> free_ops(m_cfg.queue_depth);
+		for (uint32_t i = 0; i < m_cfg.queue_depth; i++) {
+			free_ops[i] = m_cfg.queue_depth - i - 1;
+		}
+
+		std::array<IoUring::Completion, REAP_BATCH_SIZE> completions;
+		uint32_t num_inflight = 0;
+
+		ring.prepWakeupRead(WAKEUP_USER_DATA);
+		// Cleared if the wakeup read fails and can't be re-armed
+		bool wakeup_armed = true;
+
+		while (true) {
+			uint32_t num_taken = 0;
+			bool wait_in_ring = false;
+
+			{
+				std::lock_guard lock(m_io_queue_lock);
+
+				while (!free_ops.empty() && !m_io_queue.empty()) {
+					const uint32_t index = free_ops.back();
+					free_ops.pop_back();
+
+					ops[index].item = std::move(m_io_queue.front());
+					ops[index].transferred = 0;
+					m_io_queue.pop();
+					reserveIoVecs(ops[index]);
+					prepareOp(ops[index], index);
+					num_taken++;
 				}
 
-				if (const FileWriteCommand *write_cmd = std::get_if<FileWriteCommand>(&item.command); write_cmd) {
-					try {
-						item.file_ptr->pwrite(write_cmd->buffer, write_cmd->offset);
+				// Queue is empty here unless we're out of free slots, in which
+				// case completions will wake us up anyway, no need to ask for it.
+				// Without wakeups new operations will wait for some completion too.
+				if (wakeup_armed && num_taken + num_inflight > 0 && !free_ops.empty()) {
+					m_ring_waiting = true;
+					wait_in_ring = true;
+				}
+			}
+
+			num_inflight += num_taken;
+
+			if (num_taken > 0) {
+				m_io_work_counter.removeWork(num_taken);
+			}
+
+			if (num_inflight == 0) {
+				auto [work_count, stop_requested] = m_io_work_counter.wait();
+				if (work_count == 0 && stop_requested) {
+					return;
+				}
+
+				continue;
+			}
+
+			try {
+				ring.submit(1);
+			}
+			catch (Exception &ex) {
+				// Can't really happen unless something is badly broken, and we can't
+				// complete in-flight operations without the ring. Crash early then.
+				Log::error("io_uring submission failed: {}", ex.what());
+				std::terminate();
+			}
+
+			if (wait_in_ring) {
+				std::lock_guard lock(m_io_queue_lock);
+				m_ring_waiting = false;
+			}
+
+			size_t num_completions;
+			while ((num_completions = ring.reap(completions)) > 0) {
+				for (size_t i = 0; i < num_completions; i++) {
+					const auto [user_data, result] = completions[i];
+
+					if (user_data == WAKEUP_USER_DATA) {
+						if (result >= 0 || result == -EINTR || result == -EAGAIN) {
+							ring.prepWakeupRead(WAKEUP_USER_DATA);
+						} else {
+							// Re-arming would fail immediately again, spinning in this loop
+							Log::error("io_uring wakeup read failed, continuing without wakeups: {}",
+								std::system_category().message(-result));
+							wakeup_armed = false;
+						}
+						continue;
 					}
-					catch (Exception &ex) {
-						*write_cmd->result_ptr = cpp::failure(ex.error());
+
+					const auto index = static_cast<uint32_t>(user_data);
+					if (handleCompletion(ops[index], result, user_data)) {
+						// Drop file pointer and result references
+						ops[index].item = {};
+						free_ops.emplace_back(index);
+						num_inflight--;
 					}
-					catch (...) {
-						*write_cmd->result_ptr = cpp::failure(VoxenErrc::UnknownError);
+				}
+			}
+		}
+	}
+
+	// Blocking fallback, performs the operation with `File::pread()/pwrite()` calls
+	void performBlocking(IoQueueItem &item) noexcept
+	{
+		os::File &file = item.file_ptr->file();
+
+		std::visit(
+			[&](auto &cmd) {
+				using Cmd = std::remove_cvref_t<decltype(cmd)>;
+
+				try {
+					if constexpr (std::is_same_v<Cmd, FileReadCommand>) {
+						*cmd.result_ptr = file.pread(cmd.buffer, cmd.offset);
+					} else if constexpr (std::is_same_v<Cmd, FileReadvCommand>) {
+						*cmd.result_ptr = file.preadv(cmd.buffers, cmd.offset);
+					} else if constexpr (std::is_same_v<Cmd, FileWriteCommand>) {
+						file.pwrite(cmd.buffer, cmd.offset);
+					} else {
+						file.pwritev(cmd.buffers, cmd.offset);
 					}
 				}
+				catch (Exception &ex) {
+					*cmd.result_ptr = cpp::failure(ex.error());
+				}
+				catch (...) {
+					*cmd.result_ptr = cpp::failure(VoxenErrc::UnknownError);
+				}
+			},
+			item.command);
+
+		completeItem(item);
+	}
+
+	static void ringThreadProc(AsyncFileIoServiceImpl &me)
+	{
+		debug::setThreadName("FileIoThread");
+		me.runRing();
+	}
 
-				me.m_counter_tracker.completeCounter(item.async_counter);
+	// Fallback threads take queued I/O commands one by one and perform them in a blocking fashion.
+	//
+	// NOTE: see commented out piece about `AsyncIo` flag in windows implementation
+	// of `File`. It must be uncommented once we have proper asynchronous calls there.
+	static void blockingThreadProc(AsyncFileIoServiceImpl &me)
+	{
+		debug::setThreadName("FileIoThread");
+
+		while (true) {
+			auto [work_count, stop_requested] = me.m_io_work_counter.wait();
+			if (work_count == 0) {
+				// Stop requested and all queued work is done
+				return;
 			}
 
-			std::tie(work_count, stop_requested) = me.m_io_work_counter.removeWork(work_count);
+			IoQueueItem item;
+
+			{
+				std::lock_guard lock(me.m_io_queue_lock);
+				if (me.m_io_queue.empty()) {
+					// Taken by another thread
+					continue;
+				}
+
+				item = std::move(me.m_io_queue.front());
+				me.m_io_queue.pop();
+				// Keep the counter equal to the queue size
+				me.m_io_work_counter.removeWork(1);
+			}
+
+			me.performBlocking(item);
 		}
 	}
 };
 
-AsyncFileIoService::AsyncFileIoService(ServiceLocator &svc, Config cfg) : m_impl(svc, cfg) {}
+AsyncFileIoService::RegisteredFile::RegisteredFile(os::File file, detail::AsyncFileIoServiceImpl &owner,
+	uint32_t fixed_slot) noexcept
+	: m_file(std::move(file)), m_owner(owner), m_fixed_slot(fixed_slot)
+{}
+
+AsyncFileIoService::RegisteredFile::~RegisteredFile()
+{
+	// Unregister before closing the handle
+	m_owner.releaseFixedSlot(m_fixed_slot);
+}
+
+AsyncFileIoService::AsyncFileIoService(ServiceLocator &svc, Config cfg) : m_impl(svc, std::move(cfg)) {}
 
 AsyncFileIoService::~AsyncFileIoService() = default;
 
@@ -189,4 +702,66 @@ auto AsyncFileIoService::asyncWrite(Ptr file, std::span<const std::byte> buffer,
 	return { counter, std::move(result_ptr) };
 }
 
+auto AsyncFileIoService::asyncReadv(Ptr file, std::span<const std::span<std::byte>> buffers, int64_t offset)
+	-> CoroFuture<ReadResult>
+{
+	FileReadvCommand command {
+		.buffers = { buffers.begin(), buffers.end() },
+		.total_size = 0,
+		.offset = offset,
+		.result_ptr = std::allocate_shared<ReadResult>(TPipeMemoryAllocator<ReadResult>()),
+	};
+
+	for (std::span<std::byte> buffer : buffers) {
+		command.total_size += buffer.size();
+	}
+
+	uint64_t counter = m_impl->allocateAsyncCounter();
+	auto result_ptr = command.result_ptr;
+
+	m_impl->pushIoCommand({
+		.async_counter = counter,
+		.file_ptr = std::move(file),
+		.command = std::move(command),
+	});
+
+	return { counter, std::move(result_ptr) };
+}
+
+auto AsyncFileIoService::asyncWritev(Ptr file, std::span<const std::span<const std::byte>> buffers, int64_t offset)
+	-> CoroFuture<WriteResult>
+{
+	FileWritevCommand command {
+		.buffers = { buffers.begin(), buffers.end() },
+		.total_size = 0,
+		.offset = offset,
+		.result_ptr = std::allocate_shared<WriteResult>(TPipeMemoryAllocator<WriteResult>()),
+	};
+
+	for (std::span<const std::byte> buffer : buffers) {
+		command.total_size += buffer.size();
+	}
+
+	uint64_t counter = m_impl->allocateAsyncCounter();
+	auto result_ptr = command.result_ptr;
+
+	m_impl->pushIoCommand({
+		.async_counter = counter,
+		.file_ptr = std::move(file),
+		.command = std::move(command),
+	});
+
+	return { counter, std::move(result_ptr) };
+}
+
+auto AsyncFileIoService::asyncReadBatch(std::span<const ReadRequest> requests) -> CoroFuture<BatchReadResult>
+{
+	return m_impl->enqueueBatch<FileReadCommand>(requests);
+}
+
+auto AsyncFileIoService::asyncWriteBatch(std::span<const WriteRequest> requests) -> CoroFuture<BatchWriteResult>
+{
+	return m_impl->enqueueBatch<FileWriteCommand>(requests);
+}
+
 } // namespace voxen::svc
@@ -0,0 +1,401 @@
+#include "io_uring_private.hpp"
+
+#include <voxen/util/exception.hpp>
+
+#ifndef _WIN32
+	#include <linux/io_uring.h>
+	#include <sys/eventfd.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <sys/uio.h>
+	#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace voxen::svc::detail
+{
+
+#ifndef _WIN32
+
+namespace
+{
+
+static_assert(sizeof(IoUring::IoVec) == sizeof(iovec) && offsetof(IoUring::IoVec, base) == offsetof(iovec, iov_base)
+		&& offsetof(IoUring::IoVec, size) == offsetof(iovec, iov_len),
+	"IoUring::IoVec is not layout-compatible with iovec");
+
+// Kernel refuses vectored transfers with more buffers than that.
+// Longer ones are completed partially and must be resubmitted.
+constexpr size_t MAX_IOVEC_COUNT = 1024;
+
+// Don't let a single transfer overflow `int32_t` completion result.
+// Longer transfers are completed partially and must be resubmitted.
+constexpr size_t MAX_TRANSFER_SIZE = 1u << 30;
+
+// Opcodes are 8-bit, so is the maximal probe size
+constexpr uint32_t MAX_PROBE_OPS = 256;
+
+[[noreturn]] void throwErrno(int err, const char *details)
+{
+	throw Exception::fromErrorCode({ err, std::system_category() }, details);
+}
+
+uint32_t loadAcquire(uint32_t *ptr) noexcept
+{
+	return std::atomic_ref(*ptr).load(std::memory_order_acquire);
+}
+
+void storeRelease(uint32_t *ptr, uint32_t value) noexcept
+{
+	std::atomic_ref(*ptr).store(value, std::memory_order_release);
+}
+
+template<typename T>
+T *offsetPtr(void *base, uint32_t offset) noexcept
+{
+	return reinterpret_cast<T *>(static_cast<std::byte *>(base) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring(uint32_t entries)
+{
+	io_uring_params params {};
+
+	m_ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+	if (m_ring_fd < 0) {
+		throwErrno(errno, "'io_uring_setup' failed");
+	}
+
+	try {
+		m_sq_entries = params.sq_entries;
+
+		m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_mmap) {
+			m_sq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+		}
+
+		m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+			IORING_OFF_SQ_RING);
+		if (m_sq_ring == MAP_FAILED) {
+			m_sq_ring = nullptr;
+			throwErrno(errno, "'mmap' of io_uring SQ ring failed");
+		}
+
+		if (single_mmap) {
+			// Nothing to map separately, don't unmap it twice either
+			m_cq_ring = m_sq_ring;
+			m_cq_ring_size = 0;
+		} else {
+			m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+				IORING_OFF_CQ_RING);
+			if (m_cq_ring == MAP_FAILED) {
+				m_cq_ring = nullptr;
+				throwErrno(errno, "'mmap' of io_uring CQ ring failed");
+			}
+		}
+
+		m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		m_sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+			IORING_OFF_SQES);
+		if (m_sqes == MAP_FAILED) {
+			m_sqes = nullptr;
+			throwErrno(errno, "'mmap' of io_uring SQEs failed");
+		}
+
+		m_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+		if (m_wakeup_fd < 0) {
+			throwErrno(errno, "'eventfd' failed");
+		}
+
+		probeOps();
+	}
+	catch (...) {
+		release();
+		throw;
+	}
+
+	m_sq_head = offsetPtr<uint32_t>(m_sq_ring, params.sq_off.head);
+	m_sq_tail = offsetPtr<uint32_t>(m_sq_ring, params.sq_off.tail);
+	m_sq_mask = *offsetPtr<uint32_t>(m_sq_ring, params.sq_off.ring_mask);
+	m_sq_array = offsetPtr<uint32_t>(m_sq_ring, params.sq_off.array);
+	m_cq_head = offsetPtr<uint32_t>(m_cq_ring, params.cq_off.head);
+	m_cq_tail = offsetPtr<uint32_t>(m_cq_ring, params.cq_off.tail);
+	m_cq_mask = *offsetPtr<uint32_t>(m_cq_ring, params.cq_off.ring_mask);
+	m_cqes = offsetPtr<void>(m_cq_ring, params.cq_off.cqes);
+
+	m_sq_local_tail = *m_sq_tail;
+}
+
+IoUring::~IoUring() noexcept
+{
+	release();
+}
+
+void IoUring::release() noexcept
+{
+	if (m_sqes) {
+		munmap(m_sqes, m_sqes_size);
+	}
+
+	if (m_cq_ring && m_cq_ring_size > 0) {
+		munmap(m_cq_ring, m_cq_ring_size);
+	}
+
+	if (m_sq_ring) {
+		munmap(m_sq_ring, m_sq_ring_size);
+	}
+
+	if (m_ring_fd >= 0) {
+		close(m_ring_fd);
+	}
+
+	// Close it after the ring to not race with a pending wakeup read
+	if (m_wakeup_fd >= 0) {
+		close(m_wakeup_fd);
+	}
+}
+
+uint32_t IoUring::freeSqes() const noexcept
+{
+	return m_sq_entries - (m_sq_local_tail - loadAcquire(m_sq_head));
+}
+
+bool IoUring::supportsFixedBuffers() const noexcept
+{
+	return m_fixed_buffer_ops;
+}
+
+void IoUring::prepRead(Target target, std::span<std::byte> buffer, int64_t offset, uint64_t user_data) noexcept
+{
+	uint8_t opcode = target.buffer_index != NO_INDEX ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	prepRw(opcode, target, buffer.data(), buffer.size(), offset, user_data);
+}
+
+void IoUring::prepWrite(Target target, std::span<const std::byte> buffer, int64_t offset, uint64_t user_data) noexcept
+{
+	uint8_t opcode = target.buffer_index != NO_INDEX ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	prepRw(opcode, target, buffer.data(), buffer.size(), offset, user_data);
+}
+
+void IoUring::prepReadv(Target target, std::span<const IoVec> iovecs, int64_t offset, uint64_t user_data) noexcept
+{
+	target.buffer_index = NO_INDEX;
+	prepRw(IORING_OP_READV, target, iovecs.data(), std::min(iovecs.size(), MAX_IOVEC_COUNT), offset, user_data);
+}
+
+void IoUring::prepWritev(Target target, std::span<const IoVec> iovecs, int64_t offset, uint64_t user_data) noexcept
+{
+	target.buffer_index = NO_INDEX;
+	prepRw(IORING_OP_WRITEV, target, iovecs.data(), std::min(iovecs.size(), MAX_IOVEC_COUNT), offset, user_data);
+}
+
+void IoUring::prepWakeupRead(uint64_t user_data) noexcept
+{
+	prepRw(IORING_OP_READ, Target { .handle = m_wakeup_fd }, &m_wakeup_value, sizeof(m_wakeup_value), 0, user_data);
+}
+
+void IoUring::wake() noexcept
+{
+	// Can only fail on counter overflow, which means there is a pending wakeup anyway
+	uint64_t value = 1;
+	[[maybe_unused]] ssize_t res = write(m_wakeup_fd, &value, sizeof(value));
+}
+
+void IoUring::submit(uint32_t min_complete)
+{
+	// Publish all prepared entries at once
+	storeRelease(m_sq_tail, m_sq_local_tail);
+
+	const uint32_t flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+	while (true) {
+		long res = syscall(__NR_io_uring_enter, m_ring_fd, m_sq_pending, min_complete, flags, nullptr, 0);
+		if (res < 0) {
+			if (errno == EINTR) {
+				// Ignore signal interruptions
+				continue;
+			}
+
+			throwErrno(errno, "'io_uring_enter' failed");
+		}
+
+		// The kernel might consume less than we've asked, submit the rest then
+		m_sq_pending -= static_cast<uint32_t>(res);
+		if (m_sq_pending == 0) {
+			return;
+		}
+	}
+}
+
+size_t IoUring::reap(std::span<Completion> out) noexcept
+{
+	// We're the only one writing the head, no need to sync it
+	uint32_t head = *m_cq_head;
+	const uint32_t tail = loadAcquire(m_cq_tail);
+
+	size_t count = 0;
+	const auto *cqes = static_cast<const io_uring_cqe *>(m_cqes);
+
+	while (head != tail && count < out.size()) {
+		const io_uring_cqe &cqe = cqes[head & m_cq_mask];
+		out[count] = { .user_data = cqe.user_data, .result = cqe.res };
+		count++;
+		head++;
+	}
+
+	// Give CQ entries back to the kernel
+	storeRelease(m_cq_head, head);
+	return count;
+}
+
+void IoUring::registerFileTable(uint32_t size)
+{
+	// All slots are initially empty (sparse table)
+	std::vector<int> fds(size, -1);
+
+	if (syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_FILES, fds.data(), size) < 0) {
+		throwErrno(errno, "'io_uring_register(IORING_REGISTER_FILES)' failed");
+	}
+}
+
+void IoUring::updateFileSlot(uint32_t slot, os::File::NativeHandle handle)
+{
+	int fd = handle;
+	io_uring_files_update update {};
+	update.offset = slot;
+	update.fds = reinterpret_cast<uintptr_t>(&fd);
+
+	if (syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0) {
+		throwErrno(errno, "'io_uring_register(IORING_REGISTER_FILES_UPDATE)' failed");
+	}
+}
+
+void IoUring::registerBuffers(std::span<const std::span<std::byte>> buffers)
+{
+	std::vector<iovec> iovecs(buffers.size());
+	for (size_t i = 0; i < buffers.size(); i++) {
+		iovecs[i].iov_base = buffers[i].data();
+		iovecs[i].iov_len = buffers[i].size();
+	}
+
+	const auto count = static_cast<unsigned>(iovecs.size());
+	if (syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), count) < 0) {
+		throwErrno(errno, "'io_uring_register(IORING_REGISTER_BUFFERS)' failed");
+	}
+}
+
+void IoUring::probeOps()
+{
+	// Zero-initialized, as the kernel requires
+	const size_t probe_size = sizeof(io_uring_probe) + MAX_PROBE_OPS * sizeof(io_uring_probe_op);
+	auto probe_storage = std::make_unique<std::byte[]>(probe_size);
+	auto *probe = reinterpret_cast<io_uring_probe *>(probe_storage.get());
+
+	// Probing was added in the same kernel version as plain (non-vectored) read/write,
+	// so its failure means at least these operations are not supported either
+	if (syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_PROBE, probe, MAX_PROBE_OPS) < 0) {
+		throwErrno(errno, "'io_uring_register(IORING_REGISTER_PROBE)' failed");
+	}
+
+	auto supported = [probe](uint8_t opcode) {
+		return opcode < probe->ops_len && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+	};
+
+	// Wakeup read needs plain read too
+	for (uint8_t opcode : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV }) {
+		if (!supported(opcode)) {
+			throw Exception::fromError(std::make_error_condition(std::errc::function_not_supported),
+				"io_uring does not support required operations");
+		}
+	}
+
+	m_fixed_buffer_ops = supported(IORING_OP_READ_FIXED) && supported(IORING_OP_WRITE_FIXED);
+}
+
+void IoUring::prepRw(uint8_t opcode, Target target, const void *buffer, size_t size, int64_t offset,
+	uint64_t user_data) noexcept
+{
+	const uint32_t index = m_sq_local_tail & m_sq_mask;
+
+	io_uring_sqe *sqe = static_cast<io_uring_sqe *>(m_sqes) + index;
+	std::memset(sqe, 0, sizeof(io_uring_sqe));
+
+	sqe->opcode = opcode;
+	sqe->fd = target.fixed_slot != NO_INDEX ? static_cast<int32_t>(target.fixed_slot) : target.handle;
+	sqe->off = static_cast<uint64_t>(offset);
+	sqe->addr = reinterpret_cast<uintptr_t>(buffer);
+	sqe->len = static_cast<uint32_t>(std::min(size, MAX_TRANSFER_SIZE));
+	sqe->user_data = user_data;
+
+	if (target.fixed_slot != NO_INDEX) {
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+
+	if (target.buffer_index != NO_INDEX) {
+		sqe->buf_index = static_cast<uint16_t>(target.buffer_index);
+	}
+
+	m_sq_array[index] = index;
+	m_sq_local_tail++;
+	m_sq_pending++;
+}
+
+#else // _WIN32
+
+IoUring::IoUring(uint32_t)
+{
+	throw Exception::fromError(std::make_error_condition(std::errc::function_not_supported),
+		"io_uring is not available on this platform");
+}
+
+IoUring::~IoUring() noexcept = default;
+
+uint32_t IoUring::freeSqes() const noexcept
+{
+	return 0;
+}
+
+bool IoUring::supportsFixedBuffers() const noexcept
+{
+	return false;
+}
+
+void IoUring::prepRead(Target, std::span<std::byte>, int64_t, uint64_t) noexcept {}
+
+void IoUring::prepWrite(Target, std::span<const std::byte>, int64_t, uint64_t) noexcept {}
+
+void IoUring::prepReadv(Target, std::span<const IoVec>, int64_t, uint64_t) noexcept {}
+
+void IoUring::prepWritev(Target, std::span<const IoVec>, int64_t, uint64_t) noexcept {}
+
+void IoUring::prepWakeupRead(uint64_t) noexcept {}
+
+void IoUring::wake() noexcept {}
+
+void IoUring::submit(uint32_t) {}
+
+size_t IoUring::reap(std::span<Completion>) noexcept
+{
+	return 0;
+}
+
+void IoUring::registerFileTable(uint32_t) {}
+
+void IoUring::updateFileSlot(uint32_t, os::File::NativeHandle) {}
+
+void IoUring::registerBuffers(std::span<const std::span<std::byte>>) {}
+
+#endif // _WIN32
+
+} // namespace voxen::svc::detail
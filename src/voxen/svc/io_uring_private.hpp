@@ -0,0 +1,133 @@
+#pragma once
+
+#include <voxen/os/file.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace voxen::svc::detail
+{
+
+// Minimal wrapper over Linux io_uring interface, talking directly to syscalls.
+// Covers only what `AsyncFileIoService` needs: positional reads/writes,
+// registered (fixed) file table and registered buffers.
+//
+// Submission side is NOT thread-safe, it must be used from a single thread.
+// File/buffer registration functions and `wake()` can be called from any thread.
+//
+// On other platforms the constructor always throws, callers must fall back to something else.
+class IoUring {
+public:
+	// Slot/buffer index value meaning "not registered"
+	constexpr static uint32_t NO_INDEX = UINT32_MAX;
+
+	struct Completion {
+		uint64_t user_data;
+		// Non-negative - transferred bytes, negative - `-errno`
+		int32_t result;
+	};
+
+	// Describes where an I/O operation goes to
+	struct Target {
+		// Native file handle, ignored if `fixed_slot` is set
+		os::File::NativeHandle handle;
+		// Registered file table slot, or `NO_INDEX`
+		uint32_t fixed_slot = NO_INDEX;
+		// Index of registered buffer containing the transfer buffer, or `NO_INDEX`
+		uint32_t buffer_index = NO_INDEX;
+	};
+
+	// Layout-compatible with `struct iovec`
+	struct IoVec {
+		void *base;
+		size_t size;
+	};
+
+	// Create a ring with at least `entries` submission queue entries.
+	// Throws `Exception` if io_uring is unavailable (not Linux, old kernel,
+	// blocked by seccomp or sysctl, out of locked memory etc.) or if the kernel
+	// does not support some operations other than fixed-buffer transfers.
+	explicit IoUring(uint32_t entries);
+	IoUring(IoUring &&) = delete;
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(IoUring &&) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+	~IoUring() noexcept;
+
+	// Number of submission queue entries that can be prepared right now
+	uint32_t freeSqes() const noexcept;
+	// Whether the kernel supports fixed-buffer transfers, `registerBuffers()` is useless otherwise
+	bool supportsFixedBuffers() const noexcept;
+
+	// Prepare positional read, UB if `freeSqes() == 0`. Not submitted until `submit()`.
+	void prepRead(Target target, std::span<std::byte> buffer, int64_t offset, uint64_t user_data) noexcept;
+	// Prepare positional write, UB if `freeSqes() == 0`. Not submitted until `submit()`.
+	void prepWrite(Target target, std::span<const std::byte> buffer, int64_t offset, uint64_t user_data) noexcept;
+
+	// Prepare vectored positional read, UB if `freeSqes() == 0`. Not submitted until `submit()`.
+	// `iovecs` array must stay alive until completion. `target.buffer_index` is ignored.
+	void prepReadv(Target target, std::span<const IoVec> iovecs, int64_t offset, uint64_t user_data) noexcept;
+	// Prepare vectored positional write, UB if `freeSqes() == 0`. Not submitted until `submit()`.
+	// `iovecs` array must stay alive until completion. `target.buffer_index` is ignored.
+	void prepWritev(Target target, std::span<const IoVec> iovecs, int64_t offset, uint64_t user_data) noexcept;
+
+	// Prepare read from the internal wakeup eventfd, completing with `user_data` once `wake()`
+	// is called. UB if `freeSqes() == 0`. Must be prepared again after each such completion.
+	void prepWakeupRead(uint64_t user_data) noexcept;
+	// Complete pending wakeup read, interrupting `submit()` waiting for completions
+	void wake() noexcept;
+
+	// Submit all prepared entries in one syscall and wait until at least
+	// `min_complete` completions are available. Throws `Exception` on errors.
+	void submit(uint32_t min_complete);
+	// Take up to `out.size()` available completions, returns their number
+	size_t reap(std::span<Completion> out) noexcept;
+
+	// Register sparse fixed file table of `size` empty slots. Throws `Exception` on errors.
+	void registerFileTable(uint32_t size);
+	// Put `handle` into fixed file table `slot`, or clear it if `handle == INVALID_HANDLE`.
+	// Throws `Exception` on errors.
+	void updateFileSlot(uint32_t slot, os::File::NativeHandle handle);
+	// Register buffers for fixed-buffer transfers. Throws `Exception` on errors.
+	void registerBuffers(std::span<const std::span<std::byte>> buffers);
+
+private:
+#ifndef _WIN32
+	int m_ring_fd = -1;
+	int m_wakeup_fd = -1;
+	uint32_t m_sq_entries = 0;
+	// Target of wakeup eventfd reads
+	uint64_t m_wakeup_value = 0;
+
+	void *m_sq_ring = nullptr;
+	size_t m_sq_ring_size = 0;
+	void *m_cq_ring = nullptr;
+	size_t m_cq_ring_size = 0;
+	void *m_sqes = nullptr;
+	size_t m_sqes_size = 0;
+
+	uint32_t *m_sq_head = nullptr;
+	uint32_t *m_sq_tail = nullptr;
+	uint32_t m_sq_mask = 0;
+	uint32_t *m_sq_array = nullptr;
+	uint32_t *m_cq_head = nullptr;
+	uint32_t *m_cq_tail = nullptr;
+	uint32_t m_cq_mask = 0;
+	void *m_cqes = nullptr;
+
+	// Tail value not yet published to the kernel
+	uint32_t m_sq_local_tail = 0;
+	// Number of prepared but not yet submitted entries
+	uint32_t m_sq_pending = 0;
+
+	bool m_fixed_buffer_ops = false;
+
+	void probeOps();
+	void release() noexcept;
+	void prepRw(uint8_t opcode, Target target, const void *buffer, size_t size, int64_t offset,
+		uint64_t user_data) noexcept;
+#endif
+};
+
+} // namespace voxen::svc::detail
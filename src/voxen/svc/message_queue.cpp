@@ -7,7 +7,7 @@
 #include <extras/defer.hpp>
 
 #include <algorithm>
-#include <array>
+#include <bit>
 
 namespace voxen::svc
 {
@@ -16,6 +16,155 @@ using detail::InboundQueue;
 using detail::MessageHeader;
 using detail::MessageRouter;
 
+namespace
+{
+
+// Maps message UIDs to handler functions with O(1) lookups.
+// Handler items are stored in a dense array indexed from a power-of-two
+// slot table. UIDs are random so a window of bits from `v0` is a good hash.
+// On rebuild we look for a window that maps all UIDs to distinct slots
+// (semi-perfect hashing), otherwise collisions fall back to linear probing.
+// Rebuilds happen only on handler registration so they can be slow-ish.
+template<typename F>
+class DispatchTable {
+public:
+	// Returns pointer to the handler or null if not found
+	F *find(UID id) noexcept
+	{
+		if (m_slots.empty()) [[unlikely]] {
+			return nullptr;
+		}
+
+		for (size_t slot = slotOf(id);; slot = (slot + 1) & m_mask) {
+			uint32_t index = m_slots[slot];
+			if (index == EMPTY_SLOT) {
+				return nullptr;
+			}
+
+			if (m_items[index].first == id) [[likely]] {
+				return &m_items[index].second;
+			}
+		}
+	}
+
+	// Hint the CPU to load handler for `id` into cache. Only its "home" slot is
+	// considered, which is the only one unless the table fell back to probing.
+	void prefetch(UID id) const noexcept
+	{
+		if (m_slots.empty()) [[unlikely]] {
+			return;
+		}
+
+		uint32_t index = m_slots[slotOf(id)];
+		if (index != EMPTY_SLOT) {
+			__builtin_prefetch(&m_items[index]);
+		}
+	}
+
+	// Insert handler for `id` or replace the existing one
+	void insertOrReplace(UID id, F fn)
+	{
+		if (F *existing = find(id); existing) {
+			*existing = std::move(fn);
+			return;
+		}
+
+		m_items.emplace_back(id, std::move(fn));
+
+		try {
+			rebuild();
+		}
+		catch (...) {
+			m_items.pop_back();
+			throw;
+		}
+	}
+
+	// Remove handler for `id`, does nothing if it's not found
+	void erase(UID id) noexcept
+	{
+		auto iter = std::find_if(m_items.begin(), m_items.end(), [id](const Item &item) { return item.first == id; });
+		if (iter == m_items.end()) {
+			return;
+		}
+
+		// Order does not matter, move the last one in its place.
+		// Handler functions are not self-move safe, don't do it for the last one.
+		if (iter != m_items.end() - 1) {
+			*iter = std::move(m_items.back());
+		}
+		m_items.pop_back();
+
+		// Subset of items fits into the same geometry, no allocations needed
+		fillSlots(m_slots, m_shift, m_mask);
+	}
+
+private:
+	using Item = std::pair<UID, F>;
+
+	constexpr static uint32_t EMPTY_SLOT = UINT32_MAX;
+	// Keep load factor at most 1/2 so probing sequences stay short
+	constexpr static size_t MIN_SLOTS = 8;
+
+	std::vector<Item> m_items;
+	std::vector<uint32_t> m_slots;
+	uint32_t m_shift = 0;
+	uint32_t m_mask = 0;
+
+	size_t slotOf(UID id) const noexcept { return static_cast<size_t>(id.v0 >> m_shift) & m_mask; }
+
+	// Fill `slots` mapping all items with given geometry, returns true if there were no collisions
+	bool fillSlots(std::vector<uint32_t> &slots, uint32_t shift, uint32_t mask) const noexcept
+	{
+		std::fill(slots.begin(), slots.end(), EMPTY_SLOT);
+
+		bool perfect = true;
+		for (uint32_t i = 0; i < m_items.size(); i++) {
+			size_t slot = static_cast<size_t>(m_items[i].first.v0 >> shift) & mask;
+			while (slots[slot] != EMPTY_SLOT) {
+				perfect = false;
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = i;
+		}
+
+		return perfect;
+	}
+
+	void rebuild()
+	{
+		const size_t base_size = std::bit_ceil(std::max(MIN_SLOTS, m_items.size() * 2));
+
+		std::vector<uint32_t> slots;
+
+		// Try a couple of table sizes before settling on collisions
+		for (size_t size = base_size; size <= base_size * 2; size *= 2) {
+			slots.resize(size);
+
+			const auto bits = static_cast<uint32_t>(std::countr_zero(size));
+			const auto mask = static_cast<uint32_t>(size - 1);
+
+			for (uint32_t shift = 0; shift <= 64 - bits; shift++) {
+				if (fillSlots(slots, shift, mask)) {
+					m_slots = std::move(slots);
+					m_shift = shift;
+					m_mask = mask;
+					return;
+				}
+			}
+		}
+
+		// No perfect window found, use the smaller table with probing
+		slots.resize(base_size);
+		m_shift = 0;
+		m_mask = static_cast<uint32_t>(base_size - 1);
+		fillSlots(slots, m_shift, m_mask);
+		m_slots = std::move(slots);
+	}
+};
+
+} // namespace
+
 struct MessageQueue::Impl {
 	Impl() = default;
 	Impl(Impl &&other) noexcept { *this = std::move(other); }
@@ -26,6 +175,7 @@ struct MessageQueue::Impl {
 		std::swap(inbound_queue, other.inbound_queue);
 		std::swap(handlers, other.handlers);
 		std::swap(completion_handlers, other.completion_handlers);
+		std::swap(subscriptions, other.subscriptions);
 		return *this;
 	}
 
@@ -33,12 +183,12 @@ struct MessageQueue::Impl {
 	~Impl() = default;
 
 	InboundQueue *inbound_queue = nullptr;
-	// Sorted array of message UID => handler functions.
-	// Slow insertions but quite fast and cache-efficient lookups.
-	// TODO: use something with even faster/simpler lookups? Semi-perfect hashing?
-	std::vector<HandlerItem> handlers;
+	// Message UID => handler functions
+	DispatchTable<MessageHandler> handlers;
 	// Same for completion handlers
-	std::vector<CompletionHandlerItem> completion_handlers;
+	DispatchTable<CompletionHandler> completion_handlers;
+	// Sorted array of broadcast message UIDs this queue is subscribed to
+	std::vector<UID> subscriptions;
 };
 
 MessageQueue::MessageQueue() noexcept = default;
@@ -62,6 +212,11 @@ MessageQueue &MessageQueue::operator=(MessageQueue &&other) noexcept
 MessageQueue::~MessageQueue() noexcept
 {
 	if (m_impl->inbound_queue) {
+		// Unsubscribe before the queue gets released for reuse
+		for (UID topic : m_impl->subscriptions) {
+			m_router->unsubscribe(topic, m_impl->inbound_queue);
+		}
+
 		m_router->unregisterAgent(m_my_uid);
 	}
 }
@@ -70,65 +225,60 @@ void MessageQueue::pollMessages()
 {
 	Impl &impl = m_impl.object();
 
-	while (true) {
-		// Pop messages in small batches to take locks less often.
-		// TODO: make pop batch size tuneable?
-		std::array<MessageHeader *, 8> hdrs;
-		size_t popped = impl.inbound_queue->pop(hdrs);
+	// Queue pop is lock-free and takes all pending messages at once when its
+	// private chain runs out. Unhandled messages stay there if a handler throws.
+	while (MessageHeader *hdr = impl.inbound_queue->pop()) {
+		if (MessageHeader *next = impl.inbound_queue->peek(); next) {
+			// Hide memory latency of the next message. Its header was prefetched
+			// on the previous iteration, now prefetch its handler and the header after it.
+			__builtin_prefetch(next->queue_link);
 
-		if (popped == 0) {
-			return;
+			if (next->aux_data.is_completion_message) {
+				impl.completion_handlers.prefetch(next->msg_uid);
+			} else {
+				impl.handlers.prefetch(next->msg_uid);
+			}
 		}
 
-		for (size_t i = 0; i < popped; i++) {
-			MessageHeader *hdr = hdrs[i];
-
-			if (hdr->aux_data.is_completion_message) {
-				// Completion message, handle it specially.
-				// Release ref even if the handler throws
-				defer { hdr->releaseRef(); };
-
-				CompletionHandlerItem dummy_item(hdr->msg_uid, CompletionHandler());
-				auto handler_iter = std::lower_bound(impl.completion_handlers.begin(), impl.completion_handlers.end(),
-					dummy_item, completionHandlerComparator);
-				if (handler_iter != impl.completion_handlers.end() && handler_iter->first == hdr->msg_uid) {
-					RequestCompletionInfo info(hdr);
-					handler_iter->second(info, hdr->payload());
-				}
+		if (hdr->aux_data.is_completion_message) {
+			// Completion message, handle it specially.
+			// Release ref even if the handler throws
+			defer { hdr->releaseRef(); };
 
-				continue;
+			if (CompletionHandler *handler = impl.completion_handlers.find(hdr->msg_uid); handler) {
+				RequestCompletionInfo info(hdr);
+				(*handler)(info, hdr->payload());
 			}
 
-			HandlerItem dummy_item(hdr->msg_uid, MessageHandler());
-			auto handler_iter = std::lower_bound(impl.handlers.begin(), impl.handlers.end(), dummy_item,
-				handlerComparator);
-
-			bool handler_valid = handler_iter != impl.handlers.end() && handler_iter->first == hdr->msg_uid;
-
-			if (hdr->aux_data.has_request_block) {
-				// Request message, handle it specially
-				if (handler_valid) {
-					try {
-						MessageInfo info(hdr);
-						handler_iter->second(info, hdr->payload());
-						m_router->completeRequest(hdr, RequestStatus::Complete);
-					}
-					catch (...) {
-						hdr->requestBlock()->exception = std::current_exception();
-						m_router->completeRequest(hdr, RequestStatus::Failed);
-					}
-				} else {
-					m_router->completeRequest(hdr, RequestStatus::Dropped);
-				}
-			} else {
-				// Release ref even if the handler throws
-				defer{ hdr->releaseRef(); };
+			continue;
+		}
+
+		MessageHandler *handler = impl.handlers.find(hdr->msg_uid);
 
-				// Non-request message
-				if (handler_valid) {
+		if (hdr->aux_data.has_request_block) {
+			// Request message, handle it specially
+			if (handler) {
+				try {
 					MessageInfo info(hdr);
-					handler_iter->second(info, hdr->payload());
+					(*handler)(info, hdr->payload());
+					m_router->completeRequest(hdr, RequestStatus::Complete);
+				}
+				catch (...) {
+					hdr->requestBlock()->exception = std::current_exception();
+					m_router->completeRequest(hdr, RequestStatus::Failed);
 				}
+			} else {
+				m_router->completeRequest(hdr, RequestStatus::Dropped);
+			}
+		} else {
+			// Release ref even if the handler throws
+			defer{ hdr->releaseRef(); };
+
+			// Non-request message. Broadcasts come in envelopes referencing the shared message.
+			if (handler) {
+				MessageHeader *target = hdr->aux_data.is_broadcast_envelope ? hdr->broadcastTarget() : hdr;
+				MessageInfo info(target);
+				(*handler)(info, target->payload());
 			}
 		}
 	}
@@ -141,62 +291,74 @@ void MessageQueue::waitMessages(uint32_t timeout_msec)
 	pollMessages();
 }
 
-bool MessageQueue::handlerComparator(const HandlerItem &a, const HandlerItem &b) noexcept
+void MessageQueue::doRequestWithCompletion(UID to, UID msg_uid, MessageHeader *header, PayloadDeleter deleter)
 {
-	return a.first < b.first;
+	header->aux_data.needs_completion_message = 1;
+	doSend(to, msg_uid, header, deleter);
 }
 
-bool MessageQueue::completionHandlerComparator(const CompletionHandlerItem &a, const CompletionHandlerItem &b) noexcept
+void MessageQueue::doBroadcast(UID msg_uid, MessageHeader *header, PayloadDeleter deleter)
 {
-	return a.first < b.first;
+	header->from_uid = m_my_uid;
+	header->msg_uid = msg_uid;
+
+	if (deleter) {
+		header->deleterBlock()->deleter = deleter;
+	}
+
+	m_router->broadcast(header);
 }
 
-void MessageQueue::doRequestWithCompletion(UID to, UID msg_uid, MessageHeader *header, PayloadDeleter deleter)
+void MessageQueue::doRegisterHandler(UID msg_uid, MessageHandler handler)
 {
-	header->aux_data.needs_completion_message = 1;
-	doSend(to, msg_uid, header, deleter);
+	m_impl->handlers.insertOrReplace(msg_uid, std::move(handler));
 }
 
-void MessageQueue::doRegisterHandler(UID msg_uid, MessageHandler handler)
+void MessageQueue::doRegisterBroadcastHandler(UID msg_uid, MessageHandler handler)
 {
-	HandlerItem item(msg_uid, std::move(handler));
-	auto iter = std::lower_bound(m_impl->handlers.begin(), m_impl->handlers.end(), item, handlerComparator);
-	if (iter != m_impl->handlers.end() && iter->first == msg_uid) {
-		*iter = std::move(item);
-	} else {
-		m_impl->handlers.insert(iter, std::move(item));
+	auto &subs = m_impl->subscriptions;
+	auto iter = std::lower_bound(subs.begin(), subs.end(), msg_uid);
+	if (iter == subs.end() || *iter != msg_uid) {
+		iter = subs.insert(iter, msg_uid);
+
+		try {
+			m_router->subscribe(msg_uid, m_impl->inbound_queue);
+		}
+		catch (...) {
+			subs.erase(iter);
+			throw;
+		}
 	}
+
+	// If this throws we stay subscribed, incoming broadcasts will be dropped as unhandled
+	doRegisterHandler(msg_uid, std::move(handler));
 }
 
 void MessageQueue::doRegisterCompletionHandler(UID msg_uid, CompletionHandler handler)
 {
-	CompletionHandlerItem item(msg_uid, std::move(handler));
-	auto iter = std::lower_bound(m_impl->completion_handlers.begin(), m_impl->completion_handlers.end(), item,
-		completionHandlerComparator);
-	if (iter != m_impl->completion_handlers.end() && iter->first == msg_uid) {
-		*iter = std::move(item);
-	} else {
-		m_impl->completion_handlers.insert(iter, std::move(item));
-	}
+	m_impl->completion_handlers.insertOrReplace(msg_uid, std::move(handler));
 }
 
 void MessageQueue::doUnregisterHandler(UID msg_uid) noexcept
 {
-	HandlerItem dummy_item(msg_uid, MessageHandler());
-	auto iter = std::lower_bound(m_impl->handlers.begin(), m_impl->handlers.end(), dummy_item, handlerComparator);
-	if (iter != m_impl->handlers.end() && iter->first == msg_uid) {
-		m_impl->handlers.erase(iter);
+	m_impl->handlers.erase(msg_uid);
+}
+
+void MessageQueue::doUnregisterBroadcastHandler(UID msg_uid) noexcept
+{
+	auto &subs = m_impl->subscriptions;
+	auto iter = std::lower_bound(subs.begin(), subs.end(), msg_uid);
+	if (iter != subs.end() && *iter == msg_uid) {
+		subs.erase(iter);
+		m_router->unsubscribe(msg_uid, m_impl->inbound_queue);
 	}
+
+	doUnregisterHandler(msg_uid);
 }
 
 void MessageQueue::doUnregisterCompletionHandler(UID msg_uid) noexcept
 {
-	CompletionHandlerItem dummy_item(msg_uid, CompletionHandler());
-	auto iter = std::lower_bound(m_impl->completion_handlers.begin(), m_impl->completion_handlers.end(), dummy_item,
-		completionHandlerComparator);
-	if (iter != m_impl->completion_handlers.end() && iter->first == msg_uid) {
-		m_impl->completion_handlers.erase(iter);
-	}
+	m_impl->completion_handlers.erase(msg_uid);
 }
 
 } // namespace voxen::svc
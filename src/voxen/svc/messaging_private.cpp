@@ -17,6 +17,35 @@
 namespace voxen::svc::detail
 {
 
+namespace
+{
+
+void releaseBroadcastTarget(void *payload) noexcept
+{
+	(*static_cast<MessageHeader **>(payload))->releaseRef();
+}
+
+// Allocate per-recipient envelope for broadcast message `msg`, taking a ref to it
+MessageHeader *makeBroadcastEnvelope(MessageHeader *msg)
+{
+	constexpr size_t SIZE = sizeof(MessageHeader) + sizeof(MessageDeleterBlock) + sizeof(MessageHeader *);
+
+	void *alloc = PipeMemoryAllocator::allocate(SIZE, alignof(void *));
+	MessageHeader *envelope = new (alloc) MessageHeader(true, false);
+
+	envelope->from_uid = msg->from_uid;
+	envelope->msg_uid = msg->msg_uid;
+	envelope->aux_data.is_broadcast_envelope = 1;
+	envelope->deleterBlock()->deleter = &releaseBroadcastTarget;
+	*static_cast<MessageHeader **>(envelope->payload()) = msg;
+
+	// Relaxed - we're already holding a ref, nothing to synchronize with
+	msg->aux_data.atomic_word.fetch_add(1, std::memory_order_relaxed);
+	return envelope;
+}
+
+} // namespace
+
 static_assert(std::is_trivially_destructible_v<MessageHeader>);
 static_assert(std::is_trivially_destructible_v<MessageDeleterBlock>);
 static_assert(std::is_nothrow_destructible_v<MessageRequestBlock>);
@@ -84,122 +113,108 @@ void *MessageHeader::payload() noexcept
 
 void InboundQueue::push(MessageHeader *hdr) noexcept
 {
-	hdr->queue_link = nullptr;
-
-	std::lock_guard lk(m_lock);
-
-	if (!m_newest) {
-		// Empty queue
-		m_newest = hdr;
-		m_oldest = hdr;
-	} else {
-		// Non-empty queue
-		m_newest->queue_link = hdr;
-		m_newest = hdr;
-	}
+	// Treiber-style push. Can't use a plain exchange here - the consumer
+	// could grab the chain before `queue_link` of the new head is written.
+	MessageHeader *head = m_pushed_head.load(std::memory_order_relaxed);
+	do {
+		hdr->queue_link = head;
+	} while (!m_pushed_head.compare_exchange_weak(head, hdr, std::memory_order_seq_cst, std::memory_order_relaxed));
 
 	// Notify waiting thread that messages have arrived.
-	// Relaxed order - no extra sync is needed inside critical section.
-	if (m_wait_word.exchange(0, std::memory_order_relaxed) == 1) {
-		// Note - waking while still holding a lock.
-		// It eliminates any chance of double wake-up.
+	// Seq-cst order pairs with `wait()`: either we see the waiting flag
+	// here or the consumer sees our message before going to sleep.
+	// Check before exchanging to not write the shared line on every push.
+	if (m_wait_word.load(std::memory_order_seq_cst) == 1
+		&& m_wait_word.exchange(0, std::memory_order_relaxed) == 1) {
+		// Only one pusher can reset the flag, no double wake-ups
 		os::Futex::wakeSingle(&m_wait_word);
 	}
 }
 
 MessageHeader *InboundQueue::pop() noexcept
 {
-	std::lock_guard lk(m_lock);
-
-	if (!m_oldest) {
+	if (!m_consumer_chain && !grabPushed()) {
 		// Empty queue
 		return nullptr;
 	}
 
-	MessageHeader *msg = std::exchange(m_oldest, m_oldest->queue_link);
-
-	if (!m_oldest) {
-		// Just popped the last element
-		m_newest = nullptr;
-	}
-
-	return msg;
-}
-
-size_t InboundQueue::pop(std::span<MessageHeader *> msgs) noexcept
-{
-	std::lock_guard lk(m_lock);
-
-	uint32_t popped = 0;
-	while (popped < msgs.size()) {
-		if (!m_oldest) {
-			break;
-		}
-
-		msgs[popped] = std::exchange(m_oldest, m_oldest->queue_link);
-		popped++;
-	}
-
-	if (!m_oldest) {
-		// Popped the last element
-		m_newest = nullptr;
-	}
-
-	return popped;
+	return std::exchange(m_consumer_chain, m_consumer_chain->queue_link);
 }
 
 void InboundQueue::clear() noexcept
 {
-	std::lock_guard lk(m_lock);
-
-	while (m_oldest) {
-		MessageHeader *msg = std::exchange(m_oldest, m_oldest->queue_link);
+	while (MessageHeader *msg = pop()) {
 		msg->releaseRef();
 	}
-
-	m_newest = nullptr;
 }
 
 void InboundQueue::wait(uint32_t timeout_msec) noexcept
 {
+	if (m_consumer_chain) {
+		// Already got some messages
+		return;
+	}
+
 	auto time_point_now = std::chrono::steady_clock::now();
 	auto target_time_point = time_point_now + std::chrono::milliseconds(timeout_msec);
 
 	while (true) {
-		// No `lock_guard` - be careful
-		m_lock.lock();
-
-		if (m_oldest != nullptr) {
+		if (m_pushed_head.load(std::memory_order_relaxed) != nullptr) {
 			// Already got some messages
-			m_lock.unlock();
 			return;
 		}
 
-		// Check if the timeout has expired.
-		// Update time point as taking lock could take some time.
+		// Check if the timeout has expired
 		time_point_now = std::chrono::steady_clock::now();
 		if (time_point_now >= target_time_point) {
 			// Timeout expired
-			m_lock.unlock();
 			return;
 		}
 
-		// Set waiting flag. Note that we should hold the lock,
-		// otherwise a pushing thread can miss this value.
-		// Relaxed order - no extra sync is needed inside critical section.
-		m_wait_word.store(1, std::memory_order_relaxed);
-		// Note - dropping the lock just before waiting
-		m_lock.unlock();
+		// Set waiting flag then re-check the queue. Seq-cst order pairs
+		// with `push()`, see the comment there. Without it a pushing
+		// thread could miss this flag and we would sleep till timeout.
+		m_wait_word.store(1, std::memory_order_seq_cst);
+		if (m_pushed_head.load(std::memory_order_seq_cst) != nullptr) {
+			// Pushed just before we've set the flag. Resetting it is
+			// not strictly needed but saves pushers from futex syscalls.
+			m_wait_word.store(0, std::memory_order_relaxed);
+			return;
+		}
 
 		auto time_diff = target_time_point - time_point_now;
 		auto timeout = std::chrono::duration_cast<std::chrono::duration<uint32_t, std::milli>>(time_diff);
 		// Wait until it is reset back to zero by a pushing thread.
-		// As we're not holding the lock it can happen right before entering
-		// the function - that's ok, then it will return immediately.
+		// That can happen right before entering the function -
+		// that's ok, then it will return immediately.
 		os::Futex::waitFor(&m_wait_word, 1, timeout.count());
 	}
 }
 
+bool InboundQueue::grabPushed() noexcept
+{
+	// Cheap check to not write the shared line when there is nothing to take
+	if (m_pushed_head.load(std::memory_order_relaxed) == nullptr) {
+		return false;
+	}
+
+	// Take the whole chain at once, acquire pairs with CAS in `push()`
+	MessageHeader *newest = m_pushed_head.exchange(nullptr, std::memory_order_acquire);
+
+	// Reverse it from newest-first into FIFO order. Called
+	// only when the private chain is empty, just replace it.
+	MessageHeader *oldest = nullptr;
+	while (newest) {
+		MessageHeader *next = newest->queue_link;
+		newest->queue_link = oldest;
+		oldest = newest;
+		newest = next;
+	}
+
+	m_consumer_chain = oldest;
+	return oldest != nullptr;
+}
+
 // --- RoutingShard ---
 
 InboundQueue *RoutingShard::findRoute(UID id) noexcept
@@ -243,6 +258,56 @@ InboundQueue *RoutingShard::removeRoute(UID id) noexcept
 	return q;
 }
 
+void RoutingShard::subscribe(UID topic, InboundQueue *q)
+{
+	// Exclusive lock - we're writing
+	std::lock_guard lk(m_lock);
+
+	Topic dummy(topic, {});
+	auto iter = std::lower_bound(m_topics.begin(), m_topics.end(), dummy, topicComparator);
+	if (iter == m_topics.end() || iter->first != topic) {
+		iter = m_topics.insert(iter, std::move(dummy));
+	}
+
+	std::vector<InboundQueue *> &queues = iter->second;
+	if (std::find(queues.begin(), queues.end(), q) == queues.end()) {
+		try {
+			queues.emplace_back(q);
+		}
+		catch (...) {
+			if (queues.empty()) {
+				// Don't leave an empty topic we've just inserted
+				m_topics.erase(iter);
+			}
+			throw;
+		}
+	}
+}
+
+void RoutingShard::unsubscribe(UID topic, InboundQueue *q) noexcept
+{
+	// Exclusive lock - we're writing
+	std::lock_guard lk(m_lock);
+
+	Topic dummy(topic, {});
+	auto iter = std::lower_bound(m_topics.begin(), m_topics.end(), dummy, topicComparator);
+	if (iter == m_topics.end() || iter->first != topic) {
+		return;
+	}
+
+	std::vector<InboundQueue *> &queues = iter->second;
+	auto q_iter = std::find(queues.begin(), queues.end(), q);
+	if (q_iter != queues.end()) {
+		// Order does not matter, swap with the last one
+		*q_iter = queues.back();
+		queues.pop_back();
+	}
+
+	if (queues.empty()) {
+		m_topics.erase(iter);
+	}
+}
+
 // --- MessageRouter ---
 
 InboundQueue *MessageRouter::registerAgent(UID id)
@@ -302,6 +367,18 @@ void MessageRouter::send(UID to, MessageHeader *msg) noexcept
 	}
 }
 
+void MessageRouter::broadcast(MessageHeader *msg)
+{
+	// Drop the sender's ref after fan-out. The payload will be
+	// destroyed by the last recipient or right here if there are none.
+	defer { msg->releaseRef(); };
+
+	// Envelopes are pushed under the shard lock so queues can't get unsubscribed
+	// and reused by another agent in the meantime. Pushing is cheap and lock-free.
+	getShard(msg->msg_uid).forEachSubscriber(msg->msg_uid,
+		[msg](InboundQueue *q) { q->push(makeBroadcastEnvelope(msg)); });
+}
+
 void MessageRouter::completeRequest(MessageHeader *msg, RequestStatus status) noexcept
 {
 	constexpr uint32_t WAIT_BIT = 1u << 16;
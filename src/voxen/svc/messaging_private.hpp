@@ -7,9 +7,11 @@
 
 #include <extras/hardware_params.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <exception>
-#include <span>
+#include <shared_mutex>
 #include <vector>
 
 namespace voxen::svc::detail
@@ -28,11 +30,16 @@ struct MessageAuxData {
 	// Set when this is a completion message rather than an incoming request.
 	// Otherwise there is no difference, completions have the same UID and payload.
 	uint32_t is_completion_message : 1 = 0;
+	// Set for a per-recipient broadcast envelope. Its payload is a pointer to
+	// the shared broadcast message, and its deleter releases a ref to it.
+	uint32_t is_broadcast_envelope : 1 = 0;
 	// Unused bits, can become used if we add more features
-	uint32_t _padding : 20 = 0;
+	uint32_t _padding : 19 = 0;
 	// Atomic value for per-message locking, refcounting etc.
 	// In current implementation, stores:
-	// Bits [15:0] - refcount (initially 1 from header pointer after allocation)
+	// Bits [15:0] - refcount (initially 1 from header pointer after allocation).
+	//               Broadcast messages take one ref per envelope, so the number
+	//               of subscribers to one message UID must stay below 65535.
 	// Bits [16:16] - futex completion waiting flag (0 - no waiting, 1 - needs waking)
 	// Bits [18:17] - value of `RequestStatus` (0 - pending, other values mean complete)
 	// Bits [31:19] - unused, must be zero
@@ -69,8 +76,13 @@ struct MessageHeader {
 	MessageRequestBlock *requestBlock() noexcept;
 	// Payload bytes start after the header and optional blocks
 	void *payload() noexcept;
+	// Get shared message referenced by broadcast envelope (UB if `!aux_data.is_broadcast_envelope`)
+	MessageHeader *broadcastTarget() noexcept { return *static_cast<MessageHeader **>(payload()); }
 };
 
+// Intrusive lock-free multi-producer single-consumer queue.
+// Producers push onto an atomic LIFO stack head, consumer takes the whole
+// stack in one atomic exchange and reverses it into FIFO order privately.
 class alignas(extras::hardware_params::cache_line) InboundQueue {
 public:
 	InboundQueue() = default;
@@ -82,14 +94,18 @@ public:
 
 	// Insert message into the queue as the newest using its `queue_link` field.
 	// Ownership is acquired, `destroy()` will be called on `clear()`.
+	// Can be called from any thread, does not take locks.
 	void push(MessageHeader *msg) noexcept;
 	// Remove the oldest message from the queue, returns null if queue is empty.
 	// Ownership is released, you must call `destroy()` on it.
+	// Can be called only from one thread (owning the message queue).
 	MessageHeader *pop() noexcept;
-	// Remove multiple oldest messages in order, returns the number of removed messages.
-	// It will not be greater than `msgs.size()`, remaining `msgs` items are unchanged.
-	size_t pop(std::span<MessageHeader *> msgs) noexcept;
+	// Returns the message the next `pop()` will return without removing it.
+	// Can return null even if the queue is not empty, use only as a hint.
+	// Can be called only from one thread (owning the message queue).
+	MessageHeader *peek() const noexcept { return m_consumer_chain; }
 	// Drop all messages from the queue, destroying them.
+	// Can be called only from one thread (owning the message queue).
 	void clear() noexcept;
 
 	// Wait for up to `timeout_msec` until any message comes in.
@@ -100,10 +116,18 @@ public:
 	void wait(uint32_t timeout_msec) noexcept;
 
 private:
-	os::FutexLock m_lock;
+	// Newest pushed message, linked to older ones through `queue_link`.
+	// Written by producers, taken as a whole by the consumer.
+	std::atomic<MessageHeader *> m_pushed_head = nullptr;
+	// Set to 1 by the consumer before sleeping on futex, reset by producers
 	std::atomic_uint32_t m_wait_word = 0;
-	MessageHeader *m_oldest = nullptr;
-	MessageHeader *m_newest = nullptr;
+
+	// Consumer-private chain in FIFO order (oldest first), not yet popped.
+	// On a separate cache line to not bounce it with producers' writes.
+	alignas(extras::hardware_params::cache_line) MessageHeader *m_consumer_chain = nullptr;
+
+	// Take all pushed messages into (empty) `m_consumer_chain`, returns false if there were none
+	bool grabPushed() noexcept;
 };
 
 // A component of `MessageRouter`, usually should not be used directly
@@ -117,17 +141,43 @@ public:
 	// Removes inbound queue record for `id` and returns that queue (null if not recorded)
 	InboundQueue *removeRoute(UID id) noexcept;
 
+	// Adds `q` to subscribers of broadcast message `topic`. Does nothing if it's already there.
+	void subscribe(UID topic, InboundQueue *q);
+	// Removes `q` from subscribers of broadcast message `topic`. Does nothing if it's not there.
+	void unsubscribe(UID topic, InboundQueue *q) noexcept;
+	// Calls `fn(InboundQueue *)` for every subscriber of `topic`.
+	// Subscriptions can't change during this call, keep `fn` short.
+	template<typename F>
+	void forEachSubscriber(UID topic, F &&fn)
+	{
+		// Shared lock - we're only reading
+		std::shared_lock lk(m_lock);
+
+		Topic dummy(topic, {});
+		auto iter = std::lower_bound(m_topics.begin(), m_topics.end(), dummy, topicComparator);
+		if (iter != m_topics.end() && iter->first == topic) {
+			for (InboundQueue *q : iter->second) {
+				fn(q);
+			}
+		}
+	}
+
 private:
 	using Route = std::pair<UID, InboundQueue *>;
+	using Topic = std::pair<UID, std::vector<InboundQueue *>>;
 
-	// Protects access to `m_routes`
+	// Protects access to `m_routes` and `m_topics`
 	os::FutexRWLock m_lock;
 	// Maps registered agent UIDs to their inbound queues.
 	// Sorted array of agent UID => his inbound queue mappings.
 	// Slow insertions but quite fast and cache-efficient lookups.
 	std::vector<Route> m_routes;
+	// Maps broadcast message UIDs to inbound queues subscribed to them.
+	// Sorted the same way, topics with no subscribers are removed.
+	std::vector<Topic> m_topics;
 
 	static bool routeComparator(const Route &a, const Route &b) noexcept { return a.first < b.first; }
+	static bool topicComparator(const Topic &a, const Topic &b) noexcept { return a.first < b.first; }
 };
 
 // Routes UIDs to inbound message queues
@@ -153,6 +203,16 @@ public:
 	// You disown the pointer after this call, don't release ref manually.
 	void completeRequest(MessageHeader *msg, RequestStatus status) noexcept;
 
+	// Subscribe inbound queue `q` to broadcast messages with UID `topic`
+	void subscribe(UID topic, InboundQueue *q) { getShard(topic).subscribe(topic, q); }
+	// Remove subscription of inbound queue `q` to broadcast messages with UID `topic`
+	void unsubscribe(UID topic, InboundQueue *q) noexcept { getShard(topic).unsubscribe(topic, q); }
+	// Put a small envelope referencing broadcast message `msg` into the inbound queue of every
+	// agent subscribed to its UID. Payload is not copied, all envelopes share `msg` by refcount.
+	// You disown the pointer after this call (even if it throws), don't release ref manually.
+	// Throws `std::bad_alloc` if envelope allocation fails, some subscribers will then miss it.
+	void broadcast(MessageHeader *msg);
+
 	// Every UID belongs to one shard
 	RoutingShard &getShard(UID id) noexcept { return m_shards[id.v1 % NUM_SHARDS]; }
 
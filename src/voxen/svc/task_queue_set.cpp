@@ -6,8 +6,6 @@
 
 #include "task_handle_private.hpp"
 
-#include <array>
-#include <bit>
 #include <cassert>
 #include <chrono>
 
@@ -17,31 +15,24 @@ namespace voxen::svc::detail
 namespace
 {
 
+// Worker thread binding, see `TaskQueueSet::attachWorkerThread()`
+thread_local TaskQueueSet *t_attached_queue_set = nullptr;
+thread_local size_t t_attached_queue = 0;
+
 void onQueueOverflow(size_t queue)
 {
 	static os::FutexLock s_lock;
 	static auto s_last_warn_time = std::chrono::steady_clock::time_point();
 
-	{
-		std::lock_guard lock(s_lock);
-		auto now = std::chrono::steady_clock::now();
+	std::lock_guard lock(s_lock);
+	auto now = std::chrono::steady_clock::now();
 
-		if (s_last_warn_time == std::chrono::steady_clock::time_point()
-			|| now - s_last_warn_time > std::chrono::seconds(5)) {
-			s_last_warn_time = now;
-			Log::warn("TaskQueueSet: task queue #{} is overflown! Check ring buffer sizes and load distribution.", queue);
-			Log::warn("This means slave threads are overwhelmed, and performance will be severely harmed.");
-		}
+	if (s_last_warn_time == std::chrono::steady_clock::time_point()
+		|| now - s_last_warn_time > std::chrono::seconds(5)) {
+		s_last_warn_time = now;
+		Log::warn("TaskQueueSet: task queue #{} is overflown! Check ring buffer sizes and load distribution.", queue);
+		Log::warn("This means slave threads are overwhelmed, and performance will be severely harmed.");
 	}
-
-	// Our performance is surely ruined anyway, so we could as well just sleep
-	// to throttle task generation and give slave threads some time to catch up.
-	//
-	// TODO: but the effect will be quite the opposite if we are pushing
-	// into our own thread's queue, e.g. a continuation or pinned task.
-	//
-	// Also see TODO at the call site in `pushTask()`.
-	std::this_thread::sleep_for(std::chrono::microseconds(100));
 }
 
 } // namespace
@@ -50,6 +41,7 @@ TaskQueueSet::TaskQueueSet(size_t num_queues)
 	: m_num_queues(num_queues)
 	, m_ring_buffer_header(std::make_unique<RingBufferHeader[]>(num_queues))
 	, m_ring_buffer_storage(std::make_unique<RingBufferStorage[]>(num_queues))
+	, m_work_deques(std::make_unique<WorkDeque[]>(num_queues))
 {
 	// Indices are two uint32 packed together, atomics must work like on uint64
 	static_assert(std::atomic<ProduceConsumeIndex>::is_always_lock_free);
@@ -60,67 +52,149 @@ TaskQueueSet::~TaskQueueSet()
 	// Any remaining stored tasks will never be marked as complete
 	// and can deadlock the system if something else depends on them.
 	// Most likely this will mean a bug in slave threads logic.
-	for (size_t queue = 0; queue < m_num_queues; queue++) {
-		size_t remaining_tasks = 0;
+	size_t remaining_tasks = 0;
 
-		// Deref them anyway to at least not leak memory
-		PrivateTaskHandle handle = tryPopTask(queue);
-		while (handle.valid()) {
+	// Deref them anyway to at least not leak memory
+	for (size_t queue = 0; queue < m_num_queues; queue++) {
+		while (TaskHeader *task = tryPopRing(queue)) {
+			PrivateTaskHandle handle(task);
 			remaining_tasks++;
-			handle = tryPopTask(queue);
 		}
 
-		if (remaining_tasks > 0) [[unlikely]] {
-			Log::warn(
-				"~TaskQueueSet: {} remaining tasks in queue #{}! Probably the associated slave thread "
-				"has exited without draining the queue. This is most likely a bug, risk of deadlock.",
-				remaining_tasks, queue);
+		while (TaskHeader *task = tryStealDeque(queue)) {
+			PrivateTaskHandle handle(task);
+			remaining_tasks++;
 		}
 	}
+
+	for (TaskHeader *task : m_overflow_queue) {
+		PrivateTaskHandle handle(task);
+		remaining_tasks++;
+	}
+
+	if (remaining_tasks > 0) [[unlikely]] {
+		Log::warn(
+			"~TaskQueueSet: {} remaining tasks in queues! Probably slave threads have exited "
+			"without draining them. This is most likely a bug, risk of deadlock.",
+			remaining_tasks);
+	}
+}
+
+void TaskQueueSet::attachWorkerThread(size_t queue) noexcept
+{
+	assert(queue < m_num_queues);
+	t_attached_queue_set = this;
+	t_attached_queue = queue;
+}
+
+bool TaskQueueSet::tryPushLocal(PrivateTaskHandle &handle)
+{
+	if (t_attached_queue_set != this) {
+		return false;
+	}
+
+	// We store raw pointers and assume "nullptr => no data".
+	// So pushing in an invalid (null) task handle will blow it up.
+	assert(handle.valid());
+
+	const size_t queue = t_attached_queue;
+	TaskHeader *task = handle.get();
+
+	if (!tryPushDeque(queue, task) && !tryPushRing(queue, task)) [[unlikely]] {
+		onQueueOverflow(queue);
+		// Can throw, keep the ownership until it's pushed
+		pushOverflow(task);
+	}
+
+	// Ownership is transferred to the queue
+	(void) handle.release();
+	wakeSleepingThread();
+	return true;
 }
 
-void TaskQueueSet::pushTask(size_t queue, PrivateTaskHandle handle) noexcept
+void TaskQueueSet::pushTask(size_t queue, PrivateTaskHandle handle)
 {
 	// We store raw pointers and assume "nullptr => no data".
 	// So pushing in an invalid (null) task handle will blow it up.
 	assert(handle.valid());
 
+	TaskHeader *task = handle.get();
+
+	if (!tryPushRing(queue, task)) [[unlikely]] {
+		onQueueOverflow(queue);
+		// Can throw, then `handle` destroys the task
+		pushOverflow(task);
+	}
+
+	// Ownership is transferred to the queue
+	(void) handle.release();
+	wakeSleepingThread();
+}
+
+PrivateTaskHandle TaskQueueSet::tryPopTask(size_t queue) noexcept
+{
+	if (m_stop_requested.load(std::memory_order_relaxed)) [[unlikely]] {
+		return {};
+	}
+
+	return PrivateTaskHandle(tryFindTask(queue, false));
+}
+
+PrivateTaskHandle TaskQueueSet::popTaskOrWait(size_t queue) noexcept
+{
+	while (!m_stop_requested.load(std::memory_order_relaxed)) {
+		if (TaskHeader *task = tryFindTask(queue, true); task) {
+			return PrivateTaskHandle(task);
+		}
+
+		// Nothing found - announce we're going to sleep, then check everything
+		// once again. Any push after this point will see the sleeping counter
+		// and increment the epoch, so we can't miss a wakeup. This pairs with
+		// the fence in `wakeSleepingThread()`.
+		m_num_sleeping.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const uint32_t epoch = m_wake_epoch.load(std::memory_order_acquire);
+
+		TaskHeader *task = tryFindTask(queue, true);
+		if (!task && !m_stop_requested.load(std::memory_order_acquire)) {
+			os::Futex::waitInfinite(&m_wake_epoch, epoch);
+		}
+
+		m_num_sleeping.fetch_sub(1, std::memory_order_relaxed);
+
+		if (task) {
+			return PrivateTaskHandle(task);
+		}
+	}
+
+	// Stop requested
+	return {};
+}
+
+void TaskQueueSet::requestStopAll() noexcept
+{
+	m_stop_requested.store(true, std::memory_order_release);
+	m_wake_epoch.fetch_add(1, std::memory_order_release);
+	os::Futex::wakeAll(&m_wake_epoch);
+}
+
+bool TaskQueueSet::tryPushRing(size_t queue, TaskHeader *task) noexcept
+{
 	auto &header = m_ring_buffer_header[queue];
 	auto &storage = m_ring_buffer_storage[queue];
 
 	ProduceConsumeIndex index = header.current_index.load(std::memory_order_relaxed);
 	std::atomic<TaskHeader *> *item = nullptr;
-	bool need_wake = false;
 
 	while (true) {
-		assert(index.produce >= index.consume);
-		assert(index.produce <= index.consume + RING_BUFFER_SIZE);
-
-		if (index.consume + RING_BUFFER_SIZE == index.produce) [[unlikely]] {
-			// Buffer is full, warn and stall.
-			//
-			// TODO: I know this is not at all expected and should be solved by
-			// adjusting ring buffer sizes or the task generation strategy
-			// (i.e. reduce workload, available CPU cores can't keep up with it).
-			//
-			// But still there are better ways to handle it from the caller side:
-			// - Try pushing to other queues, maybe some is not as full. Though if one queue
-			//   is overflown then others are most likely close to that too, otherwise
-			//   work stealing mechanism should quickly take care of this.
-			// - Switch into "assist" mode - pop some tasks off this queue and execute
-			//   them as if we're the slave thread. Though it won't help if those tasks
-			//   generate more tasks themselves and are just the reason why we got here.
-			// - Introduce a separate unbounded "overflow queue", something like a locked deque,
-			//   and push this task there. Won't help with sustained task overwhelming but is
-			//   good enough to go through short workload bursts without ruining perf completely.
-			onQueueOverflow(queue);
-			index = header.current_index.load(std::memory_order_relaxed);
-			continue;
+		assert(index.produce - index.consume <= RING_BUFFER_SIZE);
+
+		if (index.produce - index.consume == RING_BUFFER_SIZE) [[unlikely]] {
+			// Buffer is full
+			return false;
 		}
 
 		item = &storage.item[index.produce % RING_BUFFER_SIZE];
-		// Someone waits on this queue - remember it
-		need_wake = index.wait_flag;
 
 		// XXX: I'm not sure if this is the most appropriate memory order
 		if (item->load(std::memory_order_acquire) != nullptr) [[unlikely]] {
@@ -133,11 +207,7 @@ void TaskQueueSet::pushTask(size_t queue, PrivateTaskHandle handle) noexcept
 		bool success = header.current_index.compare_exchange_weak(index,
 			{
 				.produce = index.produce + 1u,
-				// Reset the wait flag
-				.wait_flag = 0,
 				.consume = index.consume,
-				// Preserve the stop flag
-				.stop_flag = index.stop_flag,
 			},
 			// XXX: I'm not sure if this is the most appropriate memory order
 			std::memory_order_acq_rel);
@@ -147,16 +217,12 @@ void TaskQueueSet::pushTask(size_t queue, PrivateTaskHandle handle) noexcept
 		}
 	}
 
-	// `item` is "reserved" for us now - no other push or pop can touch it.
-	item->store(handle.release(), std::memory_order_release);
-	// Don't forget to wake any thread that could wait for new items
-	if (need_wake) {
-		// See waiting code in `popTaskOrWait()` to understand this cast
-		os::Futex::wakeAll(reinterpret_cast<std::atomic_uint32_t *>(&header.current_index));
-	}
+	// `item` is "reserved" for us now - no other push or pop can touch it
+	item->store(task, std::memory_order_release);
+	return true;
 }
 
-PrivateTaskHandle TaskQueueSet::tryPopTask(size_t queue) noexcept
+TaskHeader *TaskQueueSet::tryPopRing(size_t queue) noexcept
 {
 	auto &header = m_ring_buffer_header[queue];
 	auto &storage = m_ring_buffer_storage[queue];
@@ -165,24 +231,19 @@ PrivateTaskHandle TaskQueueSet::tryPopTask(size_t queue) noexcept
 	std::atomic<TaskHeader *> *item = nullptr;
 
 	while (true) {
-		assert(index.produce >= index.consume);
-		assert(index.produce <= index.consume + RING_BUFFER_SIZE);
-
-		if (index.stop_flag) [[unlikely]] {
-			// Stop requested
-			return {};
-		}
+		assert(index.produce - index.consume <= RING_BUFFER_SIZE);
 
-		if (index.produce == index.consume) [[unlikely]] {
+		if (index.produce == index.consume) {
 			// Buffer is empty
-			return {};
+			return nullptr;
 		}
 
 		item = &storage.item[index.consume % RING_BUFFER_SIZE];
 
 		// XXX: I'm not sure if this is the most appropriate memory order
 		if (item->load(std::memory_order_acquire) == nullptr) [[unlikely]] {
-			// Someone has taken this item before us, reload indices and try again
+			// Someone has taken this item before us, or the producer
+			// has not stored it yet. Reload indices and try again.
 			index = header.current_index.load(std::memory_order_relaxed);
 			continue;
 		}
@@ -191,11 +252,7 @@ PrivateTaskHandle TaskQueueSet::tryPopTask(size_t queue) noexcept
 		bool success = header.current_index.compare_exchange_weak(index,
 			{
 				.produce = index.produce,
-				// Preserve the wait flag
-				.wait_flag = index.wait_flag,
 				.consume = index.consume + 1u,
-				// Preserve the stop flag (must be zero if we reached here)
-				.stop_flag = 0,
 			},
 			// XXX: I'm not sure if this is the most appropriate memory order
 			std::memory_order_acq_rel);
@@ -203,118 +260,162 @@ PrivateTaskHandle TaskQueueSet::tryPopTask(size_t queue) noexcept
 		if (success) [[likely]] {
 			break;
 		}
-	};
+	}
 
 	// `item` is "reserved" for us now - no other pop or push can touch it.
 	// XXX: I'm not sure if this is the most appropriate memory order.
-	TaskHeader *task_header = item->exchange(nullptr, std::memory_order_acquire);
-	// And assume ownership of the loaded pointer
-	return PrivateTaskHandle(task_header);
+	return item->exchange(nullptr, std::memory_order_acquire);
 }
 
-PrivateTaskHandle TaskQueueSet::popTaskOrWait(size_t queue) noexcept
+bool TaskQueueSet::tryPushDeque(size_t queue, TaskHeader *task) noexcept
 {
-	auto &header = m_ring_buffer_header[queue];
-	auto &storage = m_ring_buffer_storage[queue];
+	// Owner-only operation, see "Correct and Efficient Work-Stealing
+	// for Weak Memory Models" (Le et al.) for the memory orders used
+	WorkDeque &deque = m_work_deques[queue];
 
-	ProduceConsumeIndex index = header.current_index.load(std::memory_order_relaxed);
-	std::atomic<TaskHeader *> *item = nullptr;
+	const int64_t bottom = deque.bottom.load(std::memory_order_relaxed);
+	const int64_t top = deque.top.load(std::memory_order_acquire);
 
-	while (true) {
-		assert(index.produce >= index.consume);
-		assert(index.produce <= index.consume + RING_BUFFER_SIZE);
+	if (bottom - top >= static_cast<int64_t>(WORK_DEQUE_SIZE)) [[unlikely]] {
+		// Deque is full
+		return false;
+	}
 
-		if (index.stop_flag) [[unlikely]] {
-			// Stop requested
-			return {};
-		}
+	deque.item[static_cast<uint64_t>(bottom) % WORK_DEQUE_SIZE].store(task, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+TaskHeader *TaskQueueSet::tryPopDeque(size_t queue) noexcept
+{
+	// Owner-only operation
+	WorkDeque &deque = m_work_deques[queue];
+
+	const int64_t bottom = deque.bottom.load(std::memory_order_relaxed) - 1;
+	deque.bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = deque.top.load(std::memory_order_relaxed);
+
+	if (top > bottom) {
+		// Deque is empty, restore the bottom index
+		deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
 
-		if (index.produce == index.consume) [[unlikely]] {
-			// Buffer is empty - try setting the wait flag and going to sleep
-			bool success = header.current_index.compare_exchange_weak(index,
-				{
-					.produce = index.produce,
-					.wait_flag = 1,
-					.consume = index.consume,
-				},
-				// XXX: I'm not sure if this is the most appropriate memory order
-				std::memory_order_acq_rel);
-
-			if (!success) [[unlikely]] {
-				// Something changed beneath us - try again
-				continue;
-			}
-
-			// XXX: not the nicest code - take the first uint32 from this struct and wait on it.
-			// But futex only supports uint32 words, and it should be indeed enough for us.
-			//
-			// Produce+wait bit is located in the first word, consume+stop bit in the second.
-			// We don't care about the consume index, but stop bit might be a problem.
-			// However, stop bit is raised by CAS on both words - and if it notices wait
-			// bit in the first word it will properly wake us up, clearing that bit as well.
-			//
-			// So from futex standpoint it's is totally fine, the only ugly thing is this cast.
-			auto words = std::bit_cast<std::array<uint32_t, 2>>(index);
-			os::Futex::waitInfinite(reinterpret_cast<std::atomic_uint32_t *>(&header.current_index), words[0]);
+	TaskHeader *task = deque.item[static_cast<uint64_t>(bottom) % WORK_DEQUE_SIZE].load(std::memory_order_relaxed);
 
-			index = header.current_index.load(std::memory_order_relaxed);
-			continue;
+	if (top == bottom) {
+		// The last item, race against thieves for it
+		if (!deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+				std::memory_order_relaxed)) {
+			// Stolen
+			task = nullptr;
 		}
 
-		item = &storage.item[index.consume % RING_BUFFER_SIZE];
+		deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
 
-		// XXX: I'm not sure if this is the most appropriate memory order
-		if (item->load(std::memory_order_acquire) == nullptr) [[unlikely]] {
-			// Someone has taken this item before us, reload indices and try again
-			index = header.current_index.load(std::memory_order_relaxed);
-			continue;
+	return task;
+}
+
+TaskHeader *TaskQueueSet::tryStealDeque(size_t queue) noexcept
+{
+	WorkDeque &deque = m_work_deques[queue];
+
+	while (true) {
+		int64_t top = deque.top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = deque.bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom) {
+			// Deque is empty
+			return nullptr;
 		}
 
-		// Try updating the consume index, "reserving" consumption of this item for our thread
-		bool success = header.current_index.compare_exchange_weak(index,
-			{
-				.produce = index.produce,
-				// Preserve the wait flag
-				.wait_flag = index.wait_flag,
-				.consume = index.consume + 1u,
-				// Preserve the stop flag (must be zero if we reached here)
-				.stop_flag = 0,
-			},
-			// XXX: I'm not sure if this is the most appropriate memory order
-			std::memory_order_acq_rel);
+		TaskHeader *task = deque.item[static_cast<uint64_t>(top) % WORK_DEQUE_SIZE].load(std::memory_order_relaxed);
 
-		if (success) [[likely]] {
-			break;
+		if (deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return task;
 		}
-	};
 
-	// `item` is "reserved" for us now - no other pop or push can touch it.
-	// XXX: I'm not sure if this is the most appropriate memory order.
-	TaskHeader *task_header = item->exchange(nullptr, std::memory_order_acquire);
-	// And assume ownership of the loaded pointer
-	return PrivateTaskHandle(task_header);
+		// Lost the race to another thief or the owner, retry while there are items
+	}
 }
 
-void TaskQueueSet::requestStopAll() noexcept
+void TaskQueueSet::pushOverflow(TaskHeader *task)
 {
-	for (size_t queue = 0; queue < m_num_queues; queue++) {
-		auto &header = m_ring_buffer_header[queue];
+	std::lock_guard lock(m_overflow_lock);
+	m_overflow_queue.emplace_back(task);
+	m_overflow_size.store(m_overflow_queue.size(), std::memory_order_release);
+}
+
+TaskHeader *TaskQueueSet::tryPopOverflow() noexcept
+{
+	// Fast check without locking, overflow is almost always empty
+	if (m_overflow_size.load(std::memory_order_acquire) == 0) [[likely]] {
+		return nullptr;
+	}
+
+	std::lock_guard lock(m_overflow_lock);
+
+	if (m_overflow_queue.empty()) {
+		return nullptr;
+	}
 
-		ProduceConsumeIndex index = header.current_index.load(std::memory_order_relaxed);
-		ProduceConsumeIndex new_index = index;
-		bool need_wake = false;
+	TaskHeader *task = m_overflow_queue.front();
+	m_overflow_queue.pop_front();
+	m_overflow_size.store(m_overflow_queue.size(), std::memory_order_release);
+	return task;
+}
 
-		do {
-			need_wake = index.wait_flag;
-			new_index.wait_flag = 0;
-			new_index.stop_flag = 1;
-		} while (!header.current_index.compare_exchange_weak(index, new_index, std::memory_order_release));
+TaskHeader *TaskQueueSet::tryFindTask(size_t queue, bool steal) noexcept
+{
+	// Own queues first - deque is filled by tasks we've just executed
+	// and likely has the hottest data, then tasks pushed from outside
+	if (TaskHeader *task = tryPopDeque(queue); task) {
+		return task;
+	}
 
-		if (need_wake) {
-			// See waiting code in `popTaskOrWait()` to understand this cast
-			os::Futex::wakeAll(reinterpret_cast<std::atomic_uint32_t *>(&header.current_index));
+	if (TaskHeader *task = tryPopRing(queue); task) {
+		return task;
+	}
+
+	if (TaskHeader *task = tryPopOverflow(); task) {
+		return task;
+	}
+
+	if (!steal) {
+		return nullptr;
+	}
+
+	// Try stealing, starting from the next thread to spread contention.
+	// Take from deques first as their tasks were pushed by busy threads.
+	for (size_t i = 1; i < m_num_queues; i++) {
+		if (TaskHeader *task = tryStealDeque((queue + i) % m_num_queues); task) {
+			return task;
 		}
 	}
+
+	for (size_t i = 1; i < m_num_queues; i++) {
+		if (TaskHeader *task = tryPopRing((queue + i) % m_num_queues); task) {
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
+void TaskQueueSet::wakeSleepingThread() noexcept
+{
+	// Pairs with the fence in `popTaskOrWait()`. Either the sleeping thread sees
+	// our just pushed task when re-checking queues, or we see it's sleeping here.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (m_num_sleeping.load(std::memory_order_relaxed) > 0) {
+		m_wake_epoch.fetch_add(1, std::memory_order_release);
+		os::Futex::wakeSingle(&m_wake_epoch);
+	}
 }
 
 } // namespace voxen::svc::detail
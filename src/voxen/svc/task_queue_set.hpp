@@ -1,21 +1,41 @@
 #pragma once
 
+#include <voxen/os/futex.hpp>
 #include <voxen/svc/svc_fwd.hpp>
 
 #include <extras/hardware_params.hpp>
 
 #include <atomic>
+#include <deque>
 #include <memory>
 
 namespace voxen::svc::detail
 {
 
+// Set of per-thread task queues with work stealing.
+//
+// Every worker thread owns two queues:
+// - Chase-Lev work-stealing deque, only the owner pushes into it. Tasks
+//   enqueued from inside other tasks go there, skipping any contention.
+//   The owner pops in LIFO order (hot caches), thieves steal in FIFO order.
+// - Bounded MPMC ring buffer, tasks enqueued from outside of worker threads
+//   (e.g. World thread) are distributed over them by the caller.
+//
+// When both of them are full, tasks go into a shared locked overflow queue.
+// This is not expected in normal operation but allows to go through short
+// workload bursts without blocking producers.
+//
+// Idle threads try stealing from others' queues before going to sleep.
+// Any push wakes one sleeping thread, so no queue stays unattended while
+// some threads are idle.
 class TaskQueueSet {
 public:
 	// Must be a power of two for two reasons:
 	// - Trivial modulo operation (masking off lower bits)
-	// - So that wraparound of `ProduceConsumeIndex` does not cause troubles
+	// - So that wraparound of produce/consume indices does not cause troubles
 	constexpr static uint64_t RING_BUFFER_SIZE = 1024;
+	// Same requirements as for `RING_BUFFER_SIZE`
+	constexpr static uint64_t WORK_DEQUE_SIZE = 1024;
 
 	TaskQueueSet(size_t num_queues);
 	TaskQueueSet(TaskQueueSet &&) = delete;
@@ -24,9 +44,28 @@ public:
 	TaskQueueSet &operator=(const TaskQueueSet &) = delete;
 	~TaskQueueSet();
 
-	void pushTask(size_t queue, PrivateTaskHandle handle) noexcept;
+	// Bind the calling thread to `queue`, it will then push tasks into its own deque.
+	// Must be called once by every worker thread before it starts popping tasks.
+	void attachWorkerThread(size_t queue) noexcept;
 
+	// Push task into the work deque of the calling thread if it's an attached worker.
+	// Returns false if it is not, then `handle` is left untouched.
+	// Throws `std::bad_alloc` if both queues are full and the overflow queue can't
+	// grow, `handle` is left untouched in this case too.
+	bool tryPushLocal(PrivateTaskHandle &handle);
+	// Push task into the ring buffer of `queue`, this can be done from any thread.
+	// Throws `std::bad_alloc` if it's full and the overflow queue can't grow,
+	// the task is not enqueued then.
+	void pushTask(size_t queue, PrivateTaskHandle handle);
+
+	// Take a task for worker thread `queue` from its own queues or the overflow
+	// queue, without waiting. Does not steal - this is called by threads having
+	// blocked tasks, and stealing would only make them hoard more blocked tasks.
+	// Returns null handle if nothing was found or the stop was requested.
 	PrivateTaskHandle tryPopTask(size_t queue) noexcept;
+	// Same as `tryPopTask()` but steals from other threads if there is nothing
+	// in its own queues, and sleeps until a task is available if stealing fails.
+	// Returns null handle only after the stop was requested.
 	PrivateTaskHandle popTaskOrWait(size_t queue) noexcept;
 
 	void requestStopAll() noexcept;
@@ -34,13 +73,9 @@ public:
 private:
 	struct alignas(uint64_t) ProduceConsumeIndex {
 		// Number of produced (pushed) items, wraparound is fine
-		uint32_t produce : 31 = 0;
-		// Set when one or more threads are waiting on this queue
-		uint32_t wait_flag : 1 = 0;
+		uint32_t produce = 0;
 		// Number of consumed (popped) items, wraparound is fine
-		uint32_t consume : 31 = 0;
-		// Set when threads attached to this queue are requested to stop
-		uint32_t stop_flag : 1 = 0;
+		uint32_t consume = 0;
 	};
 
 	struct alignas(extras::hardware_params::cache_line) RingBufferHeader {
@@ -51,9 +86,44 @@ private:
 		std::atomic<TaskHeader *> item[RING_BUFFER_SIZE];
 	};
 
+	struct alignas(extras::hardware_params::cache_line) WorkDeque {
+		// Changed only by the owner thread. Signed to simplify
+		// the "pop from empty deque" case in Chase-Lev algorithm.
+		std::atomic_int64_t bottom = 0;
+		// Changed by thieves and by the owner when taking the last item
+		alignas(extras::hardware_params::cache_line) std::atomic_int64_t top = 0;
+		alignas(extras::hardware_params::cache_line) std::atomic<TaskHeader *> item[WORK_DEQUE_SIZE];
+	};
+
 	const size_t m_num_queues;
 	std::unique_ptr<RingBufferHeader[]> m_ring_buffer_header;
 	std::unique_ptr<RingBufferStorage[]> m_ring_buffer_storage;
+	std::unique_ptr<WorkDeque[]> m_work_deques;
+
+	// Number of threads sleeping (or about to) in `popTaskOrWait()`
+	alignas(extras::hardware_params::cache_line) std::atomic_uint32_t m_num_sleeping = 0;
+	// Futex word for sleeping threads, incremented on every wake
+	std::atomic_uint32_t m_wake_epoch = 0;
+	std::atomic_bool m_stop_requested = false;
+
+	// Overflow queue, used only when both the deque and the ring buffer are full
+	alignas(extras::hardware_params::cache_line) std::atomic_size_t m_overflow_size = 0;
+	os::FutexLock m_overflow_lock;
+	std::deque<TaskHeader *> m_overflow_queue;
+
+	bool tryPushRing(size_t queue, TaskHeader *task) noexcept;
+	TaskHeader *tryPopRing(size_t queue) noexcept;
+
+	bool tryPushDeque(size_t queue, TaskHeader *task) noexcept;
+	TaskHeader *tryPopDeque(size_t queue) noexcept;
+	TaskHeader *tryStealDeque(size_t queue) noexcept;
+
+	// The only allocating (and throwing) push path
+	void pushOverflow(TaskHeader *task);
+	TaskHeader *tryPopOverflow() noexcept;
+
+	TaskHeader *tryFindTask(size_t queue, bool steal) noexcept;
+	void wakeSleepingThread() noexcept;
 };
 
 } // namespace voxen::svc::detail
@@ -47,7 +47,7 @@ public:
 	TaskServiceImpl(TaskService &me, ServiceLocator &svc, TaskService::Config cfg)
 		: m_cfg(cfg)
 		, m_counter_tracker(svc.requestService<AsyncCounterTracker>())
-		, m_queue_set(cfg.num_threads)
+		, m_queue_set(std::make_unique<TaskQueueSet>(cfg.num_threads))
 		, m_slave_threads(std::make_unique<std::thread[]>(cfg.num_threads))
 	{
 		svc.requestService<PipeMemoryAllocator>();
@@ -55,14 +55,14 @@ public:
 		Log::info("Starting task service with {} threads", cfg.num_threads);
 		for (size_t i = 0; i < m_cfg.num_threads; i++) {
 			m_slave_threads[i] = std::thread(TaskServiceSlave::threadFn, std::ref(me), i, std::ref(m_counter_tracker),
-				std::ref(m_queue_set));
+				std::ref(*m_queue_set));
 		}
 	}
 
 	~TaskServiceImpl()
 	{
 		Log::info("Stopping task service");
-		m_queue_set.requestStopAll();
+		m_queue_set->requestStopAll();
 
 		// XXX: if the system is deadlocked waiting will hang here.
 		// Would be nice to detect it somehow - wait with timeout then crash?
@@ -85,15 +85,19 @@ public:
 		const uint64_t counter = m_counter_tracker.allocateCounter();
 		header->task_counter = counter;
 
-		// Select the target queue randomly.
-		// XXX: might use some heuristics for more optimal scheduling,
-		// e.g. prefer the current thread (if enqueueing from another task)
-		// or do account for hardware topology and try threads in order of cache sharing.
+		// When enqueueing from inside a task, push into the current thread's own
+		// deque. It's uncontended, and other threads will steal from it if idle.
+		if (m_queue_set->tryPushLocal(handle)) {
+			return counter;
+		}
+
+		// Otherwise select the target queue randomly, stealing will fix any imbalance.
+		// XXX: might account for hardware topology and try threads in order of cache sharing.
 		// This will get especially important if we ever launch on NUMA systems.
 		uint64_t random_value = Hash::xxh64Fixed(counter ^ reinterpret_cast<uintptr_t>(header));
 		size_t queue_id = random_value % m_cfg.num_threads;
 
-		m_queue_set.pushTask(queue_id, std::move(handle));
+		m_queue_set->pushTask(queue_id, std::move(handle));
 
 		return counter;
 	}
@@ -102,7 +106,8 @@ private:
 	const TaskService::Config m_cfg;
 
 	AsyncCounterTracker &m_counter_tracker;
-	TaskQueueSet m_queue_set;
+	// Heap-allocated as it has cache line-aligned parts
+	std::unique_ptr<TaskQueueSet> m_queue_set;
 	std::unique_ptr<std::thread[]> m_slave_threads;
 };
 
@@ -137,6 +137,7 @@ void TaskServiceSlave::threadFn(TaskService &my_service, size_t my_queue, AsyncC
 	TaskQueueSet &queue_set)
 {
 	debug::setThreadName("ThreadPool@%zu", my_queue);
+	queue_set.attachWorkerThread(my_queue);
 
 	SlaveState state {
 		.task_service = my_service,
@@ -175,11 +176,14 @@ void TaskServiceSlave::threadFn(TaskService &my_service, size_t my_queue, AsyncC
 			task = queue_set.tryPopTask(my_queue);
 
 			// If we've received a valid handle, then just continue the main loop
-			// trying to execute it. Otherwise we know the input queue is empty and
-			// we have nothing to do for a while - might go over waiting tasks
-			// in the meantime and then try getting a handle again. Unless
-			// the system is deadlocked, we are guaranteed to eventually drain
-			// the waiting queue (in finite time) and exit this loop.
+			// trying to execute it. Otherwise our own queues were empty (this does
+			// not steal, other threads might still have tasks) - might go over
+			// waiting tasks in the meantime and then try getting a handle again.
+			// Unless the system is deadlocked, we are guaranteed to eventually
+			// drain the waiting queue (in finite time) and exit this loop.
+			// Tasks left in other queues are not lost: `popTaskOrWait()` announces
+			// sleeping, re-checks all queues and only then waits on futex, while
+			// any push after that announcement wakes a sleeping thread.
 			while (!task.valid() && !state.local_waiting_queue.empty()) {
 				tryDrainLocalQueue(state);
 				task = queue_set.tryPopTask(my_queue);
@@ -0,0 +1,140 @@
+#include <voxen/common/pipe_memory_allocator.hpp>
+
+#include <voxen/svc/service_locator.hpp>
+
+#include "../../voxen_test_common.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace voxen
+{
+
+namespace
+{
+
+// Every allocation of this size takes a whole slab
+constexpr size_t SLAB_FILLING_SIZE = PipeMemoryAllocator::MAX_ALLOC_SIZE;
+
+std::vector<void *> allocateSlabs(size_t count)
+{
+	std::vector<void *> ptrs;
+	for (size_t i = 0; i < count; i++) {
+		ptrs.emplace_back(PipeMemoryAllocator::allocate(SLAB_FILLING_SIZE, 1));
+	}
+	return ptrs;
+}
+
+void deallocateAll(std::vector<void *> &ptrs)
+{
+	for (void *ptr : ptrs) {
+		PipeMemoryAllocator::deallocate(ptr);
+	}
+	ptrs.clear();
+}
+
+// Wait until `pred()` returns true, with a (generous) time limit
+template<typename F>
+bool waitUntil(F &&pred)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+
+	while (std::chrono::steady_clock::now() < deadline) {
+		if (pred()) {
+			return true;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	return false;
+}
+
+} // namespace
+
+TEST_CASE("'PipeMemoryAllocator' keeps free slabs during retention window", "[voxen::pipe_memory_allocator]")
+{
+	svc::ServiceLocator svc;
+	PipeMemoryAllocator allocator(svc,
+		PipeMemoryAllocator::Config {
+			.gc_period_msec = 5,
+			// Destroy every idle slab, this also cleans up leftovers of other tests
+			.destroy_free_slabs_threshold = 0,
+			.free_slabs_window_msec = 1000,
+			.huge_pages = PipeMemoryAllocator::HugePages::Off,
+			.numa_aware_slabs = false,
+		});
+
+	constexpr size_t NUM_SPIKE_SLABS = 12;
+
+	auto free_slabs = [] { return PipeMemoryAllocator::stats().free_slabs; };
+
+	// The first spike, slabs are destroyed once the window fills up
+	std::vector<void *> ptrs = allocateSlabs(NUM_SPIKE_SLABS);
+	deallocateAll(ptrs);
+
+	CHECK(waitUntil([&] { return free_slabs() == 0; }));
+
+	// Another spike takes slabs while the window tracks it
+	ptrs = allocateSlabs(NUM_SPIKE_SLABS);
+	deallocateAll(ptrs);
+
+	// All but the last one (still owned by this thread) get back to the free list
+	REQUIRE(waitUntil([&] { return free_slabs() >= NUM_SPIKE_SLABS - 1; }));
+
+	// They were taken recently, must be retained for a while
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	CHECK(free_slabs() >= NUM_SPIKE_SLABS - 1);
+
+	// Then destroyed after not being taken for the whole window
+	CHECK(waitUntil([&] { return free_slabs() == 0; }));
+}
+
+TEST_CASE("'PipeMemoryAllocator' falls back from hugetlb pages", "[voxen::pipe_memory_allocator]")
+{
+	// Hugetlb pages are usually not reserved, then this tests the fallback path.
+	// Otherwise slabs can come from either source depending on the reserve.
+	const auto huge_pages = GENERATE(PipeMemoryAllocator::HugePages::Explicit,
+		PipeMemoryAllocator::HugePages::Transparent, PipeMemoryAllocator::HugePages::Off);
+	INFO("Huge pages mode: " << int(huge_pages));
+
+	svc::ServiceLocator svc;
+	PipeMemoryAllocator allocator(svc,
+		PipeMemoryAllocator::Config {
+			// Don't let GC destroy slabs while we're counting them
+			.destroy_free_slabs_threshold = 1000,
+			.huge_pages = huge_pages,
+			.numa_aware_slabs = false,
+		});
+
+	const PipeMemoryAllocator::Stats stats_before = PipeMemoryAllocator::stats();
+	// Fallback state is reset on service start
+	CHECK_FALSE(stats_before.hugetlb_fallback);
+
+	// Don't let free slabs of previous tests serve this spike
+	constexpr size_t NUM_SPIKE_SLABS = 4;
+	std::vector<void *> ptrs = allocateSlabs(stats_before.free_slabs + NUM_SPIKE_SLABS);
+
+	// Memory must be usable whatever the backing is
+	for (void *ptr : ptrs) {
+		std::memset(ptr, 0x5A, SLAB_FILLING_SIZE);
+	}
+
+	const PipeMemoryAllocator::Stats stats_after = PipeMemoryAllocator::stats();
+	CHECK(stats_after.slabs >= stats_before.slabs + NUM_SPIKE_SLABS);
+
+	if (huge_pages == PipeMemoryAllocator::HugePages::Explicit) {
+		// Either new slabs got hugetlb pages or the fallback was taken
+		CHECK((stats_after.hugetlb_fallback || stats_after.hugetlb_slabs >= NUM_SPIKE_SLABS));
+	} else {
+		// Hugetlb mapping is not even attempted
+		CHECK_FALSE(stats_after.hugetlb_fallback);
+		CHECK(stats_after.hugetlb_slabs <= stats_before.hugetlb_slabs);
+	}
+
+	deallocateAll(ptrs);
+}
+
+} // namespace voxen
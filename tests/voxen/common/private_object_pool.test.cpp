@@ -46,4 +46,70 @@ TEST_CASE("'PrivateObjectPool' basic test case", "[voxen::private_object_pool]")
 	}
 }
 
+TEST_CASE("'PrivateObjectPool' slab packing and trim", "[voxen::private_object_pool]")
+{
+	using Pool = PrivateObjectPool<uint64_t, 256>;
+	Pool pool;
+
+	std::vector<Pool::Ptr> objects;
+
+	// Find out how many objects fit into one slab
+	do {
+		objects.emplace_back(pool.allocate(objects.size()));
+	} while (pool.stats().slabs == 1);
+
+	// The second slab is empty now but not released until trim
+	const size_t per_slab = objects.size() - 1;
+	objects.pop_back();
+	REQUIRE(pool.stats().empty_slabs == 1);
+
+	// Fill three slabs (A, B, C) completely
+	while (objects.size() < 3 * per_slab) {
+		objects.emplace_back(pool.allocate(objects.size()));
+	}
+
+	REQUIRE(pool.stats().slabs == 3);
+
+	// Leave A almost full, B half full and C with only one object
+	objects[0].reset();
+	for (size_t i = per_slab; i < per_slab + per_slab / 2; i++) {
+		objects[i].reset();
+	}
+	for (size_t i = 2 * per_slab + 1; i < 3 * per_slab; i++) {
+		objects[i].reset();
+	}
+
+	// Nothing is empty yet
+	CHECK(pool.trim() == 0);
+
+	// These must go into the most occupied slabs A and B, not into C
+	for (size_t i = 0; i < 1 + per_slab / 2; i++) {
+		objects.emplace_back(pool.allocate(i));
+	}
+
+	// Now C becomes empty and can be released
+	objects[2 * per_slab].reset();
+
+	ObjectPoolStats stats = pool.stats();
+	CHECK(stats.slabs == 3);
+	CHECK(stats.empty_slabs == 1);
+	CHECK(stats.live_objects == 2 * per_slab);
+
+	CHECK(pool.trim() == stats.slab_size);
+	CHECK(pool.stats().slabs == 2);
+
+	// Release everything, all slabs must go away
+	objects.clear();
+	CHECK(pool.trim() == 2 * stats.slab_size);
+
+	stats = pool.stats();
+	CHECK(stats.slabs == 0);
+	CHECK(stats.live_objects == 0);
+
+	// And the pool is still usable after that
+	Pool::Ptr ptr = pool.allocate(uint64_t(42));
+	CHECK(*ptr == 42);
+	CHECK(pool.stats().slabs == 1);
+}
+
 } // namespace voxen
@@ -137,6 +137,14 @@ TEST_CASE("'SharedObjectPool' multithreaded deallocation", "[voxen::shared_objec
 	}
 
 	REQUIRE(errors.load() == 0);
+
+	// Objects freed from other threads must be accounted too
+	ObjectPoolStats stats = pool.stats();
+	CHECK(stats.live_objects == 0);
+	CHECK(stats.empty_slabs == stats.slabs);
+
+	CHECK(pool.trim() == stats.slabs * stats.slab_size);
+	CHECK(pool.stats().slabs == 0);
 }
 
 } // namespace voxen
@@ -2,11 +2,18 @@
 #include <voxen/common/v8g_hash_trie_impl.hpp>
 
 #include <voxen/land/chunk_key.hpp>
+#include <voxen/svc/engine.hpp>
+#include <voxen/svc/service_locator.hpp>
+#include <voxen/svc/task_service.hpp>
 
 #include "../../test_common.hpp"
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <random>
+#include <set>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace voxen
@@ -240,4 +247,237 @@ TEST_CASE("'V8gHashTrie' diff", "[voxen::v8g_hash_trie]")
 	CHECK(found_remove == expected_remove);
 }
 
+TEST_CASE("'V8gHashTrie' batch insert/erase", "[voxen::v8g_hash_trie]")
+{
+	using Trie = V8gHashTrie<TrivialKey, uint64_t>;
+
+	Trie batched;
+	Trie reference;
+	std::unordered_map<uint64_t, uint64_t> verification;
+
+	std::mt19937_64 rng(0xDEADBEEF + 3);
+
+	for (uint64_t timeline = 1; timeline <= 6; timeline++) {
+		// Keep snapshots to check that batch ops don't alter shared nodes
+		const Trie batched_snapshot = batched;
+		const size_t snapshot_size = batched_snapshot.size();
+
+		std::vector<Trie::BatchItem> items;
+		std::vector<TrivialKey> erased_keys;
+
+		for (int i = 0; i < 5000; i++) {
+			// Small key range on odd timelines - many updates and deep prefix collisions
+			uint64_t key = timeline % 2 ? rng() : (rng() % 4096) << 52;
+			uint64_t value = rng();
+
+			if (verification.contains(key) && rng() % 4 == 0) {
+				if (std::ranges::find(erased_keys, TrivialKey(key)) == erased_keys.end()) {
+					erased_keys.emplace_back(key);
+				}
+				continue;
+			}
+
+			if (std::ranges::find(erased_keys, TrivialKey(key)) != erased_keys.end()) {
+				continue;
+			}
+
+			auto iter = std::ranges::find_if(items, [&](const Trie::BatchItem &item) { return item.first.key == key; });
+			if (iter != items.end()) {
+				continue;
+			}
+
+			items.emplace_back(TrivialKey(key), Trie::makeValuePtr(value));
+			reference.insert(timeline, TrivialKey(key), Trie::makeValuePtr(value));
+			verification[key] = value;
+		}
+
+		for (TrivialKey key : erased_keys) {
+			reference.erase(timeline, key);
+			verification.erase(key.key);
+		}
+
+		Trie::sortBatch(items);
+		Trie::sortBatch(erased_keys);
+
+		batched.insertBatch(timeline, items);
+		batched.eraseBatch(timeline, erased_keys);
+
+		REQUIRE(batched.size() == verification.size());
+		REQUIRE(reference.size() == verification.size());
+		CHECK(batched_snapshot.size() == snapshot_size);
+
+		size_t correct = 0;
+		for (const auto &[key, value] : verification) {
+			const auto *item = batched.find(TrivialKey(key));
+			correct += item != nullptr && item->value() == value;
+		}
+
+		CHECK(correct == verification.size());
+
+		// Both containers must have items in the same (hash-sorted) order
+		const auto *a = batched.findFirst();
+		const auto *b = reference.findFirst();
+		size_t matching = 0;
+
+		while (a && b && a->key() == b->key()) {
+			matching++;
+			a = batched.findNext(a->key());
+			b = reference.findNext(b->key());
+		}
+
+		CHECK(matching == verification.size());
+		CHECK(a == nullptr);
+		CHECK(b == nullptr);
+
+		// Diff against the previous snapshot must see exactly the batch changes
+		size_t diff_count = 0;
+		batched.visitDiff(batched_snapshot, [&](const Trie::Item *, const Trie::Item *) {
+			diff_count++;
+			return true;
+		});
+
+		// Every touched key is changed unless it was both added and erased in this batch
+		std::set<uint64_t> touched_keys;
+		for (const auto &item : items) {
+			touched_keys.emplace(item.first.key);
+		}
+		for (TrivialKey key : erased_keys) {
+			touched_keys.emplace(key.key);
+		}
+
+		size_t expected_diff = 0;
+		for (uint64_t key : touched_keys) {
+			expected_diff += batched_snapshot.find(TrivialKey(key)) != nullptr || batched.find(TrivialKey(key)) != nullptr;
+		}
+
+		CHECK(diff_count == expected_diff);
+	}
+}
+
+TEST_CASE("'V8gHashTrie' parallel diff", "[voxen::v8g_hash_trie]")
+{
+	using Trie = V8gHashTrie<TrivialKey, uint64_t>;
+
+	auto engine = svc::Engine::createForTestSuite();
+	svc::TaskService &ts = engine->serviceLocator().requestService<svc::TaskService>();
+
+	Trie vht;
+	std::mt19937_64 rng(0xDEADBEEF + 4);
+	std::vector<uint64_t> keys;
+
+	for (int i = 0; i < 20'000; i++) {
+		keys.emplace_back(rng());
+		vht.insert(1, TrivialKey(keys.back()), Trie::makeValuePtr(keys.back()));
+	}
+
+	const Trie snapshot = vht;
+
+	size_t expected_changes = 0;
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		if (i % 3 == 0) {
+			vht.erase(2, TrivialKey(keys[i]));
+			expected_changes++;
+		} else if (i % 3 == 1) {
+			vht.insert(2, TrivialKey(keys[i]), Trie::makeValuePtr(~keys[i]));
+			expected_changes++;
+		}
+	}
+
+	for (int i = 0; i < 5000; i++) {
+		vht.insert(2, TrivialKey(rng()), Trie::makeValuePtr(0));
+	}
+
+	std::map<uint64_t, int> sequential;
+	vht.visitDiff(snapshot, [&](const Trie::Item *new_item, const Trie::Item *old_item) {
+		sequential[(new_item ? new_item : old_item)->key().key] = (new_item ? 1 : 0) + (old_item ? 2 : 0);
+		return true;
+	});
+
+	std::mutex lock;
+	std::map<uint64_t, int> parallel;
+	vht.visitDiffParallel(snapshot, ts, [&](const Trie::Item *new_item, const Trie::Item *old_item) {
+		std::lock_guard lk(lock);
+		parallel[(new_item ? new_item : old_item)->key().key] = (new_item ? 1 : 0) + (old_item ? 2 : 0);
+		return true;
+	});
+
+	CHECK(sequential.size() == expected_changes + 5000);
+	CHECK(parallel == sequential);
+
+	// Early exit and exception propagation
+	std::atomic_size_t calls = 0;
+	vht.visitDiffParallel(snapshot, ts, [&](const Trie::Item *, const Trie::Item *) {
+		calls++;
+		return false;
+	});
+	CHECK(calls.load() < sequential.size());
+
+	auto throwing_visit = [&]() {
+		vht.visitDiffParallel(snapshot, ts, [&](const Trie::Item *, const Trie::Item *) -> bool {
+			throw std::runtime_error("visitor failure");
+		});
+	};
+	CHECK_THROWS_AS(throwing_visit(), std::runtime_error);
+}
+
+TEST_CASE("'V8gHashTrie' memory stats", "[voxen::v8g_hash_trie]")
+{
+	using Trie = V8gHashTrie<TrivialKey, uint64_t>;
+
+	Trie trie;
+
+	auto empty_stats = trie.memoryStats(nullptr);
+	CHECK(empty_stats.node_count == 0);
+	CHECK(empty_stats.value_count == 0);
+	CHECK(empty_stats.value_bytes == 0);
+
+	std::mt19937_64 rng(0xDEADBEEF + 5);
+	std::vector<uint64_t> keys;
+
+	for (int i = 0; i < 10000; i++) {
+		keys.emplace_back(rng());
+		trie.insert(1, TrivialKey(keys.back()), Trie::makeValuePtr(uint64_t(i)));
+	}
+	// One null value, must not be counted
+	trie.insert(1, TrivialKey(rng()), Trie::ValuePtr());
+
+	auto stats = trie.memoryStats(nullptr);
+	CHECK(stats.node_count > 0);
+	CHECK(stats.node_bytes > stats.node_count * sizeof(void *));
+	CHECK(stats.value_count == keys.size());
+	CHECK(stats.value_bytes == keys.size() * sizeof(uint64_t));
+	CHECK(stats.shared_node_bytes == 0);
+	CHECK(stats.shared_value_bytes == 0);
+
+	// Heap bytes function is added to every value size
+	auto heap_stats = trie.memoryStats(nullptr, [](const uint64_t &) -> size_t { return 100; });
+	CHECK(heap_stats.value_bytes == keys.size() * (sizeof(uint64_t) + 100));
+
+	// Fresh copy shares everything
+	Trie copy = trie;
+	stats = trie.memoryStats(&copy);
+	CHECK(stats.shared_node_bytes == stats.node_bytes);
+	CHECK(stats.shared_value_bytes == stats.value_bytes);
+
+	// Replace some values in the copy
+	constexpr size_t REPLACED = 100;
+	for (size_t i = 0; i < REPLACED; i++) {
+		copy.insert(2, TrivialKey(keys[i]), Trie::makeValuePtr(uint64_t(i)));
+	}
+
+	auto old_stats = trie.memoryStats(&copy);
+	auto new_stats = copy.memoryStats(&trie);
+
+	// Sizes are unchanged, only sharing differs
+	CHECK(new_stats.value_count == old_stats.value_count);
+	CHECK(new_stats.node_bytes == old_stats.node_bytes);
+	CHECK(old_stats.value_bytes - old_stats.shared_value_bytes == REPLACED * sizeof(uint64_t));
+	CHECK(new_stats.value_bytes - new_stats.shared_value_bytes == REPLACED * sizeof(uint64_t));
+	// Paths to changed values were copied, the rest is still shared
+	CHECK(old_stats.shared_node_bytes < old_stats.node_bytes);
+	CHECK(old_stats.shared_node_bytes > 0);
+	CHECK(new_stats.shared_node_bytes == old_stats.shared_node_bytes);
+}
+
 } // namespace voxen
@@ -83,4 +83,278 @@ TEST_CASE("'CompressedChunkStorage<bool>' random values round-trip", "[voxen::la
 	test<bool>(0xDEADBEEF + 1);
 }
 
+TEST_CASE("'CompressedChunkStorage<bool>' mixed nodes round-trip", "[voxen::land::compressed_chunk_storage]")
+{
+	auto source = std::make_unique<CubeArray<bool, N>>();
+	auto dest = std::make_unique<CubeArray<bool, N>>();
+
+	std::mt19937 rng(0xDEADBEEF);
+
+	// Uniform false nodes in the lower part, uniform true
+	// nodes in the middle and random values in the top part
+	Utils::forYXZ<N>([&](uint32_t x, uint32_t y, uint32_t z) {
+		bool value = false;
+
+		if (y >= 24) {
+			value = (rng() & 1) != 0;
+		} else if (y >= 8) {
+			value = true;
+		}
+
+		source->store(x, y, z, value);
+	});
+
+	CompressedChunkStorage<bool> storage(source->cview());
+
+	Utils::forYXZ<N>([&](uint32_t x, uint32_t y, uint32_t z) {
+		if (source->load(x, y, z) != storage.load(x, y, z)) {
+			INFO("Failure point: " << x << " " << y << " " << z);
+			CHECK(source->load(x, y, z) == storage.load(x, y, z));
+		}
+	});
+
+	storage.expand(dest->view());
+	CHECK(*source == *dest);
+}
+
+TEST_CASE("'CompressedChunkStorage<uint16_t>' serialization round-trip", "[voxen::land::compressed_chunk_storage]")
+{
+	auto source = std::make_unique<CubeArray<uint16_t, N>>();
+	auto dest = std::make_unique<CubeArray<uint16_t, N>>();
+
+	auto check_round_trip = [&](const CompressedChunkStorage<uint16_t> &storage) {
+		std::vector<std::byte> bytes(storage.serializedSize());
+		CHECK(storage.serialize(bytes) == bytes.size());
+
+		CompressedChunkStorage<uint16_t> restored;
+		REQUIRE(restored.deserialize(bytes));
+		CHECK(restored.uniform() == storage.uniform());
+
+		restored.expand(dest->view());
+		CHECK(*source == *dest);
+
+		// Truncated or extended input must be rejected without changing the object
+		CHECK_FALSE(restored.deserialize(std::span(bytes).first(bytes.size() - 1)));
+		bytes.emplace_back();
+		CHECK_FALSE(restored.deserialize(bytes));
+
+		restored.expand(dest->view());
+		CHECK(*source == *dest);
+	};
+
+	SECTION("Uniform chunk")
+	{
+		source->fill(42);
+		check_round_trip(CompressedChunkStorage<uint16_t>(source->cview()));
+	}
+
+	SECTION("Mixed nodes and leaves")
+	{
+		std::mt19937 rng(0xDEADBEEF);
+
+		// Zero lower part, uniform nodes above, then a mix
+		// of uniform and random 2x2x2 leaves in the top part
+		Utils::forYXZ<N>([&](uint32_t x, uint32_t y, uint32_t z) {
+			uint16_t value = 0;
+
+			if (y >= 24) {
+				value = (x / 2 + z / 2) % 3 == 0 ? static_cast<uint16_t>(rng()) : static_cast<uint16_t>(x / 2);
+			} else if (y >= 8) {
+				value = static_cast<uint16_t>(1 + x / 8);
+			}
+
+			source->store(x, y, z, value);
+		});
+
+		check_round_trip(CompressedChunkStorage<uint16_t>(source->cview()));
+	}
+}
+
+TEST_CASE("'CompressedChunkStorage<uint16_t>' slab expansion", "[voxen::land::compressed_chunk_storage]")
+{
+	auto source = std::make_unique<CubeArray<uint16_t, N>>();
+	auto dest = std::make_unique<CubeArray<uint16_t, N>>();
+
+	auto check_slabs = [&](const CompressedChunkStorage<uint16_t> &storage) {
+		// Expand slabs in reverse order, no slab must depend on previous ones
+		dest->fill(0xFFFF);
+		for (uint32_t slab = 4; slab-- > 0;) {
+			storage.expandSlab(slab, dest->view<N>(glm::uvec3(0, slab * 8, 0)));
+		}
+
+		CHECK(*source == *dest);
+	};
+
+	SECTION("Uniform chunk")
+	{
+		source->fill(42);
+		check_slabs(CompressedChunkStorage<uint16_t>(source->cview()));
+	}
+
+	SECTION("Mixed nodes and leaves")
+	{
+		std::mt19937 rng(0xDEADBEEF);
+
+		// Zero nodes are interleaved with non-zero ones in every slab
+		Utils::forYXZ<N>([&](uint32_t x, uint32_t y, uint32_t z) {
+			uint16_t value = 0;
+
+			if ((x / 8 + y / 8 + z / 8) % 2 == 0) {
+				value = (y % 3 == 0) ? static_cast<uint16_t>(rng() % 4) : static_cast<uint16_t>(1 + y / 8);
+			}
+
+			source->store(x, y, z, value);
+		});
+
+		check_slabs(CompressedChunkStorage<uint16_t>(source->cview()));
+	}
+}
+
+TEST_CASE("'CompressedChunkStorage<uint16_t>' in-place modification", "[voxen::land::compressed_chunk_storage]")
+{
+	auto reference = std::make_unique<CubeArray<uint16_t, N>>();
+	auto dest = std::make_unique<CubeArray<uint16_t, N>>();
+
+	// Modified storage must match the reference array and be compressed
+	// exactly as well as storage constructed from that array directly
+	auto check_matches = [&](const CompressedChunkStorage<uint16_t> &storage) {
+		storage.expand(dest->view());
+		CHECK(*reference == *dest);
+
+		CompressedChunkStorage<uint16_t> fresh(reference->cview());
+		CHECK(storage.uniform() == fresh.uniform());
+
+		std::vector<std::byte> actual_bytes(storage.serializedSize());
+		std::vector<std::byte> expected_bytes(fresh.serializedSize());
+		storage.serialize(actual_bytes);
+		fresh.serialize(expected_bytes);
+		CHECK(actual_bytes == expected_bytes);
+	};
+
+	std::mt19937 rng(0xDEADBEEF);
+
+	SECTION("Single values")
+	{
+		reference->fill(0);
+		CompressedChunkStorage<uint16_t> storage;
+
+		// Split zero chunk, then merge it back
+		storage.store(5, 17, 30, 7);
+		reference->store(5u, 17u, 30u, uint16_t(7));
+		check_matches(storage);
+
+		storage.store(5, 17, 30, 0);
+		reference->store(5u, 17u, 30u, uint16_t(0));
+		check_matches(storage);
+		CHECK(storage.uniform());
+
+		// Random scattered stores with a small set of values
+		for (int i = 0; i < 2000; i++) {
+			uint32_t x = rng() % N, y = rng() % N, z = rng() % N;
+			auto value = static_cast<uint16_t>(rng() % 3);
+
+			storage.store(x, y, z, value);
+			reference->store(x, y, z, value);
+		}
+
+		check_matches(storage);
+
+		// Make a 2x2x2 leaf uniform through the in-place path
+		for (uint32_t i = 0; i < 8; i++) {
+			storage.store(10 + (i >> 1) % 2, 20 + (i >> 2), 12 + i % 2, 9);
+			reference->store(10 + (i >> 1) % 2, 20 + (i >> 2), 12 + i % 2, uint16_t(9));
+		}
+
+		check_matches(storage);
+	}
+
+	SECTION("Box fill")
+	{
+		reference->fill(3);
+		CompressedChunkStorage<uint16_t> storage;
+		storage.setUniform(3);
+
+		// Partially covers several nodes, clipped by chunk boundaries
+		storage.fillBox(glm::uvec3(3, 9, 20), glm::uvec3(19, 40, 27), 5);
+		reference->fill(glm::uvec3(3, 9, 20), glm::uvec3(16, 23, 7), 5);
+		check_matches(storage);
+
+		// Aligned box, must produce uniform nodes
+		storage.fillBox(glm::uvec3(8, 0, 0), glm::uvec3(24, 8, 16), 0);
+		reference->fill(glm::uvec3(8, 0, 0), glm::uvec3(16, 8, 16), 0);
+		check_matches(storage);
+
+		// Empty and out of bounds boxes do nothing
+		storage.fillBox(glm::uvec3(4, 4, 4), glm::uvec3(4, 10, 10), 1);
+		storage.fillBox(glm::uvec3(N, 0, 0), glm::uvec3(N + 5, N, N), 1);
+		check_matches(storage);
+
+		// Cover the whole chunk, must collapse into a single value
+		storage.fillBox(glm::uvec3(0), glm::uvec3(N), 8);
+		reference->fill(8);
+		check_matches(storage);
+		CHECK(storage.uniform());
+	}
+
+	SECTION("Sphere fill")
+	{
+		for (auto &item : *reference) {
+			item = static_cast<uint16_t>(rng() % 4);
+		}
+
+		CompressedChunkStorage<uint16_t> storage(reference->cview());
+
+		auto fill_reference = [&](glm::vec3 center, float radius, uint16_t value) {
+			Utils::forYXZ<N>([&](uint32_t x, uint32_t y, uint32_t z) {
+				glm::vec3 d = glm::vec3(x, y, z) + 0.5f - center;
+				if (d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius) {
+					reference->store(x, y, z, value);
+				}
+			});
+		};
+
+		// Sphere partially outside of the chunk
+		storage.fillSphere(glm::vec3(30.0f, 2.5f, 16.0f), 9.5f, 0);
+		fill_reference(glm::vec3(30.0f, 2.5f, 16.0f), 9.5f, 0);
+		check_matches(storage);
+
+		// Sphere entirely outside of the chunk
+		storage.fillSphere(glm::vec3(-20.0f, 5.0f, 5.0f), 10.0f, 1);
+		check_matches(storage);
+
+		// Sphere covering the whole chunk
+		storage.fillSphere(glm::vec3(16.0f), 30.0f, 2);
+		reference->fill(2);
+		check_matches(storage);
+		CHECK(storage.uniform());
+	}
+}
+
+
+TEST_CASE("'CompressedChunkStorage<uint16_t>' heap usage", "[voxen::land::compressed_chunk_storage]")
+{
+	CompressedChunkStorage<uint16_t> storage;
+	CHECK(storage.heapBytes() == 0);
+
+	// Single value splits one node
+	storage.store(5, 17, 30, 7);
+	const size_t single_bytes = storage.heapBytes();
+	CHECK(single_bytes > 0);
+
+	// Merging back releases everything
+	storage.store(5, 17, 30, 0);
+	CHECK(storage.heapBytes() == 0);
+
+	// Random data is not compressible
+	auto source = std::make_unique<CubeArray<uint16_t, N>>();
+	std::mt19937 rng(0xDEADBEEF);
+	for (auto &item : *source) {
+		item = static_cast<uint16_t>(rng());
+	}
+
+	CompressedChunkStorage<uint16_t> random(source->cview());
+	CHECK(random.heapBytes() >= N * N * N * sizeof(uint16_t));
+	CHECK(CompressedChunkStorage<uint16_t>(random).heapBytes() == random.heapBytes());
+}
+
 } // namespace voxen::land
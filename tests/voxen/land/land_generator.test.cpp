@@ -0,0 +1,126 @@
+#include <voxen/land/land_generator.hpp>
+
+#include <voxen/land/land_temp_blocks.hpp>
+#include <voxen/svc/engine.hpp>
+#include <voxen/svc/task_builder.hpp>
+#include <voxen/svc/task_service.hpp>
+
+#include "../../voxen_test_common.hpp"
+
+#include <vector>
+
+namespace voxen::land
+{
+
+namespace
+{
+
+std::vector<std::byte> serializeChunk(const Chunk &chunk)
+{
+	std::vector<std::byte> bytes(chunk.blockIds().serializedSize());
+	chunk.blockIds().serialize(bytes);
+	return bytes;
+}
+
+} // namespace
+
+TEST_CASE("'Generator' column heightmap cache and early skips", "[voxen::land::land_generator]")
+{
+	auto engine = svc::Engine::createForTestSuite();
+	svc::TaskService &task_svc = engine->serviceLocator().requestService<svc::TaskService>();
+
+	Generator gen;
+	WorldTickId tick(1);
+	gen.onWorldTickBegin(tick);
+
+	{
+		svc::TaskBuilder bld(task_svc);
+		// Global map is shared by all keys, preparing any one is enough
+		gen.prepareKeyGeneration(ChunkKey(0, 0, 0), bld);
+		gen.waitEnqueuedTasks(bld);
+	}
+
+	// Jump far enough ahead to evict every cached column heightmap
+	auto evict_cache = [&]() {
+		tick += 1000;
+		gen.onWorldTickBegin(tick);
+	};
+
+	// Generate the whole world height of two columns (one on each side of zero)
+	// once with cache reset before every chunk, once with cache kept warm.
+	// Coordinates are even to make valid LOD1 keys for the same column.
+	for (const int32_t column_x : { 6, -18 }) {
+		const int32_t column_z = column_x * 3;
+
+		std::vector<std::vector<std::byte>> cold_chunks;
+		std::vector<PseudoChunkData::CellEntryArray> cold_pseudo_chunks;
+
+		for (int32_t y = Consts::MIN_WORLD_Y_CHUNK; y <= Consts::MAX_WORLD_Y_CHUNK; y++) {
+			evict_cache();
+			Chunk chunk;
+			gen.generateChunk(ChunkKey(column_x, y, column_z), chunk);
+			cold_chunks.emplace_back(serializeChunk(chunk));
+
+			if (y % 2 == 0) {
+				evict_cache();
+				PseudoChunkData pseudo(ChunkKey(column_x, y, column_z, 1));
+				gen.generatePseudoChunk(ChunkKey(column_x, y, column_z, 1), pseudo);
+				cold_pseudo_chunks.emplace_back(pseudo.cellEntries());
+			}
+		}
+
+		// Don't spam assertions count, count mismatches instead
+		size_t chunk_mismatches = 0;
+		size_t pseudo_chunk_mismatches = 0;
+
+		// Interleave LODs in the same tick, their heightmaps must not mix up
+		for (int32_t y = Consts::MIN_WORLD_Y_CHUNK; y <= Consts::MAX_WORLD_Y_CHUNK; y++) {
+			Chunk chunk;
+			gen.generateChunk(ChunkKey(column_x, y, column_z), chunk);
+			if (serializeChunk(chunk) != cold_chunks[size_t(y - Consts::MIN_WORLD_Y_CHUNK)]) {
+				chunk_mismatches++;
+			}
+
+			if (y % 2 == 0) {
+				PseudoChunkData pseudo(ChunkKey(column_x, y, column_z, 1));
+				gen.generatePseudoChunk(ChunkKey(column_x, y, column_z, 1), pseudo);
+				if (pseudo.cellEntries() != cold_pseudo_chunks[size_t(y - Consts::MIN_WORLD_Y_CHUNK) / 2]) {
+					pseudo_chunk_mismatches++;
+				}
+			}
+		}
+
+		INFO("Column (" << column_x << "; " << column_z << ")");
+		CHECK(chunk_mismatches == 0);
+		CHECK(pseudo_chunk_mismatches == 0);
+
+		// The lowest chunk is fully underground and not under water, filled with one solid material
+		Chunk bottom;
+		gen.generateChunk(ChunkKey(column_x, Consts::MIN_WORLD_Y_CHUNK, column_z), bottom);
+		CHECK(bottom.blockIds().uniform());
+		CHECK(bottom.blockIds().load(0, 0, 0) != TempBlockMeta::BlockEmpty);
+		CHECK(bottom.blockIds().load(0, 0, 0) != TempBlockMeta::BlockWater);
+
+		// The highest chunk is fully above the surface
+		Chunk top;
+		gen.generateChunk(ChunkKey(column_x, Consts::MAX_WORLD_Y_CHUNK, column_z), top);
+		CHECK(top.blockIds().uniform());
+		CHECK(top.blockIds().load(0, 0, 0) == TempBlockMeta::BlockEmpty);
+
+		// Pseudo-chunks completely below or above the surface have no cells
+		CHECK(cold_pseudo_chunks.front().empty());
+		CHECK(cold_pseudo_chunks.back().empty());
+
+		// Something in between must cross the surface and go through per-block generation
+		size_t nonuniform_chunks = 0;
+		for (const auto &bytes : cold_chunks) {
+			Chunk::BlockIdStorage storage;
+			if (storage.deserialize(bytes) && !storage.uniform()) {
+				nonuniform_chunks++;
+			}
+		}
+		CHECK(nonuniform_chunks > 0);
+	}
+}
+
+} // namespace voxen::land
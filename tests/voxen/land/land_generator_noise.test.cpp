@@ -0,0 +1,67 @@
+#include <voxen/land/land_generator_noise.hpp>
+
+#include <voxen/land/land_public_consts.hpp>
+
+#include "../../voxen_test_common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace voxen::land
+{
+
+TEST_CASE("'GeneratorNoise' plane sampling matches scalar sampling", "[voxen::land::land_generator_noise]")
+{
+	constexpr double WORLD_HALF_SIZE_X = 0.5 * Consts::CHUNK_SIZE_METRES
+		* (Consts::MAX_UNIQUE_WORLD_X_CHUNK + 1 - Consts::MIN_UNIQUE_WORLD_X_CHUNK);
+
+	struct Plane {
+		double min_x;
+		double min_z;
+		double step;
+		uint32_t size;
+	};
+
+	// Cover true chunk (block centers) and pseudo-chunk (cell corners) sampling
+	// patterns of different LODs, negative coordinates and X wraparound point
+	const Plane planes[] = {
+		{ 0.375, 0.375, 0.75, 32 },
+		{ -1234.125, 5678.625, 0.75, 32 },
+		{ -24.0, -48.0, 1.5, 33 },
+		{ 96000.0, -72000.0, 12.0, 33 },
+		{ WORLD_HALF_SIZE_X - 100.0, 0.0, 6.0, 33 },
+		{ 17.0, 17.0, 1.0, 7 },
+	};
+
+	for (const Plane &plane : planes) {
+		std::vector<float> output(plane.size * plane.size);
+		GeneratorNoise::sampleOctavedWrappedSimplexPlane(plane.min_x, plane.min_z, plane.step, plane.size, output);
+
+		// Don't spam assertions count, count mismatches instead
+		size_t mismatches = 0;
+		float max_difference = 0.0f;
+
+		for (uint32_t i = 0; i < plane.size; i++) {
+			for (uint32_t j = 0; j < plane.size; j++) {
+				const double x = plane.min_x + double(i) * plane.step;
+				const double z = plane.min_z + double(j) * plane.step;
+
+				const float expected = GeneratorNoise::sampleOctavedWrappedSimplex(x, z);
+				const float actual = output[i * plane.size + j];
+
+				// Noise is in metres, allow differences much smaller than a block
+				const float difference = std::abs(expected - actual);
+				max_difference = std::max(max_difference, difference);
+				if (!(difference <= 1e-3f)) {
+					mismatches++;
+				}
+			}
+		}
+
+		INFO("Plane at (" << plane.min_x << "; " << plane.min_z << "), max difference " << max_difference);
+		CHECK(mismatches == 0);
+	}
+}
+
+} // namespace voxen::land
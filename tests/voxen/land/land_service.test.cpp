@@ -0,0 +1,341 @@
+#include <voxen/land/land_service.hpp>
+
+#include <voxen/land/land_messages.hpp>
+#include <voxen/land/land_state.hpp>
+#include <voxen/land/land_temp_blocks.hpp>
+#include <voxen/svc/engine.hpp>
+#include <voxen/svc/message_sender.hpp>
+#include <voxen/svc/messaging_service.hpp>
+
+#include "../../voxen_test_common.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace voxen::land
+{
+
+namespace
+{
+
+constexpr UID TEST_SENDER_UID("5b1e3c07-9d2a4f68-a04c7e19-3f86d2b5");
+
+class LandServiceFixture {
+public:
+	LandServiceFixture()
+	{
+		svc::ServiceLocator &svc = m_engine->serviceLocator();
+		svc.registerServiceFactory<LandService>([](svc::ServiceLocator &s) {
+			return std::make_unique<LandService>(s, LandService::Config { .memory_stats_period = 0 });
+		});
+
+		m_land = &svc.requestService<LandService>();
+		m_sender = svc.requestService<svc::MessagingService>().createSender(TEST_SENDER_UID);
+	}
+
+	LandService &land() noexcept { return *m_land; }
+	svc::MessageSender &sender() noexcept { return m_sender; }
+	const LandState &state() const noexcept { return m_land->stateForCopy(); }
+
+	ChunkTicket requestTicket(ChunkTicketArea area)
+	{
+		auto handle = m_sender.requestWithHandle<ChunkTicketRequestMessage>(LandService::SERVICE_UID, area);
+		doTick();
+		REQUIRE(handle.wait() == svc::RequestStatus::Complete);
+
+		ChunkTicket ticket = std::move(handle.payload().ticket);
+		handle.reset();
+		return ticket;
+	}
+
+	void doTick() { m_land->doTick(WorldTickId(++m_tick)); }
+
+	// Run ticks until `pred()` returns true, with a (generous) time limit
+	template<typename F>
+	bool doTicksUntil(F &&pred)
+	{
+		for (int i = 0; i < 5000; i++) {
+			doTick();
+			if (pred()) {
+				return true;
+			}
+
+			// Let tasks complete
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		return false;
+	}
+
+private:
+	svc::Engine::Ptr m_engine = svc::Engine::createForTestSuite();
+	LandService *m_land = nullptr;
+	svc::MessageSender m_sender;
+	int64_t m_tick = 0;
+};
+
+bool boxContains(const ChunkTicketBoxArea &box, ChunkKey key)
+{
+	return key.scale_log2 == box.begin.scale_log2 && glm::all(glm::greaterThanEqual(key.base(), box.begin.base()))
+		&& glm::all(glm::lessThan(key.base(), box.end.base()));
+}
+
+} // namespace
+
+TEST_CASE("'LandService' regenerates surfaces when pseudo-data becomes empty", "[voxen::land::land_service]")
+{
+	LandServiceFixture fixture;
+
+	// Deep underground, everything is solid and has no surface. Edited LOD0 chunk
+	// is kept loaded, and 3x3x3 keys at LOD1 and LOD2 are around its parents.
+	// LOD1 pseudo-data is aggregated from chunks which are not uniform after edits,
+	// while LOD2 sees all its children empty again and publishes it without a task.
+	const ChunkKey edit_chunk_key(0, -250, 0);
+	const ChunkTicket lod0_ticket = fixture.requestTicket(ChunkTicketBoxArea {
+		.begin = edit_chunk_key,
+		.end = ChunkKey(edit_chunk_key.base() + 1),
+	});
+	REQUIRE(lod0_ticket.valid());
+
+	std::vector<ChunkTicket> lod_tickets;
+	std::vector<ChunkKey> center_keys;
+	std::vector<ChunkKey> lod_keys;
+
+	for (ChunkKey center_key = edit_chunk_key.parentLodKey(); center_key.scale_log2 <= 2;
+		center_key = center_key.parentLodKey()) {
+		const int32_t S = center_key.scaleMultiplier();
+
+		lod_tickets.emplace_back(fixture.requestTicket(ChunkTicketBoxArea {
+			.begin = ChunkKey(center_key.base() - S, center_key.scale_log2),
+			.end = ChunkKey(center_key.base() + 2 * S, center_key.scale_log2),
+		}));
+		REQUIRE(lod_tickets.back().valid());
+
+		center_keys.emplace_back(center_key);
+		for (int32_t y = -1; y <= 1; y++) {
+			for (int32_t x = -1; x <= 1; x++) {
+				for (int32_t z = -1; z <= 1; z++) {
+					lod_keys.push_back(ChunkKey(center_key.base() + glm::ivec3(x, y, z) * S, center_key.scale_log2));
+				}
+			}
+		}
+	}
+
+	// Surfaces of all these keys are generated and empty
+	auto all_surfaces_empty = [&] {
+		for (ChunkKey key : lod_keys) {
+			const auto *item = fixture.state().pseudo_chunk_surface_table.find(key);
+			if (!item || item->hasValue()) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	auto center_surfaces_present = [&] {
+		for (ChunkKey key : center_keys) {
+			const auto *item = fixture.state().pseudo_chunk_surface_table.find(key);
+			if (!item || !item->hasValue()) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	REQUIRE(fixture.doTicksUntil(all_surfaces_empty));
+
+	const auto *chunk_item = fixture.state().chunk_table.find(edit_chunk_key);
+	REQUIRE(chunk_item != nullptr);
+	const Chunk::BlockId original_id = chunk_item->value().blockIds().load(0, 0, 0);
+	REQUIRE_FALSE(TempBlockMeta::isBlockEmpty(original_id));
+
+	// Cavity must be large enough to be visible at LOD2
+	auto fill_cavity = [&](Chunk::BlockId id) {
+		const glm::ivec3 cavity_begin = edit_chunk_key.base() * Consts::CHUNK_SIZE_BLOCKS + 12;
+
+		for (int32_t x = 0; x < 8; x++) {
+			for (int32_t y = 0; y < 8; y++) {
+				for (int32_t z = 0; z < 8; z++) {
+					fixture.sender().send<BlockEditMessage>(LandService::SERVICE_UID, cavity_begin + glm::ivec3(x, y, z),
+						id);
+				}
+			}
+		}
+	};
+
+	// Carve a cavity, surfaces appear inside
+	fill_cavity(TempBlockMeta::BlockEmpty);
+	CHECK(fixture.doTicksUntil(center_surfaces_present));
+
+	// Fill it back, pseudo-data is empty again and so must be all surfaces
+	fill_cavity(original_id);
+	CHECK(fixture.doTicksUntil(all_surfaces_empty));
+}
+
+TEST_CASE("'LandService' ignores block edits changing nothing", "[voxen::land::land_service]")
+{
+	LandServiceFixture fixture;
+
+	const ChunkKey edit_chunk_key(0, -250, 0);
+	const ChunkTicket ticket = fixture.requestTicket(ChunkTicketBoxArea {
+		.begin = ChunkKey(edit_chunk_key.base() - 1),
+		.end = ChunkKey(edit_chunk_key.base() + 2),
+	});
+	REQUIRE(ticket.valid());
+
+	REQUIRE(fixture.doTicksUntil([&] { return fixture.state().pseudo_chunk_surface_table.find(edit_chunk_key); }));
+
+	// Let invalidations from loading adjacent chunks settle
+	auto run_ticks = [&] {
+		for (int i = 0; i < 200; i++) {
+			fixture.doTick();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	};
+	run_ticks();
+
+	const auto *chunk_item = fixture.state().chunk_table.find(edit_chunk_key);
+	const auto *surface_item = fixture.state().pseudo_chunk_surface_table.find(edit_chunk_key);
+	REQUIRE(chunk_item != nullptr);
+	REQUIRE(surface_item != nullptr);
+
+	const uint64_t chunk_version = chunk_item->version();
+	const uint64_t surface_version = surface_item->version();
+	const Chunk::BlockId id = chunk_item->value().blockIds().load(5, 6, 7);
+
+	// Write back the same block, neither chunk nor its surface are updated
+	const glm::ivec3 position = edit_chunk_key.base() * Consts::CHUNK_SIZE_BLOCKS + glm::ivec3(5, 6, 7);
+	fixture.sender().send<BlockEditMessage>(LandService::SERVICE_UID, position, id);
+	run_ticks();
+
+	CHECK(fixture.state().chunk_table.find(edit_chunk_key)->version() == chunk_version);
+	CHECK(fixture.state().pseudo_chunk_surface_table.find(edit_chunk_key)->version() == surface_version);
+}
+
+TEST_CASE("'LandService' keeps dependencies of ticketed keys loaded", "[voxen::land::land_service]")
+{
+	LandServiceFixture fixture;
+
+	// A single LOD1 key, its pseudo-data is aggregated from 27 LOD0 chunks
+	// which are not covered by any ticket themselves
+	const ChunkKey lod1_key(glm::ivec3(4, -2, 6), 1);
+	ChunkTicket ticket = fixture.requestTicket(ChunkTicketBoxArea {
+		.begin = lod1_key,
+		.end = ChunkKey(lod1_key.base() + 2, 1),
+	});
+	REQUIRE(ticket.valid());
+
+	auto count_loaded_chunks = [&] {
+		size_t loaded = 0;
+
+		for (int32_t y = 0; y <= 2; y++) {
+			for (int32_t x = 0; x <= 2; x++) {
+				for (int32_t z = 0; z <= 2; z++) {
+					if (fixture.state().chunk_table.find(ChunkKey(lod1_key.base() + glm::ivec3(x, y, z)))) {
+						loaded++;
+					}
+				}
+			}
+		}
+
+		return loaded;
+	};
+
+	REQUIRE(fixture.doTicksUntil([&] { return fixture.state().pseudo_chunk_surface_table.find(lod1_key); }));
+	REQUIRE(count_loaded_chunks() == 27);
+
+	// Go well past the stale age, nothing changes so the ticketed key is not visited
+	for (int i = 0; i < 2000; i++) {
+		fixture.doTick();
+	}
+
+	CHECK(count_loaded_chunks() == 27);
+
+	// Once the ticket is gone, they are finally unloaded
+	ticket = {};
+	for (int i = 0; i < 2000; i++) {
+		fixture.doTick();
+	}
+
+	CHECK(count_loaded_chunks() == 0);
+}
+
+TEST_CASE("'LandService' keeps chunk ticket refcounts when adjusting boxes", "[voxen::land::land_service]")
+{
+	LandServiceFixture fixture;
+
+	ChunkTicketBoxArea fixed_box { .begin = ChunkKey(4, 0, 4), .end = ChunkKey(12, 4, 12) };
+	ChunkTicket fixed_ticket = fixture.requestTicket(fixed_box);
+	ChunkTicketBoxArea moving_box { .begin = ChunkKey(0, 0, 0), .end = ChunkKey(8, 4, 8) };
+	ChunkTicket moving_ticket = fixture.requestTicket(moving_box);
+	REQUIRE(fixed_ticket.valid());
+	REQUIRE(moving_ticket.valid());
+
+	// Compare refcounts of all keys around both boxes with the expected ones
+	auto count_mismatches = [&](uint32_t scale_log2) {
+		size_t mismatches = 0;
+		const int32_t step = 1 << scale_log2;
+
+		for (int32_t y = -8; y < 16; y += step) {
+			for (int32_t x = -16; x < 32; x += step) {
+				for (int32_t z = -16; z < 32; z += step) {
+					const ChunkKey key(glm::ivec3(x, y, z), scale_log2);
+					const uint32_t expected = uint32_t(boxContains(fixed_box, key))
+						+ uint32_t(boxContains(moving_box, key));
+
+					if (fixture.land().chunkTicketRefs(key) != expected) {
+						mismatches++;
+					}
+				}
+			}
+		}
+
+		return mismatches;
+	};
+
+	CHECK(count_mismatches(0) == 0);
+
+	auto adjust = [&](ChunkTicketBoxArea box) {
+		moving_box = box;
+		moving_ticket.adjustAsync(box);
+		fixture.doTick();
+	};
+
+	// Shift along all axes, partially overlapping both the old box and the other ticket
+	adjust({ .begin = ChunkKey(2, 1, -3), .end = ChunkKey(10, 5, 5) });
+	CHECK(count_mismatches(0) == 0);
+
+	// Shrink into the old box
+	adjust({ .begin = ChunkKey(3, 2, -1), .end = ChunkKey(5, 3, 4) });
+	CHECK(count_mismatches(0) == 0);
+
+	// Grow around the old box and the other ticket
+	adjust({ .begin = ChunkKey(-4, -2, -4), .end = ChunkKey(16, 6, 16) });
+	CHECK(count_mismatches(0) == 0);
+
+	// Jump away without any overlap
+	adjust({ .begin = ChunkKey(20, 8, 20), .end = ChunkKey(24, 12, 30) });
+	CHECK(count_mismatches(0) == 0);
+
+	// Switch LOD, keys at the previous one are released
+	adjust({ .begin = ChunkKey(glm::ivec3(0, -4, 0), 2), .end = ChunkKey(glm::ivec3(12, 8, 16), 2) });
+	CHECK(count_mismatches(0) == 0);
+	CHECK(count_mismatches(2) == 0);
+
+	// Move at that LOD
+	adjust({ .begin = ChunkKey(glm::ivec3(-8, 0, 4), 2), .end = ChunkKey(glm::ivec3(8, 12, 12), 2) });
+	CHECK(count_mismatches(2) == 0);
+
+	// Releasing tickets releases all keys
+	fixed_ticket = {};
+	moving_ticket = {};
+	fixture.doTick();
+
+	fixed_box = {};
+	moving_box = {};
+	CHECK(count_mismatches(0) == 0);
+	CHECK(count_mismatches(2) == 0);
+}
+
+} // namespace voxen::land
@@ -0,0 +1,303 @@
+#include <voxen/land/land_shared_state.hpp>
+
+#include <voxen/land/land_state.hpp>
+#include <voxen/os/process.hpp>
+#include <voxen/util/exception.hpp>
+
+#include "../../test_common.hpp"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
+namespace voxen::land
+{
+
+namespace
+{
+
+std::string makeObjectName()
+{
+	// Don't collide with concurrently running tests
+	return "voxen-test-land-shared-state-" + std::to_string(os::Process::getProcessId());
+}
+
+LandState::ChunkTable::ValuePtr makeChunk(Chunk::BlockId value, glm::uvec3 odd_block = glm::uvec3(0))
+{
+	auto chunk = std::make_shared<Chunk>();
+	chunk->setAllBlocksUniform(value);
+	chunk->setBlock(odd_block, Chunk::BlockId(value + 1));
+	return chunk;
+}
+
+Chunk::BlockId loadBlock(const SharedLandStateView::ChunkItem &item, glm::uvec3 pos)
+{
+	// Tests don't use this value, return it on failure without spamming assertions
+	constexpr Chunk::BlockId INVALID = 0xFFFF;
+
+	Chunk::BlockIdStorage storage;
+	return storage.deserialize(item.block_ids) ? storage.load(pos.x, pos.y, pos.z) : INVALID;
+}
+
+} // namespace
+
+TEST_CASE("'SharedLandState' publication round-trip", "[voxen::land::land_shared_state]")
+{
+	SharedLandStatePublisher publisher(SharedLandStatePublisher::Config {
+		.name = makeObjectName(),
+		.max_chunks = 1000,
+		.arena_bytes = 1 << 20,
+	});
+
+	SharedLandStateView view(makeObjectName());
+	CHECK(view.publisherAlive());
+	CHECK_FALSE(view.acquire().valid());
+
+	LandState state;
+	// Expected block value at (0, 0, 1) by key, the odd block is always on the diagonal
+	std::map<uint64_t, Chunk::BlockId> expected;
+	std::mt19937_64 rng(0xDEADBEEF);
+
+	for (int64_t tick = 1; tick <= 20; tick++) {
+		for (int i = 0; i < 50; i++) {
+			ChunkKey key(int64_t(rng() % 32), int64_t(rng() % 4), int64_t(rng() % 32));
+			const auto value = Chunk::BlockId(rng() % 1000);
+
+			if (rng() % 4 == 0) {
+				state.chunk_table.erase(uint64_t(tick), key);
+				expected.erase(key.packed());
+			} else {
+				state.chunk_table.insert(uint64_t(tick), key, makeChunk(value, glm::uvec3(rng() % 32)));
+				expected[key.packed()] = value;
+			}
+		}
+
+		// Null values are not published
+		state.chunk_table.insert(uint64_t(tick), ChunkKey(0, 100, 0), LandState::ChunkTable::ValuePtr());
+
+		REQUIRE(publisher.publish(WorldTickId(tick), state));
+
+		SharedLandStateView::Snapshot snapshot = view.acquire();
+		REQUIRE(snapshot.valid());
+		CHECK(snapshot.tickId() == WorldTickId(tick));
+		CHECK(snapshot.size() == expected.size());
+		CHECK_FALSE(snapshot.find(ChunkKey(0, 100, 0)).has_value());
+
+		// Don't spam assertions count, count mismatches instead
+		size_t visited = 0;
+		size_t mismatches = 0;
+
+		snapshot.forEach([&](const SharedLandStateView::ChunkItem &item) {
+			visited++;
+
+			auto iter = expected.find(item.key.packed());
+			if (iter == expected.end() || loadBlock(item, glm::uvec3(0, 0, 1)) != iter->second
+				|| item.version != state.chunk_table.find(item.key)->version()) {
+				mismatches++;
+			}
+		});
+
+		for (const auto &[packed, value] : expected) {
+			auto item = snapshot.find(ChunkKey(packed));
+			if (!item || item->key != ChunkKey(packed) || loadBlock(*item, glm::uvec3(0, 0, 1)) != value) {
+				mismatches++;
+			}
+		}
+
+		CHECK(visited == expected.size());
+		CHECK(mismatches == 0);
+	}
+}
+
+TEST_CASE("'SharedLandState' pinned snapshot blocks publication", "[voxen::land::land_shared_state]")
+{
+	SharedLandStatePublisher publisher(SharedLandStatePublisher::Config {
+		.name = makeObjectName(),
+		.max_chunks = 16,
+		.arena_bytes = 1 << 16,
+	});
+
+	SharedLandStateView view(makeObjectName());
+
+	LandState state;
+	const ChunkKey key(1, 2, 3);
+
+	state.chunk_table.insert(1, key, makeChunk(10));
+	REQUIRE(publisher.publish(WorldTickId(1), state));
+
+	SharedLandStateView::Snapshot snapshot = view.acquire();
+	REQUIRE(snapshot.valid());
+
+	// The other buffer is free
+	state.chunk_table.insert(2, key, makeChunk(20));
+	CHECK(publisher.publish(WorldTickId(2), state));
+
+	// Now it would overwrite the pinned one
+	state.chunk_table.insert(3, key, makeChunk(30));
+	CHECK_FALSE(publisher.publish(WorldTickId(3), state));
+
+	CHECK(snapshot.tickId() == WorldTickId(1));
+	CHECK(loadBlock(*snapshot.find(key), glm::uvec3(1)) == 10);
+
+	snapshot = {};
+	CHECK(publisher.publish(WorldTickId(4), state));
+
+	snapshot = view.acquire();
+	CHECK(snapshot.tickId() == WorldTickId(4));
+	CHECK(loadBlock(*snapshot.find(key), glm::uvec3(1)) == 30);
+	snapshot = {};
+
+	// Exceeding the capacity stops publication
+	for (int64_t i = 0; i < 16; i++) {
+		state.chunk_table.insert(5, ChunkKey(i, 0, 0), makeChunk(40));
+	}
+	CHECK_FALSE(publisher.publish(WorldTickId(5), state));
+	CHECK_FALSE(publisher.publish(WorldTickId(6), state));
+
+	// The last valid state is still readable
+	snapshot = view.acquire();
+	CHECK(snapshot.tickId() == WorldTickId(4));
+}
+
+TEST_CASE("'SharedLandState' republishes chunk edited in place", "[voxen::land::land_shared_state]")
+{
+	SharedLandStatePublisher publisher(SharedLandStatePublisher::Config {
+		.name = makeObjectName(),
+		.max_chunks = 16,
+		.arena_bytes = 1 << 20,
+	});
+
+	SharedLandStateView view(makeObjectName());
+
+	LandState state;
+	const ChunkKey key(1, 2, 3);
+	const ChunkKey neighbor_key(4, 5, 6);
+
+	// Uniform chunk has the smallest serialized size, its neighbor blob goes right after it
+	auto chunk = std::make_shared<Chunk>();
+	chunk->setAllBlocksUniform(10);
+	state.chunk_table.insert(1, key, chunk);
+	state.chunk_table.insert(1, neighbor_key, makeChunk(50));
+
+	// Make both buffers reference the same blobs
+	REQUIRE(publisher.publish(WorldTickId(1), state));
+	REQUIRE(publisher.publish(WorldTickId(2), state));
+
+	// This is what block edits do, serialized size grows
+	for (uint32_t i = 0; i < 32; i++) {
+		chunk->setBlock(glm::uvec3(i, i % 7, (i * 5) % 32), Chunk::BlockId(100 + i));
+	}
+	state.chunk_table.insert(3, key, chunk);
+
+	size_t mismatches = 0;
+
+	for (int64_t tick = 3; tick <= 6; tick++) {
+		REQUIRE(publisher.publish(WorldTickId(tick), state));
+
+		SharedLandStateView::Snapshot snapshot = view.acquire();
+		REQUIRE(snapshot.valid());
+
+		auto item = snapshot.find(key);
+		REQUIRE(item.has_value());
+		CHECK(item->version == 3);
+
+		for (uint32_t i = 0; i < 32; i++) {
+			if (loadBlock(*item, glm::uvec3(i, i % 7, (i * 5) % 32)) != Chunk::BlockId(100 + i)) {
+				mismatches++;
+			}
+		}
+
+		if (loadBlock(*item, glm::uvec3(31)) != 10) {
+			mismatches++;
+		}
+
+		auto neighbor_item = snapshot.find(neighbor_key);
+		if (!neighbor_item || loadBlock(*neighbor_item, glm::uvec3(1)) != 50
+			|| loadBlock(*neighbor_item, glm::uvec3(0)) != 51) {
+			mismatches++;
+		}
+	}
+
+	CHECK(mismatches == 0);
+}
+
+#ifndef _WIN32
+
+TEST_CASE("'SharedLandState' reclaims reader slots of dead processes", "[voxen::land::land_shared_state]")
+{
+	// Child process would make a different name
+	const std::string name = makeObjectName();
+
+	SharedLandStatePublisher publisher(SharedLandStatePublisher::Config {
+		.name = name,
+		.max_chunks = 16,
+		.arena_bytes = 1 << 16,
+	});
+
+	LandState state;
+	const ChunkKey key(1, 2, 3);
+	state.chunk_table.insert(1, key, makeChunk(10));
+	REQUIRE(publisher.publish(WorldTickId(1), state));
+
+	// Take all slots but one
+	std::vector<std::unique_ptr<SharedLandStateView>> views;
+	while (true) {
+		try {
+			views.emplace_back(std::make_unique<SharedLandStateView>(name));
+		}
+		catch (Exception &) {
+			break;
+		}
+	}
+
+	REQUIRE(views.size() > 1);
+	views.pop_back();
+
+	// Child process takes the last slot, pins a snapshot and dies without releasing anything
+	const pid_t child = fork();
+	REQUIRE(child >= 0);
+
+	if (child == 0) {
+		try {
+			SharedLandStateView view(name);
+			SharedLandStateView::Snapshot snapshot = view.acquire();
+			_exit(snapshot.valid() ? 0 : 1);
+		}
+		catch (...) {
+			_exit(2);
+		}
+	}
+
+	int status = 0;
+	REQUIRE(waitpid(child, &status, 0) == child);
+	REQUIRE(WIFEXITED(status));
+	REQUIRE(WEXITSTATUS(status) == 0);
+
+	// Its slot is reclaimed, along with the pinned snapshot
+	SharedLandStateView view(name);
+
+	state.chunk_table.insert(2, key, makeChunk(20));
+	CHECK(publisher.publish(WorldTickId(2), state));
+	state.chunk_table.insert(3, key, makeChunk(30));
+	CHECK(publisher.publish(WorldTickId(3), state));
+
+	SharedLandStateView::Snapshot snapshot = view.acquire();
+	REQUIRE(snapshot.valid());
+	CHECK(snapshot.tickId() == WorldTickId(3));
+	CHECK(loadBlock(*snapshot.find(key), glm::uvec3(1)) == 30);
+	snapshot = {};
+
+	// Now all slots are taken by live readers
+	CHECK_THROWS(SharedLandStateView(name));
+}
+
+#endif // _WIN32
+
+} // namespace voxen::land
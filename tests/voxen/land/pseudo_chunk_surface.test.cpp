@@ -0,0 +1,341 @@
+#include <voxen/land/pseudo_chunk_surface.hpp>
+
+#include <voxen/land/land_chunk.hpp>
+#include <voxen/land/land_temp_blocks.hpp>
+
+#include "../../voxen_test_common.hpp"
+
+#include <voxen/land/pseudo_chunk_data.hpp>
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace voxen::land
+{
+
+namespace
+{
+
+constexpr int32_t B = Consts::CHUNK_SIZE_BLOCKS;
+
+// (block X, block Y, block Z, orientation) -> face color
+using FaceMap = std::map<std::tuple<int32_t, int32_t, int32_t, int32_t>, uint16_t>;
+
+constexpr glm::ivec3 NEIGHBOR_OFFSET[6] = {
+	glm::ivec3(1, 0, 0),
+	glm::ivec3(-1, 0, 0),
+	glm::ivec3(0, 1, 0),
+	glm::ivec3(0, -1, 0),
+	glm::ivec3(0, 0, 1),
+	glm::ivec3(0, 0, -1),
+};
+
+// Octahedral encodings of axis-aligned normals in the same order
+constexpr glm::i16vec2 PACKED_FACE_NORMAL[6] = {
+	glm::i16vec2(32767, 0),
+	glm::i16vec2(-32767, 0),
+	glm::i16vec2(0, 0),
+	glm::i16vec2(32767, 32767),
+	glm::i16vec2(0, 32767),
+	glm::i16vec2(0, -32767),
+};
+
+glm::ivec3 unpackVertexPosition(const PseudoSurfaceVertexPosition &pos)
+{
+	glm::vec3 unorm = glm::vec3(pos.position_unorm) / 65535.0f;
+	return glm::ivec3(glm::round((unorm - 0.1f) / 0.8f * float(B)));
+}
+
+// Brute force list of visible faces, every one must be covered by some quad
+FaceMap collectVisibleFaces(ChunkAdjacencyRef adj)
+{
+	auto load = [&](glm::ivec3 c) -> Chunk::BlockId {
+		const Chunk *chunk = &adj.chunk;
+
+		for (int32_t axis = 0; axis < 3; axis++) {
+			if (c[axis] >= B) {
+				chunk = adj.adjacent[axis * 2];
+				c[axis] -= B;
+			} else if (c[axis] < 0) {
+				chunk = adj.adjacent[axis * 2 + 1];
+				c[axis] += B;
+			}
+		}
+
+		return chunk ? chunk->blockIds().load(uint32_t(c.x), uint32_t(c.y), uint32_t(c.z)) : 0;
+	};
+
+	FaceMap faces;
+
+	for (int32_t x = 0; x < B; x++) {
+		for (int32_t y = 0; y < B; y++) {
+			for (int32_t z = 0; z < B; z++) {
+				Chunk::BlockId id = load(glm::ivec3(x, y, z));
+				if (id == 0) {
+					continue;
+				}
+
+				for (int32_t orientation = 0; orientation < 6; orientation++) {
+					if (load(glm::ivec3(x, y, z) + NEIGHBOR_OFFSET[orientation]) == 0) {
+						uint16_t color = TempBlockMeta::packColor555(TempBlockMeta::BLOCK_FIXED_COLOR[id]);
+						faces[{ x, y, z, orientation }] = color;
+					}
+				}
+			}
+		}
+	}
+
+	return faces;
+}
+
+// Split quads back into unit faces, counting malformed quads and faces covered more than once as errors
+FaceMap collectMeshFaces(const PseudoChunkSurface &surface, size_t &errors)
+{
+	FaceMap faces;
+	errors = 0;
+
+	const PseudoSurfaceVertexPosition *positions = surface.vertexPositions();
+	const PseudoSurfaceVertexAttributes *attribs = surface.vertexAttributes();
+	const uint16_t *indices = surface.indices();
+
+	// Quads are emitted as (0, 1, 2), (2, 3, 0) triangle pairs
+	for (uint32_t i = 0; i + 6 <= surface.numIndices(); i += 6) {
+		glm::ivec3 v0 = unpackVertexPosition(positions[indices[i]]);
+		glm::ivec3 v2 = unpackVertexPosition(positions[indices[i + 2]]);
+		glm::ivec3 lo = glm::min(v0, v2);
+		glm::ivec3 hi = glm::max(v0, v2);
+
+		const PseudoSurfaceVertexAttributes &attrib = attribs[indices[i]];
+
+		int32_t orientation = 0;
+		while (orientation < 6 && attrib.normal_oct_snorm != PACKED_FACE_NORMAL[orientation]) {
+			orientation++;
+		}
+
+		// Quad must be flat along the normal axis
+		const int32_t axis = orientation / 2;
+		if (orientation == 6 || lo[axis] != hi[axis]) {
+			errors++;
+			continue;
+		}
+
+		// Face with positive normal is located on the far side of its block
+		if (orientation % 2 == 0) {
+			lo[axis]--;
+		}
+		hi[axis] = lo[axis] + 1;
+
+		for (int32_t x = lo.x; x < hi.x; x++) {
+			for (int32_t y = lo.y; y < hi.y; y++) {
+				for (int32_t z = lo.z; z < hi.z; z++) {
+					auto [iter, inserted] = faces.emplace(std::tuple(x, y, z, orientation),
+						attrib.mat_hist_entries.x);
+					if (!inserted) {
+						errors++;
+					}
+				}
+			}
+		}
+	}
+
+	return faces;
+}
+
+using TriangleList = std::vector<std::array<std::tuple<uint64_t, uint32_t, uint64_t>, 3>>;
+
+// Collect triangles with all vertex attributes affecting rendering, in a canonical order
+TriangleList collectTriangles(const PseudoChunkSurface &surface)
+{
+	TriangleList triangles;
+
+	for (uint32_t i = 0; i + 3 <= surface.numIndices(); i += 3) {
+		auto &triangle = triangles.emplace_back();
+
+		for (uint32_t j = 0; j < 3; j++) {
+			const PseudoSurfaceVertexPosition &pos = surface.vertexPositions()[surface.indices()[i + j]];
+			const PseudoSurfaceVertexAttributes &attrib = surface.vertexAttributes()[surface.indices()[i + j]];
+
+			triangle[j] = std::tuple(uint64_t(pos.position_unorm.x) | (uint64_t(pos.position_unorm.y) << 16)
+					| (uint64_t(pos.position_unorm.z) << 32),
+				uint32_t(uint16_t(attrib.normal_oct_snorm.x)) | (uint32_t(uint16_t(attrib.normal_oct_snorm.y)) << 16),
+				uint64_t(attrib.mat_hist_entries.x) | (uint64_t(attrib.mat_hist_weights.x) << 16));
+		}
+
+		// Rotate the smallest vertex first, this preserves winding
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// Average number of post-transform cache misses per triangle with FIFO cache of `cache_size`
+double calcAcmr(const PseudoChunkSurface &surface, size_t cache_size)
+{
+	std::deque<uint16_t> cache;
+	size_t misses = 0;
+
+	for (uint32_t i = 0; i < surface.numIndices(); i++) {
+		const uint16_t index = surface.indices()[i];
+		if (std::find(cache.begin(), cache.end(), index) == cache.end()) {
+			misses++;
+			cache.push_back(index);
+			if (cache.size() > cache_size) {
+				cache.pop_front();
+			}
+		}
+	}
+
+	return double(misses) / double(surface.numIndices() / 3);
+}
+
+} // namespace
+
+TEST_CASE("'PseudoChunkSurface' true chunk mesh covers visible faces", "[voxen::land::pseudo_chunk_surface]")
+{
+	Chunk chunk;
+	Chunk neighbor;
+	neighbor.setAllBlocksUniform(TempBlockMeta::BlockStone);
+
+	ChunkAdjacencyRef adj(chunk);
+	for (const Chunk *&ptr : adj.adjacent) {
+		ptr = nullptr;
+	}
+
+	SECTION("Flat terrain")
+	{
+		for (uint32_t x = 0; x < B; x++) {
+			for (uint32_t y = 0; y < B / 2; y++) {
+				for (uint32_t z = 0; z < B; z++) {
+					chunk.setBlock(glm::uvec3(x, y, z), TempBlockMeta::BlockStone);
+				}
+			}
+		}
+
+		PseudoChunkSurface surface;
+		surface.generate(adj);
+
+		// One quad for every side of the box
+		CHECK(surface.numVertices() == 6 * 4);
+		CHECK(surface.numIndices() == 6 * 6);
+
+		// Side faces are hidden by the neighbor
+		adj.adjacent[0] = &neighbor;
+		surface.generate(adj);
+		CHECK(surface.numVertices() == 5 * 4);
+	}
+
+	SECTION("Random blocks")
+	{
+		std::mt19937 rng(0xC0FFEE);
+		constexpr Chunk::BlockId BLOCKS[] = {
+			TempBlockMeta::BlockEmpty,
+			TempBlockMeta::BlockEmpty,
+			TempBlockMeta::BlockStone,
+			TempBlockMeta::BlockGrass,
+			TempBlockMeta::BlockSand,
+		};
+
+		for (uint32_t x = 0; x < B; x++) {
+			for (uint32_t y = 0; y < B; y++) {
+				for (uint32_t z = 0; z < B; z++) {
+					// Make larger same-block areas than pure noise to have something to merge
+					Chunk::BlockId id = BLOCKS[(rng() % 8 == 0 ? rng() : (x / 4 + y / 3 + z / 5)) % std::size(BLOCKS)];
+					chunk.setBlock(glm::uvec3(x, y, z), id);
+				}
+			}
+		}
+
+		adj.adjacent[0] = &neighbor;
+		adj.adjacent[3] = &neighbor;
+
+		PseudoChunkSurface surface;
+		surface.generate(adj);
+
+		size_t errors = 0;
+		FaceMap expected = collectVisibleFaces(adj);
+		FaceMap actual = collectMeshFaces(surface, errors);
+
+		CHECK(errors == 0);
+		CHECK(actual.size() == expected.size());
+		CHECK(actual == expected);
+		// Merging must actually happen
+		CHECK(surface.numVertices() < expected.size() * 4);
+	}
+}
+
+TEST_CASE("'PseudoChunkSurface' LOD surface vertex welding", "[voxen::land::pseudo_chunk_surface]")
+{
+	// Flat terrain, lower half of every chunk is solid. All pseudo-chunks
+	// of such world are identical, so the same object serves as every neighbor.
+	Chunk chunk;
+	for (uint32_t x = 0; x < B; x++) {
+		for (uint32_t y = 0; y < B / 2; y++) {
+			for (uint32_t z = 0; z < B; z++) {
+				chunk.setBlock(glm::uvec3(x, y, z), y + 1 == B / 2 ? TempBlockMeta::BlockGrass : TempBlockMeta::BlockSand);
+			}
+		}
+	}
+
+	const Chunk *chunks[27];
+	std::fill_n(chunks, 27, &chunk);
+
+	PseudoChunkData data(ChunkKey(0, 0, 0, 1));
+	data.generateFromLod0(chunks);
+	REQUIRE_FALSE(data.empty());
+
+	const PseudoChunkData *datas[19];
+	std::fill_n(datas, 19, &data);
+
+	PseudoChunkSurface exact;
+	exact.generate(datas, 1,
+		PseudoSurfaceWeldingConfig {
+			.max_normal_angle_degrees = 0.0f,
+			.max_mat_hist_weight_delta = 0,
+			.vertex_cache_size = 0,
+		});
+
+	PseudoChunkSurface reordered;
+	reordered.generate(datas, 1,
+		PseudoSurfaceWeldingConfig {
+			.max_normal_angle_degrees = 0.0f,
+			.max_mat_hist_weight_delta = 0,
+			.vertex_cache_size = 16,
+		});
+
+	PseudoChunkSurface relaxed;
+	relaxed.generate(datas, 1);
+
+	// Don't spam assertions count, count invalid indices instead
+	size_t invalid_indices = 0;
+	for (const PseudoChunkSurface *surface : { &exact, &reordered, &relaxed }) {
+		for (uint32_t i = 0; i < surface->numIndices(); i++) {
+			if (surface->indices()[i] >= surface->numVertices()) {
+				invalid_indices++;
+			}
+		}
+	}
+	CHECK(invalid_indices == 0);
+
+	// Vertices are shared by several triangles on a flat surface
+	CHECK(exact.numIndices() > 0);
+	CHECK(exact.numVertices() * 3 < exact.numIndices());
+	CHECK(relaxed.numVertices() <= exact.numVertices());
+
+	// Exact welding and reordering don't change the geometry
+	const TriangleList exact_triangles = collectTriangles(exact);
+	CHECK(exact.numIndices() == reordered.numIndices());
+	CHECK(exact_triangles == collectTriangles(reordered));
+
+	// Reordering improves vertex cache usage
+	CHECK(calcAcmr(reordered, 16) <= calcAcmr(exact, 16));
+}
+
+} // namespace voxen::land
@@ -27,9 +27,17 @@ TEST_CASE("'AsyncFileIoService' test case 1", "[voxen::svc::async_file_io_servic
 	defer { std::filesystem::remove_all(tmp_path); };
 
 	auto engine = Engine::createForTestSuite();
-	AsyncFileIoService &aio_svc = engine->serviceLocator().requestService<AsyncFileIoService>();
 	TaskService &task_svc = engine->serviceLocator().requestService<TaskService>();
 
+	// Run with both io_uring (if available) and blocking threads backends
+	const bool force_fallback = GENERATE(false, true);
+	INFO("Forced fallback: " << force_fallback);
+	// Zero queue depth is treated as one, all operations go one by one then
+	const uint32_t queue_depth = GENERATE(64u, 0u);
+	INFO("Queue depth: " << queue_depth);
+	AsyncFileIoService aio_svc(engine->serviceLocator(),
+		AsyncFileIoService::Config { .queue_depth = queue_depth, .force_fallback = force_fallback });
+
 	constexpr size_t N = 10;
 	std::vector<uint64_t> task_counters(N);
 	// TODO: we should use something like "error message queue" to make it clear
@@ -103,4 +111,113 @@ TEST_CASE("'AsyncFileIoService' test case 1", "[voxen::svc::async_file_io_servic
 	CHECK(errors.load() == 0);
 }
 
+TEST_CASE("'AsyncFileIoService' vectored and batch requests", "[voxen::svc::async_file_io_service]")
+{
+	std::filesystem::path tmp_path = std::filesystem::temp_directory_path() / "test-voxen-file-aio-case2";
+	INFO("Temporary directory: " << tmp_path);
+
+	REQUIRE_NOTHROW(std::filesystem::create_directory(tmp_path));
+	defer { std::filesystem::remove_all(tmp_path); };
+
+	auto engine = Engine::createForTestSuite();
+	TaskService &task_svc = engine->serviceLocator().requestService<TaskService>();
+
+	// Run with both io_uring (if available) and blocking threads backends
+	const bool force_fallback = GENERATE(false, true);
+	INFO("Forced fallback: " << force_fallback);
+	AsyncFileIoService aio_svc(engine->serviceLocator(),
+		AsyncFileIoService::Config { .force_fallback = force_fallback });
+
+	constexpr size_t N = 16;
+	constexpr size_t BLOCK_SIZE = 100;
+
+	auto file = aio_svc.registerFile(os::File::open(tmp_path / "file.bin",
+		os::FileFlags { os::FileFlagsBit::AsyncIo, os::FileFlagsBit::Read, os::FileFlagsBit::Write,
+			os::FileFlagsBit::Create }));
+
+	// Blocks are filled with their index
+	std::vector<std::byte> source(N * BLOCK_SIZE);
+	for (size_t i = 0; i < source.size(); i++) {
+		source[i] = std::byte(i / BLOCK_SIZE);
+	}
+
+	std::atomic_size_t errors = 0;
+
+	auto coro = [](std::atomic_size_t &errs, AsyncFileIoService &srv, AsyncFileIoService::Ptr file,
+					std::span<const std::byte> src) -> CoroTask {
+		// Write blocks in reverse order with one vectored write
+		std::vector<std::span<const std::byte>> write_bufs;
+		for (size_t i = N; i-- > 0;) {
+			write_bufs.emplace_back(src.subspan(i * BLOCK_SIZE, BLOCK_SIZE));
+		}
+
+		AsyncFileIoService::WriteResult write_result = co_await srv.asyncWritev(file, write_bufs, 0);
+		if (write_result.has_error()) {
+			errs.fetch_add(1);
+			co_return;
+		}
+
+		// Read blocks back with a batch, restoring the original order
+		std::vector<std::byte> dst(src.size());
+		std::vector<AsyncFileIoService::ReadRequest> requests;
+		for (size_t i = 0; i < N; i++) {
+			requests.push_back({
+				.file = file,
+				.buffer = std::span(dst).subspan(i * BLOCK_SIZE, BLOCK_SIZE),
+				.offset = int64_t((N - i - 1) * BLOCK_SIZE),
+			});
+		}
+
+		// Batch request past EOF must return a short read
+		std::byte extra[BLOCK_SIZE];
+		requests.push_back({ .file = file, .buffer = extra, .offset = int64_t(src.size() - 10) });
+
+		AsyncFileIoService::BatchReadResult results = co_await srv.asyncReadBatch(requests);
+		if (results.size() != N + 1) {
+			errs.fetch_add(1);
+			co_return;
+		}
+
+		for (size_t i = 0; i < N; i++) {
+			if (results[i].has_error() || *results[i] != BLOCK_SIZE) {
+				errs.fetch_add(1);
+			}
+		}
+
+		if (results[N].has_error() || *results[N] != 10) {
+			errs.fetch_add(1);
+		}
+
+		if (memcmp(dst.data(), src.data(), src.size()) != 0) {
+			errs.fetch_add(1);
+		}
+
+		// Vectored read of the whole file into two halves of a larger buffer
+		std::vector<std::byte> dst2(src.size() + BLOCK_SIZE);
+		const size_t half = src.size() / 2;
+		std::span<std::byte> read_bufs[2] = { std::span(dst2).first(half), std::span(dst2).subspan(half) };
+
+		AsyncFileIoService::ReadResult read_result = co_await srv.asyncReadv(file, read_bufs, 0);
+		if (read_result.has_error() || *read_result != src.size()) {
+			errs.fetch_add(1);
+			co_return;
+		}
+
+		// Layout on disk is reversed
+		for (size_t i = 0; i < src.size(); i++) {
+			if (dst2[i] != std::byte(N - i / BLOCK_SIZE - 1)) {
+				errs.fetch_add(1);
+				co_return;
+			}
+		}
+	};
+
+	TaskBuilder bld(task_svc);
+	bld.enqueueTask(coro(errors, aio_svc, std::move(file), source));
+	bld.addWait(bld.getLastTaskCounter());
+	bld.enqueueSyncPoint().wait();
+
+	CHECK(errors.load() == 0);
+}
+
 } // namespace voxen::svc
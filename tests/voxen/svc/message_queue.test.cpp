@@ -5,6 +5,10 @@
 
 #include "../../voxen_test_common.hpp"
 
+#include <array>
+#include <utility>
+#include <vector>
+
 namespace voxen::svc
 {
 
@@ -32,9 +36,47 @@ struct TestRequestMessage {
 	int sum;
 };
 
+struct TestBroadcastMessage {
+	constexpr static UID MESSAGE_UID = UID("7d3e9a52-0c4bf186-e95a27d3-4b81c06f");
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Broadcast;
+
+	TestBroadcastMessage(int v, int* d) noexcept : value(v), destroyed(d) {}
+	TestBroadcastMessage(TestBroadcastMessage&&) = delete;
+	TestBroadcastMessage(const TestBroadcastMessage&) = delete;
+	TestBroadcastMessage& operator=(TestBroadcastMessage&&) = delete;
+	TestBroadcastMessage& operator=(const TestBroadcastMessage&) = delete;
+	~TestBroadcastMessage() noexcept { (*destroyed)++; }
+
+	int value;
+	int* destroyed;
+};
+
+struct TestBroadcastSignal {
+	constexpr static UID MESSAGE_UID = UID("e2a04f7c-936db815-5fc1e04a-a87d3b29");
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Broadcast;
+};
+
+// The first half has distinct `v0` parts, the second half shares it and
+// can't be mapped to distinct slots, forcing the dispatch table into probing
+template<size_t I>
+struct TestDispatchSignal {
+	constexpr static UID MESSAGE_UID = I < 16 ? UID(0x9e3779b97f4a7c15 * (I + 1), I) : UID(0x3c5e8f1a2b7d9046, I);
+	constexpr static svc::MessageClass MESSAGE_CLASS = svc::MessageClass::Unicast;
+};
+
+// Too large to be stored inline in a handler function object
+struct TestCountingHandler {
+	std::vector<int>* counters;
+	size_t index;
+	std::array<uint64_t, 4> padding = {};
+
+	void operator()(MessageInfo&) const { (*counters)[index]++; }
+};
+
 constexpr UID U1("8819c518-0260c91d-db31ab20-f0daee10");
 constexpr UID U2("eb934a1d-ea3777fe-8aeaf67f-13149325");
 constexpr UID U3("5eba2318-3dd0e03a-7101e4e9-e7b8dbea");
+constexpr UID U4("a36f0d91-48e2c7b5-0d9b6e13-f52a84c7");
 
 } // namespace
 
@@ -258,4 +300,193 @@ TEST_CASE("'MessageQueue' basic request test", "[voxen::svc::message_queue]")
 	}
 }
 
+TEST_CASE("'MessageQueue' basic broadcast test", "[voxen::svc::message_queue]")
+{
+	auto engine = Engine::createForTestSuite();
+
+	MessageQueue mq1;
+	MessageQueue mq2;
+	MessageQueue mq3;
+
+	int destroyed = 0;
+	const TestBroadcastMessage* payload_addr[2] = {};
+	int signals_received = 0;
+
+	{
+		auto& msg = engine->serviceLocator().requestService<MessagingService>();
+
+		mq1 = msg.registerAgent(U1);
+		mq1.registerHandler<TestBroadcastSignal>([&](MessageInfo& info) {
+			CHECK(info.senderUid() == U2);
+			signals_received++;
+		});
+
+		mq2 = msg.registerAgent(U2);
+		mq2.registerHandler<TestBroadcastMessage>([&](const TestBroadcastMessage& m, MessageInfo& info) {
+			CHECK(info.senderUid() == U1);
+			CHECK(m.value == 42);
+			payload_addr[0] = &m;
+		});
+
+		mq3 = msg.registerAgent(U3);
+		mq3.registerHandler<TestBroadcastMessage>([&](const TestBroadcastMessage& m, MessageInfo& info) {
+			CHECK(info.senderUid() == U1);
+			CHECK(m.value == 42);
+			payload_addr[1] = &m;
+		});
+	}
+
+	{
+		INFO("Broadcasting to two subscribers");
+
+		mq1.broadcast<TestBroadcastMessage>(42, &destroyed);
+
+		mq2.waitMessages();
+		// Payload is shared, it must not be destroyed until every recipient is done
+		CHECK(destroyed == 0);
+		mq3.waitMessages();
+		CHECK(destroyed == 1);
+
+		// Both recipients must have seen the same payload object
+		CHECK(payload_addr[0] != nullptr);
+		CHECK(payload_addr[0] == payload_addr[1]);
+	}
+
+	{
+		INFO("Broadcasting after unsubscribing");
+
+		mq3.unregisterHandler<TestBroadcastMessage>();
+		payload_addr[0] = nullptr;
+		payload_addr[1] = nullptr;
+
+		mq1.broadcast<TestBroadcastMessage>(42, &destroyed);
+		mq2.waitMessages();
+		mq3.waitMessages(10);
+
+		CHECK(destroyed == 2);
+		CHECK(payload_addr[0] != nullptr);
+		CHECK(payload_addr[1] == nullptr);
+	}
+
+	{
+		INFO("Broadcasting with no subscribers");
+
+		mq2.unregisterHandler<TestBroadcastMessage>();
+		mq1.broadcast<TestBroadcastMessage>(42, &destroyed);
+		// Dropped right away
+		CHECK(destroyed == 3);
+	}
+
+	{
+		INFO("Broadcasting signal");
+
+		mq2.broadcast<TestBroadcastSignal>();
+		mq2.broadcast<TestBroadcastSignal>();
+		mq1.waitMessages();
+		mq1.waitMessages(10);
+
+		CHECK(signals_received == 2);
+	}
+
+	{
+		INFO("Destroying subscribed queue");
+
+		auto& msg = engine->serviceLocator().requestService<MessagingService>();
+
+		{
+			MessageQueue mq4 = msg.registerAgent(U4);
+			mq4.registerHandler<TestBroadcastSignal>([&](MessageInfo&) { signals_received++; });
+		}
+
+		// Must unsubscribe on destruction, otherwise the broadcast
+		// would go to a released (or reused) inbound queue
+		mq2.broadcast<TestBroadcastSignal>();
+		mq1.waitMessages();
+
+		{
+			// Reuse the same inbound queue for another agent
+			MessageQueue mq4 = msg.registerAgent(U4);
+			mq4.pollMessages();
+		}
+
+		CHECK(signals_received == 3);
+	}
+}
+
+TEST_CASE("'MessageQueue' handler registration and removal", "[voxen::svc::message_queue]")
+{
+	auto engine = Engine::createForTestSuite();
+	auto& msg = engine->serviceLocator().requestService<MessagingService>();
+
+	MessageQueue mq1 = msg.registerAgent(U1);
+	MessageQueue mq2 = msg.registerAgent(U2);
+
+	constexpr size_t NUM_TYPES = 32;
+	std::vector<int> received(NUM_TYPES);
+	std::vector<int> expected(NUM_TYPES);
+
+	auto register_handler = [&]<size_t I>(std::integral_constant<size_t, I>) {
+		mq2.registerHandler<TestDispatchSignal<I>>(TestCountingHandler { .counters = &received, .index = I });
+	};
+
+	auto unregister_handler = [&]<size_t I>(std::integral_constant<size_t, I>) {
+		mq2.unregisterHandler<TestDispatchSignal<I>>();
+	};
+
+	// Send one message of every type, count deliveries of those having handlers
+	auto send_all = [&]<size_t... I>(std::index_sequence<I...>, const std::vector<bool>& registered) {
+		(mq1.send<TestDispatchSignal<I>>(U2), ...);
+		mq2.waitMessages();
+
+		for (size_t i = 0; i < NUM_TYPES; i++) {
+			expected[i] += registered[i] ? 1 : 0;
+		}
+
+		return received == expected;
+	};
+
+	constexpr auto all_types = std::make_index_sequence<NUM_TYPES>();
+	std::vector<bool> registered(NUM_TYPES, true);
+
+	[&]<size_t... I>(std::index_sequence<I...>) {
+		(register_handler(std::integral_constant<size_t, I>()), ...);
+	}(all_types);
+
+	CHECK(send_all(all_types, registered));
+
+	// The most recently registered one, then one in the middle of both halves
+	unregister_handler(std::integral_constant<size_t, NUM_TYPES - 1>());
+	registered[NUM_TYPES - 1] = false;
+	CHECK(send_all(all_types, registered));
+
+	unregister_handler(std::integral_constant<size_t, 10>());
+	unregister_handler(std::integral_constant<size_t, 20>());
+	registered[10] = false;
+	registered[20] = false;
+	CHECK(send_all(all_types, registered));
+
+	// Removing an unregistered handler does nothing
+	unregister_handler(std::integral_constant<size_t, 10>());
+	CHECK(send_all(all_types, registered));
+
+	// Register them back
+	register_handler(std::integral_constant<size_t, 20>());
+	register_handler(std::integral_constant<size_t, NUM_TYPES - 1>());
+	register_handler(std::integral_constant<size_t, 10>());
+	registered.assign(NUM_TYPES, true);
+	CHECK(send_all(all_types, registered));
+
+	// Remove everything, then register just one
+	[&]<size_t... I>(std::index_sequence<I...>) {
+		(unregister_handler(std::integral_constant<size_t, I>()), ...);
+	}(all_types);
+
+	registered.assign(NUM_TYPES, false);
+	CHECK(send_all(all_types, registered));
+
+	register_handler(std::integral_constant<size_t, 17>());
+	registered[17] = true;
+	CHECK(send_all(all_types, registered));
+}
+
 } // namespace voxen::svc
@@ -3,13 +3,16 @@
 #include <voxen/os/time.hpp>
 #include <voxen/svc/engine.hpp>
 #include <voxen/svc/task_builder.hpp>
+#include <voxen/svc/task_context.hpp>
 #include <voxen/svc/task_coro.hpp>
 
 #include "../../voxen_test_common.hpp"
 
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <unordered_set>
+#include <vector>
 
 namespace voxen::svc
 {
@@ -439,4 +442,75 @@ TEST_CASE("'TaskService' test case 7", "[voxen::svc::task_service]")
 	CHECK(sum.load() == 882); // 63 (one fail) * 14 (2*(1+2*(1+2*(1))))
 }
 
+TEST_CASE("'TaskService' test case 8", "[voxen::svc::task_service]")
+{
+	auto engine = Engine::createForTestSuite();
+	// Separate instance with a known number of threads, stealing needs more than one
+	TaskService ts(engine->serviceLocator(), TaskService::Config { .num_threads = 4 });
+
+	// A single task enqueues a lot more subtasks than fits into its thread's
+	// local queue (and ring buffer too). This stresses local push, stealing
+	// by other threads and the overflow path. Subtasks spawn subtasks as well.
+	constexpr size_t NUM_SUBTASKS = 5000;
+	constexpr size_t NUM_SUBSUBTASKS = 4;
+
+	std::atomic_size_t counter = 0;
+	std::atomic_size_t started_subtasks = 0;
+	std::vector<uint64_t> subtask_counters;
+	std::thread::id spawner_thread;
+	std::vector<std::thread::id> subtask_threads(NUM_SUBTASKS);
+
+	TaskBuilder bld(ts);
+	bld.enqueueTask([&](TaskContext &ctx) {
+		spawner_thread = std::this_thread::get_id();
+		TaskBuilder inner_bld(ctx.taskService());
+
+		for (size_t i = 0; i < NUM_SUBTASKS; i++) {
+			inner_bld.enqueueTask([&counter, &started_subtasks, &subtask_threads, i](TaskContext &inner_ctx) {
+				subtask_threads[i] = std::this_thread::get_id();
+				started_subtasks.fetch_add(1);
+				TaskBuilder leaf_bld(inner_ctx.taskService());
+
+				for (size_t j = 0; j < NUM_SUBSUBTASKS; j++) {
+					leaf_bld.enqueueTask([&counter](TaskContext &) { counter.fetch_add(1); });
+				}
+
+				counter.fetch_add(1);
+			});
+			subtask_counters.emplace_back(inner_bld.getLastTaskCounter());
+		}
+
+		// Keep this thread busy so it doesn't take its subtasks back.
+		// Otherwise it might drain its own deque before others wake up.
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (started_subtasks.load() < NUM_SUBTASKS && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	bld.addWait(bld.getLastTaskCounter());
+	bld.enqueueSyncPoint().wait();
+
+	// Subtasks don't wait for their children, so wait for the counter to reach the final value
+	bld.addWait(subtask_counters);
+	bld.enqueueSyncPoint().wait();
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	while (counter.load() < NUM_SUBTASKS * (1 + NUM_SUBSUBTASKS) && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	CHECK(counter.load() == NUM_SUBTASKS * (1 + NUM_SUBSUBTASKS));
+
+	// The first subtasks were pushed into the spawner's work deque (it holds 1024),
+	// other threads could only get them by stealing
+	size_t stolen_subtasks = 0;
+	for (size_t i = 0; i < 1000; i++) {
+		if (subtask_threads[i] != spawner_thread) {
+			stolen_subtasks++;
+		}
+	}
+
+	CHECK(stolen_subtasks > 0);
+}
+
 } // namespace voxen::svc